@@ -0,0 +1,30 @@
+// Camera facing sprite expansion shared by GSMain and VSSpriteMain. ExpandBillboard in
+// shadow-core/Billboard.h does the same math on the CPU.
+
+// corners in triangle strip order
+static const float3 g_BillboardCorners[4] =
+{
+    float3(-1, 1, 0),
+    float3(1, 1, 0),
+    float3(-1, -1, 0),
+    float3(1, -1, 0),
+};
+
+static const float2 g_BillboardTexcoords[4] =
+{
+    float2(0, 0),
+    float2(1, 0),
+    float2(0, 1),
+    float2(1, 1),
+};
+
+// the corner offset is rotated into world space by the upper 3x3 of the inverse view matrix
+float3 BillboardCornerPosition(float3 center, float radius, row_major float4x4 invView, uint corner)
+{
+    return mul(g_BillboardCorners[corner] * radius, (float3x3) invView) + center;
+}
+
+float2 BillboardCornerTexcoord(uint corner)
+{
+    return g_BillboardTexcoords[corner];
+}
@@ -3,6 +3,7 @@ struct Particle
     float3 pos;
     float radius;
     float opacity;
+    uint color; // RGBA8, see Particle::color
 };
 
 StructuredBuffer<Particle> sbParticles : register(t0);
@@ -11,6 +12,10 @@ RWBuffer<float> sbShadows : register(u0);
 cbuffer cbCS : register(b0)
 {
     float3 sunDir;
+    uint particlesCount;
+    float3 up;
+    uint dispatchGroupsX;
+    float3 forward;
 }
 
 bool NeverIntersects(float3 particlePos, float3 otherParticlePos);
@@ -18,11 +23,9 @@ bool NeverIntersects(float3 particlePos, float3 otherParticlePos);
 [numthreads(THREAD_X, THREAD_Y, 1)]
 void CSMain(uint3 groupID : SV_GroupID, uint3 dispatchID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupThreadID, uint groupIndex : SV_GroupIndex)
 {
-    uint index = groupID.x * THREAD_X + groupThreadID.x + (groupID.y * THREAD_Y + groupThreadID.y) * THREAD_X;
-        
-    uint particlesCount = THREAD_X * THREAD_Y;
+    uint index = (groupID.y * dispatchGroupsX + groupID.x) * (THREAD_X * THREAD_Y) + groupIndex;
     
-    if (index > particlesCount)
+    if (index >= particlesCount)
     {
         return;
     }
@@ -33,7 +36,7 @@ void CSMain(uint3 groupID : SV_GroupID, uint3 dispatchID : SV_DispatchThreadID,
     
     float3 origin = particle.pos;
         
-    for (int i = 0; i < particlesCount; ++i)
+    for (uint i = 0; i < particlesCount; ++i)
     {
         if (i == index)
         {
@@ -67,49 +70,8 @@ void CSMain(uint3 groupID : SV_GroupID, uint3 dispatchID : SV_DispatchThreadID,
     }
 }
 
+// the other particle is not ahead along the light, the ray towards the sun cannot hit it
 bool NeverIntersects(float3 particlePos, float3 otherParticlePos)
 {
-    if (sunDir.x == 1.0f)
-    {
-        if (otherParticlePos.x <= particlePos.x)
-        {
-            return true;
-        }
-    }
-    if (sunDir.x == -1.0f)
-    {
-        if (otherParticlePos.x >= particlePos.x)
-        {
-            return true;
-        }
-    }
-    if (sunDir.y == 1.0f)
-    {
-        if (otherParticlePos.y <= particlePos.y)
-        {
-            return true;
-        }
-    }
-    if (sunDir.y == -1.0f)
-    {
-        if (otherParticlePos.y >= particlePos.y)
-        {
-            return true;
-        }
-    }
-    if (sunDir.z == 1.0f)
-    {
-        if (otherParticlePos.z <= particlePos.z)
-        {
-            return true;
-        }
-    }
-    if (sunDir.z == -1.0f)
-    {
-        if (otherParticlePos.z >= particlePos.z)
-        {
-            return true;
-        }
-    }
-    return false;
+    return dot(otherParticlePos - particlePos, sunDir) <= 0.0f;
 }
@@ -3,104 +3,148 @@ struct Particle
     float3  pos;
     float   radius;
     float   opacity;
+    uint    color;  // RGBA8, see Particle::color
 };
 
 StructuredBuffer<Particle> sbParticles : register(t0);
 RWBuffer<float> sbShadows : register(u0);
 
+// the incremental pass starts from the slot computed before and only reshades receivers whose
+// bit is set in sbDirtyMask, bit index % 32 of word index / 32
+RWBuffer<float> sbPreviousShadows : register(u1);
+StructuredBuffer<uint> sbDirtyMask : register(t1);
+
+// sunDir, up and forward are an orthonormal basis built on the CPU by SunBasis::FromDirection
 cbuffer cbCS : register(b0)
 {
     float3  sunDir;
+    uint    particlesCount;
+    float3  up;
+    uint    dispatchGroupsX;
+    float3  forward;
+    uint    incremental;
 }
 
-groupshared float3 sunBasis[THREAD_X * THREAD_Y];
+float3 ToSunBasis(float3 pos);
+
+#define GROUP_SIZE (THREAD_X * THREAD_Y)
+
+// one tile of occluders, loaded by the whole group and consumed by every thread of it
+groupshared float3 tileSunBasisPos[GROUP_SIZE];
+groupshared float tileRadius[GROUP_SIZE];
+groupshared float tileOpacity[GROUP_SIZE];
 
-int Sign(float value);
+groupshared uint groupDirty;
 
 [numthreads(THREAD_X, THREAD_Y, 1)]
 void CSMain(uint3 groupID : SV_GroupID, uint3 dispatchID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupThreadID, uint groupIndex : SV_GroupIndex)
 {
-    uint index = groupID.x * THREAD_X + groupThreadID.x + (groupID.y * THREAD_Y + groupThreadID.y) * THREAD_X;
+    // groups are laid out row by row so that more than 65535 of them can be dispatched
+    uint groupStart = (groupID.y * dispatchGroupsX + groupID.x) * GROUP_SIZE;
+    uint index = groupStart + groupIndex;
 
-    uint particlesCount = THREAD_X * THREAD_Y;
+    // the whole group is past the end, nobody is left to wait for at the barriers
+    if (groupStart >= particlesCount)
+    {
+        return;
+    }
 
-    /*
-         if (index >= particlesCount)
-         {
-            return;
-         }
-    
-        cannot be used here.
-        It causes thread-divergent control flow before sync (the early exit error).
-    */
+    // tail threads still have to load their part of every tile and reach every barrier
+    bool active = index < particlesCount;
 
-    if (index < particlesCount)
+    if (incremental != 0)
     {
-        int sunDirX = sunDir.x;
-        int sunDirY = sunDir.y;
-        int sunDirZ = sunDir.z;
-
-        float3 up;
-        up.x = sunDirX ^ (Sign(sunDirX) * 1);
-        up.y = sunDirY ^ (Sign(sunDirY) * 1);
-        up.z = sunDirZ ^ (Sign(sunDirZ) * 1);
-        
-        if (length(up) == 0.0f)
+        bool dirty = active && (sbDirtyMask[index / 32] & (1u << (index % 32))) != 0;
+
+        if (groupIndex == 0)
         {
-            if (Sign(sunDirY) == Sign(sunDirZ))
-            {
-                up = float3(0.0f, -1.0f, 1.0f);
-            }
-            else
-            {
-                up = float3(0.0f, 1.0f, 1.0f);
-            }
+            groupDirty = 0;
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (dirty)
+        {
+            InterlockedOr(groupDirty, 1);
         }
-        
-        float3 forward = cross(sunDir, up);
 
-        float3 curPos = sbParticles[index].pos;
+        GroupMemoryBarrierWithGroupSync();
 
-        float3 sunBasisPos = float3(
-            dot(curPos, sunDir),
-            dot(curPos, up),
-            dot(curPos, forward)
-        );
+        // receivers no change reached keep the shadow they had in the previous slot
+        if (active && !dirty)
+        {
+            sbShadows[index] = sbPreviousShadows[index];
+        }
 
-        sunBasis[index] = sunBasisPos;
+        // groupDirty is the same for the whole group, so it leaves together
+        if (groupDirty == 0)
+        {
+            return;
+        }
+
+        // clean threads still load their part of every tile below
+        active = dirty;
     }
-    
-    GroupMemoryBarrierWithGroupSync();
 
-    if (index >= particlesCount)
+    float radius = 0.0f;
+    float3 sunBasisPos = float3(0.0f, 0.0f, 0.0f);
+
+    if (active)
     {
-        return;
+        radius = sbParticles[index].radius;
+        sunBasisPos = ToSunBasis(sbParticles[index].pos);
     }
-    
-    float radius = sbParticles[index].radius;
-    
-    float3 sunBasisPos = sunBasis[index];
-    
-    for (int i = 0; i < particlesCount; ++i)
+
+    float shadow = 1.0f;
+
+    for (uint tileStart = 0; tileStart < particlesCount; tileStart += GROUP_SIZE)
     {
-        if (i == index)
+        uint load = tileStart + groupIndex;
+
+        if (load < particlesCount)
         {
-            continue;
+            tileSunBasisPos[groupIndex] = ToSunBasis(sbParticles[load].pos);
+            tileRadius[groupIndex] = sbParticles[load].radius;
+            tileOpacity[groupIndex] = sbParticles[load].opacity;
         }
-        float otherRadius = sbParticles[i].radius;
-        
-        float3 sunBasisOtherPos = sunBasis[i];
-        
-        float3 dirToOther = sunBasisOtherPos - sunBasisPos;
-    
-        if (dirToOther.x >= 0.0f && length(dirToOther.yz) <= radius + otherRadius)
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (active)
         {
-            sbShadows[index] *= (1.0f - sbParticles[i].opacity);
-        }        
+            uint tileCount = min(GROUP_SIZE, particlesCount - tileStart);
+
+            for (uint i = 0; i < tileCount; ++i)
+            {
+                if (tileStart + i == index)
+                {
+                    continue;
+                }
+
+                float3 dirToOther = tileSunBasisPos[i] - sunBasisPos;
+
+                if (dirToOther.x >= 0.0f && length(dirToOther.yz) <= radius + tileRadius[i])
+                {
+                    shadow *= (1.0f - tileOpacity[i]);
+                }
+            }
+        }
+
+        // the next tile overwrites what slower threads may still be reading
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (active)
+    {
+        sbShadows[index] = shadow;
     }
 }
 
-int Sign(float value)
+float3 ToSunBasis(float3 pos)
 {
-    return (value != 0) ? value / abs(value) : 1;
+    return float3(
+        dot(pos, sunDir),
+        dot(pos, up),
+        dot(pos, forward)
+    );
 }
@@ -0,0 +1,209 @@
+struct Particle
+{
+    float3  pos;
+    float   radius;
+    float   opacity;
+    uint    color;
+};
+
+// root constants, matches CullConstants in DeviceContext.h
+cbuffer cbCull : register(b0)
+{
+    float4  frustumPlanes[6];   // Frustum of shadow-core/FrustumCull.h, normalized and facing inwards
+    uint    particlesCount;
+    uint    blockCount;         // groups of CSCullCount and CSCullCompact, BLOCK_SIZE entries each
+};
+
+StructuredBuffer<Particle> sbParticles : register(t0);
+
+// what CSScatter of SortShader.hlsl left, back to front
+StructuredBuffer<uint> sbDrawOrder : register(t1);
+
+// the survivors of every block, turned into where they start in sbVisible by CSCullScan
+RWStructuredBuffer<uint> sbBlockOffsets : register(u0);
+
+// the survivors in draw order, what the vertex stage reads as sbDrawOrder
+RWStructuredBuffer<uint> sbVisible : register(u1);
+
+// D3D12_DRAW_ARGUMENTS of the instanced sprite draw, then of the point list draw
+RWStructuredBuffer<uint> sbDrawArgs : register(u2);
+
+#define GROUP_SIZE 256
+#define ITEMS_PER_THREAD 8
+#define BLOCK_SIZE (GROUP_SIZE * ITEMS_PER_THREAD)
+
+// words of a bit per thread
+#define MASK_WORDS (GROUP_SIZE / 32)
+
+// SpriteBoundingRadius of shadow-core/FrustumCull.h
+#define SPRITE_BOUNDS_SCALE 1.41421356f
+
+// Frustum::Intersects
+bool IsVisible(uint particle)
+{
+    float3 center = sbParticles[particle].pos;
+    float radius = sbParticles[particle].radius * SPRITE_BOUNDS_SCALE;
+
+    [unroll]
+    for (uint i = 0; i < 6; ++i)
+    {
+        if (dot(center, frustumPlanes[i].xyz) + frustumPlanes[i].w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// entries of a thread are GROUP_SIZE apart, so every step of the group reads consecutive ones
+uint BlockIndex(uint group, uint item, uint thread)
+{
+    return group * BLOCK_SIZE + item * GROUP_SIZE + thread;
+}
+
+groupshared uint s_Count;
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSCullCount(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    if (threadId.x == 0)
+    {
+        s_Count = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint visible = 0;
+    for (uint item = 0; item < ITEMS_PER_THREAD; ++item)
+    {
+        uint index = BlockIndex(groupId.x, item, threadId.x);
+        if (index < particlesCount && IsVisible(sbDrawOrder[index]))
+        {
+            ++visible;
+        }
+    }
+
+    InterlockedAdd(s_Count, visible);
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadId.x == 0)
+    {
+        sbBlockOffsets[groupId.x] = s_Count;
+    }
+}
+
+groupshared uint s_Scan[GROUP_SIZE];
+
+// Exclusive prefix sum of the block counts in one group, like CSScanDigits of SortShader.hlsl,
+// and the total as the instance (or vertex) count of the indirect draw.
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSCullScan(uint3 threadId : SV_GroupThreadID)
+{
+    uint runLength = (blockCount + GROUP_SIZE - 1) / GROUP_SIZE;
+    uint first = min(threadId.x * runLength, blockCount);
+    uint last = min(first + runLength, blockCount);
+
+    uint runSum = 0;
+    for (uint i = first; i < last; ++i)
+    {
+        runSum += sbBlockOffsets[i];
+    }
+
+    s_Scan[threadId.x] = runSum;
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint offset = 1; offset < GROUP_SIZE; offset <<= 1)
+    {
+        uint value = s_Scan[threadId.x];
+        if (threadId.x >= offset)
+        {
+            value += s_Scan[threadId.x - offset];
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        s_Scan[threadId.x] = value;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint prefix = s_Scan[threadId.x] - runSum;
+    for (uint j = first; j < last; ++j)
+    {
+        uint count = sbBlockOffsets[j];
+        sbBlockOffsets[j] = prefix;
+        prefix += count;
+    }
+
+    if (threadId.x == GROUP_SIZE - 1)
+    {
+        uint visibleCount = s_Scan[threadId.x];
+
+        // 4 vertex strips instanced per particle
+        sbDrawArgs[0] = 4;
+        sbDrawArgs[1] = visibleCount;
+        sbDrawArgs[2] = 0;
+        sbDrawArgs[3] = 0;
+
+        // a point per particle
+        sbDrawArgs[4] = visibleCount;
+        sbDrawArgs[5] = 1;
+        sbDrawArgs[6] = 0;
+        sbDrawArgs[7] = 0;
+    }
+}
+
+// a bit per thread, set for the threads whose entry of the chunk survives
+groupshared uint s_VisibleThreads[MASK_WORDS];
+
+// Writes the block's survivors from its offset on, in draw order: the block goes through its
+// entries a chunk of GROUP_SIZE at a time and a survivor's place in the chunk is the number of
+// lower threads whose entry survived.
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSCullCompact(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint thread = threadId.x;
+    uint word = thread / 32;
+    uint bit = 1u << (thread % 32);
+
+    uint base = sbBlockOffsets[groupId.x];
+
+    for (uint item = 0; item < ITEMS_PER_THREAD; ++item)
+    {
+        if (thread < MASK_WORDS)
+        {
+            s_VisibleThreads[thread] = 0;
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        uint index = BlockIndex(groupId.x, item, thread);
+        uint particle = 0;
+        bool visible = false;
+        if (index < particlesCount)
+        {
+            particle = sbDrawOrder[index];
+            visible = IsVisible(particle);
+        }
+
+        if (visible)
+        {
+            InterlockedOr(s_VisibleThreads[word], bit);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        uint rank = countbits(s_VisibleThreads[word] & (bit - 1));
+        uint chunkCount = 0;
+        for (uint w = 0; w < MASK_WORDS; ++w)
+        {
+            uint bits = countbits(s_VisibleThreads[w]);
+            rank += w < word ? bits : 0;
+            chunkCount += bits;
+        }
+
+        if (visible)
+        {
+            sbVisible[base + rank] = particle;
+        }
+        base += chunkCount;
+
+        // every thread has read the masks before the next chunk clears them
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
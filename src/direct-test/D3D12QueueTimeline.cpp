@@ -0,0 +1,46 @@
+#include "D3D12QueueTimeline.h"
+
+D3D12QueueTimeline::D3D12QueueTimeline(ID3D12Device* device, ID3D12CommandQueue* queue) : m_Queue(queue)
+{
+    device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence));
+
+    m_FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+D3D12QueueTimeline::~D3D12QueueTimeline()
+{
+    CpuWait(m_LastSignaled);
+
+    CloseHandle(m_FenceEvent);
+}
+
+uint64_t D3D12QueueTimeline::Signal()
+{
+    ++m_LastSignaled;
+    m_Queue->Signal(m_Fence.Get(), m_LastSignaled);
+
+    return m_LastSignaled;
+}
+
+uint64_t D3D12QueueTimeline::GetCompletedValue() const
+{
+    return m_Fence->GetCompletedValue();
+}
+
+void D3D12QueueTimeline::GpuWait(const IQueueTimeline& other, uint64_t value)
+{
+    const D3D12QueueTimeline& otherQueue = static_cast<const D3D12QueueTimeline&>(other);
+
+    m_Queue->Wait(otherQueue.GetFence(), value);
+}
+
+void D3D12QueueTimeline::CpuWait(uint64_t value)
+{
+    if (m_Fence->GetCompletedValue() >= value)
+    {
+        return;
+    }
+
+    m_Fence->SetEventOnCompletion(value, m_FenceEvent);
+    WaitForSingleObject(m_FenceEvent, INFINITE);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "config.h"
+
+#include "AsyncShadowScheduler.h"
+
+// IQueueTimeline over a D3D12 command queue with a fence of its own
+class D3D12QueueTimeline : public IQueueTimeline
+{
+public:
+    D3D12QueueTimeline(ID3D12Device* device, ID3D12CommandQueue* queue);
+
+    D3D12QueueTimeline(const D3D12QueueTimeline&) = delete;
+    D3D12QueueTimeline& operator=(const D3D12QueueTimeline&) = delete;
+
+    ~D3D12QueueTimeline();
+
+    uint64_t Signal() override;
+
+    uint64_t GetCompletedValue() const override;
+
+    // other has to be a D3D12QueueTimeline on the same device
+    void GpuWait(const IQueueTimeline& other, uint64_t value) override;
+
+    void CpuWait(uint64_t value) override;
+
+    ID3D12Fence* GetFence() const { return m_Fence.Get(); }
+
+private:
+    ComPtr<ID3D12CommandQueue> m_Queue;
+    ComPtr<ID3D12Fence> m_Fence;
+    HANDLE m_FenceEvent;
+
+    UINT64 m_LastSignaled = 0;
+};
@@ -0,0 +1,438 @@
+#include "D3D12RenderBackend.h"
+
+#include "DepthSort.h"
+#include "FrustumCull.h"
+
+#include <climits>
+#include <cstddef>
+
+namespace
+{
+    // timestamps around the commands recorded while it lives, nothing without a ring
+    class GpuScope
+    {
+    public:
+        GpuScope(D3D12TimestampRing* ring, ID3D12GraphicsCommandList* commandList, const char* name)
+            : m_Ring(ring), m_CommandList(commandList), m_Scope(ring != nullptr ? ring->BeginScope(commandList, name) : UINT_MAX)
+        {
+        }
+
+        ~GpuScope()
+        {
+            if (m_Ring != nullptr)
+            {
+                m_Ring->EndScope(m_CommandList, m_Scope);
+            }
+        }
+
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+
+    private:
+        D3D12TimestampRing* m_Ring;
+        ID3D12GraphicsCommandList* m_CommandList;
+        UINT m_Scope;
+    };
+
+    // scopes recorded on one list per frame: simulation and shadows, or sort, cull and draw
+    const UINT MaxTimestampScopes = 8;
+}
+
+D3D12RenderBackend::D3D12RenderBackend(DeviceContext& gpu) : m_GPU(gpu)
+{
+}
+
+void D3D12RenderBackend::SetProfiler(Profiler* profiler)
+{
+    m_Profiler = profiler;
+
+    if (profiler != nullptr && m_ComputeTimestamps == nullptr)
+    {
+        m_ComputeTimestamps = std::make_unique<D3D12TimestampRing>(m_GPU.m_Device.Get(), m_GPU.m_ComputeCommandQueue.Get(), D3D12_COMMAND_LIST_TYPE_COMPUTE,
+            ProfileTrack::Compute, AsyncShadowScheduler::SlotCount, MaxTimestampScopes);
+        m_GraphicsTimestamps = std::make_unique<D3D12TimestampRing>(m_GPU.m_Device.Get(), m_GPU.m_CommandQueue.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT,
+            ProfileTrack::Graphics, static_cast<UINT>(DeviceContext::frameBufferCount), MaxTimestampScopes);
+    }
+}
+
+void D3D12RenderBackend::BeginCompute(uint32_t slot)
+{
+    // the scheduler made sure the slot's previous compute work retired
+    m_GPU.m_ComputeCommandAllocator[slot]->Reset();
+    m_GPU.m_ComputeCommandList->Reset(m_GPU.m_ComputeCommandAllocator[slot].Get(), m_GPU.m_ComputePipelineStateObject.Get());
+
+    // and with it the timestamps the slot resolved last time
+    if (ComputeTimestamps() != nullptr)
+    {
+        m_ComputeTimestamps->BeginSlot(slot, m_Profiler->GetFrame(), *m_Profiler);
+    }
+
+    ID3D12DescriptorHeap* ppHeaps[] = { m_GPU.m_srvDescriptorHeap.Get() };
+    m_GPU.m_ComputeCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+}
+
+void D3D12RenderBackend::UploadParticles(uint32_t slot, const ParticleRange* ranges, size_t rangeCount, const Particle* particles)
+{
+    ID3D12Resource* sbParticles = m_GPU.m_sbParticles[slot].Get();
+    ID3D12Resource* sbParticlesDelta = m_GPU.m_sbParticlesDelta[slot].Get();
+
+    m_GPU.m_ComputeCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sbParticles, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    // each range is staged at the offset it goes to
+    for (size_t i = 0; i < rangeCount; ++i)
+    {
+        uint32_t start = ranges[i].first;
+        UINT count = ranges[i].count;
+
+        // the slot's previous pass retired before BeginCompute returned, nothing reads the staging copy
+        memcpy(m_GPU.m_ParticlesDeltaData[slot] + start, &particles[start], count * sizeof(Particle));
+
+        UINT64 offset = static_cast<UINT64>(start) * sizeof(Particle);
+        m_GPU.m_ComputeCommandList->CopyBufferRegion(sbParticles, offset, sbParticlesDelta, offset, count * sizeof(Particle));
+    }
+
+    m_GPU.m_ComputeCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sbParticles, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+}
+
+void D3D12RenderBackend::DispatchSimulation(uint32_t slot, const SimulationStep& step)
+{
+    UINT previousSlot = (slot + AsyncShadowScheduler::SlotCount - 1) % AsyncShadowScheduler::SlotCount;
+
+    ID3D12GraphicsCommandList* commandList = m_GPU.m_ComputeCommandList.Get();
+    ID3D12Resource* sbParticles = m_GPU.m_sbParticles[slot].Get();
+
+    GpuScope scope(ComputeTimestamps(), commandList, "Simulation");
+
+    DeviceContext::SimulationConstantBuffer& cbSimulation = m_GPU.m_cbSimulation;
+    cbSimulation.deltaTime = step.deltaTime;
+    cbSimulation.emitSequence = step.emitSequence;
+    cbSimulation.emitCount = step.emitCount;
+
+    UINT64 cbOffset = static_cast<UINT64>(slot) * m_GPU.SimulationConstantBufferAlignedSize;
+    memcpy(m_GPU.m_cbSimulationGPUAddress + cbOffset, &cbSimulation, sizeof(cbSimulation));
+
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sbParticles, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+    commandList->SetComputeRootSignature(m_GPU.m_SimulationRootSignature.Get());
+    commandList->SetPipelineState(m_GPU.m_SimulatePipelineStateObject.Get());
+
+    commandList->SetComputeRootConstantBufferView(0, m_GPU.m_cbSimulationUploadHeap->GetGPUVirtualAddress() + cbOffset);
+    commandList->SetComputeRootConstantBufferView(1, m_GPU.m_DeadListCount->GetGPUVirtualAddress());
+    commandList->SetComputeRootShaderResourceView(2, m_GPU.m_sbParticles[previousSlot]->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(3, sbParticles->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(4, m_GPU.m_sbMotion->GetGPUVirtualAddress());
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE deadListHandle(m_GPU.m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), DeviceContext::DeadListUavIndex(), m_GPU.srvDescriptorSize);
+    commandList->SetComputeRootDescriptorTable(5, deadListHandle);
+
+    commandList->Dispatch(m_GPU.m_SimulationGroupsX, m_GPU.m_SimulationGroupsY, 1);
+
+    // CSEmit overwrites what CSSimulate appended and wrote, and needs its final dead count
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_DeadListCounter.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    commandList->CopyBufferRegion(m_GPU.m_DeadListCount.Get(), 0, m_GPU.m_DeadListCounter.Get(), 0, sizeof(uint32_t));
+
+    D3D12_RESOURCE_BARRIER afterCopy[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_DeadListCounter.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_DeadListCount.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER),
+    };
+    commandList->ResourceBarrier(_countof(afterCopy), afterCopy);
+
+    if (step.emitCount > 0)
+    {
+        UINT groupsX = 0;
+        UINT groupsY = 0;
+        m_GPU.SimulationDispatchSize(step.emitCount, groupsX, groupsY);
+
+        commandList->SetPipelineState(m_GPU.m_EmitPipelineStateObject.Get());
+        commandList->Dispatch(groupsX, groupsY, 1);
+    }
+
+    D3D12_RESOURCE_BARRIER afterEmit[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(sbParticles, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_DeadListCount.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST),
+    };
+    commandList->ResourceBarrier(_countof(afterEmit), afterEmit);
+}
+
+void D3D12RenderBackend::DispatchShadows(uint32_t slot, const uint32_t* dirtyMask)
+{
+    GpuScope scope(ComputeTimestamps(), m_GPU.m_ComputeCommandList.Get(), "Shadows");
+
+    if (dirtyMask != nullptr)
+    {
+        // one bit per receiver, the light source has none
+        memcpy(m_GPU.m_DirtyMaskData[slot], dirtyMask, (m_GPU.m_cbSunDir.particlesCount + 31) / 32 * sizeof(uint32_t));
+    }
+
+    m_GPU.m_cbSunDir.incremental = dirtyMask != nullptr ? 1 : 0;
+
+    UINT64 cbOffset = static_cast<UINT64>(slot) * m_GPU.ComputeConstantBufferAlignedSize;
+    memcpy(m_GPU.m_cbSunDirGPUAddress + cbOffset, &m_GPU.m_cbSunDir, sizeof(m_GPU.m_cbSunDir));
+
+    // the simulation step may have switched it on the same list
+    m_GPU.m_ComputeCommandList->SetPipelineState(m_GPU.m_ComputePipelineStateObject.Get());
+    m_GPU.m_ComputeCommandList->SetComputeRootSignature(m_GPU.m_ComputeRootSignature.Get());
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE srvHandle(m_GPU.m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), DeviceContext::ParticlesSrvIndex(slot), m_GPU.srvDescriptorSize);
+    m_GPU.m_ComputeCommandList->SetComputeRootDescriptorTable(0, srvHandle);
+
+    // the slot being computed and, right after it, the previous one
+    CD3DX12_GPU_DESCRIPTOR_HANDLE uavHandle(m_GPU.m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), DeviceContext::ShadowsUavIndex(slot), m_GPU.srvDescriptorSize);
+    m_GPU.m_ComputeCommandList->SetComputeRootDescriptorTable(1, uavHandle);
+
+    m_GPU.m_ComputeCommandList->SetComputeRootConstantBufferView(2, m_GPU.m_cbSunDirUploadHeap->GetGPUVirtualAddress() + cbOffset);
+
+    m_GPU.m_ComputeCommandList->SetComputeRootShaderResourceView(3, m_GPU.m_DirtyMask[slot]->GetGPUVirtualAddress());
+
+    m_GPU.m_ComputeCommandList->Dispatch(m_GPU.m_DispatchGroupsX, m_GPU.m_DispatchGroupsY, 1);
+}
+
+void D3D12RenderBackend::CopyShadowsToReadback(uint32_t slot, uint32_t readbackSlot)
+{
+    ID3D12Resource* sbShadows = m_GPU.m_sbShadows[slot].Get();
+
+    m_GPU.m_ComputeCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sbShadows, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+    m_GPU.m_ComputeCommandList->CopyResource(m_GPU.m_ReadbackBuffers[readbackSlot].Get(), sbShadows);
+
+    m_GPU.m_ComputeCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sbShadows, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+}
+
+void D3D12RenderBackend::SubmitCompute()
+{
+    if (ComputeTimestamps() != nullptr)
+    {
+        m_ComputeTimestamps->Resolve(m_GPU.m_ComputeCommandList.Get());
+    }
+
+    m_GPU.m_ComputeCommandList->Close();
+    ID3D12CommandList* ppCommandLists[] = { m_GPU.m_ComputeCommandList.Get() };
+
+    m_GPU.m_ComputeCommandQueue->ExecuteCommandLists(1, ppCommandLists);
+}
+
+void D3D12RenderBackend::Draw(uint32_t slot)
+{
+    m_GPU.WaitForPreviousFrame();
+
+    m_GPU.m_CommandAllocator[m_GPU.frameIndex]->Reset();
+
+    bool instanced = m_SpritePath == SpritePath::Instanced && m_GPU.m_SpritePipelineStateObject != nullptr;
+    ID3D12PipelineState* pipelineState = instanced ? m_GPU.m_SpritePipelineStateObject.Get() : m_GPU.m_PipelineStateObject.Get();
+
+    m_GPU.m_CommandList->Reset(m_GPU.m_CommandAllocator[m_GPU.frameIndex].Get(), pipelineState);
+
+    // the frame that last used frameIndex has been waited for, timestamps included
+    D3D12TimestampRing* timestamps = GraphicsTimestamps();
+    if (timestamps != nullptr)
+    {
+        timestamps->BeginSlot(m_GPU.frameIndex, m_Profiler->GetFrame(), *m_Profiler);
+    }
+
+    {
+        GpuScope scope(timestamps, m_GPU.m_CommandList.Get(), "Sort");
+        SortParticles(slot);
+    }
+
+    if (m_FrustumCull)
+    {
+        GpuScope scope(timestamps, m_GPU.m_CommandList.Get(), "Cull");
+        CullParticles(slot);
+    }
+    m_GPU.m_CommandList->SetPipelineState(pipelineState);
+
+    // transition the "frameIndex" render target from the present state to the render target state so the command list draws to it starting from here
+    m_GPU.m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_renderTargets[m_GPU.frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_GPU.m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_GPU.frameIndex, m_GPU.rtvDescriptorSize);
+
+    // get a handle to the depth/stencil buffer
+    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_GPU.m_dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+    m_GPU.m_CommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+
+    const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f }; // 0.0f, 0.2f, 0.4f, 1.0f
+    m_GPU.m_CommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+
+    m_GPU.m_CommandList->ClearDepthStencilView(m_GPU.m_dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+
+    ID3D12DescriptorHeap* heaps[] = { m_GPU.m_srvDescriptorHeap.Get() };
+    m_GPU.m_CommandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+    m_GPU.m_CommandList->SetGraphicsRootSignature(m_GPU.m_GraphicsRootSignature.Get()); // set the root signature
+
+    m_GPU.m_CommandList->RSSetViewports(1, &m_GPU.m_Viewport); // set the viewports
+    m_GPU.m_CommandList->RSSetScissorRects(1, &m_GPU.m_ScissorRect); // set the scissor rects
+    m_GPU.m_CommandList->IASetPrimitiveTopology(instanced ? D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D_PRIMITIVE_TOPOLOGY_POINTLIST); // set the primitive topology
+
+    m_GPU.m_CommandList->SetGraphicsRootConstantBufferView(0, m_GPU.m_constantBufferUploadHeaps[m_GPU.frameIndex]->GetGPUVirtualAddress());
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE srvHandle(m_GPU.m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), DeviceContext::ParticlesSrvIndex(slot), m_GPU.srvDescriptorSize);
+    m_GPU.m_CommandList->SetGraphicsRootDescriptorTable(1, srvHandle);
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE uavHandle(m_GPU.m_srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), DeviceContext::ShadowsUavIndex(slot), m_GPU.srvDescriptorSize);
+    m_GPU.m_CommandList->SetGraphicsRootDescriptorTable(2, uavHandle);
+
+    ID3D12Resource* drawOrder = m_FrustumCull ? m_GPU.m_CullVisible.Get() : m_GPU.m_SortValues[0].Get();
+    m_GPU.m_CommandList->SetGraphicsRootShaderResourceView(3, drawOrder->GetGPUVirtualAddress());
+
+    UINT particlesCount = static_cast<UINT>(m_GPU.m_Particles.size());
+
+    {
+        GpuScope scope(timestamps, m_GPU.m_CommandList.Get(), "Draw");
+
+        if (m_FrustumCull)
+        {
+            // the survivor count never comes back to the CPU
+            UINT64 argumentOffset = instanced ? 0 : sizeof(D3D12_DRAW_ARGUMENTS);
+            m_GPU.m_CommandList->ExecuteIndirect(m_GPU.m_DrawCommandSignature.Get(), 1, m_GPU.m_CullDrawArgs.Get(), argumentOffset, nullptr, 0);
+        }
+        else if (instanced)
+        {
+            // every instance is its own strip, so no strip cut is needed between particles
+            m_GPU.m_CommandList->DrawInstanced(4, particlesCount, 0, 0);
+        }
+        else
+        {
+            m_GPU.m_CommandList->DrawInstanced(particlesCount, 1, 0, 0);
+        }
+    }
+
+    // transition the "frameIndex" render target from the render target state to the present state. If the debug layer is enabled, you will receive a
+    // warning if present is called on the render target when it's not in the present state
+    m_GPU.m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_renderTargets[m_GPU.frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+
+    if (timestamps != nullptr)
+    {
+        timestamps->Resolve(m_GPU.m_CommandList.Get());
+    }
+
+    m_GPU.m_CommandList->Close();
+
+    ID3D12CommandList* ppCommandLists[] = { m_GPU.m_CommandList.Get() };
+    m_GPU.m_CommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+}
+
+void D3D12RenderBackend::SortParticles(uint32_t slot)
+{
+    ID3D12GraphicsCommandList* commandList = m_GPU.m_CommandList.Get();
+
+    // the view the constant buffer of this frame was loaded with
+    ViewDepth view = ViewDepth::FromInvView(m_GPU.m_cbPerObject.invViewMat);
+
+    DeviceContext::SortConstants constants = {};
+    constants.viewAxis = view.axis;
+    constants.viewOffset = view.offset;
+    constants.particlesCount = static_cast<UINT>(m_GPU.m_Particles.size());
+    constants.blockCount = m_GPU.m_SortBlockCount;
+
+    const UINT constantsCount = sizeof(constants) / sizeof(UINT);
+    const UINT shiftIndex = offsetof(DeviceContext::SortConstants, shift) / sizeof(UINT);
+
+    // the previous draw read the order as sbDrawOrder
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_SortValues[0].Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+    commandList->SetComputeRootSignature(m_GPU.m_SortRootSignature.Get());
+    commandList->SetComputeRoot32BitConstants(0, constantsCount, &constants, 0);
+    commandList->SetComputeRootShaderResourceView(1, m_GPU.m_sbParticles[slot]->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(6, m_GPU.m_SortBlockOffsets->GetGPUVirtualAddress());
+
+    auto bindPairs = [&](int source)
+        {
+            commandList->SetComputeRootUnorderedAccessView(2, m_GPU.m_SortKeys[source]->GetGPUVirtualAddress());
+            commandList->SetComputeRootUnorderedAccessView(3, m_GPU.m_SortValues[source]->GetGPUVirtualAddress());
+            commandList->SetComputeRootUnorderedAccessView(4, m_GPU.m_SortKeys[1 - source]->GetGPUVirtualAddress());
+            commandList->SetComputeRootUnorderedAccessView(5, m_GPU.m_SortValues[1 - source]->GetGPUVirtualAddress());
+        };
+
+    // keys and the identity order into the first pair, which is the draw order when not sorting
+    bindPairs(0);
+    commandList->SetPipelineState(m_GPU.m_SortKeysPipelineStateObject.Get());
+    commandList->Dispatch(m_GPU.m_SortBlockCount, 1, 1);
+
+    if (m_DepthSort)
+    {
+        // an even number of passes, so the sorted pairs end up in the first pair again
+        for (UINT pass = 0; pass < 4; ++pass)
+        {
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+            bindPairs(pass % 2);
+            commandList->SetComputeRoot32BitConstant(0, pass * 8, shiftIndex);
+
+            commandList->SetPipelineState(m_GPU.m_SortCountPipelineStateObject.Get());
+            commandList->Dispatch(m_GPU.m_SortBlockCount, 1, 1);
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_GPU.m_SortBlockOffsets.Get()));
+
+            commandList->SetPipelineState(m_GPU.m_SortScanPipelineStateObject.Get());
+            commandList->Dispatch(1, 1, 1);
+            commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_GPU.m_SortBlockOffsets.Get()));
+
+            commandList->SetPipelineState(m_GPU.m_SortScatterPipelineStateObject.Get());
+            commandList->Dispatch(m_GPU.m_SortBlockCount, 1, 1);
+        }
+    }
+
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_SortValues[0].Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+}
+
+void D3D12RenderBackend::CullParticles(uint32_t slot)
+{
+    ID3D12GraphicsCommandList* commandList = m_GPU.m_CommandList.Get();
+
+    // the frustum of the matrices this frame was loaded with
+    Frustum frustum = Frustum::FromViewProjection(m_GPU.m_cbPerObject.wvpMat);
+
+    DeviceContext::CullConstants constants = {};
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        constants.frustumPlanes[plane] = frustum.planes[plane];
+    }
+    constants.particlesCount = static_cast<UINT>(m_GPU.m_Particles.size());
+    constants.blockCount = m_GPU.m_CullBlockCount;
+
+    // the previous draw read both
+    D3D12_RESOURCE_BARRIER beforeCull[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_CullVisible.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_CullDrawArgs.Get(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+    };
+    commandList->ResourceBarrier(_countof(beforeCull), beforeCull);
+
+    commandList->SetComputeRootSignature(m_GPU.m_CullRootSignature.Get());
+    commandList->SetComputeRoot32BitConstants(0, sizeof(constants) / sizeof(UINT), &constants, 0);
+    commandList->SetComputeRootShaderResourceView(1, m_GPU.m_sbParticles[slot]->GetGPUVirtualAddress());
+    commandList->SetComputeRootShaderResourceView(2, m_GPU.m_SortValues[0]->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(3, m_GPU.m_CullBlockOffsets->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(4, m_GPU.m_CullVisible->GetGPUVirtualAddress());
+    commandList->SetComputeRootUnorderedAccessView(5, m_GPU.m_CullDrawArgs->GetGPUVirtualAddress());
+
+    commandList->SetPipelineState(m_GPU.m_CullCountPipelineStateObject.Get());
+    commandList->Dispatch(m_GPU.m_CullBlockCount, 1, 1);
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_GPU.m_CullBlockOffsets.Get()));
+
+    commandList->SetPipelineState(m_GPU.m_CullScanPipelineStateObject.Get());
+    commandList->Dispatch(1, 1, 1);
+    commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_GPU.m_CullBlockOffsets.Get()));
+
+    commandList->SetPipelineState(m_GPU.m_CullCompactPipelineStateObject.Get());
+    commandList->Dispatch(m_GPU.m_CullBlockCount, 1, 1);
+
+    D3D12_RESOURCE_BARRIER afterCull[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_CullVisible.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_GPU.m_CullDrawArgs.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+    };
+    commandList->ResourceBarrier(_countof(afterCull), afterCull);
+}
+
+void D3D12RenderBackend::Present()
+{
+    // this command goes in at the end of our command queue. we will know when our command queue
+    // has finished because the m_Fence value will be set to "fenceValue" from the GPU since the command
+    // queue is being executed on the GPU
+    m_GPU.m_CommandQueue->Signal(m_GPU.m_Fence[m_GPU.frameIndex].Get(), m_GPU.m_FenceValue[m_GPU.frameIndex]);
+
+    // present the current backbuffer
+    m_GPU.m_SwapChain->Present(0, 0);
+}
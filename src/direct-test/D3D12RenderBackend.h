@@ -0,0 +1,89 @@
+#pragma once
+#include "DeviceContext.h"
+#include "D3D12TimestampRing.h"
+
+#include "Profiler.h"
+#include "RenderBackend.h"
+
+#include <memory>
+
+// how Draw turns particles into sprites
+enum class SpritePath
+{
+    Instanced,      // VSSpriteMain, 4 vertex triangle strip instanced per particle
+    GeometryShader, // VSMain points expanded by GSMain
+};
+
+// IRenderBackend over the resources of a DeviceContext: the compute list, root signatures and
+// descriptor tables of the shadow and simulation passes, and the swap chain frames.
+class D3D12RenderBackend : public IRenderBackend
+{
+public:
+    explicit D3D12RenderBackend(DeviceContext& gpu);
+
+    IQueueTimeline& GetComputeQueue() override { return *m_GPU.m_ComputeTimeline; }
+    IQueueTimeline& GetGraphicsQueue() override { return *m_GPU.m_GraphicsTimeline; }
+
+    uint32_t GetReadbackSlotCount() const override { return DeviceContext::readbackSlotCount; }
+
+    void BeginCompute(uint32_t slot) override;
+
+    void UploadParticles(uint32_t slot, const ParticleRange* ranges, size_t rangeCount, const Particle* particles) override;
+
+    void DispatchSimulation(uint32_t slot, const SimulationStep& step) override;
+
+    void DispatchShadows(uint32_t slot, const uint32_t* dirtyMask) override;
+
+    void CopyShadowsToReadback(uint32_t slot, uint32_t readbackSlot) override;
+
+    void SubmitCompute() override;
+
+    void Draw(uint32_t slot) override;
+
+    void Present() override;
+
+    const float* ReadShadows(uint32_t readbackSlot) override { return m_GPU.m_ReadbackData[readbackSlot]; }
+
+    // Instanced is used whenever its pipeline state could be created, GeometryShader otherwise
+    void SetSpritePath(SpritePath path) { m_SpritePath = path; }
+
+    // Particles are drawn back to front so their blending does not depend on the particle order,
+    // without the sort they are drawn in index order.
+    void SetDepthSort(bool enabled) { m_DepthSort = enabled; }
+
+    // Particles whose sprite can not reach the view are culled on the GPU and the survivors drawn
+    // through ExecuteIndirect, without the cull every particle goes through the vertex stage.
+    void SetFrustumCull(bool enabled) { m_FrustumCull = enabled; }
+
+    // Times the compute passes and the draw with timestamp queries. Their results reach profiler
+    // when the slot that recorded them comes around again, a few frames late. nullptr stops.
+    void SetProfiler(Profiler* profiler);
+
+private:
+    // Records the depth sort of slot's particles on the direct list ahead of the draw, leaving
+    // the draw order in m_SortValues[0]. See SortShader.hlsl.
+    void SortParticles(uint32_t slot);
+
+    // Records the frustum cull of the draw order after SortParticles, leaving the survivors in
+    // m_CullVisible and the draw arguments in m_CullDrawArgs. See CullShader.hlsl.
+    void CullParticles(uint32_t slot);
+
+    DeviceContext& m_GPU;
+
+    SpritePath m_SpritePath = SpritePath::Instanced;
+
+    bool m_DepthSort = true;
+
+    bool m_FrustumCull = true;
+
+    Profiler* m_Profiler = nullptr;
+
+    // by compute slot and by swap chain frame, created with the first profiler and kept, the GPU
+    // may still write into them
+    std::unique_ptr<D3D12TimestampRing> m_ComputeTimestamps;
+    std::unique_ptr<D3D12TimestampRing> m_GraphicsTimestamps;
+
+    // the rings while a profiler is set, nullptr otherwise
+    D3D12TimestampRing* ComputeTimestamps() const { return m_Profiler != nullptr ? m_ComputeTimestamps.get() : nullptr; }
+    D3D12TimestampRing* GraphicsTimestamps() const { return m_Profiler != nullptr ? m_GraphicsTimestamps.get() : nullptr; }
+};
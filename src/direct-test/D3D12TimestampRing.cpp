@@ -0,0 +1,107 @@
+#include "D3D12TimestampRing.h"
+
+#include <climits>
+
+D3D12TimestampRing::D3D12TimestampRing(ID3D12Device* device, ID3D12CommandQueue* queue, D3D12_COMMAND_LIST_TYPE type, ProfileTrack track, UINT slotCount, UINT maxScopes)
+    : m_Queue(queue), m_Track(track), m_MaxScopes(maxScopes), m_Slots(slotCount)
+{
+    UINT queryCount = slotCount * maxScopes * 2;
+
+    // copy queues would need D3D12_QUERY_HEAP_TYPE_COPY_QUEUE_TIMESTAMP, direct and compute share this one
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = queryCount;
+    device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_QueryHeap));
+
+    device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(UINT64(queryCount) * sizeof(UINT64)),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_Readback));
+
+    m_Readback->SetName(type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"Compute Timestamps Readback" : L"Graphics Timestamps Readback");
+
+    // persistently mapped, a slot is only read once the GPU is done writing it
+    m_Readback->Map(0, nullptr, reinterpret_cast<void**>(&m_ReadbackData));
+
+    m_Queue->GetTimestampFrequency(&m_TimestampFrequency);
+    QueryPerformanceFrequency(&m_CpuFrequency);
+}
+
+D3D12TimestampRing::~D3D12TimestampRing()
+{
+    m_Readback->Unmap(0, nullptr);
+}
+
+void D3D12TimestampRing::BeginSlot(UINT slot, uint64_t frame, Profiler& profiler)
+{
+    Slot& previous = m_Slots[slot];
+    if (previous.resolved && !previous.names.empty())
+    {
+        // GPU ticks to the steady_clock of the profiler, which counts QueryPerformanceCounter on Windows
+        UINT64 gpuCalibration = 0;
+        UINT64 cpuCalibration = 0;
+        m_Queue->GetClockCalibration(&gpuCalibration, &cpuCalibration);
+
+        double cpuMicroseconds = static_cast<double>(cpuCalibration) * 1e6 / static_cast<double>(m_CpuFrequency.QuadPart);
+        double microsecondsPerTick = 1e6 / static_cast<double>(m_TimestampFrequency);
+
+        const UINT64* timestamps = m_ReadbackData + UINT64(slot) * m_MaxScopes * 2;
+        for (size_t scope = 0; scope < previous.names.size(); ++scope)
+        {
+            UINT64 begin = timestamps[scope * 2];
+            UINT64 end = timestamps[scope * 2 + 1];
+
+            ProfileEvent event;
+            event.name = previous.names[scope];
+            event.track = m_Track;
+            event.frame = previous.frame;
+            event.start = profiler.FromSteadyMicroseconds(cpuMicroseconds + (static_cast<double>(begin) - static_cast<double>(gpuCalibration)) * microsecondsPerTick);
+            event.duration = end > begin ? static_cast<double>(end - begin) * microsecondsPerTick : 0.0;
+            profiler.AddEvent(event);
+        }
+    }
+
+    m_Slot = slot;
+    m_Slots[slot].frame = frame;
+    m_Slots[slot].names.clear();
+    m_Slots[slot].resolved = false;
+}
+
+UINT D3D12TimestampRing::BeginScope(ID3D12GraphicsCommandList* commandList, const char* name)
+{
+    Slot& slot = m_Slots[m_Slot];
+    UINT scope = static_cast<UINT>(slot.names.size());
+    if (scope >= m_MaxScopes)
+    {
+        return UINT_MAX;
+    }
+
+    slot.names.push_back(name);
+    commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_Slot * m_MaxScopes + scope) * 2);
+    return scope;
+}
+
+void D3D12TimestampRing::EndScope(ID3D12GraphicsCommandList* commandList, UINT scope)
+{
+    if (scope != UINT_MAX)
+    {
+        commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_Slot * m_MaxScopes + scope) * 2 + 1);
+    }
+}
+
+void D3D12TimestampRing::Resolve(ID3D12GraphicsCommandList* commandList)
+{
+    Slot& slot = m_Slots[m_Slot];
+    if (slot.names.empty())
+    {
+        return;
+    }
+
+    UINT first = m_Slot * m_MaxScopes * 2;
+    UINT count = static_cast<UINT>(slot.names.size()) * 2;
+    commandList->ResolveQueryData(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, count, m_Readback.Get(), UINT64(first) * sizeof(UINT64));
+    slot.resolved = true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "config.h"
+
+#include "Profiler.h"
+
+#include <vector>
+
+// Timestamp queries around the scopes of one queue's command lists, read back frames later
+// without a stall. Every slot of the ring owns a range of the query heap and of the readback
+// buffer the queries are resolved into; the owner reuses a slot only once the GPU is done with
+// it (the frame's allocator can be reset), which is when its timestamps are handed to the profiler.
+class D3D12TimestampRing
+{
+public:
+    // maxScopes per slot, scopes past it in a slot are not timed
+    D3D12TimestampRing(ID3D12Device* device, ID3D12CommandQueue* queue, D3D12_COMMAND_LIST_TYPE type, ProfileTrack track, UINT slotCount, UINT maxScopes);
+
+    D3D12TimestampRing(const D3D12TimestampRing&) = delete;
+    D3D12TimestampRing& operator=(const D3D12TimestampRing&) = delete;
+
+    ~D3D12TimestampRing();
+
+    // Hands what slot recorded last time to profiler and starts recording the scopes of frame
+    // into it. The GPU has to be done with the slot.
+    void BeginSlot(UINT slot, uint64_t frame, Profiler& profiler);
+
+    // the timestamps of a scope, returns its index for EndScope
+    UINT BeginScope(ID3D12GraphicsCommandList* commandList, const char* name);
+    void EndScope(ID3D12GraphicsCommandList* commandList, UINT scope);
+
+    // copies the slot's timestamps into the readback buffer, recorded last on the slot's list
+    void Resolve(ID3D12GraphicsCommandList* commandList);
+
+private:
+    struct Slot
+    {
+        uint64_t frame = 0;
+        std::vector<const char*> names;
+        bool resolved = false;
+    };
+
+    ComPtr<ID3D12CommandQueue> m_Queue;
+    ComPtr<ID3D12QueryHeap> m_QueryHeap;
+    ComPtr<ID3D12Resource> m_Readback;
+    UINT64* m_ReadbackData = nullptr;
+
+    ProfileTrack m_Track;
+    UINT m_MaxScopes;
+
+    // ticks per second of the queue's timestamps, and of QueryPerformanceCounter
+    UINT64 m_TimestampFrequency = 0;
+    LARGE_INTEGER m_CpuFrequency;
+
+    std::vector<Slot> m_Slots;
+    UINT m_Slot = 0;
+};
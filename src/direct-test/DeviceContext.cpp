@@ -1,7 +1,17 @@
 #include "DeviceContext.h"
 
-DeviceContext::DeviceContext(Win32Application& window, const std::vector<Particle>& particles)
-    : window(window), m_Particles(particles)
+namespace
+{
+    // relative to the working directory, like the sources always were
+    const char ShaderSourceDirectory[] = ".";
+    const char ShaderCacheDirectory[] = "ShaderCache";
+
+    // only valid for the adapter and driver that wrote it, so PrecompileShaders cannot fill it
+    const char PipelineCachePath[] = "ShaderCache/pipelines.bin";
+}
+
+DeviceContext::DeviceContext(Win32Application& window, const std::vector<Particle>& particles, const SimulationSettings& simulationSettings)
+    : window(window), m_Particles(particles), m_SimulationSettings(simulationSettings)
 {
     m_camera.Init({ 0.0f, 0.0f, 1500.0f });
     m_camera.SetMoveSpeed(250.0f);
@@ -35,18 +45,38 @@ void DeviceContext::InitD3D(Win32Application& window)
 
     CreateBufferResources();
 
+    m_Pipelines = std::make_unique<PipelineLibrary>(m_Device.Get(), PipelineCachePath);
+
     CreateRootSignatures();
 
+    m_Shaders = std::make_unique<ShaderLibrary>(ShaderSourceDirectory, ShaderCacheDirectory);
+
     CreateGraphicsPSO();
 
     CreateComputePSO();
 
-    CreateVertexBuffer();
+    CreateSimulationPSOs();
+
+    CreateSortPSOs();
+
+    CreateCullPSOs();
+
+    m_Pipelines->Save();
 
     CreateDepthResources(window.Width, window.Height);
 
     CreateConstantBuffers();
 
+    CreateReadbackBuffers();
+
+    CreateIncrementalBuffers();
+
+    CreateSimulationResources();
+
+    CreateSortResources();
+
+    CreateCullResources();
+
     m_CommandList->Close();
     ID3D12CommandList* ppCommandLists[] = { m_CommandList.Get() };
     m_CommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
@@ -54,7 +84,10 @@ void DeviceContext::InitD3D(Win32Application& window)
     m_FenceValue[frameIndex]++;
     m_CommandQueue->Signal(m_Fence[frameIndex].Get(), m_FenceValue[frameIndex]);
 
-    CreateVertexBufferView(window.Width, window.Height);
+    // the compute queue reads the particles and writes the shadows uploaded above
+    m_ComputeCommandQueue->Wait(m_Fence[frameIndex].Get(), m_FenceValue[frameIndex]);
+
+    CreateViewport(window.Width, window.Height);
 
     LoadMatrices(window.m_aspectRatio);
 }
@@ -134,9 +167,16 @@ void DeviceContext::CreateCommandQueues()
 
     m_Device->CreateCommandQueue(&computeQueueDesc, IID_PPV_ARGS(&m_ComputeCommandQueue));
 
-    m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&m_ComputeCommandAllocator));
+    // one allocator per shadow slot, reset once the compute work of the slot's previous use retired
+    for (UINT i = 0; i < AsyncShadowScheduler::SlotCount; i++)
+    {
+        m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&m_ComputeCommandAllocator[i]));
+    }
 
-    m_Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_ComputeCommandAllocator.Get(), NULL, IID_PPV_ARGS(&m_ComputeCommandList));
+    m_Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_ComputeCommandAllocator[0].Get(), NULL, IID_PPV_ARGS(&m_ComputeCommandList));
+
+    // every frame resets the list before recording into it
+    m_ComputeCommandList->Close();
 }
 
 void DeviceContext::CreateSwapchain(Win32Application& window)
@@ -202,7 +242,7 @@ void DeviceContext::CreateBackBuffers()
 void DeviceContext::CreateBufferResources()
 {
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 3;
+    srvHeapDesc.NumDescriptors = srvDescriptorCount;
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -210,8 +250,9 @@ void DeviceContext::CreateBufferResources()
 
     srvDescriptorSize = m_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+    for (UINT slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
     {
-        UINT sb_ShadowsSize = m_Particles.size() * sizeof(float);
+        UINT64 sb_ShadowsSize = m_Particles.size() * sizeof(float);
         D3D12_HEAP_PROPERTIES defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE(D3D12_HEAP_TYPE_DEFAULT));
         D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sb_ShadowsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
@@ -224,15 +265,19 @@ void DeviceContext::CreateBufferResources()
             &bufferDesc,
             D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr,
-            IID_PPV_ARGS(&m_sbShadows));
+            IID_PPV_ARGS(&m_sbShadows[slot]));
 
-        m_Device->CreateCommittedResource(
-            &uploadHeapProperties,
-            D3D12_HEAP_FLAG_NONE,
-            &uploadBufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&m_sbShadowsUpload));
+        // both slots start out from the same data, so they share the upload buffer
+        if (slot == 0)
+        {
+            m_Device->CreateCommittedResource(
+                &uploadHeapProperties,
+                D3D12_HEAP_FLAG_NONE,
+                &uploadBufferDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_PPV_ARGS(&m_sbShadowsUpload));
+        }
 
         std::vector<float> initialShadowsData(m_Particles.size(), 1.0f);
 
@@ -241,34 +286,53 @@ void DeviceContext::CreateBufferResources()
         shadowsData.RowPitch = sb_ShadowsSize;
         shadowsData.SlicePitch = shadowsData.RowPitch;
 
-        UpdateSubresources<1>(m_CommandList.Get(), m_sbShadows.Get(), m_sbShadowsUpload.Get(), 0, 0, 1, &shadowsData);
-        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_sbShadows.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+        UpdateSubresources<1>(m_CommandList.Get(), m_sbShadows[slot].Get(), m_sbShadowsUpload.Get(), 0, 0, 1, &shadowsData);
+
+        // compute writes and the vertex shader reads the shadows through UAVs, the buffers stay in
+        // this state and the queues are ordered by the fences of AsyncShadowScheduler
+        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_sbShadows[slot].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 
         D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
         uavDesc.Format = DXGI_FORMAT_R32_FLOAT;
         //uavDesc.Format = DXGI_FORMAT_R32_UINT;
         uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
         uavDesc.Buffer.FirstElement = 0;
-        uavDesc.Buffer.NumElements = m_Particles.size();
+        uavDesc.Buffer.NumElements = static_cast<UINT>(m_Particles.size());
         uavDesc.Buffer.StructureByteStride = 0; // sizeof(float)
         uavDesc.Buffer.CounterOffsetInBytes = 0;
         uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
 
-        CD3DX12_CPU_DESCRIPTOR_HANDLE uavHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), 1, srvDescriptorSize);
-        m_Device->CreateUnorderedAccessView(m_sbShadows.Get(), nullptr, &uavDesc, uavHandle);
+        CD3DX12_CPU_DESCRIPTOR_HANDLE uavHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), ShadowsUavIndex(slot), srvDescriptorSize);
+        m_Device->CreateUnorderedAccessView(m_sbShadows[slot].Get(), nullptr, &uavDesc, uavHandle);
 
+        // slot 0 is also the previous slot of the last UAV in the heap
+        if (slot == 0)
+        {
+            CD3DX12_CPU_DESCRIPTOR_HANDLE wrapHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), 2 * AsyncShadowScheduler::SlotCount, srvDescriptorSize);
+            m_Device->CreateUnorderedAccessView(m_sbShadows[slot].Get(), nullptr, &uavDesc, wrapHandle);
+        }
     }
 
     XMFLOAT3 sunPosition = XMFLOAT3(-700.0f, 500.0f, 0.0f);
     
     {
         // compute constant buffer      
-        
-        float normalizedX = sunPosition.x == 0.0f ? 0.0f : sunPosition.x / std::abs(sunPosition.x);
-        float normalizedY = sunPosition.y == 0.0f ? 0.0f : sunPosition.y / std::abs(sunPosition.y);
-        float normalizedZ = sunPosition.z == 0.0f ? 0.0f : sunPosition.z / std::abs(sunPosition.z);
-        
-        m_cbSunDir.sunDir = XMFLOAT3(normalizedX, normalizedY, normalizedZ);
+
+        // the direction towards the sun, the basis around it is built here once instead of per thread
+        SunBasis basis = SunBasis::FromDirection(sunPosition);
+
+        m_cbSunDir.sunDir = basis.sunDir;
+        m_cbSunDir.up = basis.up;
+        m_cbSunDir.forward = basis.forward;
+
+        // the light source is the last particle and takes no part in the shadowing
+        m_cbSunDir.particlesCount = static_cast<UINT>(m_Particles.size() - 1);
+
+        ComputeDispatchSize(m_cbSunDir.particlesCount);
+        m_cbSunDir.dispatchGroupsX = m_DispatchGroupsX;
+
+        // the first pass of each slot has no previous result to start from
+        m_cbSunDir.incremental = 0;
     
         m_Device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // this heap will be used to upload the constant buffer data
@@ -279,29 +343,24 @@ void DeviceContext::CreateBufferResources()
             IID_PPV_ARGS(&m_cbSunDirUploadHeap)
         );
 
-        BYTE* mappedData = nullptr;
-        m_cbSunDirUploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&mappedData));
+        CD3DX12_RANGE readRange(0, 0);
 
-        memcpy(mappedData, &m_cbSunDir, sizeof(m_cbSunDir));
+        // kept mapped, every frame copies m_cbSunDir into the part of the slot it computes
+        m_cbSunDirUploadHeap->Map(0, &readRange, reinterpret_cast<void**>(&m_cbSunDirGPUAddress));
 
-        m_cbSunDirUploadHeap->Unmap(0, nullptr);
+        for (UINT slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
+        {
+            memcpy(m_cbSunDirGPUAddress + slot * ComputeConstantBufferAlignedSize, &m_cbSunDir, sizeof(m_cbSunDir));
+        }
     }
 
-    UINT dataSize = m_Particles.size() * sizeof(Particle);
+    UINT64 dataSize = m_Particles.size() * sizeof(Particle);
     D3D12_HEAP_PROPERTIES defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(dataSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
     D3D12_HEAP_PROPERTIES uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     D3D12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(dataSize);
 
-    m_Device->CreateCommittedResource(
-        &defaultHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&m_sbParticles));
-
     m_Device->CreateCommittedResource(
         &uploadHeapProperties,
         D3D12_HEAP_FLAG_NONE,
@@ -318,20 +377,31 @@ void DeviceContext::CreateBufferResources()
     particleData.RowPitch = dataSize;
     particleData.SlicePitch = particleData.RowPitch;
 
-    UpdateSubresources<1>(m_CommandList.Get(), m_sbParticles.Get(), m_sbParticlesUpload.Get(), 0, 0, 1, &particleData);
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_sbParticles.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
-
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.Format = DXGI_FORMAT_UNKNOWN;
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
     srvDesc.Buffer.FirstElement = 0;
-    srvDesc.Buffer.NumElements = m_Particles.size();
+    srvDesc.Buffer.NumElements = static_cast<UINT>(m_Particles.size());
     srvDesc.Buffer.StructureByteStride = sizeof(Particle);
     srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), 0, srvDescriptorSize);
-    m_Device->CreateShaderResourceView(m_sbParticles.Get(), &srvDesc, srvHandle);
+    for (UINT slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
+    {
+        m_Device->CreateCommittedResource(
+            &defaultHeapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&m_sbParticles[slot]));
+
+        UpdateSubresources<1>(m_CommandList.Get(), m_sbParticles[slot].Get(), m_sbParticlesUpload.Get(), 0, 0, 1, &particleData);
+        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_sbParticles[slot].Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), ParticlesSrvIndex(slot), srvDescriptorSize);
+        m_Device->CreateShaderResourceView(m_sbParticles[slot].Get(), &srvDesc, srvHandle);
+    }
 }
 
 void DeviceContext::CreateSynchronizaionPrimitives()
@@ -345,13 +415,8 @@ void DeviceContext::CreateSynchronizaionPrimitives()
 
     m_FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 
-    m_Device->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&m_threadFences));
-
-    m_threadFenceEvents = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    if (m_threadFenceEvents == nullptr)
-    {
-        HRESULT_FROM_WIN32(GetLastError());
-    }
+    m_ComputeTimeline = std::make_unique<D3D12QueueTimeline>(m_Device.Get(), m_ComputeCommandQueue.Get());
+    m_GraphicsTimeline = std::make_unique<D3D12QueueTimeline>(m_Device.Get(), m_CommandQueue.Get());
 }
 
 void DeviceContext::CreateRootSignatures()
@@ -376,20 +441,21 @@ void DeviceContext::CreateRootSignatures()
         uavRange.OffsetInDescriptorsFromTableStart = 0;
 
         // create a root parameter and fill it out
-        CD3DX12_ROOT_PARAMETER  rootParameters[3];
+        CD3DX12_ROOT_PARAMETER  rootParameters[4];
         rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV; // this is a constant buffer view root descriptor
         rootParameters[0].Descriptor = rootCBVDescriptor; // this is the root descriptor for this root parameter
         rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL; // our pixel shader will be the only shader accessing this parameter for now
 
         rootParameters[1].InitAsDescriptorTable(1, &range);
         rootParameters[2].InitAsDescriptorTable(1, &uavRange);
+        rootParameters[3].InitAsShaderResourceView(1); // sbDrawOrder
 
         CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
         rootSignatureDesc.Init(_countof(rootParameters),
             rootParameters, // a pointer to the beginning of our root parameters array
             0,
             nullptr,
-            D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT | // we can deny shader stages here for better performance
+            // no input layout, the vertex shaders read everything from sbParticles
             D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
             D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS
         );
@@ -397,6 +463,7 @@ void DeviceContext::CreateRootSignatures()
         ID3DBlob* signature;
         D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, nullptr);
         m_Device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_GraphicsRootSignature));
+        m_Pipelines->AddRootSignature(m_GraphicsRootSignature.Get(), signature);
     }
 
     // compute root signature
@@ -411,14 +478,15 @@ void DeviceContext::CreateRootSignatures()
         compRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
         compRange.OffsetInDescriptorsFromTableStart = 0;
 
+        // u0 is the slot being computed, u1 the previous slot the incremental pass copies from
         D3D12_DESCRIPTOR_RANGE compUavRange = {};
         compUavRange.BaseShaderRegister = 0;
-        compUavRange.NumDescriptors = 1;
+        compUavRange.NumDescriptors = 2;
         compUavRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
         compUavRange.OffsetInDescriptorsFromTableStart = 0;
 
         // create a root parameter and fill it out
-        CD3DX12_ROOT_PARAMETER  computeRootParameters[3];
+        CD3DX12_ROOT_PARAMETER  computeRootParameters[4];
         computeRootParameters[0].InitAsDescriptorTable(1, &compRange);
         computeRootParameters[1].InitAsDescriptorTable(1, &compUavRange);
 
@@ -426,6 +494,8 @@ void DeviceContext::CreateRootSignatures()
         computeRootParameters[2].Descriptor = computeCBVDescriptor; // this is the root descriptor for this root parameter
         computeRootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL; // our pixel shader will be the only shader accessing this parameter for now
 
+        // the dirty mask of the slot, read straight from its upload buffer
+        computeRootParameters[3].InitAsShaderResourceView(1);
 
         CD3DX12_ROOT_SIGNATURE_DESC compRootSignatureDesc;
         compRootSignatureDesc.Init(_countof(computeRootParameters),
@@ -437,84 +507,83 @@ void DeviceContext::CreateRootSignatures()
         ID3DBlob* compSignature;
         D3D12SerializeRootSignature(&compRootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &compSignature, nullptr);
         m_Device->CreateRootSignature(0, compSignature->GetBufferPointer(), compSignature->GetBufferSize(), IID_PPV_ARGS(&m_ComputeRootSignature));
+        m_Pipelines->AddRootSignature(m_ComputeRootSignature.Get(), compSignature);
     }
-}
 
-void DeviceContext::CreateGraphicsPSO()
-{
-    // compile vertex shader
-    ID3DBlob* vertexShader; // d3d blob for holding vertex shader bytecode
-    ID3DBlob* errorBuff; // a buffer holding the error data if any
-    auto hr = D3DCompileFromFile(L"VertexShader.hlsl",
-        nullptr,
-        nullptr,
-        "VSMain",
-        "vs_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-        0,
-        &vertexShader,
-        &errorBuff);
-    if (FAILED(hr))
+    // simulation root signature
     {
-        OutputDebugStringA((char*)errorBuff->GetBufferPointer());
+        // the dead list needs its counter, which root UAVs do not have
+        D3D12_DESCRIPTOR_RANGE deadListRange = {};
+        deadListRange.BaseShaderRegister = 2;
+        deadListRange.NumDescriptors = 1;
+        deadListRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        deadListRange.OffsetInDescriptorsFromTableStart = 0;
+
+        CD3DX12_ROOT_PARAMETER simulationRootParameters[6];
+        simulationRootParameters[0].InitAsConstantBufferView(0); // cbSimulation
+        simulationRootParameters[1].InitAsConstantBufferView(1); // cbDeadList
+        simulationRootParameters[2].InitAsShaderResourceView(0); // sbPreviousParticles
+        simulationRootParameters[3].InitAsUnorderedAccessView(0); // sbParticles
+        simulationRootParameters[4].InitAsUnorderedAccessView(1); // sbMotion
+        simulationRootParameters[5].InitAsDescriptorTable(1, &deadListRange);
+
+        CD3DX12_ROOT_SIGNATURE_DESC simulationRootSignatureDesc;
+        simulationRootSignatureDesc.Init(_countof(simulationRootParameters), simulationRootParameters, 0, nullptr);
+
+        ID3DBlob* simulationSignature;
+        D3D12SerializeRootSignature(&simulationRootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &simulationSignature, nullptr);
+        m_Device->CreateRootSignature(0, simulationSignature->GetBufferPointer(), simulationSignature->GetBufferSize(), IID_PPV_ARGS(&m_SimulationRootSignature));
+        m_Pipelines->AddRootSignature(m_SimulationRootSignature.Get(), simulationSignature);
     }
 
-    // fill out a shader bytecode structure, which is basically just a pointer
-    // to the shader bytecode and the size of the shader bytecode
-    D3D12_SHADER_BYTECODE vertexShaderBytecode = {};
-    vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
-    vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
-
-    // compile geometry shader
-
-    ID3DBlob* geometryShader; // d3d blob for holding vertex shader bytecode
-    hr = D3DCompileFromFile(L"GeometryShader.hlsl",
-        nullptr,
-        nullptr,
-        "GSMain",
-        "gs_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-        0,
-        &geometryShader,
-        &errorBuff);
-    if (FAILED(hr))
+    // sort root signature
     {
-        OutputDebugStringA((char*)errorBuff->GetBufferPointer());
+        CD3DX12_ROOT_PARAMETER sortRootParameters[7];
+        sortRootParameters[0].InitAsConstants(sizeof(SortConstants) / sizeof(UINT), 0); // cbSort
+        sortRootParameters[1].InitAsShaderResourceView(0); // sbParticles
+        sortRootParameters[2].InitAsUnorderedAccessView(0); // sbKeys
+        sortRootParameters[3].InitAsUnorderedAccessView(1); // sbValues
+        sortRootParameters[4].InitAsUnorderedAccessView(2); // sbSortedKeys
+        sortRootParameters[5].InitAsUnorderedAccessView(3); // sbSortedValues
+        sortRootParameters[6].InitAsUnorderedAccessView(4); // sbBlockOffsets
+
+        CD3DX12_ROOT_SIGNATURE_DESC sortRootSignatureDesc;
+        sortRootSignatureDesc.Init(_countof(sortRootParameters), sortRootParameters, 0, nullptr);
+
+        ID3DBlob* sortSignature;
+        D3D12SerializeRootSignature(&sortRootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &sortSignature, nullptr);
+        m_Device->CreateRootSignature(0, sortSignature->GetBufferPointer(), sortSignature->GetBufferSize(), IID_PPV_ARGS(&m_SortRootSignature));
+        m_Pipelines->AddRootSignature(m_SortRootSignature.Get(), sortSignature);
     }
 
-    D3D12_SHADER_BYTECODE geometryShaderBytecode = {};
-    geometryShaderBytecode.BytecodeLength = geometryShader->GetBufferSize();
-    geometryShaderBytecode.pShaderBytecode = geometryShader->GetBufferPointer();
-
-    // compile pixel shader
-    ID3DBlob* pixelShader;
-    D3DCompileFromFile(L"PixelShader.hlsl",
-        nullptr,
-        nullptr,
-        "PSMain",
-        "ps_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-        0,
-        &pixelShader,
-        &errorBuff
-    );
-
-    // fill out shader bytecode structure for pixel shader
-    D3D12_SHADER_BYTECODE pixelShaderBytecode = {};
-    pixelShaderBytecode.BytecodeLength = pixelShader->GetBufferSize();
-    pixelShaderBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-
-    // create input layout
-
-    D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+    // cull root signature
     {
-        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offsetof(Vertex, color), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    };
+        CD3DX12_ROOT_PARAMETER cullRootParameters[6];
+        cullRootParameters[0].InitAsConstants(sizeof(CullConstants) / sizeof(UINT), 0); // cbCull
+        cullRootParameters[1].InitAsShaderResourceView(0); // sbParticles
+        cullRootParameters[2].InitAsShaderResourceView(1); // sbDrawOrder
+        cullRootParameters[3].InitAsUnorderedAccessView(0); // sbBlockOffsets
+        cullRootParameters[4].InitAsUnorderedAccessView(1); // sbVisible
+        cullRootParameters[5].InitAsUnorderedAccessView(2); // sbDrawArgs
+
+        CD3DX12_ROOT_SIGNATURE_DESC cullRootSignatureDesc;
+        cullRootSignatureDesc.Init(_countof(cullRootParameters), cullRootParameters, 0, nullptr);
+
+        ID3DBlob* cullSignature;
+        D3D12SerializeRootSignature(&cullRootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &cullSignature, nullptr);
+        m_Device->CreateRootSignature(0, cullSignature->GetBufferPointer(), cullSignature->GetBufferSize(), IID_PPV_ARGS(&m_CullRootSignature));
+        m_Pipelines->AddRootSignature(m_CullRootSignature.Get(), cullSignature);
+    }
+}
 
-    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
+void DeviceContext::CreateGraphicsPSO()
+{
+    D3D12_SHADER_BYTECODE vertexShaderBytecode = m_Shaders->Get(ShaderPermutations()[ParticleVS]);
+    D3D12_SHADER_BYTECODE geometryShaderBytecode = m_Shaders->Get(ShaderPermutations()[ParticleGS]);
+    D3D12_SHADER_BYTECODE pixelShaderBytecode = m_Shaders->Get(ShaderPermutations()[ParticlePS]);
 
-    inputLayoutDesc.NumElements = _countof(inputLayout);
-    inputLayoutDesc.pInputElementDescs = inputLayout;
+    // empty input layout, the vertex shader indexes sbParticles with SV_VertexID and no vertex buffer is bound
+    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
 
     DXGI_SAMPLE_DESC sampleDesc = {};
     sampleDesc.Count = 1; // multisample count (no multisampling, so we just put 1, since we still need 1 sample)
@@ -551,7 +620,22 @@ void DeviceContext::CreateGraphicsPSO()
     psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
     // create the pso
-    m_Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_PipelineStateObject));
+    m_Pipelines->CreateGraphics(psoDesc, m_PipelineStateObject);
+
+    // the same sprites without the geometry shader, one instance of a triangle strip per particle
+    D3D12_SHADER_BYTECODE spriteShaderBytecode = m_Shaders->Get(ShaderPermutations()[SpriteVS]);
+    if (spriteShaderBytecode.pShaderBytecode == nullptr)
+    {
+        // RenderSystem falls back to the geometry shader path without m_SpritePipelineStateObject
+        return;
+    }
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC spritePsoDesc = psoDesc;
+    spritePsoDesc.VS = spriteShaderBytecode;
+    spritePsoDesc.GS = {};
+    spritePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+
+    m_Pipelines->CreateGraphics(spritePsoDesc, m_SpritePipelineStateObject);
 }
 
 void DeviceContext::Cleanup()
@@ -583,7 +667,6 @@ void DeviceContext::Cleanup()
 
     //SAFE_RELEASE(m_PipelineStateObject);
     //SAFE_RELEASE(m_GraphicsRootSignature);
-    //SAFE_RELEASE(m_VertexBuffer);
 
     //SAFE_RELEASE(m_depthStencilBuffer);
     //SAFE_RELEASE(m_dsDescriptorHeap);
@@ -596,80 +679,112 @@ void DeviceContext::Cleanup()
 
 void DeviceContext::CreateComputePSO()
 {
-    std::string x_str = std::to_string(THREAD_X);
-    std::string y_str = std::to_string(THREAD_Y);
+    D3D12_COMPUTE_PIPELINE_STATE_DESC computePSOdesc = {};
+    computePSOdesc.CS = m_Shaders->Get(ShaderPermutations()[ShadowCS]);
+    computePSOdesc.pRootSignature = m_ComputeRootSignature.Get();
 
-    LPCSTR THREAD_X_VALUE = x_str.c_str();
-    LPCSTR THREAD_Y_VALUE = y_str.c_str();
+    m_Pipelines->CreateCompute(computePSOdesc, m_ComputePipelineStateObject);
+}
 
-    D3D_SHADER_MACRO defines[] = {
-        {"THREAD_X", THREAD_X_VALUE},
-        {"THREAD_Y", THREAD_Y_VALUE},
-        {NULL, NULL }
+void DeviceContext::CreateSimulationPSOs()
+{
+    struct EntryPoint
+    {
+        ShaderId shader;
+        ComPtr<ID3D12PipelineState>& pipelineState;
     };
 
-    ID3DBlob* computeShader;
-    D3DCompileFromFile(L"ComputeShader_SunBasis.hlsl",
-        defines,
-        D3D_COMPILE_STANDARD_FILE_INCLUDE,
-        "CSMain",
-        "cs_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-        0,
-        &computeShader,
-        nullptr
-    );
-
-    D3D12_SHADER_BYTECODE computeShaderBytecode = {};
-    computeShaderBytecode.BytecodeLength = computeShader->GetBufferSize();
-    computeShaderBytecode.pShaderBytecode = computeShader->GetBufferPointer();
-
+    EntryPoint entryPoints[] = {
+        { SimulateCS, m_SimulatePipelineStateObject },
+        { EmitCS, m_EmitPipelineStateObject },
+    };
 
-    D3D12_COMPUTE_PIPELINE_STATE_DESC computePSOdesc = {};
-    computePSOdesc.CS = computeShaderBytecode;
-    computePSOdesc.pRootSignature = m_ComputeRootSignature.Get();
+    for (EntryPoint& entryPoint : entryPoints)
+    {
+        D3D12_COMPUTE_PIPELINE_STATE_DESC simulationPSODesc = {};
+        simulationPSODesc.CS = m_Shaders->Get(ShaderPermutations()[entryPoint.shader]);
+        simulationPSODesc.pRootSignature = m_SimulationRootSignature.Get();
 
-    m_Device->CreateComputePipelineState(&computePSOdesc, IID_PPV_ARGS(&m_ComputePipelineStateObject));
+        m_Pipelines->CreateCompute(simulationPSODesc, entryPoint.pipelineState);
+    }
 }
 
-void DeviceContext::CreateVertexBuffer()
+void DeviceContext::CreateSortPSOs()
 {
-    m_VertexList.resize(m_Particles.size());
+    struct EntryPoint
+    {
+        ShaderId shader;
+        ComPtr<ID3D12PipelineState>& pipelineState;
+    };
+
+    EntryPoint entryPoints[] = {
+        { SortKeysCS, m_SortKeysPipelineStateObject },
+        { SortCountCS, m_SortCountPipelineStateObject },
+        { SortScanCS, m_SortScanPipelineStateObject },
+        { SortScatterCS, m_SortScatterPipelineStateObject },
+    };
 
-    for (int i = 0; i < m_VertexList.size(); ++i) {
-        m_VertexList[i].color = XMFLOAT4(0.0, 1.0, 1.0, 1.0f);
+    for (EntryPoint& entryPoint : entryPoints)
+    {
+        D3D12_COMPUTE_PIPELINE_STATE_DESC sortPSODesc = {};
+        sortPSODesc.CS = m_Shaders->Get(ShaderPermutations()[entryPoint.shader]);
+        sortPSODesc.pRootSignature = m_SortRootSignature.Get();
+
+        m_Pipelines->CreateCompute(sortPSODesc, entryPoint.pipelineState);
     }
+}
 
-    int vBufferSize = sizeof(Vertex) * m_VertexList.size();
+void DeviceContext::CreateCullPSOs()
+{
+    struct EntryPoint
+    {
+        ShaderId shader;
+        ComPtr<ID3D12PipelineState>& pipelineState;
+    };
 
-    m_Device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), // a default heap
-        D3D12_HEAP_FLAG_NONE, // no flags
-        &CD3DX12_RESOURCE_DESC::Buffer(vBufferSize), // resource description for a buffer
-        D3D12_RESOURCE_STATE_COPY_DEST, // we will start this heap in the copy destination state since we will copy data
-        // from the upload heap to this heap
-        nullptr, // optimized clear value must be null for this type of resource. used for render targets and depth/stencil buffers
-        IID_PPV_ARGS(&m_VertexBuffer));
+    EntryPoint entryPoints[] = {
+        { CullCountCS, m_CullCountPipelineStateObject },
+        { CullScanCS, m_CullScanPipelineStateObject },
+        { CullCompactCS, m_CullCompactPipelineStateObject },
+    };
 
-    m_VertexBuffer->SetName(L"Vertex Buffer Resource Heap");
+    for (EntryPoint& entryPoint : entryPoints)
+    {
+        D3D12_COMPUTE_PIPELINE_STATE_DESC cullPSODesc = {};
+        cullPSODesc.CS = m_Shaders->Get(ShaderPermutations()[entryPoint.shader]);
+        cullPSODesc.pRootSignature = m_CullRootSignature.Get();
 
-    ID3D12Resource* vBufferUploadHeap;
-    m_Device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), // upload heap
-        D3D12_HEAP_FLAG_NONE, // no flags
-        &CD3DX12_RESOURCE_DESC::Buffer(vBufferSize), // resource description for a buffer
-        D3D12_RESOURCE_STATE_GENERIC_READ, // GPU will read from this buffer and copy its contents to the default heap
-        nullptr,
-        IID_PPV_ARGS(&vBufferUploadHeap));
-    vBufferUploadHeap->SetName(L"Vertex Buffer Upload Resource Heap");
+        m_Pipelines->CreateCompute(cullPSODesc, entryPoint.pipelineState);
+    }
+}
 
-    D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = reinterpret_cast<UINT8*>(&m_VertexList[0]); // pointer to our vertex array
-    vertexData.RowPitch = vBufferSize; // size of all our triangle vertex data
-    vertexData.SlicePitch = vertexData.RowPitch; // also the size of our triangle vertex data
+std::vector<ShaderPermutation> DeviceContext::ShaderPermutations()
+{
+    const uint32_t flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+
+    std::vector<ShaderPermutation> permutations(ShaderCount);
+    permutations[ParticleVS] = { "VertexShader.hlsl", "VSMain", "vs_5_0", {}, flags };
+    permutations[SpriteVS] = { "VertexShader.hlsl", "VSSpriteMain", "vs_5_0", {}, flags };
+    permutations[ParticleGS] = { "GeometryShader.hlsl", "GSMain", "gs_5_0", {}, flags };
+    permutations[ParticlePS] = { "PixelShader.hlsl", "PSMain", "ps_5_0", {}, flags };
+    permutations[ShadowCS] = { "ComputeShader_SunBasis.hlsl", "CSMain", "cs_5_0",
+        { { "THREAD_X", std::to_string(THREAD_X) }, { "THREAD_Y", std::to_string(THREAD_Y) } }, flags };
+    permutations[SimulateCS] = { "SimulationShader.hlsl", "CSSimulate", "cs_5_0", {}, flags };
+    permutations[EmitCS] = { "SimulationShader.hlsl", "CSEmit", "cs_5_0", {}, flags };
+    permutations[SortKeysCS] = { "SortShader.hlsl", "CSSortKeys", "cs_5_0", {}, flags };
+    permutations[SortCountCS] = { "SortShader.hlsl", "CSCountDigits", "cs_5_0", {}, flags };
+    permutations[SortScanCS] = { "SortShader.hlsl", "CSScanDigits", "cs_5_0", {}, flags };
+    permutations[SortScatterCS] = { "SortShader.hlsl", "CSScatter", "cs_5_0", {}, flags };
+    permutations[CullCountCS] = { "CullShader.hlsl", "CSCullCount", "cs_5_0", {}, flags };
+    permutations[CullScanCS] = { "CullShader.hlsl", "CSCullScan", "cs_5_0", {}, flags };
+    permutations[CullCompactCS] = { "CullShader.hlsl", "CSCullCompact", "cs_5_0", {}, flags };
+    return permutations;
+}
 
-    UpdateSubresources<1>(m_CommandList.Get(), m_VertexBuffer.Get(), vBufferUploadHeap, 0, 0, 1, &vertexData);
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_VertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
+bool DeviceContext::PrecompileShaders(std::string& error)
+{
+    ShaderLibrary shaders(ShaderSourceDirectory, ShaderCacheDirectory);
+    return shaders.Precompile(ShaderPermutations(), error);
 }
 
 void DeviceContext::CreateDepthResources(uint32_t width, uint32_t height)
@@ -721,6 +836,8 @@ void DeviceContext::CreateConstantBuffers()
 
         ZeroMemory(&m_cbPerObject, sizeof(m_cbPerObject));
 
+        m_cbPerObject.lightSourceIndex = static_cast<UINT>(m_Particles.size() - 1);
+
         CD3DX12_RANGE readRange(0, 0);    // We do not intend to read from this resource on the CPU. (so end is less than or equal to begin)
 
         m_constantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_cbvGPUAddress[i]));
@@ -731,14 +848,276 @@ void DeviceContext::CreateConstantBuffers()
     }
 }
 
-void DeviceContext::CreateVertexBufferView(uint32_t width, uint32_t height)
+void DeviceContext::CreateReadbackBuffers()
+{
+    UINT64 bufferSize = m_Particles.size() * sizeof(float);
+
+    for (int i = 0; i < readbackSlotCount; ++i)
+    {
+        m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(bufferSize),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&m_ReadbackBuffers[i])
+        );
+
+        m_ReadbackBuffers[i]->SetName(L"Shadows Readback Buffer");
+
+        // readback heaps may stay mapped, the fence of the copy tells when the data is there
+        CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(bufferSize));
+        m_ReadbackBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_ReadbackData[i]));
+    }
+}
+
+void DeviceContext::CreateIncrementalBuffers()
+{
+    UINT64 deltaSize = m_Particles.size() * sizeof(Particle);
+    UINT64 maskSize = (m_Particles.size() + 31) / 32 * sizeof(uint32_t);
+
+    // the CPU only writes these, nothing is read back
+    CD3DX12_RANGE readRange(0, 0);
+
+    for (UINT slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
+    {
+        m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(deltaSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&m_sbParticlesDelta[slot])
+        );
+
+        m_sbParticlesDelta[slot]->SetName(L"Particles Delta Upload Buffer");
+        m_sbParticlesDelta[slot]->Map(0, &readRange, reinterpret_cast<void**>(&m_ParticlesDeltaData[slot]));
+
+        m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(maskSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&m_DirtyMask[slot])
+        );
+
+        m_DirtyMask[slot]->SetName(L"Dirty Mask Upload Buffer");
+        m_DirtyMask[slot]->Map(0, &readRange, reinterpret_cast<void**>(&m_DirtyMaskData[slot]));
+
+        memset(m_DirtyMaskData[slot], 0, static_cast<size_t>(maskSize));
+    }
+}
+
+void DeviceContext::CreateSimulationResources()
+{
+    // the light source is the last particle and is never simulated
+    UINT simulatedCount = static_cast<UINT>(m_Particles.size() - 1);
+
+    std::vector<ParticleMotion> motion = MakeInitialMotion(m_SimulationSettings, simulatedCount);
+    motion.resize(m_Particles.size(), ParticleMotion{});
+
+    UINT64 motionSize = motion.size() * sizeof(ParticleMotion);
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(motionSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_sbMotion));
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(motionSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_sbMotionUpload));
+
+    m_sbMotion->SetName(L"Particle Motion Buffer");
+
+    D3D12_SUBRESOURCE_DATA motionData = {};
+    motionData.pData = reinterpret_cast<UINT8*>(motion.data());
+    motionData.RowPitch = motionSize;
+    motionData.SlicePitch = motionData.RowPitch;
+
+    UpdateSubresources<1>(m_CommandList.Get(), m_sbMotion.Get(), m_sbMotionUpload.Get(), 0, 0, 1, &motionData);
+    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_sbMotion.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+    // every particle starts alive, so the dead list starts empty: committed resources are
+    // zeroed, which is a counter of 0
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(m_Particles.size() * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&m_DeadList));
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&m_DeadListCounter));
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_DeadListCount));
+
+    m_DeadList->SetName(L"Dead List");
+    m_DeadListCounter->SetName(L"Dead List Counter");
+    m_DeadListCount->SetName(L"Dead List Count");
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC deadListDesc = {};
+    deadListDesc.Format = DXGI_FORMAT_UNKNOWN;
+    deadListDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    deadListDesc.Buffer.FirstElement = 0;
+    deadListDesc.Buffer.NumElements = static_cast<UINT>(m_Particles.size());
+    deadListDesc.Buffer.StructureByteStride = sizeof(uint32_t);
+    deadListDesc.Buffer.CounterOffsetInBytes = 0;
+    deadListDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE deadListHandle(m_srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), DeadListUavIndex(), srvDescriptorSize);
+    m_Device->CreateUnorderedAccessView(m_DeadList.Get(), m_DeadListCounter.Get(), &deadListDesc, deadListHandle);
+
+    // CSSimulate runs over every particle, the light source included, so it gets copied along
+    UINT particlesCount = static_cast<UINT>(m_Particles.size());
+    SimulationDispatchSize(particlesCount, m_SimulationGroupsX, m_SimulationGroupsY);
+
+    m_cbSimulation = {};
+    m_cbSimulation.gravity = m_SimulationSettings.gravity;
+    m_cbSimulation.drag = m_SimulationSettings.drag;
+    m_cbSimulation.emitterCenter = m_SimulationSettings.emitterCenter;
+    m_cbSimulation.emitterSpread = m_SimulationSettings.emitterSpread;
+    m_cbSimulation.emitVelocity = m_SimulationSettings.emitVelocity;
+    m_cbSimulation.velocitySpread = m_SimulationSettings.velocitySpread;
+    m_cbSimulation.lifetimeMin = m_SimulationSettings.lifetimeMin;
+    m_cbSimulation.lifetimeMax = m_SimulationSettings.lifetimeMax;
+    m_cbSimulation.particleRadius = m_SimulationSettings.radius;
+    m_cbSimulation.particleOpacity = m_SimulationSettings.opacity;
+    m_cbSimulation.particleColor = m_SimulationSettings.color;
+    m_cbSimulation.seed = m_SimulationSettings.seed;
+    m_cbSimulation.particlesCount = particlesCount;
+    m_cbSimulation.simulatedCount = simulatedCount;
+    m_cbSimulation.dispatchGroupsX = m_SimulationGroupsX;
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_cbSimulationUploadHeap)
+    );
+
+    CD3DX12_RANGE readRange(0, 0);
+    m_cbSimulationUploadHeap->Map(0, &readRange, reinterpret_cast<void**>(&m_cbSimulationGPUAddress));
+}
+
+void DeviceContext::CreateSortResources()
+{
+    UINT particlesCount = static_cast<UINT>(m_Particles.size());
+    m_SortBlockCount = (particlesCount + sortBlockSize - 1) / sortBlockSize;
+
+    UINT64 pairSize = UINT64(particlesCount) * sizeof(uint32_t);
+
+    for (int pair = 0; pair < 2; ++pair)
+    {
+        m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(pairSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            nullptr,
+            IID_PPV_ARGS(&m_SortKeys[pair]));
+
+        // Draw hands m_SortValues[0] to the vertex stage and takes it back for the next sort
+        m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(pairSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+            pair == 0 ? D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            nullptr,
+            IID_PPV_ARGS(&m_SortValues[pair]));
+
+        m_SortKeys[pair]->SetName(L"Sort Keys");
+        m_SortValues[pair]->SetName(L"Sort Values");
+    }
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(UINT64(sortRadix) * m_SortBlockCount * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&m_SortBlockOffsets));
+
+    m_SortBlockOffsets->SetName(L"Sort Block Offsets");
+}
+
+void DeviceContext::CreateCullResources()
+{
+    UINT particlesCount = static_cast<UINT>(m_Particles.size());
+    m_CullBlockCount = (particlesCount + cullBlockSize - 1) / cullBlockSize;
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(UINT64(m_CullBlockCount) * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&m_CullBlockOffsets));
+
+    // both start in the state the draw leaves them in
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(UINT64(particlesCount) * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+        nullptr,
+        IID_PPV_ARGS(&m_CullVisible));
+
+    m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(2 * sizeof(D3D12_DRAW_ARGUMENTS), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+        D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+        nullptr,
+        IID_PPV_ARGS(&m_CullDrawArgs));
+
+    m_CullBlockOffsets->SetName(L"Cull Block Offsets");
+    m_CullVisible->SetName(L"Cull Visible Particles");
+    m_CullDrawArgs->SetName(L"Cull Draw Arguments");
+
+    // no root arguments change between draws, so no root signature is needed
+    D3D12_INDIRECT_ARGUMENT_DESC drawArgument = {};
+    drawArgument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+    D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+    commandSignatureDesc.ByteStride = sizeof(D3D12_DRAW_ARGUMENTS);
+    commandSignatureDesc.NumArgumentDescs = 1;
+    commandSignatureDesc.pArgumentDescs = &drawArgument;
+
+    m_Device->CreateCommandSignature(&commandSignatureDesc, nullptr, IID_PPV_ARGS(&m_DrawCommandSignature));
+}
+
+void DeviceContext::SimulationDispatchSize(UINT threadCount, UINT& groupsX, UINT& groupsY) const
 {
-    int vBufferSize = sizeof(Vertex) * m_VertexList.size();
+    UINT groupsCount = (threadCount + simulationGroupSize - 1) / simulationGroupSize;
 
-    m_VertexBufferView.BufferLocation = m_VertexBuffer->GetGPUVirtualAddress();
-    m_VertexBufferView.SizeInBytes = vBufferSize;
-    m_VertexBufferView.StrideInBytes = sizeof(Vertex);
+    groupsX = std::min<UINT>(std::max<UINT>(groupsCount, 1), m_SimulationGroupsX > 0 ? m_SimulationGroupsX : D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION);
+    groupsY = (groupsCount + groupsX - 1) / groupsX;
+}
 
+void DeviceContext::CreateViewport(uint32_t width, uint32_t height)
+{
     m_Viewport.TopLeftX = 0;
     m_Viewport.TopLeftY = 0;
     m_Viewport.Width = width;
@@ -752,6 +1131,16 @@ void DeviceContext::CreateVertexBufferView(uint32_t width, uint32_t height)
     m_ScissorRect.bottom = height;
 }
 
+void DeviceContext::ComputeDispatchSize(UINT particlesCount)
+{
+    UINT groupSize = THREAD_X * THREAD_Y;
+    UINT groupsCount = (particlesCount + groupSize - 1) / groupSize;
+
+    // one dispatch dimension holds at most 65535 groups, the rest wraps into rows along y
+    m_DispatchGroupsX = std::min<UINT>(std::max<UINT>(groupsCount, 1), D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION);
+    m_DispatchGroupsY = (groupsCount + m_DispatchGroupsX - 1) / m_DispatchGroupsX;
+}
+
 void DeviceContext::WaitForPreviousFrame()
 {
     // swap the current rtv buffer index so we draw on the correct buffer
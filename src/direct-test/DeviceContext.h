@@ -6,17 +6,26 @@
 
 #include "Particle.hpp"
 
+#include "D3D12QueueTimeline.h"
+#include "ParticleSimulation.h"
+#include "PipelineLibrary.h"
+#include "ShaderLibrary.h"
+#include "SunBasis.h"
+
+#include <memory>
+
 #define SAFE_RELEASE(p) { if ( (p) ) { (p)->Release(); (p) = 0; } }
 
 struct DeviceContext
 {
-    DeviceContext(Win32Application& window, const std::vector<Particle>& particles);
+    DeviceContext(Win32Application& window, const std::vector<Particle>& particles, const SimulationSettings& simulationSettings);
 
+    // holds a reference to the window, and the GPU objects are released by the destructor
     DeviceContext(const DeviceContext&) = delete;
-    DeviceContext(DeviceContext&&) = default;
+    DeviceContext(DeviceContext&&) = delete;
 
     DeviceContext& operator=(const DeviceContext&) = delete;
-    DeviceContext& operator=(DeviceContext&&) = default;
+    DeviceContext& operator=(DeviceContext&&) = delete;
 
     ~DeviceContext();
 
@@ -40,16 +49,62 @@ struct DeviceContext
 
     void CreateComputePSO();
 
-    void CreateVertexBuffer();
+    void CreateSimulationPSOs();
+
+    void CreateSortPSOs();
+
+    void CreateCullPSOs();
 
     void CreateDepthResources(uint32_t width, uint32_t height);
 
     void CreateConstantBuffers();
 
-    void CreateVertexBufferView(uint32_t width, uint32_t height);
+    void CreateReadbackBuffers();
+
+    void CreateIncrementalBuffers();
+
+    void CreateSimulationResources();
+
+    void CreateSortResources();
+
+    void CreateCullResources();
+
+    void CreateViewport(uint32_t width, uint32_t height);
+
+    void ComputeDispatchSize(UINT particlesCount);
+
+    // groupsX and groupsY of a SimulationShader.hlsl dispatch over threadCount threads, with at
+    // most m_SimulationGroupsX groups per row as cbSimulation.dispatchGroupsX says
+    void SimulationDispatchSize(UINT threadCount, UINT& groupsX, UINT& groupsY) const;
 
     void LoadMatrices(float aspectRatio);
 
+    // every shader the PSOs are built from, indexes ShaderPermutations()
+    enum ShaderId
+    {
+        ParticleVS,
+        SpriteVS,
+        ParticleGS,
+        ParticlePS,
+        ShadowCS,
+        SimulateCS,
+        EmitCS,
+        SortKeysCS,
+        SortCountCS,
+        SortScanCS,
+        SortScatterCS,
+        CullCountCS,
+        CullScanCS,
+        CullCompactCS,
+        ShaderCount
+    };
+
+    static std::vector<ShaderPermutation> ShaderPermutations();
+
+    // Fills the shader cache with every permutation, what the PrecompileShaders target of
+    // direct-test.vcxproj runs through --precompile-shaders. Needs no device.
+    static bool PrecompileShaders(std::string& error);
+
     void Cleanup();
 
     void WaitForPreviousFrame();
@@ -59,12 +114,6 @@ public:
 
     std::vector<Particle> m_Particles;
 
-    struct Vertex {
-        XMFLOAT4 color = { 1.0, 0.0, 0.0, 1.0 };
-    };
-
-    std::vector<Vertex> m_VertexList;
-
     ComPtr<ID3D12Device> m_Device;
 
     ComPtr<IDXGISwapChain3> m_SwapChain;
@@ -72,24 +121,111 @@ public:
     ComPtr<ID3D12CommandQueue> m_CommandQueue;
 
     ComPtr<ID3D12CommandQueue> m_ComputeCommandQueue;
-    ComPtr<ID3D12CommandAllocator> m_ComputeCommandAllocator;
+    ComPtr<ID3D12CommandAllocator> m_ComputeCommandAllocator[AsyncShadowScheduler::SlotCount];
     ComPtr<ID3D12GraphicsCommandList> m_ComputeCommandList;
 
     ComPtr<ID3D12DescriptorHeap> m_rtvDescriptorHeap;
 
     ComPtr<ID3D12Resource> m_renderTargets[frameBufferCount];
 
-    const int THREAD_X = 32;
-    const int THREAD_Y = 32;
+    static const int THREAD_X = 32;
+    static const int THREAD_Y = 32;
+
+    UINT m_DispatchGroupsX = 0;
+    UINT m_DispatchGroupsY = 0;
 
-    ComPtr<ID3D12Resource> m_sbParticles;
+    // one copy per shadow slot, so the compute queue can patch the slot it computes while the
+    // frame being drawn still reads the other one; both start out from m_sbParticlesUpload
+    ComPtr<ID3D12Resource> m_sbParticles[AsyncShadowScheduler::SlotCount];
     ComPtr<ID3D12Resource> m_sbParticlesUpload;
     ComPtr<ID3D12DescriptorHeap> m_srvDescriptorHeap;
     int srvDescriptorSize;
 
-    ComPtr<ID3D12Resource> m_sbShadows;
+    // double-buffered: compute writes one slot while the frame being drawn reads the other
+    ComPtr<ID3D12Resource> m_sbShadows[AsyncShadowScheduler::SlotCount];
     ComPtr<ID3D12Resource> m_sbShadowsUpload;
 
+    // m_srvDescriptorHeap holds the particle SRVs, then the shadow UAVs ordered so that the
+    // descriptor after slot i's UAV is the UAV of the slot computed before it, a two entry
+    // table starting at ShadowsUavIndex(slot) binds (current, previous) for the incremental pass
+    static UINT ParticlesSrvIndex(UINT slot) { return slot; }
+    static UINT ShadowsUavIndex(UINT slot) { return AsyncShadowScheduler::SlotCount + (AsyncShadowScheduler::SlotCount - slot) % AsyncShadowScheduler::SlotCount; }
+    static UINT DeadListUavIndex() { return 2 * AsyncShadowScheduler::SlotCount + 1; }
+    static const UINT srvDescriptorCount = 2 * AsyncShadowScheduler::SlotCount + 2;
+
+    // persistently mapped, the particles that changed since a slot was last computed are staged
+    // here and copied into m_sbParticles[slot] by the compute list of that slot
+    ComPtr<ID3D12Resource> m_sbParticlesDelta[AsyncShadowScheduler::SlotCount];
+    Particle* m_ParticlesDeltaData[AsyncShadowScheduler::SlotCount];
+
+    // persistently mapped bit per receiver, set for the receivers the incremental pass recomputes
+    ComPtr<ID3D12Resource> m_DirtyMask[AsyncShadowScheduler::SlotCount];
+    uint32_t* m_DirtyMaskData[AsyncShadowScheduler::SlotCount];
+
+    // Simulation stage, see SimulationShader.hlsl. CSSimulate integrates the particles of the
+    // previous slot into the slot being computed and appends the ones that die to m_DeadList,
+    // CSEmit consumes dead slots for new particles. The shadow pass runs right after on the result.
+    SimulationSettings m_SimulationSettings;
+
+    ComPtr<ID3D12Resource> m_sbMotion;
+    ComPtr<ID3D12Resource> m_sbMotionUpload;
+
+    ComPtr<ID3D12Resource> m_DeadList;
+    ComPtr<ID3D12Resource> m_DeadListCounter;
+
+    // the counter is copied here between the two passes and bound as cbDeadList
+    ComPtr<ID3D12Resource> m_DeadListCount;
+
+    ComPtr<ID3D12RootSignature> m_SimulationRootSignature;
+    ComPtr<ID3D12PipelineState> m_SimulatePipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_EmitPipelineStateObject;
+
+    // GROUP_SIZE of SimulationShader.hlsl
+    static const UINT simulationGroupSize = 256;
+
+    UINT m_SimulationGroupsX = 0;
+    UINT m_SimulationGroupsY = 0;
+
+    // Depth sort of the draw order, see SortShader.hlsl. Keys and particle indices ping-pong
+    // between the two pairs over the four passes, which leaves the indices back to front in
+    // m_SortValues[0], bound as sbDrawOrder of the vertex shaders.
+    ComPtr<ID3D12Resource> m_SortKeys[2];
+    ComPtr<ID3D12Resource> m_SortValues[2];
+    ComPtr<ID3D12Resource> m_SortBlockOffsets;
+
+    ComPtr<ID3D12RootSignature> m_SortRootSignature;
+    ComPtr<ID3D12PipelineState> m_SortKeysPipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_SortCountPipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_SortScanPipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_SortScatterPipelineStateObject;
+
+    // BLOCK_SIZE and RADIX of SortShader.hlsl
+    static const UINT sortBlockSize = 2048;
+    static const UINT sortRadix = 256;
+
+    UINT m_SortBlockCount = 0;
+
+    // Frustum cull of the draw order, see CullShader.hlsl. The survivors of m_SortValues[0] are
+    // compacted into m_CullVisible and their count written into m_CullDrawArgs, which the draw
+    // executes indirectly through m_DrawCommandSignature.
+    ComPtr<ID3D12Resource> m_CullBlockOffsets;
+    ComPtr<ID3D12Resource> m_CullVisible;
+    ComPtr<ID3D12Resource> m_CullDrawArgs;
+
+    ComPtr<ID3D12RootSignature> m_CullRootSignature;
+    ComPtr<ID3D12PipelineState> m_CullCountPipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_CullScanPipelineStateObject;
+    ComPtr<ID3D12PipelineState> m_CullCompactPipelineStateObject;
+
+    // a single DrawInstanced, m_CullDrawArgs holds the one of the sprite path and then the one
+    // of the geometry shader path
+    ComPtr<ID3D12CommandSignature> m_DrawCommandSignature;
+
+    // BLOCK_SIZE of CullShader.hlsl
+    static const UINT cullBlockSize = 2048;
+
+    UINT m_CullBlockCount = 0;
+
     ComPtr<ID3D12CommandAllocator> m_CommandAllocator[frameBufferCount];
 
     ComPtr<ID3D12GraphicsCommandList> m_CommandList;
@@ -100,17 +236,24 @@ public:
 
     UINT64 m_FenceValue[frameBufferCount];
 
-    ComPtr<ID3D12Fence> m_threadFences;
-    HANDLE m_threadFenceEvents;
-
-    UINT64 m_renderContextFenceValues = 0;
-    UINT64 m_threadFenceValues = 0;
+    std::unique_ptr<D3D12QueueTimeline> m_ComputeTimeline;
+    std::unique_ptr<D3D12QueueTimeline> m_GraphicsTimeline;
 
     int frameIndex;
 
     int rtvDescriptorSize;
 
+    // bytecode of ShaderPermutations(), from the shader cache or compiled on a miss
+    std::unique_ptr<ShaderLibrary> m_Shaders;
+
+    // every PSO below goes through it, blobs from the last run make them cheap to create
+    std::unique_ptr<PipelineLibrary> m_Pipelines;
+
+    // point list expanded by GSMain, kept as the fallback of m_SpritePipelineStateObject
     ComPtr<ID3D12PipelineState> m_PipelineStateObject;
+
+    // VSSpriteMain, instanced triangle strips and no geometry shader
+    ComPtr<ID3D12PipelineState> m_SpritePipelineStateObject;
     ComPtr<ID3D12PipelineState> m_ComputePipelineStateObject;
 
     ComPtr<ID3D12RootSignature> m_GraphicsRootSignature;
@@ -120,33 +263,87 @@ public:
 
     D3D12_RECT m_ScissorRect;
 
-    ComPtr<ID3D12Resource> m_VertexBuffer;
-
-    D3D12_VERTEX_BUFFER_VIEW m_VertexBufferView;
-
     ComPtr<ID3D12Resource> m_depthStencilBuffer;
     ComPtr<ID3D12DescriptorHeap> m_dsDescriptorHeap;
 
     ComPtr<ID3D12DescriptorHeap> m_mainDescriptorHeap[frameBufferCount];
     ComPtr<ID3D12Resource> m_constantBufferUploadHeap[frameBufferCount];
 
-    ComPtr<ID3D12Resource> m_ReadbackBuffer;
+    static const UINT readbackSlotCount = 3;
+
+    // persistently mapped copies of sbShadows, slot bookkeeping is done by ReadbackRing
+    ComPtr<ID3D12Resource> m_ReadbackBuffers[readbackSlotCount];
+    float* m_ReadbackData[readbackSlotCount];
 
     struct ConstantBufferPerObject {
         DirectX::XMFLOAT4X4 wvpMat;
         DirectX::XMFLOAT4X4 invViewMat;
+        UINT lightSourceIndex;
     };
 
+    // matches the HLSL packing of cbCS, each float3 shares a 16 byte register with the value after it
     struct ComputeConstantBuffer {
         DirectX::XMFLOAT3 sunDir;
+        UINT particlesCount;
+        DirectX::XMFLOAT3 up;
+        UINT dispatchGroupsX;
+        DirectX::XMFLOAT3 forward;
+        UINT incremental;
+    };
+
+    // matches cbSimulation, packed like ComputeConstantBuffer
+    struct SimulationConstantBuffer {
+        DirectX::XMFLOAT3 gravity;
+        float drag;
+        DirectX::XMFLOAT3 emitterCenter;
+        float emitterSpread;
+        DirectX::XMFLOAT3 emitVelocity;
+        float velocitySpread;
+        float lifetimeMin;
+        float lifetimeMax;
+        float particleRadius;
+        float particleOpacity;
+        float deltaTime;
+        UINT seed;
+        UINT emitCount;
+        UINT emitSequence;
+        UINT particlesCount;
+        UINT simulatedCount;
+        UINT dispatchGroupsX;
+        UINT particleColor;
+    };
+
+    // matches cbSort, set as root constants
+    struct SortConstants {
+        DirectX::XMFLOAT3 viewAxis;
+        float viewOffset;
+        UINT particlesCount;
+        UINT blockCount;
+        UINT shift;
+    };
+
+    // matches cbCull, set as root constants
+    struct CullConstants {
+        DirectX::XMFLOAT4 frustumPlanes[6];
+        UINT particlesCount;
+        UINT blockCount;
     };
 
     int ConstantBufferPerObjectAlignedSize = (sizeof(ConstantBufferPerObject) + 255) & ~255;
+    int ComputeConstantBufferAlignedSize = (sizeof(ComputeConstantBuffer) + 255) & ~255;
+    int SimulationConstantBufferAlignedSize = (sizeof(SimulationConstantBuffer) + 255) & ~255;
 
     ConstantBufferPerObject m_cbPerObject;
 
+    // one 256 byte aligned copy per shadow slot, rewritten by the frame computing into the slot
     ComputeConstantBuffer m_cbSunDir;
     ComPtr<ID3D12Resource> m_cbSunDirUploadHeap;
+    UINT8* m_cbSunDirGPUAddress;
+
+    // one 256 byte aligned copy per shadow slot as well, the per frame fields are set by RenderSystem
+    SimulationConstantBuffer m_cbSimulation;
+    ComPtr<ID3D12Resource> m_cbSimulationUploadHeap;
+    UINT8* m_cbSimulationGPUAddress;
 
     ComPtr<ID3D12Resource> m_constantBufferUploadHeaps[frameBufferCount];
 
@@ -23,28 +23,11 @@ cbuffer ConstantBuffer : register(b0)
     row_major float4x4 invViewMat;
 };
 
+#include "Billboard.hlsli"
+
 //
 // GS for rendering point sprite particles.  Takes a point and turns 
-// it into 2 triangles.
-
-cbuffer cbImmutable
-{
-    static float3 g_positions[4] =
-    {
-        float3(-1, 1, 0),
-        float3(1, 1, 0),
-        float3(-1, -1, 0),
-        float3(1, -1, 0),
-    };
-    
-    static float2 g_texcoords[4] =
-    {
-        float2(0, 0),
-        float2(1, 0),
-        float2(0, 1),
-        float2(1, 1),
-    };
-};
+// it into 2 triangles. VSSpriteMain does the same without a GS.
 
 [maxvertexcount(4)]
 void GSMain(point VS_OUTPUT input[1], inout TriangleStream<GS_OUTPUT> SpriteStream)
@@ -54,11 +37,10 @@ void GSMain(point VS_OUTPUT input[1], inout TriangleStream<GS_OUTPUT> SpriteStre
     // Emit two new triangles.
     for (int i = 0; i < 4; i++)
     {
-        float3 position = g_positions[i] * radius;
-        position = mul(position, (float3x3) invViewMat) + input[0].pos;
+        float3 position = BillboardCornerPosition(input[0].pos.xyz, radius, invViewMat, i);
         
         output.pos = mul(float4(position, 1.0), wvpMat);
-        output.tex = g_texcoords[i];
+        output.tex = BillboardCornerTexcoord(i);
         output.color = input[0].color;
         output.shadow = input[0].shadow;
         output.radius = input[0].radius;
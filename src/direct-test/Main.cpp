@@ -1,12 +1,71 @@
 #include "RenderSystem.h"
 
+#include <cstring>
+
+// A windows subsystem app has no console for stderr. The debugger always gets the message. It
+// goes to the standard error handle when the parent handed one down, as the Exec of the
+// PrecompileShaders build target does, so the build log shows it without a dialog blocking the
+// build; started any other way it is shown in a message box.
+static void ReportStartupError(const std::string& message)
+{
+	std::string line = message + "\n";
+	OutputDebugStringA(line.c_str());
+
+	HANDLE output = GetStdHandle(STD_ERROR_HANDLE);
+	if (output != NULL && output != INVALID_HANDLE_VALUE)
+	{
+		DWORD written;
+		WriteFile(output, line.data(), static_cast<DWORD>(line.size()), &written, NULL);
+	}
+	else
+	{
+		MessageBoxA(NULL, message.c_str(), "direct-test", MB_OK | MB_ICONERROR);
+	}
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
 {
+	// run by the PrecompileShaders build target, fills the shader cache and exits without a window
+	if (std::strstr(lpCmdLine, "--precompile-shaders") != nullptr)
+	{
+		std::string error;
+		if (!DeviceContext::PrecompileShaders(error))
+		{
+			ReportStartupError("precompile-shaders: " + error);
+			return 1;
+		}
+		return 0;
+	}
+
+	// --trace path: profiles the run and writes the newest frames as a Chrome trace on exit
+	std::string tracePath;
+	if (const char* trace = std::strstr(lpCmdLine, "--trace"))
+	{
+		trace += std::strlen("--trace");
+		trace += std::strspn(trace, " \t");
+		tracePath.assign(trace, std::strcspn(trace, " \t"));
+	}
+
 	Win32Application m_Window = {};
 	m_Window.Initialize(hInstance, nShowCmd);
 
 	RenderSystem particlesRender(m_Window);
+	if (!tracePath.empty())
+	{
+		particlesRender.EnableProfiling();
+	}
+
 	particlesRender.MainLoop();
 
+	if (!tracePath.empty())
+	{
+		std::string error;
+		if (!particlesRender.WriteTrace(tracePath.c_str(), error))
+		{
+			OutputDebugStringA(("trace: " + error + "\n").c_str());
+			return 1;
+		}
+	}
+
 	return 0;
 }
@@ -0,0 +1,230 @@
+#include "PipelineLibrary.h"
+
+namespace
+{
+    PipelineCacheIdentity QueryIdentity(ID3D12Device* device)
+    {
+        PipelineCacheIdentity identity;
+
+        ComPtr<IDXGIFactory4> factory;
+        ComPtr<IDXGIAdapter1> adapter;
+        if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory)))
+            || FAILED(factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+        {
+            return identity;
+        }
+
+        DXGI_ADAPTER_DESC1 desc;
+        if (SUCCEEDED(adapter->GetDesc1(&desc)))
+        {
+            identity.vendorId = desc.VendorId;
+            identity.deviceId = desc.DeviceId;
+        }
+
+        // the user mode driver version, the only thing IDXGIDevice support is still asked for
+        LARGE_INTEGER driverVersion;
+        if (SUCCEEDED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion)))
+        {
+            identity.driverVersion = static_cast<uint64_t>(driverVersion.QuadPart);
+        }
+        return identity;
+    }
+
+    void AddShader(PipelineKey& key, const D3D12_SHADER_BYTECODE& shader)
+    {
+        key.Add(static_cast<uint64_t>(shader.BytecodeLength));
+        key.Add(shader.pShaderBytecode, shader.BytecodeLength);
+    }
+
+    // the states field by field, some of their structs have padding
+    void AddBlendState(PipelineKey& key, const D3D12_BLEND_DESC& blend)
+    {
+        key.Add(static_cast<uint64_t>(blend.AlphaToCoverageEnable));
+        key.Add(static_cast<uint64_t>(blend.IndependentBlendEnable));
+
+        for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget)
+        {
+            key.Add(static_cast<uint64_t>(target.BlendEnable));
+            key.Add(static_cast<uint64_t>(target.LogicOpEnable));
+            key.Add(static_cast<uint64_t>(target.SrcBlend));
+            key.Add(static_cast<uint64_t>(target.DestBlend));
+            key.Add(static_cast<uint64_t>(target.BlendOp));
+            key.Add(static_cast<uint64_t>(target.SrcBlendAlpha));
+            key.Add(static_cast<uint64_t>(target.DestBlendAlpha));
+            key.Add(static_cast<uint64_t>(target.BlendOpAlpha));
+            key.Add(static_cast<uint64_t>(target.LogicOp));
+            key.Add(static_cast<uint64_t>(target.RenderTargetWriteMask));
+        }
+    }
+
+    void AddStencilOp(PipelineKey& key, const D3D12_DEPTH_STENCILOP_DESC& op)
+    {
+        key.Add(static_cast<uint64_t>(op.StencilFailOp));
+        key.Add(static_cast<uint64_t>(op.StencilDepthFailOp));
+        key.Add(static_cast<uint64_t>(op.StencilPassOp));
+        key.Add(static_cast<uint64_t>(op.StencilFunc));
+    }
+
+    void AddDepthStencilState(PipelineKey& key, const D3D12_DEPTH_STENCIL_DESC& depthStencil)
+    {
+        key.Add(static_cast<uint64_t>(depthStencil.DepthEnable));
+        key.Add(static_cast<uint64_t>(depthStencil.DepthWriteMask));
+        key.Add(static_cast<uint64_t>(depthStencil.DepthFunc));
+        key.Add(static_cast<uint64_t>(depthStencil.StencilEnable));
+        key.Add(static_cast<uint64_t>(depthStencil.StencilReadMask));
+        key.Add(static_cast<uint64_t>(depthStencil.StencilWriteMask));
+        AddStencilOp(key, depthStencil.FrontFace);
+        AddStencilOp(key, depthStencil.BackFace);
+    }
+
+    void AddInputLayout(PipelineKey& key, const D3D12_INPUT_LAYOUT_DESC& inputLayout)
+    {
+        key.Add(static_cast<uint64_t>(inputLayout.NumElements));
+
+        for (UINT i = 0; i < inputLayout.NumElements; ++i)
+        {
+            const D3D12_INPUT_ELEMENT_DESC& element = inputLayout.pInputElementDescs[i];
+            key.AddString(element.SemanticName);
+            key.Add(static_cast<uint64_t>(element.SemanticIndex));
+            key.Add(static_cast<uint64_t>(element.Format));
+            key.Add(static_cast<uint64_t>(element.InputSlot));
+            key.Add(static_cast<uint64_t>(element.AlignedByteOffset));
+            key.Add(static_cast<uint64_t>(element.InputSlotClass));
+            key.Add(static_cast<uint64_t>(element.InstanceDataStepRate));
+        }
+    }
+}
+
+PipelineLibrary::PipelineLibrary(ID3D12Device* device, const std::string& path) : m_Device(device), m_Path(path)
+{
+    PipelineCacheIdentity identity = QueryIdentity(device);
+
+    std::string error;
+    if (!m_Cache.Load(path, &identity, error))
+    {
+        OutputDebugStringA(("pipeline cache: " + error + ", rebuilding it\n").c_str());
+    }
+    m_Cache.SetIdentity(identity);
+}
+
+void PipelineLibrary::AddRootSignature(ID3D12RootSignature* rootSignature, ID3DBlob* serialized)
+{
+    uint64_t hash = PipelineKey().Add(serialized->GetBufferPointer(), serialized->GetBufferSize()).Get();
+    m_RootSignatures.emplace_back(rootSignature, hash);
+}
+
+template <typename Desc, typename CreateFunction>
+HRESULT PipelineLibrary::CreateCached(uint64_t key, Desc& desc, CreateFunction create, ComPtr<ID3D12PipelineState>& pipelineState)
+{
+    m_UsedKeys.push_back(key);
+
+    const std::vector<uint8_t>* blob = m_Cache.Find(key);
+    if (blob != nullptr)
+    {
+        desc.CachedPSO.pCachedBlob = blob->data();
+        desc.CachedPSO.CachedBlobSizeInBytes = blob->size();
+
+        if (SUCCEEDED(create(desc)))
+        {
+            ++m_Hits;
+            return S_OK;
+        }
+
+        // D3D12_ERROR_ADAPTER_NOT_FOUND, D3D12_ERROR_DRIVER_VERSION_MISMATCH or a blob that
+        // does not match the description after all
+        m_Cache.Remove(key);
+        desc.CachedPSO = {};
+    }
+
+    HRESULT hr = create(desc);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    ++m_Creates;
+
+    ComPtr<ID3DBlob> cached;
+    if (SUCCEEDED(pipelineState->GetCachedBlob(&cached)))
+    {
+        m_Cache.Store(key, cached->GetBufferPointer(), cached->GetBufferSize());
+    }
+    return hr;
+}
+
+HRESULT PipelineLibrary::CreateGraphics(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, ComPtr<ID3D12PipelineState>& pipelineState)
+{
+    PipelineKey key;
+    key.AddString("graphics");
+    key.Add(RootSignatureHash(desc.pRootSignature));
+    AddShader(key, desc.VS);
+    AddShader(key, desc.PS);
+    AddShader(key, desc.DS);
+    AddShader(key, desc.HS);
+    AddShader(key, desc.GS);
+    key.Add(static_cast<uint64_t>(desc.StreamOutput.NumEntries));
+    AddBlendState(key, desc.BlendState);
+    key.Add(static_cast<uint64_t>(desc.SampleMask));
+    key.Add(&desc.RasterizerState, sizeof(desc.RasterizerState));
+    AddDepthStencilState(key, desc.DepthStencilState);
+    AddInputLayout(key, desc.InputLayout);
+    key.Add(static_cast<uint64_t>(desc.IBStripCutValue));
+    key.Add(static_cast<uint64_t>(desc.PrimitiveTopologyType));
+    key.Add(static_cast<uint64_t>(desc.NumRenderTargets));
+    key.Add(desc.RTVFormats, sizeof(desc.RTVFormats));
+    key.Add(static_cast<uint64_t>(desc.DSVFormat));
+    key.Add(&desc.SampleDesc, sizeof(desc.SampleDesc));
+    key.Add(static_cast<uint64_t>(desc.NodeMask));
+    key.Add(static_cast<uint64_t>(desc.Flags));
+
+    return CreateCached(key.Get(), desc, [&](const D3D12_GRAPHICS_PIPELINE_STATE_DESC& attempt)
+        {
+            return m_Device->CreateGraphicsPipelineState(&attempt, IID_PPV_ARGS(&pipelineState));
+        }, pipelineState);
+}
+
+HRESULT PipelineLibrary::CreateCompute(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, ComPtr<ID3D12PipelineState>& pipelineState)
+{
+    PipelineKey key;
+    key.AddString("compute");
+    key.Add(RootSignatureHash(desc.pRootSignature));
+    AddShader(key, desc.CS);
+    key.Add(static_cast<uint64_t>(desc.NodeMask));
+    key.Add(static_cast<uint64_t>(desc.Flags));
+
+    return CreateCached(key.Get(), desc, [&](const D3D12_COMPUTE_PIPELINE_STATE_DESC& attempt)
+        {
+            return m_Device->CreateComputePipelineState(&attempt, IID_PPV_ARGS(&pipelineState));
+        }, pipelineState);
+}
+
+void PipelineLibrary::Save()
+{
+    m_Cache.RemoveUnused(m_UsedKeys);
+
+    if (!m_Cache.IsModified())
+    {
+        return;
+    }
+
+    std::string error;
+    if (!m_Cache.Save(m_Path, error))
+    {
+        // only the next launch pays for it
+        OutputDebugStringA(("pipeline cache: " + error + "\n").c_str());
+    }
+}
+
+uint64_t PipelineLibrary::RootSignatureHash(ID3D12RootSignature* rootSignature) const
+{
+    for (const auto& known : m_RootSignatures)
+    {
+        if (known.first == rootSignature)
+        {
+            return known.second;
+        }
+    }
+
+    // unregistered, keyed by nothing but the pipeline itself; the driver still rejects a
+    // blob built for another root signature and the pipeline is rebuilt
+    return 0;
+}
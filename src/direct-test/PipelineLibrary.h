@@ -0,0 +1,53 @@
+#pragma once
+#include "config.h"
+
+#include "PipelineCache.h"
+
+#include <utility>
+#include <vector>
+
+// Creates pipeline state objects through a PipelineCache file. A pipeline whose description
+// hashes to a cached blob is created from it, which skips the driver's own compile; a blob the
+// driver refuses is dropped and the pipeline built from scratch, so a stale cache only costs
+// the time it would have taken anyway.
+class PipelineLibrary
+{
+public:
+    // Loads the cache at path. One written for another adapter or driver, or damaged, is
+    // ignored and overwritten by Save.
+    PipelineLibrary(ID3D12Device* device, const std::string& path);
+
+    // Root signatures go into the pipeline key through their serialized form, register each
+    // one before creating pipelines with it.
+    void AddRootSignature(ID3D12RootSignature* rootSignature, ID3DBlob* serialized);
+
+    HRESULT CreateGraphics(D3D12_GRAPHICS_PIPELINE_STATE_DESC desc, ComPtr<ID3D12PipelineState>& pipelineState);
+
+    HRESULT CreateCompute(D3D12_COMPUTE_PIPELINE_STATE_DESC desc, ComPtr<ID3D12PipelineState>& pipelineState);
+
+    // Writes the file when a pipeline was added or dropped since it was loaded. Blobs no
+    // pipeline asked for, left over from older shaders, are dropped first.
+    void Save();
+
+    size_t GetHitCount() const { return m_Hits; }
+    size_t GetCreateCount() const { return m_Creates; }
+
+private:
+    uint64_t RootSignatureHash(ID3D12RootSignature* rootSignature) const;
+
+    // create(desc) with the cached blob of key if there is one, then without it
+    template <typename Desc, typename CreateFunction>
+    HRESULT CreateCached(uint64_t key, Desc& desc, CreateFunction create, ComPtr<ID3D12PipelineState>& pipelineState);
+
+    ComPtr<ID3D12Device> m_Device;
+    std::string m_Path;
+
+    PipelineCache m_Cache;
+
+    std::vector<std::pair<ID3D12RootSignature*, uint64_t>> m_RootSignatures;
+
+    std::vector<uint64_t> m_UsedKeys;
+
+    size_t m_Hits = 0;
+    size_t m_Creates = 0;
+};
@@ -1,33 +1,82 @@
 #pragma once
+#include "D3D12RenderBackend.h"
 #include "DeviceContext.h"
 
+#include "FramePipeline.h"
+#include "ShadowSnapshot.h"
+
 class RenderSystem
 {
 public:
-	RenderSystem(Win32Application& window);
+	// with simulate the particles are moved by the simulation stage every frame, otherwise they
+	// only change through UpdateParticles
+	RenderSystem(Win32Application& window, UINT particlesCount = 1025, bool simulate = true);
 
+	// m_Backend, m_Pipeline and m_GPU hold references to other members and to the window, a
+	// moved RenderSystem would point into the one it was moved from
 	RenderSystem(const RenderSystem&) = delete;
-	RenderSystem(RenderSystem&&) = default;
+	RenderSystem(RenderSystem&&) = delete;
 
 	RenderSystem& operator=(const RenderSystem&) = delete;
-	RenderSystem& operator=(RenderSystem&&) = default;
+	RenderSystem& operator=(RenderSystem&&) = delete;
 
 	~RenderSystem() = default;
 
 public:
-	void RecordDrawingCommands();
-
 	void Render();
 
+	// Asks for the shadows of the next frame. They are copied into a readback slot along with
+	// that frame's shadow pass and handed to OnShadowsReadback a few frames later, without a stall.
 	void ReadDataFromComputePipeline();
 
-	void RunSimulation();
+	// Replaces the particles listed in indices with values. Only their delta is uploaded and the
+	// next shadow passes reshade just the receivers whose shadows they can affect. Not available
+	// while the simulation runs, the particles then only live on the GPU.
+	void UpdateParticles(const uint32_t* indices, size_t count, const Particle* values);
 
 	void MainLoop();
 
+	// Instanced is used whenever its pipeline state could be created, GeometryShader otherwise
+	void SetSpritePath(SpritePath path) { m_Backend.SetSpritePath(path); }
+
+	// back to front unless disabled, see D3D12RenderBackend::SetDepthSort
+	void SetDepthSort(bool enabled) { m_Backend.SetDepthSort(enabled); }
+
+	// see D3D12RenderBackend::SetFrustumCull
+	void SetFrustumCull(bool enabled) { m_Backend.SetFrustumCull(enabled); }
+
+	// Times the frame loop from now on: the CPU steps of FramePipeline and the GPU passes through
+	// timestamp queries. Keeps the newest frames only, WriteTrace saves them.
+	void EnableProfiling();
+
+	// see Profiler::WriteChromeTrace
+	bool WriteTrace(const char* path, std::string& error) const { return m_Profiler.WriteChromeTrace(path, error); }
+
 private:
-	int particlesCount = 1025; // 1024 is a light source
-	std::vector<Particle> m_Particles = Particle::LoadParticles(XMFLOAT3(330.0f * 0.50f, 0, 0), XMFLOAT4(0, 0, -20, 1 / 100000000.0f), 330.0f, particlesCount);
+	UINT particlesCount; // the last one is a light source
+	std::vector<Particle> m_Particles = Particle::LoadParticles(XMFLOAT3(330.0f * 0.50f, 0, 0), 330.0f, particlesCount);
+
+	// keeps the demo ball populated: same place and size as LoadParticles above, drifting along -z
+	static SimulationSettings DemoSimulationSettings(UINT particlesCount);
+
+	SimulationSettings m_SimulationSettings = DemoSimulationSettings(particlesCount);
+
+	bool m_SimulationEnabled;
 
 	DeviceContext m_GPU;
+
+	D3D12RenderBackend m_Backend{ m_GPU };
+
+	// the frame loop itself, the same one shadow-tool frames runs on SoftwareRenderBackend
+	FramePipeline m_Pipeline{ m_Backend, m_Particles, SunBasis{ m_GPU.m_cbSunDir.sunDir, m_GPU.m_cbSunDir.up, m_GPU.m_cbSunDir.forward }, m_SimulationEnabled ? &m_SimulationSettings : nullptr };
+
+	// the newest shadows read back and the frame that computed them
+	std::vector<float> m_ShadowsReadback;
+	uint64_t m_ShadowsReadbackFrame = 0;
+
+	void OnShadowsReadback(const float* shadows, uint64_t frame);
+
+	Profiler m_Profiler;
+
+	std::chrono::steady_clock::time_point m_LastFrameTime = std::chrono::steady_clock::now();
 };
@@ -0,0 +1,119 @@
+#include "ShaderLibrary.h"
+
+ShaderLibrary::ShaderLibrary(const std::string& sourceDirectory, const std::string& cacheDirectory)
+    : m_SourceDirectory(sourceDirectory)
+{
+    std::string error;
+    if (!m_Cache.Open(cacheDirectory, error))
+    {
+        // an index we cannot read is rebuilt by the next Store
+        OutputDebugStringA(("shader cache: " + error + "\n").c_str());
+    }
+}
+
+D3D12_SHADER_BYTECODE ShaderLibrary::Get(const ShaderPermutation& permutation)
+{
+    D3D12_SHADER_BYTECODE result = {};
+
+    std::string error;
+    const std::vector<uint8_t>* bytecode = Find(permutation, error);
+    if (bytecode == nullptr)
+    {
+        OutputDebugStringA((DescribePermutation(permutation) + ": " + error + "\n").c_str());
+        return result;
+    }
+
+    result.pShaderBytecode = bytecode->data();
+    result.BytecodeLength = bytecode->size();
+    return result;
+}
+
+bool ShaderLibrary::Precompile(const std::vector<ShaderPermutation>& permutations, std::string& error)
+{
+    error.clear();
+
+    for (const ShaderPermutation& permutation : permutations)
+    {
+        std::string permutationError;
+        if (Find(permutation, permutationError) == nullptr)
+        {
+            error += DescribePermutation(permutation) + ": " + permutationError + "\n";
+        }
+    }
+    return error.empty();
+}
+
+const std::vector<uint8_t>* ShaderLibrary::Find(const ShaderPermutation& permutation, std::string& error)
+{
+    uint64_t sourceHash;
+    if (!HashShaderSource(m_SourceDirectory, permutation.file, sourceHash, error))
+    {
+        return nullptr;
+    }
+
+    uint64_t key = ShaderCacheKey(permutation, sourceHash);
+
+    auto loaded = m_Bytecode.find(key);
+    if (loaded != m_Bytecode.end())
+    {
+        return &loaded->second;
+    }
+
+    std::vector<uint8_t> bytecode;
+    if (m_Cache.Load(key, bytecode))
+    {
+        ++m_Hits;
+        return &(m_Bytecode[key] = std::move(bytecode));
+    }
+
+    if (!Compile(permutation, bytecode, error))
+    {
+        return nullptr;
+    }
+    ++m_Compiles;
+
+    // a cache we cannot write only costs the next launch a compile
+    std::string storeError;
+    if (!m_Cache.Store(key, DescribePermutation(permutation), bytecode.data(), bytecode.size(), storeError))
+    {
+        OutputDebugStringA(("shader cache: " + storeError + "\n").c_str());
+    }
+
+    return &(m_Bytecode[key] = std::move(bytecode));
+}
+
+bool ShaderLibrary::Compile(const ShaderPermutation& permutation, std::vector<uint8_t>& bytecode, std::string& error) const
+{
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const ShaderDefine& define : permutation.defines)
+    {
+        defines.push_back({ define.name.c_str(), define.value.c_str() });
+    }
+    defines.push_back({ nullptr, nullptr });
+
+    // shader paths are plain ASCII
+    std::string file = m_SourceDirectory + "/" + permutation.file;
+    std::wstring path(file.begin(), file.end());
+
+    ComPtr<ID3DBlob> shader;
+    ComPtr<ID3DBlob> errorBuff;
+    HRESULT hr = D3DCompileFromFile(path.c_str(),
+        defines.data(),
+        D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        permutation.entryPoint.c_str(),
+        permutation.target.c_str(),
+        permutation.flags,
+        0,
+        &shader,
+        &errorBuff);
+
+    if (FAILED(hr))
+    {
+        error = errorBuff ? static_cast<const char*>(errorBuff->GetBufferPointer()) : "D3DCompileFromFile failed";
+        return false;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(shader->GetBufferPointer());
+    bytecode.assign(data, data + shader->GetBufferSize());
+    return true;
+}
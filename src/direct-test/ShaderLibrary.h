@@ -0,0 +1,42 @@
+#pragma once
+#include "config.h"
+
+#include "ShaderCache.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Shader bytecode for the PSOs. A permutation whose sources still hash to a key in the
+// ShaderCache is loaded from disk, anything else is compiled with D3DCompileFromFile and
+// stored, so only the first launch after a shader edit pays for the compile.
+class ShaderLibrary
+{
+public:
+    // shader sources are read from sourceDirectory, compiled blobs live in cacheDirectory
+    ShaderLibrary(const std::string& sourceDirectory, const std::string& cacheDirectory);
+
+    // Points into the library, valid for as long as it lives. Empty when the permutation does
+    // not compile, the compiler output goes to the debugger.
+    D3D12_SHADER_BYTECODE Get(const ShaderPermutation& permutation);
+
+    // Compiles and stores every permutation the cache misses. Returns false when one of them
+    // fails, error then holds the compiler output of each failure.
+    bool Precompile(const std::vector<ShaderPermutation>& permutations, std::string& error);
+
+    size_t GetHitCount() const { return m_Hits; }
+    size_t GetCompileCount() const { return m_Compiles; }
+
+private:
+    // bytecode of the permutation from the cache or the compiler, nullptr on failure
+    const std::vector<uint8_t>* Find(const ShaderPermutation& permutation, std::string& error);
+
+    bool Compile(const ShaderPermutation& permutation, std::vector<uint8_t>& bytecode, std::string& error) const;
+
+    std::string m_SourceDirectory;
+    ShaderCache m_Cache;
+
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_Bytecode;
+
+    size_t m_Hits = 0;
+    size_t m_Compiles = 0;
+};
@@ -0,0 +1,169 @@
+struct Particle
+{
+    float3  pos;
+    float   radius;
+    float   opacity;
+    uint    color;  // RGBA8, see Particle::color
+};
+
+// alive while age < lifetime, see ParticleMotion in ParticleSimulation.h
+struct ParticleMotion
+{
+    float3  velocity;
+    float   age;
+    float   lifetime;
+};
+
+// the particles of the slot computed last frame, read while the frame being drawn reads them too
+StructuredBuffer<Particle> sbPreviousParticles : register(t0);
+
+RWStructuredBuffer<Particle> sbParticles : register(u0);
+RWStructuredBuffer<ParticleMotion> sbMotion : register(u1);
+
+// indices of dead slots, used as an append buffer by CSSimulate and a consume buffer by CSEmit
+// through its hidden counter, so both entry points share one declaration
+RWStructuredBuffer<uint> sbDeadList : register(u2);
+
+// matches SimulationConstantBuffer in DeviceContext.h
+cbuffer cbSimulation : register(b0)
+{
+    float3  gravity;
+    float   drag;
+    float3  emitterCenter;
+    float   emitterSpread;
+    float3  emitVelocity;
+    float   velocitySpread;
+    float   lifetimeMin;
+    float   lifetimeMax;
+    float   particleRadius;
+    float   particleOpacity;
+    float   deltaTime;
+    uint    seed;
+    uint    emitCount;
+    uint    emitSequence;
+    uint    particlesCount;     // entries of sbParticles, the ones past simulatedCount are copied as they are
+    uint    simulatedCount;
+    uint    dispatchGroupsX;
+    uint    particleColor;
+}
+
+// the dead list counter as it was after CSSimulate, copied here so CSEmit never consumes past it
+cbuffer cbDeadList : register(b1)
+{
+    uint    deadCount;
+}
+
+#define GROUP_SIZE 256
+
+// the draws per sequence number of ParticleSimulation.cpp
+#define DRAW_RADIUS     0
+#define DRAW_COS_THETA  1
+#define DRAW_PHI        2
+#define DRAW_VELOCITY_X 3
+#define DRAW_VELOCITY_Y 4
+#define DRAW_VELOCITY_Z 5
+#define DRAW_LIFETIME   6
+#define DRAW_COUNT      8
+
+uint PcgHash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// SimulationRandom of ParticleSimulation.cpp
+float SimulationRandom(uint sequence, uint draw)
+{
+    uint hash = PcgHash(seed ^ PcgHash(sequence * DRAW_COUNT + draw));
+    return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+uint ThreadIndex(uint3 groupID, uint groupIndex)
+{
+    // groups are laid out row by row so that more than 65535 of them can be dispatched
+    return (groupID.y * dispatchGroupsX + groupID.x) * GROUP_SIZE + groupIndex;
+}
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSSimulate(uint3 groupID : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    uint index = ThreadIndex(groupID, groupIndex);
+
+    if (index >= particlesCount)
+    {
+        return;
+    }
+
+    Particle particle = sbPreviousParticles[index];
+
+    if (index >= simulatedCount)
+    {
+        sbParticles[index] = particle;
+        return;
+    }
+
+    ParticleMotion motion = sbMotion[index];
+
+    // IntegrateParticle of ParticleSimulation.cpp
+    if (motion.age < motion.lifetime)
+    {
+        motion.velocity += (gravity - drag * motion.velocity) * deltaTime;
+        particle.pos += motion.velocity * deltaTime;
+        motion.age += deltaTime;
+
+        if (motion.age >= motion.lifetime)
+        {
+            particle.radius = 0.0f;
+            particle.opacity = 0.0f;
+            motion.velocity = float3(0.0f, 0.0f, 0.0f);
+            motion.age = 0.0f;
+            motion.lifetime = 0.0f;
+
+            sbDeadList[sbDeadList.IncrementCounter()] = index;
+        }
+
+        sbMotion[index] = motion;
+    }
+
+    sbParticles[index] = particle;
+}
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSEmit(uint3 groupID : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    uint thread = ThreadIndex(groupID, groupIndex);
+
+    if (thread >= min(emitCount, deadCount))
+    {
+        return;
+    }
+
+    uint index = sbDeadList[sbDeadList.DecrementCounter() - 1];
+    uint sequence = emitSequence + thread;
+
+    // EmitParticle of ParticleSimulation.cpp
+    float radius = emitterSpread * pow(SimulationRandom(sequence, DRAW_RADIUS), 1.0f / 3.0f);
+    float cosTheta = 1.0f - 2.0f * SimulationRandom(sequence, DRAW_COS_THETA);
+    float sinTheta = sqrt(max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 6.28318530f * SimulationRandom(sequence, DRAW_PHI);
+
+    Particle particle;
+    particle.pos = emitterCenter + radius * float3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+    particle.radius = particleRadius;
+    particle.opacity = particleOpacity;
+    particle.color = particleColor;
+
+    float3 jitter = float3(
+        SimulationRandom(sequence, DRAW_VELOCITY_X),
+        SimulationRandom(sequence, DRAW_VELOCITY_Y),
+        SimulationRandom(sequence, DRAW_VELOCITY_Z));
+
+    ParticleMotion motion;
+    motion.velocity = emitVelocity + velocitySpread * (2.0f * jitter - 1.0f);
+    motion.age = 0.0f;
+    motion.lifetime = lerp(lifetimeMin, lifetimeMax, SimulationRandom(sequence, DRAW_LIFETIME));
+
+    sbParticles[index] = particle;
+    sbMotion[index] = motion;
+}
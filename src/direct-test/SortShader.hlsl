@@ -0,0 +1,205 @@
+struct Particle
+{
+    float3  pos;
+    float   radius;
+    float   opacity;
+    uint    color;
+};
+
+// root constants, matches SortConstants in DeviceContext.h
+cbuffer cbSort : register(b0)
+{
+    float3  viewAxis;       // ViewDepth of shadow-core/DepthSort.h, view space z = dot(pos, viewAxis) + viewOffset
+    float   viewOffset;
+    uint    particlesCount;
+    uint    blockCount;     // groups of CSSortKeys, CSCountDigits and CSScatter, BLOCK_SIZE keys each
+    uint    shift;          // of the digit the pass sorts by
+};
+
+StructuredBuffer<Particle> sbParticles : register(t0);
+
+// the pairs a pass reads and the ones it writes, swapped from one pass to the next
+RWStructuredBuffer<uint> sbKeys : register(u0);
+RWStructuredBuffer<uint> sbValues : register(u1);
+RWStructuredBuffer<uint> sbSortedKeys : register(u2);
+RWStructuredBuffer<uint> sbSortedValues : register(u3);
+
+// RADIX counters per block, digit major ([digit * blockCount + block]), so that after CSScanDigits
+// every entry is where the block's keys of that digit start in the output
+RWStructuredBuffer<uint> sbBlockOffsets : register(u4);
+
+#define GROUP_SIZE 256
+#define ITEMS_PER_THREAD 8
+#define BLOCK_SIZE (GROUP_SIZE * ITEMS_PER_THREAD)
+
+// 8 bit digits, four passes like RadixSorter
+#define RADIX 256
+
+// words of a bit per thread
+#define MASK_WORDS (GROUP_SIZE / 32)
+
+// FloatToSortableKey of shadow-core/RadixSort.h
+uint FloatToSortableKey(float value)
+{
+    uint bits = asuint(value);
+
+    // -0 sorts as +0
+    if ((bits & 0x7fffffffu) == 0)
+    {
+        bits = 0;
+    }
+
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// The key of item of the group's block. Items of a thread are GROUP_SIZE apart so every step
+// of the group reads consecutive keys.
+uint BlockIndex(uint group, uint item, uint thread)
+{
+    return group * BLOCK_SIZE + item * GROUP_SIZE + thread;
+}
+
+// ascending keys draw back to front, particle indices as values
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSSortKeys(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    for (uint item = 0; item < ITEMS_PER_THREAD; ++item)
+    {
+        uint index = BlockIndex(groupId.x, item, threadId.x);
+        if (index < particlesCount)
+        {
+            sbKeys[index] = FloatToSortableKey(dot(sbParticles[index].pos, viewAxis) + viewOffset);
+            sbValues[index] = index;
+        }
+    }
+}
+
+groupshared uint s_Counts[RADIX];
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSCountDigits(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    // GROUP_SIZE == RADIX, a counter per thread
+    s_Counts[threadId.x] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint item = 0; item < ITEMS_PER_THREAD; ++item)
+    {
+        uint index = BlockIndex(groupId.x, item, threadId.x);
+        if (index < particlesCount)
+        {
+            InterlockedAdd(s_Counts[(sbKeys[index] >> shift) & (RADIX - 1)], 1);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    sbBlockOffsets[threadId.x * blockCount + groupId.x] = s_Counts[threadId.x];
+}
+
+groupshared uint s_Scan[GROUP_SIZE];
+
+// Exclusive prefix sum over all of sbBlockOffsets in one group: every thread sums a run of
+// entries, the runs are scanned in groupshared memory and each thread writes its run's prefixes.
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSScanDigits(uint3 threadId : SV_GroupThreadID)
+{
+    uint entryCount = RADIX * blockCount;
+    uint runLength = (entryCount + GROUP_SIZE - 1) / GROUP_SIZE;
+    uint first = min(threadId.x * runLength, entryCount);
+    uint last = min(first + runLength, entryCount);
+
+    uint runSum = 0;
+    for (uint i = first; i < last; ++i)
+    {
+        runSum += sbBlockOffsets[i];
+    }
+
+    s_Scan[threadId.x] = runSum;
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint offset = 1; offset < GROUP_SIZE; offset <<= 1)
+    {
+        uint value = s_Scan[threadId.x];
+        if (threadId.x >= offset)
+        {
+            value += s_Scan[threadId.x - offset];
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        s_Scan[threadId.x] = value;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint prefix = s_Scan[threadId.x] - runSum;
+    for (uint j = first; j < last; ++j)
+    {
+        uint count = sbBlockOffsets[j];
+        sbBlockOffsets[j] = prefix;
+        prefix += count;
+    }
+}
+
+groupshared uint s_Offsets[RADIX];
+
+// a bit per thread for every digit, set for the threads of the chunk whose key has that digit
+groupshared uint s_DigitThreads[RADIX * MASK_WORDS];
+
+// Writes the block's pairs to their digit's range, stable: the block goes through its keys a
+// chunk of GROUP_SIZE at a time, in index order, and a key's rank among the chunk's keys of the
+// same digit is the number of lower threads set in that digit's mask.
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSScatter(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint thread = threadId.x;
+    uint word = thread / 32;
+    uint bit = 1u << (thread % 32);
+
+    s_Offsets[thread] = sbBlockOffsets[thread * blockCount + groupId.x];
+
+    for (uint item = 0; item < ITEMS_PER_THREAD; ++item)
+    {
+        // thread clears the mask of digit thread, only it reads that mask after the ranks
+        for (uint w = 0; w < MASK_WORDS; ++w)
+        {
+            s_DigitThreads[thread * MASK_WORDS + w] = 0;
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        uint index = BlockIndex(groupId.x, item, thread);
+        bool valid = index < particlesCount;
+
+        uint key = 0;
+        uint value = 0;
+        uint digit = 0;
+        if (valid)
+        {
+            key = sbKeys[index];
+            value = sbValues[index];
+            digit = (key >> shift) & (RADIX - 1);
+            InterlockedOr(s_DigitThreads[digit * MASK_WORDS + word], bit);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        if (valid)
+        {
+            uint rank = countbits(s_DigitThreads[digit * MASK_WORDS + word] & (bit - 1));
+            for (uint lower = 0; lower < word; ++lower)
+            {
+                rank += countbits(s_DigitThreads[digit * MASK_WORDS + lower]);
+            }
+
+            uint destination = s_Offsets[digit] + rank;
+            sbSortedKeys[destination] = key;
+            sbSortedValues[destination] = value;
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        // the next chunk's keys of digit thread go after this chunk's
+        uint chunkCount = 0;
+        for (uint m = 0; m < MASK_WORDS; ++m)
+        {
+            chunkCount += countbits(s_DigitThreads[thread * MASK_WORDS + m]);
+        }
+        s_Offsets[thread] += chunkCount;
+    }
+}
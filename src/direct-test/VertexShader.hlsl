@@ -1,6 +1,5 @@
 struct VS_INPUT
 {
-    float4 color    : COLOR;
     uint id         : SV_VERTEXID;
 };
 
@@ -17,6 +16,7 @@ cbuffer ConstantBuffer : register(b0)
 {
     row_major float4x4 wvpMat;
     row_major float4x4 invViewMat;
+    uint lightSourceIndex;
 };
 
 struct Particle
@@ -24,25 +24,37 @@ struct Particle
     float3 pos;
     float radius;
     float opacity;
+    uint color;
 };
 
 StructuredBuffer<Particle> sbParticles : register(t0);
 RWBuffer<float> sbShadows : register(u0);
 
-VS_OUTPUT VSMain(VS_INPUT input)
+// particle indices back to front, see SortShader.hlsl
+StructuredBuffer<uint> sbDrawOrder : register(t1);
+
+#include "Billboard.hlsli"
+
+// Particle::color, red in the low byte
+float4 UnpackColor(uint color)
+{
+    return float4(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24) / 255.0f;
+}
+
+// everything both draw paths read for particle id
+VS_OUTPUT LoadParticle(uint id)
 {
     VS_OUTPUT output;
     
-    float4 pos = float4(sbParticles[input.id].pos, 1.0f);
+    float4 pos = float4(sbParticles[id].pos, 1.0f);
     
     output.pos = pos;
-    output.color = input.color;
-    output.radius = sbParticles[input.id].radius;
+    output.radius = sbParticles[id].radius;
     
-    float opacity = sbParticles[input.id].opacity;
-    float4 color = input.color;
+    float opacity = sbParticles[id].opacity;
+    float4 color = UnpackColor(sbParticles[id].color);
     
-    if (input.id == 1024) // light source
+    if (id == lightSourceIndex) // light source
     {
         color = float4(1.0, 1.0, 1.0, 1.0);
         opacity = 1.0f;
@@ -51,7 +63,49 @@ VS_OUTPUT VSMain(VS_INPUT input)
     output.color = color;
     output.opacity = opacity;
     
-    output.shadow = sbShadows[input.id];
+    output.shadow = sbShadows[id];
+    
+    return output;
+}
+
+// one point per particle, expanded by GSMain
+VS_OUTPUT VSMain(VS_INPUT input)
+{
+    return LoadParticle(sbDrawOrder[input.id]);
+}
+
+struct VS_SPRITE_INPUT
+{
+    uint corner     : SV_VERTEXID;
+    uint id         : SV_INSTANCEID;
+};
+
+// what GSMain emits and PSMain reads
+struct VS_SPRITE_OUTPUT
+{
+    float2 tex : TEXCOORD0;
+    float4 pos : SV_POSITION;
+    float4 color : COLOR;
+    float shadow : SHADOW;
+    float radius : RADIUS;
+    float opacity : OPACITY;
+};
+
+// Draws every particle as an instance of a 4 vertex triangle strip, the corner comes from
+// SV_VertexID, so sprites are expanded without a geometry shader.
+VS_SPRITE_OUTPUT VSSpriteMain(VS_SPRITE_INPUT input)
+{
+    VS_OUTPUT particle = LoadParticle(sbDrawOrder[input.id]);
+    
+    float3 position = BillboardCornerPosition(particle.pos.xyz, particle.radius, invViewMat, input.corner);
+    
+    VS_SPRITE_OUTPUT output;
+    output.pos = mul(float4(position, 1.0), wvpMat);
+    output.tex = BillboardCornerTexcoord(input.corner);
+    output.color = particle.color;
+    output.shadow = particle.shadow;
+    output.radius = particle.radius;
+    output.opacity = particle.opacity;
     
     return output;
 }
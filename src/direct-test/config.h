@@ -55,6 +55,7 @@ using namespace Microsoft::WRL;
 
 #include "d3dx12.h"
 #include <string>
+#include <algorithm>
 
 #include <fstream>
 
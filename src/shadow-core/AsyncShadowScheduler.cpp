@@ -0,0 +1,60 @@
+#include "AsyncShadowScheduler.h"
+
+AsyncShadowScheduler::AsyncShadowScheduler(IQueueTimeline& computeQueue, IQueueTimeline& graphicsQueue)
+    : m_ComputeQueue(&computeQueue), m_GraphicsQueue(&graphicsQueue)
+{
+}
+
+uint32_t AsyncShadowScheduler::BeginCompute()
+{
+    m_ComputeSlot = static_cast<uint32_t>(m_Frame % SlotCount);
+
+    if (m_ComputeDone[m_ComputeSlot] > 0)
+    {
+        m_ComputeQueue->CpuWait(m_ComputeDone[m_ComputeSlot]);
+    }
+
+    // write-after-read across queues, the draw of frame N - 1 still reads this slot
+    if (m_DrawDone[m_ComputeSlot] > 0)
+    {
+        m_ComputeQueue->GpuWait(*m_GraphicsQueue, m_DrawDone[m_ComputeSlot]);
+    }
+
+    return m_ComputeSlot;
+}
+
+void AsyncShadowScheduler::EndCompute()
+{
+    m_ComputeDone[m_ComputeSlot] = m_ComputeQueue->Signal();
+}
+
+uint32_t AsyncShadowScheduler::BeginDraw()
+{
+    if (m_Frame == 0)
+    {
+        m_DrawSlot = SlotCount - 1;
+        return m_DrawSlot;
+    }
+
+    m_DrawSlot = static_cast<uint32_t>((m_Frame - 1) % SlotCount);
+    m_GraphicsQueue->GpuWait(*m_ComputeQueue, m_ComputeDone[m_DrawSlot]);
+
+    return m_DrawSlot;
+}
+
+void AsyncShadowScheduler::EndDraw()
+{
+    m_DrawDone[m_DrawSlot] = m_GraphicsQueue->Signal();
+    m_NewestSlot = m_ComputeSlot;
+
+    ++m_Frame;
+}
+
+void AsyncShadowScheduler::Flush()
+{
+    for (uint32_t slot = 0; slot < SlotCount; ++slot)
+    {
+        m_ComputeQueue->CpuWait(m_ComputeDone[slot]);
+        m_GraphicsQueue->CpuWait(m_DrawDone[slot]);
+    }
+}
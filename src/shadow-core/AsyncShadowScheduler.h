@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+
+// One GPU queue seen as a monotonic fence timeline. The D3D12 implementation wraps a command
+// queue and a fence, a CPU mock can complete the values by hand.
+class IQueueTimeline
+{
+public:
+    virtual ~IQueueTimeline() = default;
+
+    // enqueues a signal behind everything submitted so far and returns the value it will reach
+    virtual uint64_t Signal() = 0;
+
+    virtual uint64_t GetCompletedValue() const = 0;
+
+    // makes work submitted to this queue from now on wait for other to reach value, without the CPU
+    virtual void GpuWait(const IQueueTimeline& other, uint64_t value) = 0;
+
+    // blocks the calling thread until this queue reaches value
+    virtual void CpuWait(uint64_t value) = 0;
+};
+
+// Frame pacing of the double-buffered shadow pass. Frame N computes shadows into slot N % 2 on
+// the compute queue while the graphics queue draws with the slot written by frame N - 1, so the
+// two overlap. A slot is only written again once the draw that read it has retired.
+//
+// Per frame: BeginCompute, submit the compute work, EndCompute, BeginDraw, submit the draw, EndDraw.
+class AsyncShadowScheduler
+{
+public:
+    static const uint32_t SlotCount = 2;
+
+    AsyncShadowScheduler(IQueueTimeline& computeQueue, IQueueTimeline& graphicsQueue);
+
+    // Returns the slot this frame's compute pass writes. The CPU waits until the compute work
+    // that last used the slot retired (its command allocator can then be reset), the compute
+    // queue waits on the GPU for the draw that last read it.
+    uint32_t BeginCompute();
+
+    void EndCompute();
+
+    // Returns the slot the draw reads and makes the graphics queue wait for the compute pass that
+    // wrote it. The first frame has no previous one and reads the untouched slot.
+    uint32_t BeginDraw();
+
+    void EndDraw();
+
+    // the slot written by the newest submitted compute pass and the compute value it signals
+    uint32_t GetNewestSlot() const { return m_NewestSlot; }
+    uint64_t GetComputeValue(uint32_t slot) const { return m_ComputeDone[slot]; }
+
+    uint64_t GetFrame() const { return m_Frame; }
+
+    // CPU waits for everything submitted through the scheduler on both queues
+    void Flush();
+
+private:
+    IQueueTimeline* m_ComputeQueue;
+    IQueueTimeline* m_GraphicsQueue;
+
+    uint64_t m_Frame = 0;
+
+    uint32_t m_ComputeSlot = 0;
+    uint32_t m_DrawSlot = SlotCount - 1;
+    uint32_t m_NewestSlot = SlotCount - 1;
+
+    // timeline values at which the last compute pass writing / draw reading each slot retires, 0 for never
+    uint64_t m_ComputeDone[SlotCount] = {};
+    uint64_t m_DrawDone[SlotCount] = {};
+};
@@ -0,0 +1,45 @@
+#include "Billboard.h"
+
+using namespace DirectX;
+
+namespace
+{
+    // g_BillboardCorners and g_BillboardTexcoords of Billboard.hlsli
+    const float CornerX[BillboardCornerCount] = { -1.0f, 1.0f, -1.0f, 1.0f };
+    const float CornerY[BillboardCornerCount] = { 1.0f, 1.0f, -1.0f, -1.0f };
+
+    const XMFLOAT2 Texcoords[BillboardCornerCount] =
+    {
+        XMFLOAT2(0.0f, 0.0f),
+        XMFLOAT2(1.0f, 0.0f),
+        XMFLOAT2(0.0f, 1.0f),
+        XMFLOAT2(1.0f, 1.0f),
+    };
+}
+
+BillboardVertex ExpandBillboard(const XMFLOAT3& center, float radius, const XMFLOAT4X4& invView, uint32_t corner)
+{
+    corner %= BillboardCornerCount;
+
+    // mul(row vector, (float3x3) invView): x times the first row plus y times the second
+    float x = CornerX[corner] * radius;
+    float y = CornerY[corner] * radius;
+
+    BillboardVertex vertex;
+    vertex.position.x = x * invView.m[0][0] + y * invView.m[1][0] + center.x;
+    vertex.position.y = x * invView.m[0][1] + y * invView.m[1][1] + center.y;
+    vertex.position.z = x * invView.m[0][2] + y * invView.m[1][2] + center.z;
+    vertex.texcoord = Texcoords[corner];
+    return vertex;
+}
+
+void ExpandBillboards(const Particle* particles, size_t count, const XMFLOAT4X4& invView, BillboardVertex* vertices)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t corner = 0; corner < BillboardCornerCount; ++corner)
+        {
+            vertices[i * BillboardCornerCount + corner] = ExpandBillboard(particles[i].pos, particles[i].radius, invView, corner);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "MathTypes.h"
+#include "Particle.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU version of Billboard.hlsli, the camera facing sprite both GSMain and VSSpriteMain build
+// around every particle.
+
+// corners per sprite, in triangle strip order
+const uint32_t BillboardCornerCount = 4;
+
+struct BillboardVertex
+{
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT2 texcoord;
+};
+
+// Corner corner of the sprite of the given radius around center. invView is row major, as in
+// cbPerObject.invViewMat, and only its upper 3x3 is used.
+BillboardVertex ExpandBillboard(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT4X4& invView, uint32_t corner);
+
+// BillboardCornerCount vertices per particle into vertices, particle i at vertices[4 * i]
+void ExpandBillboards(const Particle* particles, size_t count, const DirectX::XMFLOAT4X4& invView, BillboardVertex* vertices);
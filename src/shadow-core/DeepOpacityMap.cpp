@@ -0,0 +1,248 @@
+#include "DeepOpacityMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace
+{
+    // keeps fully opaque particles finite in log space, one of them still leaves only 1e-6
+    const float MinTransmittance = 1e-6f;
+
+    template <typename Function>
+    void ForEach(ThreadPool* pool, size_t taskCount, const Function& function)
+    {
+        if (pool != nullptr)
+        {
+            pool->ParallelFor(taskCount, [&](size_t task, size_t) { function(task); });
+            return;
+        }
+
+        for (size_t task = 0; task < taskCount; ++task)
+        {
+            function(task);
+        }
+    }
+}
+
+DeepOpacityMap::DeepOpacityMap(const SunBasis& basis, const DeepOpacityMapSettings& settings) : m_Basis(basis), m_Settings(settings)
+{
+}
+
+ShadowStats DeepOpacityMap::Compute(const Particle* particles, size_t count, float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    m_SunBasisPositions.resize(count);
+    m_Radius.resize(count);
+    m_LogTransmittance.resize(count);
+
+    DirectX::XMFLOAT3 minimum = m_Basis.Project(particles[0].pos);
+    DirectX::XMFLOAT3 maximum = minimum;
+    float maxRadius = 0.0f;
+    bool finite = true;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        DirectX::XMFLOAT3 sunBasisPos = m_Basis.Project(particles[i].pos);
+        m_SunBasisPositions[i] = sunBasisPos;
+        m_Radius[i] = particles[i].radius;
+        m_LogTransmittance[i] = std::log(std::max(1.0f - particles[i].opacity, MinTransmittance));
+
+        minimum.x = std::min(minimum.x, sunBasisPos.x);
+        minimum.y = std::min(minimum.y, sunBasisPos.y);
+        minimum.z = std::min(minimum.z, sunBasisPos.z);
+        maximum.x = std::max(maximum.x, sunBasisPos.x);
+        maximum.y = std::max(maximum.y, sunBasisPos.y);
+        maximum.z = std::max(maximum.z, sunBasisPos.z);
+        maxRadius = std::max(maxRadius, particles[i].radius);
+
+        finite = finite && std::isfinite(sunBasisPos.x) && std::isfinite(sunBasisPos.y) && std::isfinite(sunBasisPos.z)
+            && std::isfinite(particles[i].radius);
+    }
+
+    float extent = std::max(maximum.y - minimum.y, maximum.z - minimum.z);
+
+    // An infinite or NaN position or radius, or a spread too wide for a float with the spare
+    // cells around it, fits no grid and would turn cell and slice indices into garbage. The
+    // exact pass copes with them.
+    float margin = 2.0f * extent;
+    finite = finite && std::isfinite(maximum.x - minimum.x)
+        && std::isfinite(minimum.y - margin) && std::isfinite(maximum.y + margin)
+        && std::isfinite(minimum.z - margin) && std::isfinite(maximum.z + margin);
+
+    if (!finite)
+    {
+        ShadowEngine engine(m_Basis);
+        return pool != nullptr ? engine.ComputeParallel(*pool, particles, count, shadows) : engine.Compute(particles, count, shadows);
+    }
+
+    // one spare cell on every side, so bilinear lookups of any receiver stay inside the grid
+    uint32_t resolution = std::max(m_Settings.resolution, 4u);
+
+    m_CellSize = extent > 0.0f ? extent / static_cast<float>(resolution - 3) : 1.0f;
+    m_CellsY = std::min(static_cast<uint32_t>((maximum.y - minimum.y) / m_CellSize) + 3, resolution);
+    m_CellsZ = std::min(static_cast<uint32_t>((maximum.z - minimum.z) / m_CellSize) + 3, resolution);
+    m_OriginY = minimum.y - m_CellSize;
+    m_OriginZ = minimum.z - m_CellSize;
+
+    m_Slices = std::max(m_Settings.slices, 1u);
+    m_OriginX = minimum.x;
+    m_SliceDepth = maximum.x > minimum.x ? (maximum.x - minimum.x) / static_cast<float>(m_Slices) : 1.0f;
+
+    auto sliceOf = [&](float x)
+        {
+            return std::min(static_cast<uint32_t>((x - m_OriginX) / m_SliceDepth), m_Slices - 1);
+        };
+
+    // bucket the particles by slice, each slice is then splatted by one task without locks
+    m_SliceStart.assign(m_Slices + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        ++m_SliceStart[sliceOf(m_SunBasisPositions[i].x) + 1];
+    }
+    for (uint32_t s = 0; s < m_Slices; ++s)
+    {
+        m_SliceStart[s + 1] += m_SliceStart[s];
+    }
+
+    m_SliceOrder.resize(count);
+    std::vector<uint32_t> cursor(m_SliceStart.begin(), m_SliceStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_SliceOrder[cursor[sliceOf(m_SunBasisPositions[i].x)]++] = static_cast<uint32_t>(i);
+    }
+
+    size_t layerSize = static_cast<size_t>(m_CellsY) * m_CellsZ;
+    m_Layers.assign(layerSize * (m_Slices + 1), 0.0f);
+
+    std::atomic<uint64_t> cellsSplatted{ 0 };
+    ForEach(pool, m_Slices, [&](size_t slice)
+        {
+            cellsSplatted += SplatSlice(static_cast<uint32_t>(slice), maxRadius);
+        });
+
+    // prefix along depth from the sun side, one task per row of cells
+    ForEach(pool, m_CellsY, [&](size_t row)
+        {
+            for (uint32_t s = m_Slices - 1; s-- > 0;)
+            {
+                float* layer = &m_Layers[s * layerSize + row * m_CellsZ];
+                const float* ahead = layer + layerSize;
+
+                for (uint32_t z = 0; z < m_CellsZ; ++z)
+                {
+                    layer[z] += ahead[z];
+                }
+            }
+        });
+
+    size_t tileCount = (count + ShadowEngine::ReceiverTileSize - 1) / ShadowEngine::ReceiverTileSize;
+    ForEach(pool, tileCount, [&](size_t tile)
+        {
+            size_t first = tile * ShadowEngine::ReceiverTileSize;
+            size_t last = std::min(first + ShadowEngine::ReceiverTileSize, count);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                const DirectX::XMFLOAT3& sunBasisPos = m_SunBasisPositions[i];
+
+                uint32_t slice = sliceOf(sunBasisPos.x);
+                float sliceEnd = m_OriginX + static_cast<float>(slice + 1) * m_SliceDepth;
+                float ahead = std::min(std::max((sliceEnd - sunBasisPos.x) / m_SliceDepth, 0.0f), 1.0f);
+
+                // everything past the slice, plus the part of the slice ahead of the receiver
+                float behindSlice = SampleLayer(slice + 1, sunBasisPos.y, sunBasisPos.z);
+                float withSlice = SampleLayer(slice, sunBasisPos.y, sunBasisPos.z);
+                float logShadow = behindSlice + (withSlice - behindSlice) * ahead;
+
+                // the receiver splatted itself into its own slice, the pairwise test skips it
+                logShadow -= ahead * m_LogTransmittance[i];
+
+                shadows[i] = std::min(std::exp(logShadow), 1.0f);
+            }
+        });
+
+    stats.pairsTested = cellsSplatted;
+    return stats;
+}
+
+ShadowStats DeepOpacityMap::Compute(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool)
+{
+    shadows.resize(particles.size());
+
+    return Compute(particles.data(), particles.size(), shadows.data(), pool);
+}
+
+size_t DeepOpacityMap::GetMemoryUsage() const
+{
+    return m_SunBasisPositions.capacity() * sizeof(DirectX::XMFLOAT3)
+        + (m_Radius.capacity() + m_LogTransmittance.capacity() + m_Layers.capacity()) * sizeof(float)
+        + (m_SliceStart.capacity() + m_SliceOrder.capacity()) * sizeof(uint32_t);
+}
+
+uint64_t DeepOpacityMap::SplatSlice(uint32_t slice, float maxRadius)
+{
+    uint64_t cellsSplatted = 0;
+    float* layer = &m_Layers[static_cast<size_t>(slice) * m_CellsY * m_CellsZ];
+
+    for (uint32_t k = m_SliceStart[slice]; k < m_SliceStart[slice + 1]; ++k)
+    {
+        uint32_t i = m_SliceOrder[k];
+        float y = m_SunBasisPositions[i].y;
+        float z = m_SunBasisPositions[i].z;
+
+        // the cells whose centre a receiver of any radius could occupy while touching this occluder
+        float reach = m_Radius[i] + maxRadius;
+        float logTransmittance = m_LogTransmittance[i];
+
+        // clamped while still floats, a reach far beyond the grid does not fit an int
+        float cellsY = static_cast<float>(m_CellsY);
+        float cellsZ = static_cast<float>(m_CellsZ);
+        int firstY = static_cast<int>(std::min(std::max(std::ceil((y - reach - m_OriginY) / m_CellSize - 0.5f), 0.0f), cellsY));
+        int lastY = static_cast<int>(std::max(std::min(std::floor((y + reach - m_OriginY) / m_CellSize - 0.5f), cellsY - 1.0f), -1.0f));
+        int firstZ = static_cast<int>(std::min(std::max(std::ceil((z - reach - m_OriginZ) / m_CellSize - 0.5f), 0.0f), cellsZ));
+        int lastZ = static_cast<int>(std::max(std::min(std::floor((z + reach - m_OriginZ) / m_CellSize - 0.5f), cellsZ - 1.0f), -1.0f));
+
+        for (int cellY = firstY; cellY <= lastY; ++cellY)
+        {
+            float dy = m_OriginY + (static_cast<float>(cellY) + 0.5f) * m_CellSize - y;
+            float* row = layer + static_cast<size_t>(cellY) * m_CellsZ;
+
+            for (int cellZ = firstZ; cellZ <= lastZ; ++cellZ)
+            {
+                float dz = m_OriginZ + (static_cast<float>(cellZ) + 0.5f) * m_CellSize - z;
+
+                if (std::sqrt(dy * dy + dz * dz) <= reach)
+                {
+                    row[cellZ] += logTransmittance;
+                    ++cellsSplatted;
+                }
+            }
+        }
+    }
+    return cellsSplatted;
+}
+
+float DeepOpacityMap::SampleLayer(uint32_t layerIndex, float y, float z) const
+{
+    float u = (y - m_OriginY) / m_CellSize - 0.5f;
+    float v = (z - m_OriginZ) / m_CellSize - 0.5f;
+
+    float y0 = std::min(std::max(std::floor(u), 0.0f), static_cast<float>(m_CellsY - 2));
+    float z0 = std::min(std::max(std::floor(v), 0.0f), static_cast<float>(m_CellsZ - 2));
+    float ty = std::min(std::max(u - y0, 0.0f), 1.0f);
+    float tz = std::min(std::max(v - z0, 0.0f), 1.0f);
+
+    const float* row0 = &m_Layers[(static_cast<size_t>(layerIndex) * m_CellsY + static_cast<size_t>(y0)) * m_CellsZ + static_cast<size_t>(z0)];
+    const float* row1 = row0 + m_CellsZ;
+
+    float l0 = row0[0] + (row0[1] - row0[0]) * tz;
+    float l1 = row1[0] + (row1[1] - row1[0]) * tz;
+
+    return l0 + (l1 - l0) * ty;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Particle.hpp"
+#include "ShadowEngine.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DeepOpacityMapSettings
+{
+    // cells along the longer of the up and forward extents, the other axis keeps square cells
+    uint32_t resolution = 256;
+
+    // depth slices along sunDir
+    uint32_t slices = 64;
+};
+
+// Approximate alternative to the pairwise sun basis pass, a deep opacity map in the sun basis.
+// Every particle multiplies its (1 - opacity) into the cells of its depth slice whose centre it
+// reaches, a light-space grid over up x forward x depth. The slices are then prefix-multiplied
+// from the sun side, so each cell holds the transmittance of everything at or ahead of its
+// slice, and a receiver reads its shadow in O(1) with a bilinear lookup in the two slice
+// boundaries around its depth.
+//
+// The work is O(N * cells per disc + cells) instead of O(N^2). Receiver positions are blurred
+// over a cell and occluders inside the receiver's own slice are counted by the fraction of the
+// slice ahead of it instead of by their depth, CompareShadows measures what that costs.
+// An occluder reaches a cell when the cell centre is within its radius plus the largest radius,
+// so receivers smaller than the largest particle are over-shadowed, as in StreamingShadowBaker.
+class DeepOpacityMap
+{
+public:
+    explicit DeepOpacityMap(const SunBasis& basis, const DeepOpacityMapSettings& settings = DeepOpacityMapSettings());
+
+    // shadows[i] approximates what ShadowEngine::Compute returns. The stats count cell updates
+    // as pairsTested, occluderHits stays 0. Slices and receiver tiles go to the pool when one is given.
+    // Particles with an infinite or NaN position or radius fit no map, they get the exact shadows
+    // and stats of ShadowEngine::ComputeParallel (or Compute without a pool).
+    ShadowStats Compute(const Particle* particles, size_t count, float* shadows, ThreadPool* pool = nullptr);
+
+    ShadowStats Compute(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool = nullptr);
+
+    float GetCellSize() const { return m_CellSize; }
+    float GetSliceDepth() const { return m_SliceDepth; }
+
+    // bytes of working memory kept between calls
+    size_t GetMemoryUsage() const;
+
+private:
+    uint64_t SplatSlice(uint32_t slice, float maxRadius);
+
+    float SampleLayer(uint32_t layer, float y, float z) const;
+
+    SunBasis m_Basis;
+    DeepOpacityMapSettings m_Settings;
+
+    std::vector<DirectX::XMFLOAT3> m_SunBasisPositions;
+    std::vector<float> m_Radius;
+    std::vector<float> m_LogTransmittance;
+
+    // particles bucketed by depth slice, m_SliceStart[s] .. m_SliceStart[s + 1]
+    std::vector<uint32_t> m_SliceStart;
+    std::vector<uint32_t> m_SliceOrder;
+
+    // log of the transmittance, layer s holds the sum over slices >= s and layer m_Slices is 0
+    std::vector<float> m_Layers;
+
+    float m_OriginX = 0.0f;
+    float m_OriginY = 0.0f;
+    float m_OriginZ = 0.0f;
+    float m_CellSize = 1.0f;
+    float m_SliceDepth = 1.0f;
+    uint32_t m_CellsY = 0;
+    uint32_t m_CellsZ = 0;
+    uint32_t m_Slices = 0;
+};
@@ -0,0 +1,42 @@
+#include "DepthSort.h"
+
+#include <algorithm>
+
+namespace
+{
+    // keys made per task
+    const size_t KeyBlockSize = 1 << 16;
+}
+
+const std::vector<uint32_t>& DepthSorter::Sort(const Particle* particles, size_t count, const ViewDepth& view, ThreadPool* pool)
+{
+    m_Keys.resize(count);
+    m_Order.resize(count);
+
+    auto makeKeys = [&](size_t block, size_t)
+        {
+            size_t last = std::min(count, (block + 1) * KeyBlockSize);
+            for (size_t i = block * KeyBlockSize; i < last; ++i)
+            {
+                m_Keys[i] = DepthSortKey(view, particles[i].pos);
+                m_Order[i] = static_cast<uint32_t>(i);
+            }
+        };
+
+    size_t blockCount = (count + KeyBlockSize - 1) / KeyBlockSize;
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(blockCount, makeKeys);
+        m_Sorter.SortParallel(*pool, m_Keys.data(), m_Order.data(), count);
+    }
+    else
+    {
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            makeKeys(block, 0);
+        }
+        m_Sorter.Sort(m_Keys.data(), m_Order.data(), count);
+    }
+
+    return m_Order;
+}
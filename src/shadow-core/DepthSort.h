@@ -0,0 +1,60 @@
+#pragma once
+#include "MathTypes.h"
+#include "Particle.hpp"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The view space z of a point as cbSort of SortShader.hlsl holds it: dot(position, axis) + offset.
+// The view of XMMatrixLookToRH looks down -z, so the smaller z the farther away.
+struct ViewDepth
+{
+    DirectX::XMFLOAT3 axis;
+    float offset;
+
+    // from the row major inverse view matrix of cbPerObject, whose third row is the camera's z
+    // axis and whose fourth row its position
+    static ViewDepth FromInvView(const DirectX::XMFLOAT4X4& invView)
+    {
+        ViewDepth view;
+        view.axis = DirectX::XMFLOAT3(invView.m[2][0], invView.m[2][1], invView.m[2][2]);
+        view.offset = -(invView.m[3][0] * view.axis.x + invView.m[3][1] * view.axis.y + invView.m[3][2] * view.axis.z);
+        return view;
+    }
+
+    float Depth(const DirectX::XMFLOAT3& position) const
+    {
+        return position.x * axis.x + position.y * axis.y + position.z * axis.z + offset;
+    }
+};
+
+// Sort key of a particle, ascending keys draw back to front. CSSortKeys computes the same.
+inline uint32_t DepthSortKey(const ViewDepth& view, const DirectX::XMFLOAT3& position)
+{
+    return FloatToSortableKey(view.Depth(position));
+}
+
+// CPU version of the depth sort in SortShader.hlsl: keys from DepthSortKey, particle indices as
+// values, a stable radix sort, so particles at the same depth keep their index order.
+class DepthSorter
+{
+public:
+    // Returns the particle indices from the farthest to the nearest, the order the vertex stage
+    // reads sbParticles through. Keys are made and sorted on the pool when one is given.
+    const std::vector<uint32_t>& Sort(const Particle* particles, size_t count, const ViewDepth& view, ThreadPool* pool = nullptr);
+
+    const std::vector<uint32_t>& GetOrder() const { return m_Order; }
+
+    // the keys of GetOrder(), ascending
+    const std::vector<uint32_t>& GetKeys() const { return m_Keys; }
+
+    size_t GetMemoryUsage() const { return (m_Keys.capacity() + m_Order.capacity()) * sizeof(uint32_t) + m_Sorter.GetMemoryUsage(); }
+
+private:
+    RadixSorter m_Sorter;
+    std::vector<uint32_t> m_Keys;
+    std::vector<uint32_t> m_Order;
+};
@@ -0,0 +1,212 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+
+namespace
+{
+    // everything before the light source, nothing without one
+    size_t ReceiverCount(const std::vector<Particle>& particles)
+    {
+        return particles.empty() ? 0 : particles.size() - 1;
+    }
+}
+
+FramePipeline::FramePipeline(IRenderBackend& backend, const std::vector<Particle>& particles, const SunBasis& basis, const SimulationSettings* simulation)
+    : m_Backend(backend), m_Particles(particles), m_Scheduler(backend.GetComputeQueue(), backend.GetGraphicsQueue()),
+    m_ReadbackRing(backend.GetReadbackSlotCount()), m_ShadowTracker(basis), m_Simulating(simulation != nullptr),
+    m_EmissionClock(static_cast<uint32_t>(ReceiverCount(particles)))
+{
+    if (simulation != nullptr)
+    {
+        m_EmissionRate = simulation->emissionRate;
+    }
+
+    m_ShadowTracker.Reset(m_Particles.data(), ReceiverCount(m_Particles));
+    m_DirtyMask.resize((m_ShadowTracker.Size() + 31) / 32);
+}
+
+FrameStats FramePipeline::RunFrame(float deltaTime)
+{
+    if (m_Profiler != nullptr)
+    {
+        m_Profiler->BeginFrame(m_Scheduler.GetFrame());
+    }
+
+    FrameStats stats;
+    {
+        ProfileScope scope(m_Profiler, "Readbacks");
+        stats.readbacks = ProcessReadbacks();
+    }
+
+    // a requested readback rides along with this frame's shadow pass
+    uint32_t readbackSlot = 0;
+    bool readback = m_ReadbackRequested && m_ReadbackRing.Acquire(readbackSlot);
+
+    // the shadows of this frame are computed while the graphics queue draws with the previous ones
+    {
+        ProfileScope computeScope(m_Profiler, "Compute");
+
+        stats.computeSlot = m_Scheduler.BeginCompute();
+        m_Backend.BeginCompute(stats.computeSlot);
+
+        stats.uploadedParticles = UploadStaleParticles(stats.computeSlot);
+
+        if (m_Simulating)
+        {
+            ProfileScope scope(m_Profiler, "Simulation");
+
+            SimulationStep step;
+            step.deltaTime = deltaTime;
+            step.emitSequence = m_EmissionClock.GetSequence();
+
+            // no more than the dead list can ever hold, CSEmit clamps again to what it holds now
+            step.emitCount = std::min(m_EmissionClock.Advance(m_EmissionRate, deltaTime), static_cast<uint32_t>(m_ShadowTracker.Size()));
+            stats.emitCount = step.emitCount;
+
+            m_Backend.DispatchSimulation(stats.computeSlot, step);
+        }
+
+        {
+            ProfileScope scope(m_Profiler, "Shadows");
+            stats.incremental = PrepareDirtyMask(stats.shadedReceivers);
+            m_Backend.DispatchShadows(stats.computeSlot, stats.incremental ? m_DirtyMask.data() : nullptr);
+        }
+
+        if (readback)
+        {
+            m_Backend.CopyShadowsToReadback(stats.computeSlot, readbackSlot);
+        }
+
+        m_Backend.SubmitCompute();
+        m_Scheduler.EndCompute();
+    }
+
+    if (readback)
+    {
+        m_ReadbackRing.Submit(readbackSlot, m_Scheduler.GetComputeValue(stats.computeSlot), m_Scheduler.GetFrame());
+        m_ReadbackRequested = false;
+    }
+
+    {
+        ProfileScope scope(m_Profiler, "Draw");
+        stats.drawSlot = m_Scheduler.BeginDraw();
+        m_Backend.Draw(stats.drawSlot);
+        m_Scheduler.EndDraw();
+    }
+
+    {
+        ProfileScope scope(m_Profiler, "Present");
+        m_Backend.Present();
+    }
+    return stats;
+}
+
+bool FramePipeline::UpdateParticles(const uint32_t* indices, size_t count, const Particle* values)
+{
+    if (m_Simulating)
+    {
+        return false;
+    }
+
+    uint32_t lightSourceIndex = static_cast<uint32_t>(m_Particles.size() - 1);
+
+    m_ChangedReceivers.clear();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = indices[i];
+
+        m_Particles[index] = values[i];
+
+        for (uint32_t slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
+        {
+            m_StaleParticles[slot].push_back(index);
+        }
+
+        if (index != lightSourceIndex)
+        {
+            m_ChangedReceivers.push_back(index);
+        }
+    }
+
+    m_ShadowTracker.Update(m_Particles.data(), m_ChangedReceivers.data(), m_ChangedReceivers.size());
+    return true;
+}
+
+void FramePipeline::Flush()
+{
+    m_Scheduler.Flush();
+    ProcessReadbacks();
+}
+
+uint32_t FramePipeline::ProcessReadbacks()
+{
+    uint64_t completedValue = m_Backend.GetComputeQueue().GetCompletedValue();
+    uint32_t count = 0;
+
+    ReadbackRing::Readback readback;
+    while (m_ReadbackRing.PopCompleted(completedValue, readback))
+    {
+        const float* shadows = m_Backend.ReadShadows(readback.slot);
+        if (m_OnReadback)
+        {
+            m_OnReadback(shadows, readback.frame);
+        }
+
+        m_ReadbackRing.Release(readback.slot);
+        ++count;
+    }
+    return count;
+}
+
+uint32_t FramePipeline::UploadStaleParticles(uint32_t shadowSlot)
+{
+    std::vector<uint32_t>& stale = m_StaleParticles[shadowSlot];
+    if (stale.empty())
+    {
+        return 0;
+    }
+
+    std::sort(stale.begin(), stale.end());
+    stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+
+    // runs of consecutive indices become one copy each
+    m_UploadRanges.clear();
+    for (size_t first = 0; first < stale.size();)
+    {
+        size_t last = first + 1;
+        while (last < stale.size() && stale[last] == stale[last - 1] + 1)
+        {
+            ++last;
+        }
+
+        m_UploadRanges.push_back({ stale[first], static_cast<uint32_t>(last - first) });
+        first = last;
+    }
+
+    m_Backend.UploadParticles(shadowSlot, m_UploadRanges.data(), m_UploadRanges.size(), m_Particles.data());
+
+    uint32_t count = static_cast<uint32_t>(stale.size());
+    stale.clear();
+    return count;
+}
+
+bool FramePipeline::PrepareDirtyMask(uint32_t& shadedReceivers)
+{
+    // past a quarter of the receivers the mask saves less than the copy of the clean ones costs,
+    // and the simulation moves every particle each frame
+    bool incremental = !m_Simulating && !m_FullShadowPass && m_ShadowTracker.GetDirty().size() <= m_ShadowTracker.Size() / 4;
+
+    if (incremental)
+    {
+        m_ShadowTracker.WriteDirtyMask(m_DirtyMask.data());
+    }
+
+    shadedReceivers = static_cast<uint32_t>(incremental ? m_ShadowTracker.GetDirty().size() : m_ShadowTracker.Size());
+
+    // this pass brings the slot up to date with every change so far, the next one starts from it
+    m_ShadowTracker.ClearDirty();
+    m_FullShadowPass = false;
+
+    return incremental;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "AsyncShadowScheduler.h"
+#include "IncrementalShadowEngine.h"
+#include "Particle.hpp"
+#include "ParticleSimulation.h"
+#include "Profiler.h"
+#include "ReadbackRing.h"
+#include "RenderBackend.h"
+#include "SunBasis.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// what one RunFrame did
+struct FrameStats
+{
+    uint32_t computeSlot = 0;
+    uint32_t drawSlot = 0;
+    uint32_t uploadedParticles = 0;
+    uint32_t emitCount = 0;
+
+    // receivers the shadow pass reshaded, all of them unless it was incremental
+    uint32_t shadedReceivers = 0;
+    bool incremental = false;
+
+    uint32_t readbacks = 0;
+};
+
+// The frame loop of RenderSystem without the window and the graphics API: pacing of the two
+// queues, the particle deltas and dirty masks of the incremental shadow pass, the simulation
+// step and the readback ring. Everything that touches a GPU goes through IRenderBackend, so the
+// same frames run on D3D12 or on SoftwareRenderBackend.
+class FramePipeline
+{
+public:
+    // particles is what the backend's slots start out with, the last one is the light source;
+    // an empty set runs frames without receivers. With simulation the particles are moved by the simulation stage every frame, otherwise
+    // they only change through UpdateParticles.
+    FramePipeline(IRenderBackend& backend, const std::vector<Particle>& particles, const SunBasis& basis, const SimulationSettings* simulation);
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Hands finished readbacks to the callback, computes this frame's shadows while the graphics
+    // queue draws the previous ones, then presents.
+    FrameStats RunFrame(float deltaTime);
+
+    // Asks for the shadows of the next frame. They are copied into a readback slot along with
+    // that frame's shadow pass and handed to the callback a few frames later, without a stall.
+    void RequestReadback() { m_ReadbackRequested = true; }
+
+    using ReadbackCallback = std::function<void(const float* shadows, uint64_t frame)>;
+
+    void SetReadbackCallback(ReadbackCallback callback) { m_OnReadback = std::move(callback); }
+
+    // Replaces the particles listed in indices with values. Only their delta is uploaded and the
+    // next shadow passes reshade just the receivers whose shadows they can affect. Returns false
+    // while the simulation runs, the particles then only live in the backend.
+    bool UpdateParticles(const uint32_t* indices, size_t count, const Particle* values);
+
+    // waits for both queues and hands out every readback still in flight
+    void Flush();
+
+    // the CPU copy, stops matching the backend once the simulation moves the particles
+    const std::vector<Particle>& GetParticles() const { return m_Particles; }
+
+    bool IsSimulating() const { return m_Simulating; }
+
+    const AsyncShadowScheduler& GetScheduler() const { return m_Scheduler; }
+
+    // Records every frame's steps as CPU scopes of profiler, nullptr stops. The GPU side of the
+    // passes is timed by the backend, through the same profiler.
+    void SetProfiler(Profiler* profiler) { m_Profiler = profiler; }
+
+private:
+    // hands every finished readback to the callback, returns how many
+    uint32_t ProcessReadbacks();
+
+    // uploads the particles changed since shadowSlot was last computed, returns how many
+    uint32_t UploadStaleParticles(uint32_t shadowSlot);
+
+    // Fills m_DirtyMask and returns true when the pass can be incremental, or false when
+    // enough receivers are dirty that a full pass is cheaper.
+    bool PrepareDirtyMask(uint32_t& shadedReceivers);
+
+    IRenderBackend& m_Backend;
+
+    std::vector<Particle> m_Particles;
+
+    AsyncShadowScheduler m_Scheduler;
+
+    ReadbackRing m_ReadbackRing;
+    bool m_ReadbackRequested = false;
+    ReadbackCallback m_OnReadback;
+
+    // tracks which receivers have to be reshaded, the light source is left out as in the shader
+    IncrementalShadowEngine m_ShadowTracker;
+    std::vector<uint32_t> m_DirtyMask;
+
+    // indices changed since each slot's particles were last uploaded
+    std::vector<uint32_t> m_StaleParticles[AsyncShadowScheduler::SlotCount];
+    std::vector<uint32_t> m_ChangedReceivers;
+    std::vector<ParticleRange> m_UploadRanges;
+
+    // the first pass has no previous slot to copy from
+    bool m_FullShadowPass = true;
+
+    bool m_Simulating;
+    float m_EmissionRate = 0.0f;
+
+    // sequence numbers of emitted particles carry on after the initial ones, as in ParticleSimulation
+    EmissionClock m_EmissionClock;
+
+    Profiler* m_Profiler = nullptr;
+};
@@ -0,0 +1,107 @@
+#include "FrustumCull.h"
+
+#include <algorithm>
+#include <cmath>
+
+Frustum Frustum::FromViewProjection(const DirectX::XMFLOAT4X4& wvp)
+{
+    // clip = (p, 1) * wvp, so every clip coordinate is the dot product with a column
+    auto column = [&](int index)
+        {
+            return DirectX::XMFLOAT4(wvp.m[0][index], wvp.m[1][index], wvp.m[2][index], wvp.m[3][index]);
+        };
+
+    DirectX::XMFLOAT4 x = column(0);
+    DirectX::XMFLOAT4 y = column(1);
+    DirectX::XMFLOAT4 z = column(2);
+    DirectX::XMFLOAT4 w = column(3);
+
+    // -w <= x <= w, -w <= y <= w and 0 <= z <= w
+    Frustum frustum;
+    frustum.planes[0] = DirectX::XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);
+    frustum.planes[1] = DirectX::XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);
+    frustum.planes[2] = DirectX::XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);
+    frustum.planes[3] = DirectX::XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);
+    frustum.planes[4] = z;
+    frustum.planes[5] = DirectX::XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);
+
+    // unit normals, so that the plane distance compares against a radius
+    for (DirectX::XMFLOAT4& plane : frustum.planes)
+    {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f)
+        {
+            plane = DirectX::XMFLOAT4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+        }
+    }
+    return frustum;
+}
+
+const std::vector<uint32_t>& FrustumCuller::Cull(const Particle* particles, size_t count, const Frustum& frustum, const uint32_t* drawOrder, ThreadPool* pool)
+{
+    size_t blockCount = (count + BlockSize - 1) / BlockSize;
+    m_Inside.resize(count);
+    m_BlockOffsets.assign(blockCount, 0);
+
+    auto test = [&](size_t block, size_t)
+        {
+            size_t last = std::min(count, (block + 1) * BlockSize);
+            size_t inside = 0;
+            for (size_t drawn = block * BlockSize; drawn < last; ++drawn)
+            {
+                const Particle& particle = particles[drawOrder != nullptr ? drawOrder[drawn] : drawn];
+                m_Inside[drawn] = frustum.Intersects(particle.pos, SpriteBoundingRadius(particle.radius)) ? 1 : 0;
+                inside += m_Inside[drawn];
+            }
+            m_BlockOffsets[block] = inside;
+        };
+
+    auto compact = [&](size_t block, size_t)
+        {
+            size_t last = std::min(count, (block + 1) * BlockSize);
+            size_t offset = m_BlockOffsets[block];
+            for (size_t drawn = block * BlockSize; drawn < last; ++drawn)
+            {
+                if (m_Inside[drawn] != 0)
+                {
+                    m_Visible[offset++] = static_cast<uint32_t>(drawOrder != nullptr ? drawOrder[drawn] : drawn);
+                }
+            }
+        };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(blockCount, test);
+    }
+    else
+    {
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            test(block, 0);
+        }
+    }
+
+    // exclusive prefix sum of the block counts, CSCullScan
+    size_t visibleCount = 0;
+    for (size_t& offset : m_BlockOffsets)
+    {
+        size_t inside = offset;
+        offset = visibleCount;
+        visibleCount += inside;
+    }
+    m_Visible.resize(visibleCount);
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(blockCount, compact);
+    }
+    else
+    {
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            compact(block, 0);
+        }
+    }
+
+    return m_Visible;
+}
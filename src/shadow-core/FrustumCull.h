@@ -0,0 +1,68 @@
+#pragma once
+#include "MathTypes.h"
+#include "Particle.hpp"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The six planes of the view volume, normalized and facing inwards: a point is inside a plane
+// when dot(point, plane.xyz) + plane.w >= 0. cbCull of CullShader.hlsl holds the same planes.
+struct Frustum
+{
+    // left, right, bottom, top, near, far
+    DirectX::XMFLOAT4 planes[6];
+
+    // from the row major world view projection matrix of cbPerObject, which takes row vectors
+    // to clip space with z from 0 to w
+    static Frustum FromViewProjection(const DirectX::XMFLOAT4X4& wvp);
+
+    // False when the sphere lies entirely behind one plane. Spheres just outside a corner of the
+    // volume pass, which only costs their draw.
+    bool Intersects(const DirectX::XMFLOAT3& center, float radius) const
+    {
+        for (const DirectX::XMFLOAT4& plane : planes)
+        {
+            if (center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// The sphere around a particle's sprite: ExpandBillboard reaches radius along both axes of the
+// camera facing quad, so its corners are radius * sqrt(2) from the center.
+inline float SpriteBoundingRadius(float radius)
+{
+    return radius * 1.41421356f;
+}
+
+// CPU version of the cull in CullShader.hlsl: the particles whose sprite can reach the view are
+// compacted in draw order, through per block counts and their prefix sum, the same way the
+// compute passes write the list ExecuteIndirect draws.
+class FrustumCuller
+{
+public:
+    // Returns the entries of drawOrder (the particle indices 0 to count - 1 when nullptr) that
+    // survive the cull, in their order. Blocks are tested and compacted on the pool when given.
+    const std::vector<uint32_t>& Cull(const Particle* particles, size_t count, const Frustum& frustum, const uint32_t* drawOrder = nullptr, ThreadPool* pool = nullptr);
+
+    const std::vector<uint32_t>& GetVisible() const { return m_Visible; }
+
+    size_t GetMemoryUsage() const { return m_Visible.capacity() * sizeof(uint32_t) + m_Inside.capacity() + m_BlockOffsets.capacity() * sizeof(size_t); }
+
+    // entries per task, BLOCK_SIZE of CullShader.hlsl
+    static const size_t BlockSize = 2048;
+
+private:
+    std::vector<uint32_t> m_Visible;
+
+    // per entry of the draw order, whether it survives
+    std::vector<uint8_t> m_Inside;
+
+    // the survivors of every block, then where they start in m_Visible
+    std::vector<size_t> m_BlockOffsets;
+};
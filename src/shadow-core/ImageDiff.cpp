@@ -0,0 +1,154 @@
+#include "ImageDiff.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    struct Lab
+    {
+        float l, a, b;
+    };
+
+    float SrgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LabCurve(float t)
+    {
+        const float delta = 6.0f / 29.0f;
+        return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+    }
+
+    // linear RGB in [0, 1] of the sRGB primaries to CIELAB relative to D65 white
+    Lab LinearToLab(float r, float g, float b)
+    {
+        float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f;
+        float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+        float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f;
+
+        float fx = LabCurve(x);
+        float fy = LabCurve(y);
+        float fz = LabCurve(z);
+
+        return { 116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz) };
+    }
+
+    // the Lab of every pixel, averaged in linear light over its 3x3 neighbourhood when blurring
+    std::vector<Lab> ToLab(const RgbaImage& image, bool blur)
+    {
+        static const std::array<float, 256> linear = []()
+            {
+                std::array<float, 256> result;
+                for (int i = 0; i < 256; ++i)
+                {
+                    result[i] = SrgbToLinear(static_cast<float>(i) / 255.0f);
+                }
+                return result;
+            }();
+
+        int32_t width = static_cast<int32_t>(image.width);
+        int32_t height = static_cast<int32_t>(image.height);
+        int32_t radius = blur ? 1 : 0;
+
+        std::vector<Lab> lab(static_cast<size_t>(width) * height);
+        for (int32_t y = 0; y < height; ++y)
+        {
+            for (int32_t x = 0; x < width; ++x)
+            {
+                float sum[3] = {};
+                int samples = 0;
+
+                // at the border only the neighbours inside the image are averaged
+                for (int32_t sy = std::max(0, y - radius); sy <= std::min(height - 1, y + radius); ++sy)
+                {
+                    for (int32_t sx = std::max(0, x - radius); sx <= std::min(width - 1, x + radius); ++sx)
+                    {
+                        const uint8_t* pixel = image.Pixel(sx, sy);
+                        sum[0] += linear[pixel[0]];
+                        sum[1] += linear[pixel[1]];
+                        sum[2] += linear[pixel[2]];
+                        ++samples;
+                    }
+                }
+
+                lab[static_cast<size_t>(y) * width + x] = LinearToLab(sum[0] / samples, sum[1] / samples, sum[2] / samples);
+            }
+        }
+        return lab;
+    }
+}
+
+bool DiffImages(const RgbaImage& expected, const RgbaImage& actual, const ImageDiffSettings& settings, ImageDiffResult& result,
+    RgbaImage* heatMap, std::string& error)
+{
+    if (expected.width != actual.width || expected.height != actual.height)
+    {
+        error = "images are " + std::to_string(expected.width) + "x" + std::to_string(expected.height) + " and "
+            + std::to_string(actual.width) + "x" + std::to_string(actual.height);
+        return false;
+    }
+
+    std::vector<Lab> expectedLab = ToLab(expected, settings.blur);
+    std::vector<Lab> actualLab = ToLab(actual, settings.blur);
+
+    result = ImageDiffResult();
+    result.pixelCount = expectedLab.size();
+
+    if (heatMap != nullptr)
+    {
+        heatMap->Resize(expected.width, expected.height);
+    }
+
+    double sum = 0.0;
+    for (uint32_t y = 0; y < expected.height; ++y)
+    {
+        for (uint32_t x = 0; x < expected.width; ++x)
+        {
+            size_t i = static_cast<size_t>(y) * expected.width + x;
+            float dl = expectedLab[i].l - actualLab[i].l;
+            float da = expectedLab[i].a - actualLab[i].a;
+            float db = expectedLab[i].b - actualLab[i].b;
+            float deltaE = std::sqrt(dl * dl + da * da + db * db);
+
+            sum += deltaE;
+            if (deltaE > result.maxDeltaE)
+            {
+                result.maxDeltaE = deltaE;
+                result.maxX = x;
+                result.maxY = y;
+            }
+
+            bool differs = deltaE >= settings.threshold;
+            if (differs)
+            {
+                ++result.differingPixels;
+            }
+
+            if (heatMap != nullptr)
+            {
+                uint8_t* pixel = heatMap->Pixel(x, y);
+                if (differs)
+                {
+                    // full red from ten times the threshold on
+                    float strength = std::min(1.0f, deltaE / (10.0f * settings.threshold));
+                    pixel[0] = static_cast<uint8_t>(128.0f + 127.0f * strength);
+                    pixel[1] = 0;
+                    pixel[2] = 0;
+                }
+                else
+                {
+                    uint8_t gray = static_cast<uint8_t>(std::min(std::max(expectedLab[i].l, 0.0f), 100.0f) * 0.6f);
+                    pixel[0] = pixel[1] = pixel[2] = gray;
+                }
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    result.meanDeltaE = result.pixelCount > 0 ? sum / static_cast<double>(result.pixelCount) : 0.0;
+    return true;
+}
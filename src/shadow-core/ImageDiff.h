@@ -0,0 +1,33 @@
+#pragma once
+#include "RgbaImage.h"
+
+#include <cstdint>
+#include <string>
+
+struct ImageDiffSettings
+{
+    // CIELAB distance below which two pixels count as the same, 2.3 is about one just
+    // noticeable difference
+    float threshold = 2.3f;
+
+    // Averages every pixel with its 3x3 neighbourhood before comparing, so an edge that moved by
+    // a pixel or a dithering pattern does not count as a change the way a shift in color does.
+    bool blur = true;
+};
+
+struct ImageDiffResult
+{
+    double meanDeltaE = 0.0;
+    double maxDeltaE = 0.0;
+    uint32_t maxX = 0;
+    uint32_t maxY = 0;
+
+    uint64_t differingPixels = 0;   // pixels at or above the threshold
+    uint64_t pixelCount = 0;
+};
+
+// Compares the RGB of two images of the same size in CIELAB (D65, sRGB primaries) with the CIE76
+// distance. Alpha is ignored. heatMap, when given, receives the expected image in dimmed gray with
+// the differing pixels in red, brighter the larger the difference. False when the sizes differ.
+bool DiffImages(const RgbaImage& expected, const RgbaImage& actual, const ImageDiffSettings& settings, ImageDiffResult& result,
+    RgbaImage* heatMap, std::string& error);
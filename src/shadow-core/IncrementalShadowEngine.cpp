@@ -0,0 +1,198 @@
+#include "IncrementalShadowEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+IncrementalShadowEngine::IncrementalShadowEngine(const SunBasis& basis) : m_Basis(basis)
+{
+}
+
+void IncrementalShadowEngine::Reset(const Particle* particles, size_t count)
+{
+    m_Positions.resize(count);
+    m_Radius.resize(count);
+    m_Opacity.resize(count);
+    m_MaxRadius = 0.0f;
+
+    float minY = 0.0f, maxY = 0.0f, minZ = 0.0f, maxZ = 0.0f;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_Positions[i] = m_Basis.Project(particles[i].pos);
+        m_Radius[i] = particles[i].radius;
+        m_Opacity[i] = particles[i].opacity;
+        m_MaxRadius = std::max(m_MaxRadius, particles[i].radius);
+
+        minY = i == 0 ? m_Positions[i].y : std::min(minY, m_Positions[i].y);
+        maxY = i == 0 ? m_Positions[i].y : std::max(maxY, m_Positions[i].y);
+        minZ = i == 0 ? m_Positions[i].z : std::min(minZ, m_Positions[i].z);
+        maxZ = i == 0 ? m_Positions[i].z : std::max(maxZ, m_Positions[i].z);
+    }
+
+    // as wide as radius + otherRadius, like ShadowGrid, so a query visits about 3x3 cells
+    float cellSize = 2.0f * m_MaxRadius;
+    if (!(cellSize > 0.0f))
+    {
+        float extent = std::max(maxY - minY, maxZ - minZ);
+        cellSize = extent > 0.0f ? extent / std::sqrt(static_cast<float>(count)) : 1.0f;
+    }
+
+    m_Index.Clear(cellSize);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_Index.Insert(static_cast<uint32_t>(i), m_Positions[i].y, m_Positions[i].z);
+    }
+
+    m_IsDirty.assign(count, 1);
+    m_Dirty.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_Dirty[i] = static_cast<uint32_t>(i);
+    }
+}
+
+void IncrementalShadowEngine::Update(const Particle* particles, const uint32_t* changed, size_t changedCount)
+{
+    for (size_t k = 0; k < changedCount; ++k)
+    {
+        uint32_t index = changed[k];
+
+        DirectX::XMFLOAT3 oldPosition = m_Positions[index];
+        float oldRadius = m_Radius[index];
+
+        // receivers it shadowed so far
+        MarkFootprint(oldPosition, oldRadius);
+
+        DirectX::XMFLOAT3 newPosition = m_Basis.Project(particles[index].pos);
+
+        m_Positions[index] = newPosition;
+        m_Radius[index] = particles[index].radius;
+        m_Opacity[index] = particles[index].opacity;
+        m_MaxRadius = std::max(m_MaxRadius, particles[index].radius);
+
+        m_Index.Move(index, oldPosition.y, oldPosition.z, newPosition.y, newPosition.z);
+
+        // receivers it shadows from now on, and its own shadow since its occluders may differ
+        MarkFootprint(newPosition, m_Radius[index]);
+        MarkDirty(index);
+    }
+}
+
+ShadowStats IncrementalShadowEngine::Shade(float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+
+    size_t dirtyCount = m_Dirty.size();
+    size_t tileCount = (dirtyCount + ShadowEngine::ReceiverTileSize - 1) / ShadowEngine::ReceiverTileSize;
+
+    std::atomic<uint64_t> pairsTested{ 0 };
+    std::atomic<uint64_t> occluderHits{ 0 };
+
+    auto shadeTile = [&](size_t tile, size_t)
+        {
+            size_t first = tile * ShadowEngine::ReceiverTileSize;
+            size_t last = std::min(first + ShadowEngine::ReceiverTileSize, dirtyCount);
+
+            uint64_t tilePairs = 0;
+            uint64_t tileHits = 0;
+
+            for (size_t k = first; k < last; ++k)
+            {
+                uint32_t receiver = m_Dirty[k];
+                const DirectX::XMFLOAT3& sunBasisPos = m_Positions[receiver];
+                float radius = m_Radius[receiver];
+
+                float shadow = 1.0f;
+
+                m_Index.Query(sunBasisPos.y, sunBasisPos.z, radius + m_MaxRadius, [&](uint32_t other)
+                    {
+                        if (other == receiver)
+                        {
+                            return;
+                        }
+
+                        ++tilePairs;
+
+                        if (Occludes(sunBasisPos, radius, m_Positions[other], m_Radius[other]))
+                        {
+                            shadow *= (1.0f - m_Opacity[other]);
+                            ++tileHits;
+                        }
+                    });
+
+                shadows[receiver] = shadow;
+            }
+
+            pairsTested += tilePairs;
+            occluderHits += tileHits;
+        };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(tileCount, shadeTile);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tileCount; ++tile)
+        {
+            shadeTile(tile, 0);
+        }
+    }
+
+    ClearDirty();
+
+    stats.pairsTested = pairsTested;
+    stats.occluderHits = occluderHits;
+    return stats;
+}
+
+void IncrementalShadowEngine::WriteDirtyMask(uint32_t* mask) const
+{
+    std::memset(mask, 0, (m_IsDirty.size() + 31) / 32 * sizeof(uint32_t));
+
+    for (uint32_t index : m_Dirty)
+    {
+        mask[index / 32] |= 1u << (index % 32);
+    }
+}
+
+void IncrementalShadowEngine::ClearDirty()
+{
+    for (uint32_t index : m_Dirty)
+    {
+        m_IsDirty[index] = 0;
+    }
+    m_Dirty.clear();
+}
+
+size_t IncrementalShadowEngine::GetMemoryUsage() const
+{
+    return m_Positions.capacity() * sizeof(DirectX::XMFLOAT3)
+        + (m_Radius.capacity() + m_Opacity.capacity()) * sizeof(float)
+        + m_IsDirty.capacity() * sizeof(uint8_t)
+        + m_Dirty.capacity() * sizeof(uint32_t)
+        + m_Index.GetMemoryUsage();
+}
+
+void IncrementalShadowEngine::MarkDirty(uint32_t index)
+{
+    if (!m_IsDirty[index])
+    {
+        m_IsDirty[index] = 1;
+        m_Dirty.push_back(index);
+    }
+}
+
+void IncrementalShadowEngine::MarkFootprint(const DirectX::XMFLOAT3& sunBasisPos, float radius)
+{
+    m_Index.Query(sunBasisPos.y, sunBasisPos.z, radius + m_MaxRadius, [&](uint32_t receiver)
+        {
+            // the receiver sees this occluder exactly when Occludes(receiver, occluder) holds
+            if (!m_IsDirty[receiver] && Occludes(m_Positions[receiver], m_Radius[receiver], sunBasisPos, radius))
+            {
+                m_IsDirty[receiver] = 1;
+                m_Dirty.push_back(receiver);
+            }
+        });
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Particle.hpp"
+#include "ShadowEngine.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+#include "YzHashIndex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keeps shadows up to date when only some particles change from one frame to the next.
+//
+// A particle that moves or changes radius or opacity can only alter the shadows of receivers
+// behind it (dirToOther.x >= 0) whose disc overlapped its old footprint or overlaps its new
+// one, plus its own shadow. Update finds those receivers through a YzHashIndex kept across
+// frames and marks them dirty; Shade recomputes exactly the dirty receivers and leaves every
+// other shadow as it is. The dirty set can also be handed to the GPU as a bit mask instead.
+class IncrementalShadowEngine
+{
+public:
+    explicit IncrementalShadowEngine(const SunBasis& basis);
+
+    // Takes a copy of the particles and marks every receiver dirty. Call again when the count
+    // or the sun changes.
+    void Reset(const Particle* particles, size_t count);
+
+    // particles is the whole updated array, changed lists the entries that differ from what the
+    // engine saw last; duplicates are fine
+    void Update(const Particle* particles, const uint32_t* changed, size_t changedCount);
+
+    // Recomputes the dirty receivers into shadows, which holds the previous result for all the
+    // others, and clears the dirty set. The hits are the ones of Compute, multiplied in cell order.
+    ShadowStats Shade(float* shadows, ThreadPool* pool = nullptr);
+
+    const std::vector<uint32_t>& GetDirty() const { return m_Dirty; }
+
+    // bit i % 32 of mask[i / 32] is set for dirty receivers, mask holds (Size() + 31) / 32 words
+    void WriteDirtyMask(uint32_t* mask) const;
+
+    void ClearDirty();
+
+    size_t Size() const { return m_Positions.size(); }
+
+    // bytes kept between frames
+    size_t GetMemoryUsage() const;
+
+private:
+    void MarkDirty(uint32_t index);
+
+    // marks the receivers behind the occluder whose disc overlaps its footprint
+    void MarkFootprint(const DirectX::XMFLOAT3& sunBasisPos, float radius);
+
+    SunBasis m_Basis;
+    YzHashIndex m_Index;
+
+    std::vector<DirectX::XMFLOAT3> m_Positions;
+    std::vector<float> m_Radius;
+    std::vector<float> m_Opacity;
+
+    // never shrinks, queries only need an upper bound of any receiver's radius
+    float m_MaxRadius = 0.0f;
+
+    std::vector<uint8_t> m_IsDirty;
+    std::vector<uint32_t> m_Dirty;
+};
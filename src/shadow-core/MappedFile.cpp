@@ -0,0 +1,151 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const char* path, std::string& error)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error = "cannot open '" + std::string(path) + "'";
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        error = "cannot get the size of '" + std::string(path) + "'";
+        return false;
+    }
+
+    m_File = file;
+    m_Size = static_cast<size_t>(size.QuadPart);
+    m_IsOpen = true;
+
+    // a zero sized file cannot be mapped
+    if (m_Size == 0)
+    {
+        return true;
+    }
+
+    m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping != nullptr)
+    {
+        m_Data = static_cast<const unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+
+    if (m_Data == nullptr)
+    {
+        Close();
+        error = "cannot map '" + std::string(path) + "'";
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping != nullptr)
+    {
+        CloseHandle(m_Mapping);
+    }
+    if (m_File != nullptr)
+    {
+        CloseHandle(m_File);
+    }
+
+    m_Data = nullptr;
+    m_Mapping = nullptr;
+    m_File = nullptr;
+    m_Size = 0;
+    m_IsOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const char* path, std::string& error)
+{
+    Close();
+
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        error = "cannot open '" + std::string(path) + "': " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+        error = "cannot get the size of '" + std::string(path) + "': " + std::strerror(errno);
+        close(file);
+        return false;
+    }
+
+    m_File = file;
+    m_Size = static_cast<size_t>(status.st_size);
+    m_IsOpen = true;
+
+    // a zero sized file cannot be mapped
+    if (m_Size == 0)
+    {
+        return true;
+    }
+
+    void* data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, file, 0);
+    if (data == MAP_FAILED)
+    {
+        error = "cannot map '" + std::string(path) + "': " + std::strerror(errno);
+        Close();
+        return false;
+    }
+
+    madvise(data, m_Size, MADV_SEQUENTIAL);
+
+    m_Data = static_cast<const unsigned char*>(data);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(m_Data), m_Size);
+    }
+    if (m_File >= 0)
+    {
+        close(m_File);
+    }
+
+    m_Data = nullptr;
+    m_File = -1;
+    m_Size = 0;
+    m_IsOpen = false;
+}
+
+#endif
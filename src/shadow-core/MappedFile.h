@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file mapped into memory. The pages are loaded on first touch, so
+// opening a large file costs nothing until its data is read.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // closes the previous file, on failure error says why and the object stays closed
+    bool Open(const char* path, std::string& error);
+
+    void Close();
+
+    bool IsOpen() const { return m_IsOpen; }
+
+    // nullptr for an empty file
+    const unsigned char* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+private:
+    const unsigned char* m_Data = nullptr;
+    size_t m_Size = 0;
+    bool m_IsOpen = false;
+
+#if defined(_WIN32)
+    void* m_File = nullptr;
+    void* m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+// The DirectXMath storage types shadow-core works with. Windows builds take them from the SDK, so
+// Particle and the structs around it stay the very types direct-test hands to D3D12. Other
+// platforms have no DirectXMath, the definitions below stand in for it with the same names and
+// layout. shadow-core only stores and reads these, it calls none of the DirectXMath functions.
+#if defined(_WIN32)
+#include <DirectXMath.h>
+#else
+#include <cstddef>
+
+namespace DirectX
+{
+    struct XMFLOAT2
+    {
+        float x;
+        float y;
+
+        XMFLOAT2() = default;
+        constexpr XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+    };
+
+    struct XMFLOAT3
+    {
+        float x;
+        float y;
+        float z;
+
+        XMFLOAT3() = default;
+        constexpr XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+    };
+
+    struct XMFLOAT4
+    {
+        float x;
+        float y;
+        float z;
+        float w;
+
+        XMFLOAT4() = default;
+        constexpr XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+    };
+
+    // row major, like the SDK's
+    struct XMFLOAT4X4
+    {
+        float m[4][4];
+
+        XMFLOAT4X4() = default;
+        constexpr XMFLOAT4X4(
+            float m00, float m01, float m02, float m03,
+            float m10, float m11, float m12, float m13,
+            float m20, float m21, float m22, float m23,
+            float m30, float m31, float m32, float m33)
+            : m{ { m00, m01, m02, m03 }, { m10, m11, m12, m13 }, { m20, m21, m22, m23 }, { m30, m31, m32, m33 } }
+        {
+        }
+
+        float operator()(size_t row, size_t column) const { return m[row][column]; }
+        float& operator()(size_t row, size_t column) { return m[row][column]; }
+    };
+}
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#include "MathTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Particle
+{
+    // the cyan every particle of the demo is drawn with
+    static const uint32_t DefaultColor = 0xFFFFFF00;
+
+    DirectX::XMFLOAT3   pos;
+    float               radius;
+    float               opacity;
+
+    // RGBA8 with red in the low byte, the layout of DXGI_FORMAT_R8G8B8A8_UNORM, unpacked by
+    // UnpackColor in VertexShader.hlsl. Only drawing reads it, the shadow pass ignores it.
+    uint32_t            color = DefaultColor;
+
+    // components in [0, 1], rounded to the nearest of 256 levels
+    static uint32_t PackColor(float r, float g, float b, float a = 1.0f)
+    {
+        auto level = [](float value)
+            {
+                value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+                return static_cast<uint32_t>(value * 255.0f + 0.5f);
+            };
+
+        return level(r) | (level(g) << 8) | (level(b) << 16) | (level(a) << 24);
+    }
+
+    // The generator the demo always used: the LCG behind rand() of the MSVC runtime after
+    // srand(0). Other C runtimes have other rand()s, this one gives the same layout everywhere
+    // and leaves the global rand() state alone.
+    struct DemoRandom
+    {
+        uint32_t state = 0;
+
+        int Next()
+        {
+            state = state * 214013u + 2531011u;
+            return static_cast<int>((state >> 16) & 0x7FFF);
+        }
+    };
+
+    static float RandomPercent(DemoRandom& random)
+    {
+        float ret = static_cast<float>((random.Next() % 10000) - 5000);
+        return ret / 5000.0f;
+    }
+
+    // Particles uniformly inside a ball. They carry no velocity, the simulation gives them one
+    // (SimulationSettings::emitVelocity).
+    static std::vector<Particle> LoadParticles(const DirectX::XMFLOAT3& center, float spread, uint32_t numParticles)
+    {
+        DemoRandom random;
+
+        std::vector<Particle> particlesData(numParticles);
+
+        for (uint32_t i = 0; i < numParticles; i++)
+        {
+            DirectX::XMFLOAT3 delta(spread, spread, spread);
+
+            while (delta.x * delta.x + delta.y * delta.y + delta.z * delta.z > spread * spread)
+            {
+                delta.x = RandomPercent(random) * spread;
+                delta.y = RandomPercent(random) * spread;
+                delta.z = RandomPercent(random) * spread;
+            }
+
+            particlesData[i].pos.x = center.x + delta.x;
+            particlesData[i].pos.y = center.y + delta.y;
+            particlesData[i].pos.z = center.z + delta.z;
+
+            particlesData[i].radius = 20.0f;
+            particlesData[i].opacity = 0.1f;
+        }
+        return particlesData;
+    }
+};
+
+// the HLSL Particle structs and the SRV stride depend on this layout
+static_assert(sizeof(Particle) == 24, "Particle must stay 24 bytes with no padding");
@@ -0,0 +1,37 @@
+#include "ParticleArrays.h"
+
+#include <limits>
+
+void ParticleArrays::Assign(const Particle* particles, size_t count, const SunBasis& basis)
+{
+    size_t paddedCount = (count + Padding - 1) / Padding * Padding;
+
+    m_Count = count;
+
+    m_Depth.resize(paddedCount);
+    m_Up.resize(paddedCount);
+    m_Forward.resize(paddedCount);
+    m_Radius.resize(paddedCount);
+    m_Opacity.resize(paddedCount);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        DirectX::XMFLOAT3 sunBasisPos = basis.Project(particles[i].pos);
+
+        m_Depth[i] = sunBasisPos.x;
+        m_Up[i] = sunBasisPos.y;
+        m_Forward[i] = sunBasisPos.z;
+        m_Radius[i] = particles[i].radius;
+        m_Opacity[i] = particles[i].opacity;
+    }
+
+    // padding never passes dirToOther.x >= 0, and even if it did it would not darken anything
+    for (size_t i = count; i < paddedCount; ++i)
+    {
+        m_Depth[i] = -std::numeric_limits<float>::infinity();
+        m_Up[i] = 0.0f;
+        m_Forward[i] = 0.0f;
+        m_Radius[i] = 0.0f;
+        m_Opacity[i] = 0.0f;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "Particle.hpp"
+#include "SunBasis.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+template <typename T, size_t Alignment>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n)
+    {
+        size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+#if defined(_MSC_VER)
+        void* memory = _aligned_malloc(bytes, Alignment);
+#else
+        void* memory = std::aligned_alloc(Alignment, bytes);
+#endif
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t)
+    {
+#if defined(_MSC_VER)
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
+
+// Structure-of-arrays copy of the particles with positions already projected into the sun
+// basis. The arrays are 64-byte aligned and padded to a multiple of Padding elements with
+// entries that sit infinitely far from the sun, so SIMD loops never need a scalar tail.
+class ParticleArrays
+{
+public:
+    static const size_t Padding = 16;
+
+    void Assign(const Particle* particles, size_t count, const SunBasis& basis);
+
+    size_t Size() const { return m_Count; }
+    size_t PaddedSize() const { return m_Depth.size(); }
+
+    const float* Depth() const { return m_Depth.data(); }
+    const float* Up() const { return m_Up.data(); }
+    const float* Forward() const { return m_Forward.data(); }
+    const float* Radius() const { return m_Radius.data(); }
+    const float* Opacity() const { return m_Opacity.data(); }
+
+    size_t GetMemoryUsage() const { return 5 * m_Depth.capacity() * sizeof(float); }
+
+private:
+    size_t m_Count = 0;
+
+    AlignedVector<float> m_Depth;
+    AlignedVector<float> m_Up;
+    AlignedVector<float> m_Forward;
+    AlignedVector<float> m_Radius;
+    AlignedVector<float> m_Opacity;
+};
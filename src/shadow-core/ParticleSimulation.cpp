@@ -0,0 +1,209 @@
+#include "ParticleSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    const float Pi = 3.14159265f;
+
+    uint32_t PcgHash(uint32_t value)
+    {
+        uint32_t state = value * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    // draws per sequence number, SimulationShader.hlsl uses the same numbering
+    enum Draw : uint32_t
+    {
+        DrawRadius,
+        DrawCosTheta,
+        DrawPhi,
+        DrawVelocityX,
+        DrawVelocityY,
+        DrawVelocityZ,
+        DrawLifetime,
+        DrawAge,
+        DrawCount,
+    };
+
+    XMFLOAT3 RandomVelocity(const SimulationSettings& settings, uint32_t sequence)
+    {
+        return XMFLOAT3(
+            settings.emitVelocity.x + settings.velocitySpread * (2.0f * SimulationRandom(settings.seed, sequence, DrawVelocityX) - 1.0f),
+            settings.emitVelocity.y + settings.velocitySpread * (2.0f * SimulationRandom(settings.seed, sequence, DrawVelocityY) - 1.0f),
+            settings.emitVelocity.z + settings.velocitySpread * (2.0f * SimulationRandom(settings.seed, sequence, DrawVelocityZ) - 1.0f));
+    }
+
+    float RandomLifetime(const SimulationSettings& settings, uint32_t sequence)
+    {
+        float t = SimulationRandom(settings.seed, sequence, DrawLifetime);
+        return settings.lifetimeMin + (settings.lifetimeMax - settings.lifetimeMin) * t;
+    }
+}
+
+float SimulationRandom(uint32_t seed, uint32_t sequence, uint32_t draw)
+{
+    uint32_t hash = PcgHash(seed ^ PcgHash(sequence * DrawCount + draw));
+
+    // 24 bits fit a float mantissa exactly
+    return static_cast<float>(hash >> 8) * (1.0f / 16777216.0f);
+}
+
+bool IntegrateParticle(const SimulationSettings& settings, float deltaTime, Particle& particle, ParticleMotion& motion)
+{
+    motion.velocity.x += (settings.gravity.x - settings.drag * motion.velocity.x) * deltaTime;
+    motion.velocity.y += (settings.gravity.y - settings.drag * motion.velocity.y) * deltaTime;
+    motion.velocity.z += (settings.gravity.z - settings.drag * motion.velocity.z) * deltaTime;
+
+    particle.pos.x += motion.velocity.x * deltaTime;
+    particle.pos.y += motion.velocity.y * deltaTime;
+    particle.pos.z += motion.velocity.z * deltaTime;
+
+    motion.age += deltaTime;
+
+    if (motion.age < motion.lifetime)
+    {
+        return false;
+    }
+
+    particle.radius = 0.0f;
+    particle.opacity = 0.0f;
+    motion.velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    motion.age = 0.0f;
+    motion.lifetime = 0.0f;
+    return true;
+}
+
+void EmitParticle(const SimulationSettings& settings, uint32_t sequence, Particle& particle, ParticleMotion& motion)
+{
+    // uniform in the ball: the cube root spreads the radii by volume
+    float radius = settings.emitterSpread * std::cbrt(SimulationRandom(settings.seed, sequence, DrawRadius));
+    float cosTheta = 1.0f - 2.0f * SimulationRandom(settings.seed, sequence, DrawCosTheta);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * Pi * SimulationRandom(settings.seed, sequence, DrawPhi);
+
+    particle.pos.x = settings.emitterCenter.x + radius * sinTheta * std::cos(phi);
+    particle.pos.y = settings.emitterCenter.y + radius * sinTheta * std::sin(phi);
+    particle.pos.z = settings.emitterCenter.z + radius * cosTheta;
+    particle.radius = settings.radius;
+    particle.opacity = settings.opacity;
+    particle.color = settings.color;
+
+    motion.velocity = RandomVelocity(settings, sequence);
+    motion.age = 0.0f;
+    motion.lifetime = RandomLifetime(settings, sequence);
+}
+
+std::vector<ParticleMotion> MakeInitialMotion(const SimulationSettings& settings, size_t count)
+{
+    std::vector<ParticleMotion> motion(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t sequence = static_cast<uint32_t>(i);
+
+        motion[i].velocity = RandomVelocity(settings, sequence);
+        motion[i].lifetime = RandomLifetime(settings, sequence);
+        motion[i].age = motion[i].lifetime * SimulationRandom(settings.seed, sequence, DrawAge);
+    }
+    return motion;
+}
+
+uint32_t EmissionClock::Advance(float rate, float deltaTime)
+{
+    m_Pending += std::max(0.0f, rate * deltaTime);
+
+    float whole = std::floor(m_Pending);
+    m_Pending -= whole;
+
+    uint32_t count = static_cast<uint32_t>(whole);
+    m_Sequence += count;
+    return count;
+}
+
+ParticleSimulation::ParticleSimulation(const SimulationSettings& settings) : m_Settings(settings)
+{
+}
+
+void ParticleSimulation::Reset(const Particle* particles, size_t count)
+{
+    m_Particles.assign(particles, particles + count);
+    m_Motion = MakeInitialMotion(m_Settings, count);
+    m_DeadList.clear();
+    m_Clock = EmissionClock(static_cast<uint32_t>(count));
+}
+
+SimulationStepStats ParticleSimulation::Step(float deltaTime, ThreadPool* pool)
+{
+    SimulationStepStats stats;
+
+    size_t count = m_Particles.size();
+    size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+
+    m_ChunkKilled.resize(chunkCount);
+
+    auto integrateChunk = [&](size_t chunk, size_t)
+        {
+            size_t first = chunk * ChunkSize;
+            size_t last = std::min(first + ChunkSize, count);
+
+            std::vector<uint32_t>& killed = m_ChunkKilled[chunk];
+            killed.clear();
+
+            for (size_t i = first; i < last; ++i)
+            {
+                ParticleMotion& motion = m_Motion[i];
+
+                // dead slots wait on the dead list
+                if (!(motion.age < motion.lifetime))
+                {
+                    continue;
+                }
+
+                if (IntegrateParticle(m_Settings, deltaTime, m_Particles[i], motion))
+                {
+                    killed.push_back(static_cast<uint32_t>(i));
+                }
+            }
+        };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(chunkCount, integrateChunk);
+    }
+    else
+    {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            integrateChunk(chunk, 0);
+        }
+    }
+
+    for (const std::vector<uint32_t>& killed : m_ChunkKilled)
+    {
+        m_DeadList.insert(m_DeadList.end(), killed.begin(), killed.end());
+        stats.killed += static_cast<uint32_t>(killed.size());
+    }
+
+    uint32_t sequence = m_Clock.GetSequence();
+    uint32_t due = m_Clock.Advance(m_Settings.emissionRate, deltaTime);
+
+    // what the dead list cannot hold is dropped, the GPU clamps to its dead count the same way
+    uint32_t emitCount = static_cast<uint32_t>(std::min<size_t>(due, m_DeadList.size()));
+
+    for (uint32_t i = 0; i < emitCount; ++i)
+    {
+        uint32_t index = m_DeadList.back();
+        m_DeadList.pop_back();
+
+        EmitParticle(m_Settings, sequence + i, m_Particles[index], m_Motion[index]);
+    }
+
+    stats.emitted = emitCount;
+    stats.alive = static_cast<uint32_t>(GetAliveCount());
+    return stats;
+}
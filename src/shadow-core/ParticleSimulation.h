@@ -0,0 +1,125 @@
+#pragma once
+#include "Particle.hpp"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// State the simulation keeps next to each Particle, the layout of sbMotion in
+// SimulationShader.hlsl. A particle is alive while age < lifetime; dead ones keep their slot
+// with radius and opacity 0, so they neither draw nor shadow anything until it is reused.
+struct ParticleMotion
+{
+    DirectX::XMFLOAT3   velocity;
+    float               age;
+    float               lifetime;
+};
+
+struct SimulationSettings
+{
+    // constant acceleration, and the fraction of the velocity lost per second
+    DirectX::XMFLOAT3 gravity = { 0.0f, 0.0f, 0.0f };
+    float drag = 0.0f;
+
+    // new particles start uniformly inside this ball
+    DirectX::XMFLOAT3 emitterCenter = { 0.0f, 0.0f, 0.0f };
+    float emitterSpread = 330.0f;
+
+    // start velocity, each component jittered by up to velocitySpread
+    DirectX::XMFLOAT3 emitVelocity = { 0.0f, 0.0f, 0.0f };
+    float velocitySpread = 0.0f;
+
+    float lifetimeMin = 5.0f;
+    float lifetimeMax = 10.0f;
+
+    // particles per second, only dead slots can be reused so the total never grows
+    float emissionRate = 0.0f;
+
+    float radius = 20.0f;
+    float opacity = 0.1f;
+    uint32_t color = Particle::DefaultColor;
+
+    uint32_t seed = 0;
+};
+
+// Uniform value in [0, 1) from a PCG hash, the same integer math as in SimulationShader.hlsl.
+// Every emitted particle draws from its own sequence number, so what it looks like does not
+// depend on which thread emits it or in which slot it lands.
+float SimulationRandom(uint32_t seed, uint32_t sequence, uint32_t draw);
+
+// Semi-implicit Euler step of one live particle. Returns true when it died during the step,
+// in which case it is already cleared to the dead state.
+bool IntegrateParticle(const SimulationSettings& settings, float deltaTime, Particle& particle, ParticleMotion& motion);
+
+// A new particle for emission number sequence.
+void EmitParticle(const SimulationSettings& settings, uint32_t sequence, Particle& particle, ParticleMotion& motion);
+
+// Motion of count particles that are alive from the start, e.g. Particle::LoadParticles. Their
+// ages are staggered over their lifetimes so they do not all die in the same frame. They use
+// sequence numbers [0, count), emission carries on from count.
+std::vector<ParticleMotion> MakeInitialMotion(const SimulationSettings& settings, size_t count);
+
+// Turns an emission rate into a whole number of particles per step. The fraction left over is
+// carried to the next step, and the sequence numbers of the emitted particles are handed out
+// in order, so the CPU and GPU paths emit the same particles for the same steps.
+class EmissionClock
+{
+public:
+    explicit EmissionClock(uint32_t firstSequence = 0) : m_Sequence(firstSequence) {}
+
+    // particles due during deltaTime, their sequence numbers start at GetSequence() before the call
+    uint32_t Advance(float rate, float deltaTime);
+
+    uint32_t GetSequence() const { return m_Sequence; }
+
+private:
+    float m_Pending = 0.0f;
+    uint32_t m_Sequence;
+};
+
+struct SimulationStepStats
+{
+    uint32_t killed = 0;
+    uint32_t emitted = 0;
+    uint32_t alive = 0;
+};
+
+// CPU version of the simulation stage in SimulationShader.hlsl, deterministic for a given
+// settings, start and sequence of time steps. Each step integrates every live particle, pushes
+// the ones that die onto the dead list in index order and then refills up to the emission count
+// from the top of the dead list. The GPU integrates each particle the same way, up to float
+// rounding, but its append/consume order depends on scheduling, so which slot an emitted
+// particle lands in may differ.
+class ParticleSimulation
+{
+public:
+    explicit ParticleSimulation(const SimulationSettings& settings);
+
+    // particles are alive, with the motion of MakeInitialMotion
+    void Reset(const Particle* particles, size_t count);
+
+    SimulationStepStats Step(float deltaTime, ThreadPool* pool = nullptr);
+
+    const std::vector<Particle>& GetParticles() const { return m_Particles; }
+    const std::vector<ParticleMotion>& GetMotion() const { return m_Motion; }
+    const std::vector<uint32_t>& GetDeadList() const { return m_DeadList; }
+
+    const SimulationSettings& GetSettings() const { return m_Settings; }
+
+    size_t GetAliveCount() const { return m_Particles.size() - m_DeadList.size(); }
+
+    // particles integrated per task when a pool is given
+    static const size_t ChunkSize = 4096;
+
+private:
+    SimulationSettings m_Settings;
+    EmissionClock m_Clock;
+
+    std::vector<Particle> m_Particles;
+    std::vector<ParticleMotion> m_Motion;
+    std::vector<uint32_t> m_DeadList;
+
+    // particles killed by each chunk, merged in chunk order after the step
+    std::vector<std::vector<uint32_t>> m_ChunkKilled;
+};
@@ -0,0 +1,247 @@
+#include "PipelineCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+    const char Magic[8] = { 'P', 'S', 'O', 'C', 'A', 'C', 'H', 'E' };
+
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& data, bool& missing)
+    {
+        data.clear();
+
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        missing = file == nullptr;
+        if (missing)
+        {
+            return false;
+        }
+
+        uint8_t buffer[64 * 1024];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+
+        bool ok = !std::ferror(file);
+        std::fclose(file);
+        return ok;
+    }
+}
+
+PipelineKey& PipelineKey::Add(const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    // FNV-1a
+    for (size_t i = 0; i < size; ++i)
+    {
+        m_Hash ^= bytes[i];
+        m_Hash *= 1099511628211ull;
+    }
+    return *this;
+}
+
+PipelineKey& PipelineKey::AddString(const char* text)
+{
+    size_t length = text != nullptr ? std::strlen(text) : 0;
+    Add(static_cast<uint64_t>(length));
+    return Add(text, length);
+}
+
+bool PipelineCache::Load(const std::string& path, const PipelineCacheIdentity* expected, std::string& error)
+{
+    m_Entries.clear();
+    m_Modified = false;
+
+    std::vector<uint8_t> data;
+    bool missing;
+    if (!ReadWholeFile(path, data, missing))
+    {
+        if (missing)
+        {
+            return true;
+        }
+        error = "cannot read '" + path + "'";
+        return false;
+    }
+
+    PipelineCacheHeader header;
+    if (data.size() < sizeof(header))
+    {
+        error = "'" + path + "' is too short for a pipeline cache";
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.headerSize != sizeof(header))
+    {
+        error = "'" + path + "' is not a pipeline cache";
+        return false;
+    }
+
+    if (header.version != PipelineCacheVersion)
+    {
+        error = "'" + path + "' is pipeline cache version " + std::to_string(header.version) + ", expected " + std::to_string(PipelineCacheVersion);
+        return false;
+    }
+
+    uint64_t checksum = PipelineKey().Add(data.data() + sizeof(header), data.size() - sizeof(header)).Get();
+    if (checksum != header.checksum)
+    {
+        error = "'" + path + "' is damaged, its checksum does not match";
+        return false;
+    }
+
+    PipelineCacheIdentity identity;
+    identity.vendorId = header.vendorId;
+    identity.deviceId = header.deviceId;
+    identity.driverVersion = header.driverVersion;
+
+    if (expected != nullptr && !(identity == *expected))
+    {
+        error = "'" + path + "' was written for another adapter or driver";
+        return false;
+    }
+
+    uint64_t tableSize = header.entryCount * sizeof(PipelineCacheEntry);
+    if (header.entryCount > data.size() / sizeof(PipelineCacheEntry) || tableSize > data.size() - sizeof(header))
+    {
+        error = "'" + path + "' has more entries than fit in it";
+        return false;
+    }
+
+    std::vector<Entry> entries(static_cast<size_t>(header.entryCount));
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        PipelineCacheEntry entry;
+        std::memcpy(&entry, data.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        if (entry.offset > data.size() || entry.size > data.size() - entry.offset)
+        {
+            error = "'" + path + "' has an entry past its end";
+            return false;
+        }
+
+        entries[i].key = entry.key;
+        entries[i].blob.assign(data.begin() + static_cast<size_t>(entry.offset), data.begin() + static_cast<size_t>(entry.offset + entry.size));
+    }
+
+    m_Identity = identity;
+    m_Entries.swap(entries);
+    return true;
+}
+
+const std::vector<uint8_t>* PipelineCache::Find(uint64_t key) const
+{
+    for (const Entry& entry : m_Entries)
+    {
+        if (entry.key == key)
+        {
+            return &entry.blob;
+        }
+    }
+    return nullptr;
+}
+
+void PipelineCache::Store(uint64_t key, const void* blob, size_t size)
+{
+    Remove(key);
+
+    Entry entry;
+    entry.key = key;
+    entry.blob.assign(static_cast<const uint8_t*>(blob), static_cast<const uint8_t*>(blob) + size);
+    m_Entries.push_back(std::move(entry));
+    m_Modified = true;
+}
+
+void PipelineCache::Remove(uint64_t key)
+{
+    for (size_t i = 0; i < m_Entries.size(); ++i)
+    {
+        if (m_Entries[i].key == key)
+        {
+            m_Entries.erase(m_Entries.begin() + i);
+            m_Modified = true;
+            return;
+        }
+    }
+}
+
+void PipelineCache::RemoveUnused(const std::vector<uint64_t>& used)
+{
+    size_t count = m_Entries.size();
+
+    m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(), [&](const Entry& entry)
+        {
+            return std::find(used.begin(), used.end(), entry.key) == used.end();
+        }), m_Entries.end());
+
+    m_Modified = m_Modified || m_Entries.size() != count;
+}
+
+bool PipelineCache::Save(const std::string& path, std::string& error)
+{
+    PipelineCacheHeader header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = PipelineCacheVersion;
+    header.headerSize = sizeof(header);
+    header.vendorId = m_Identity.vendorId;
+    header.deviceId = m_Identity.deviceId;
+    header.driverVersion = m_Identity.driverVersion;
+    header.entryCount = m_Entries.size();
+
+    std::vector<uint8_t> data(sizeof(header) + m_Entries.size() * sizeof(PipelineCacheEntry));
+
+    for (size_t i = 0; i < m_Entries.size(); ++i)
+    {
+        PipelineCacheEntry entry = {};
+        entry.key = m_Entries[i].key;
+        entry.offset = data.size();
+        entry.size = m_Entries[i].blob.size();
+        std::memcpy(data.data() + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+
+        data.insert(data.end(), m_Entries[i].blob.begin(), m_Entries[i].blob.end());
+    }
+
+    header.checksum = PipelineKey().Add(data.data() + sizeof(header), data.size() - sizeof(header)).Get();
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    std::error_code code;
+    std::filesystem::path target(path);
+    if (target.has_parent_path())
+    {
+        std::filesystem::create_directories(target.parent_path(), code);
+    }
+
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+    {
+        error = "cannot write '" + temporary + "'";
+        return false;
+    }
+
+    bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = std::fclose(file) == 0 && written;
+
+    if (written)
+    {
+        std::filesystem::rename(temporary, path, code);
+    }
+
+    if (!written || code)
+    {
+        std::filesystem::remove(temporary, code);
+        error = "failed writing '" + path + "'";
+        return false;
+    }
+
+    m_Modified = false;
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The device a pipeline blob was built for. Drivers only accept their own blobs, so a cache
+// written on another adapter or driver version is dropped as a whole.
+struct PipelineCacheIdentity
+{
+    uint32_t vendorId = 0;
+    uint32_t deviceId = 0;
+    uint64_t driverVersion = 0;
+};
+
+inline bool operator==(const PipelineCacheIdentity& a, const PipelineCacheIdentity& b)
+{
+    return a.vendorId == b.vendorId && a.deviceId == b.deviceId && a.driverVersion == b.driverVersion;
+}
+
+// Hash of everything a pipeline is created from, fed field by field. Structs go in whole only
+// when they have no padding, the bytes of padding are not guaranteed to be the same each run.
+class PipelineKey
+{
+public:
+    PipelineKey& Add(const void* data, size_t size);
+
+    PipelineKey& Add(uint64_t value) { return Add(&value, sizeof(value)); }
+
+    // the length goes in first, so "ab" + "c" and "a" + "bc" differ
+    PipelineKey& AddString(const char* text);
+
+    uint64_t Get() const { return m_Hash; }
+
+private:
+    uint64_t m_Hash = 14695981039346656037ull;
+};
+
+// On-disk layout, followed by entryCount PipelineCacheEntry and then the blobs
+struct PipelineCacheHeader
+{
+    char magic[8];                  // "PSOCACHE"
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint64_t driverVersion;
+    uint64_t entryCount;
+    uint64_t checksum;              // PipelineKey of the bytes after the header
+};
+
+struct PipelineCacheEntry
+{
+    uint64_t key;                   // PipelineKey of the pipeline description
+    uint64_t offset;                // from the start of the file
+    uint64_t size;
+};
+
+const uint32_t PipelineCacheVersion = 1;
+
+// Pipeline blobs by description key, read and written as one file. Nothing here knows about a
+// graphics API: the backend hashes its pipeline descriptions into keys, hands the blobs the
+// driver gives back to Store and passes the ones Find returns to the driver on the next run.
+class PipelineCache
+{
+public:
+    // Replaces the contents with the file at path. A missing file leaves the cache empty and
+    // returns true. A file that is damaged, of another version or, when expected is given, of
+    // another identity also leaves it empty but returns false with the reason in error, the
+    // caller then rebuilds every pipeline and Save overwrites the file.
+    bool Load(const std::string& path, const PipelineCacheIdentity* expected, std::string& error);
+
+    // nullptr when key is not cached
+    const std::vector<uint8_t>* Find(uint64_t key) const;
+
+    void Store(uint64_t key, const void* blob, size_t size);
+
+    // for a blob the driver refused
+    void Remove(uint64_t key);
+
+    // drops every entry whose key is not in used, blobs of pipelines that no longer exist
+    void RemoveUnused(const std::vector<uint64_t>& used);
+
+    // identity written by Save, and the one Load found in the file
+    void SetIdentity(const PipelineCacheIdentity& identity) { m_Identity = identity; }
+    const PipelineCacheIdentity& GetIdentity() const { return m_Identity; }
+
+    size_t GetEntryCount() const { return m_Entries.size(); }
+
+    // true after Store or Remove changed what Load read
+    bool IsModified() const { return m_Modified; }
+
+    // writes to a temporary file first and renames it, so a crash never leaves half a cache
+    bool Save(const std::string& path, std::string& error);
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        std::vector<uint8_t> blob;
+    };
+
+    PipelineCacheIdentity m_Identity;
+    std::vector<Entry> m_Entries;
+    bool m_Modified = false;
+};
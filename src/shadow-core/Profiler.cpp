@@ -0,0 +1,219 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // name with the characters JSON strings can not hold as they are escaped
+    std::string JsonString(const char* name)
+    {
+        std::string escaped = "\"";
+        for (const char* c = name; *c != '\0'; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                escaped += '\\';
+                escaped += *c;
+            }
+            else if (static_cast<unsigned char>(*c) < 0x20)
+            {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(*c)));
+                escaped += code;
+            }
+            else
+            {
+                escaped += *c;
+            }
+        }
+        return escaped + "\"";
+    }
+
+    size_t HistogramBucket(double microseconds)
+    {
+        size_t bucket = 0;
+        while (bucket + 1 < ProfileStats::HistogramBuckets && microseconds >= std::ldexp(1.0, static_cast<int>(bucket)))
+        {
+            ++bucket;
+        }
+        return bucket;
+    }
+}
+
+Profiler::Profiler(size_t frameCapacity) : m_Start(std::chrono::steady_clock::now()), m_FrameCapacity(std::max<size_t>(frameCapacity, 1))
+{
+}
+
+void Profiler::BeginFrame(uint64_t frame)
+{
+    double now = Now();
+    if (m_FrameStarted)
+    {
+        AddEvent({ "Frame", ProfileTrack::Cpu, m_Frame, m_FrameStart, now - m_FrameStart });
+    }
+
+    m_Frame = frame;
+    m_FrameStarted = true;
+    m_FrameStart = now;
+
+    if (m_Frames.empty() || m_Frames.back().frame < frame)
+    {
+        m_Frames.push_back({ frame, {} });
+        if (m_Frames.size() > m_FrameCapacity)
+        {
+            m_Frames.pop_front();
+        }
+    }
+}
+
+void Profiler::AddEvent(const ProfileEvent& event)
+{
+    // GPU events arrive a few frames late, so the search starts at the newest frame
+    for (auto frame = m_Frames.rbegin(); frame != m_Frames.rend(); ++frame)
+    {
+        if (frame->frame == event.frame)
+        {
+            frame->events.push_back(event);
+            return;
+        }
+        if (frame->frame < event.frame)
+        {
+            break;
+        }
+    }
+}
+
+std::vector<ProfileStats> Profiler::ComputeStats() const
+{
+    std::vector<ProfileStats> stats;
+    std::vector<std::vector<double>> durations;
+
+    for (uint32_t track = 0; track < static_cast<uint32_t>(ProfileTrack::Count); ++track)
+    {
+        for (const ProfileFrame& frame : m_Frames)
+        {
+            for (const ProfileEvent& event : frame.events)
+            {
+                if (event.track != static_cast<ProfileTrack>(track))
+                {
+                    continue;
+                }
+
+                auto found = std::find_if(stats.begin(), stats.end(), [&](const ProfileStats& entry)
+                    {
+                        return entry.track == event.track && std::strcmp(entry.name, event.name) == 0;
+                    });
+
+                size_t index = static_cast<size_t>(found - stats.begin());
+                if (found == stats.end())
+                {
+                    ProfileStats entry;
+                    entry.name = event.name;
+                    entry.track = event.track;
+                    stats.push_back(entry);
+                    durations.emplace_back();
+                }
+
+                durations[index].push_back(event.duration);
+                ++stats[index].histogram[HistogramBucket(event.duration)];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        std::vector<double>& values = durations[i];
+        std::sort(values.begin(), values.end());
+
+        double sum = 0.0;
+        for (double value : values)
+        {
+            sum += value;
+        }
+
+        ProfileStats& entry = stats[i];
+        entry.count = values.size();
+        entry.minMs = values.front() / 1000.0;
+        entry.avgMs = sum / static_cast<double>(values.size()) / 1000.0;
+        entry.p99Ms = values[std::min(values.size() - 1, values.size() * 99 / 100)] / 1000.0;
+        entry.maxMs = values.back() / 1000.0;
+    }
+    return stats;
+}
+
+bool Profiler::WriteChromeTrace(const char* path, std::string& error) const
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        error = "cannot write '" + std::string(path) + "'";
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    // names for the rows, then every event
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"shadow frames\"}}");
+    for (uint32_t track = 0; track < static_cast<uint32_t>(ProfileTrack::Count); ++track)
+    {
+        std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":%s}}",
+            track, JsonString(GetTrackName(static_cast<ProfileTrack>(track))).c_str());
+        std::fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"sort_index\":%u}}", track, track);
+    }
+
+    for (const ProfileFrame& frame : m_Frames)
+    {
+        for (const ProfileEvent& event : frame.events)
+        {
+            std::fprintf(file, ",\n{\"name\":%s,\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                JsonString(event.name).c_str(), event.track == ProfileTrack::Cpu ? "cpu" : "gpu", static_cast<uint32_t>(event.track),
+                event.start, event.duration, static_cast<unsigned long long>(event.frame));
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+
+    if (std::fclose(file) != 0)
+    {
+        error = "failed writing '" + std::string(path) + "'";
+        return false;
+    }
+    return true;
+}
+
+const char* Profiler::GetTrackName(ProfileTrack track)
+{
+    switch (track)
+    {
+    case ProfileTrack::Cpu: return "CPU";
+    case ProfileTrack::Graphics: return "Graphics queue";
+    case ProfileTrack::Compute: return "Compute queue";
+    default: return "?";
+    }
+}
+
+ProfileScope::ProfileScope(Profiler* profiler, const char* name)
+    : ProfileScope(profiler, name, ProfileTrack::Cpu, profiler != nullptr ? profiler->GetFrame() : 0)
+{
+}
+
+ProfileScope::ProfileScope(Profiler* profiler, const char* name, ProfileTrack track, uint64_t frame)
+    : m_Profiler(profiler), m_Event{ name, track, frame, 0.0, 0.0 }
+{
+    if (m_Profiler != nullptr)
+    {
+        m_Event.start = m_Profiler->Now();
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (m_Profiler != nullptr)
+    {
+        m_Event.duration = m_Profiler->Now() - m_Event.start;
+        m_Profiler->AddEvent(m_Event);
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// what ran the work of a ProfileEvent, a thread of the Chrome trace
+enum class ProfileTrack : uint32_t
+{
+    Cpu,
+    Graphics,
+    Compute,
+    Count
+};
+
+// One timed scope. Names are not copied, they have to outlive the profiler: string literals.
+struct ProfileEvent
+{
+    const char* name;
+    ProfileTrack track;
+    uint64_t frame;
+
+    // microseconds since the profiler was created
+    double start;
+    double duration;
+};
+
+// the events of one frame, GPU ones arrive when their timestamps have been resolved
+struct ProfileFrame
+{
+    uint64_t frame;
+    std::vector<ProfileEvent> events;
+};
+
+// durations of one scope over the frames the profiler keeps
+struct ProfileStats
+{
+    // by powers of two microseconds: bucket 0 counts durations below 1 us, bucket i those from
+    // 2^(i - 1) up to 2^i us, the last one everything longer
+    static const size_t HistogramBuckets = 24;
+
+    const char* name;
+    ProfileTrack track;
+    uint64_t count = 0;
+
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+
+    std::array<uint32_t, HistogramBuckets> histogram = {};
+};
+
+// Collects the timed scopes of the frame loop per frame: CPU ones from ProfileScope, GPU ones
+// from the timestamp queries of the render backend, handed in once they are resolved. Only the
+// newest frames are kept, so it can stay on for a whole run. Not thread safe, every event comes
+// from the thread running the frames.
+class Profiler
+{
+public:
+    static const size_t DefaultFrameCapacity = 600;
+
+    explicit Profiler(size_t frameCapacity = DefaultFrameCapacity);
+
+    // Starts the record of frame, events recorded from now on belong to it. The time since the
+    // previous BeginFrame becomes a "Frame" event of the previous one.
+    void BeginFrame(uint64_t frame);
+
+    // the frame of the newest BeginFrame
+    uint64_t GetFrame() const { return m_Frame; }
+
+    // microseconds since the profiler was created
+    double Now() const { return FromSteadyClock(std::chrono::steady_clock::now()); }
+
+    double FromSteadyClock(std::chrono::steady_clock::time_point time) const
+    {
+        return std::chrono::duration<double, std::micro>(time - m_Start).count();
+    }
+
+    // the same from microseconds since the steady_clock epoch, e.g. calibrated GPU timestamps
+    double FromSteadyMicroseconds(double microseconds) const
+    {
+        return microseconds - std::chrono::duration<double, std::micro>(m_Start.time_since_epoch()).count();
+    }
+
+    // Adds event to the record of its frame. Events of frames no longer kept are dropped.
+    void AddEvent(const ProfileEvent& event);
+
+    // oldest first
+    const std::deque<ProfileFrame>& GetFrames() const { return m_Frames; }
+
+    // one entry per scope name and track, CPU scopes first, in the order they first appear
+    std::vector<ProfileStats> ComputeStats() const;
+
+    // Writes every kept event as a complete ("X") event of the Chrome trace event format, one
+    // thread per track, for chrome://tracing or Perfetto.
+    bool WriteChromeTrace(const char* path, std::string& error) const;
+
+    static const char* GetTrackName(ProfileTrack track);
+
+private:
+    std::chrono::steady_clock::time_point m_Start;
+
+    size_t m_FrameCapacity;
+    std::deque<ProfileFrame> m_Frames;
+
+    uint64_t m_Frame = 0;
+    bool m_FrameStarted = false;
+    double m_FrameStart = 0.0;
+};
+
+// Times the scope it lives in. Does nothing without a profiler, so call sites need no checks.
+class ProfileScope
+{
+public:
+    // a CPU scope of the profiler's current frame
+    ProfileScope(Profiler* profiler, const char* name);
+
+    // work done on the CPU for another track and frame, e.g. the queues of SoftwareRenderBackend
+    ProfileScope(Profiler* profiler, const char* name, ProfileTrack track, uint64_t frame);
+
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler* m_Profiler;
+    ProfileEvent m_Event;
+};
@@ -0,0 +1,175 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+
+void RadixSorter::Sort(uint32_t* keys, uint32_t* values, size_t count)
+{
+    if (count < 2)
+    {
+        return;
+    }
+
+    m_TempKeys.resize(count);
+    m_TempValues.resize(count);
+
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* dstKeys = m_TempKeys.data();
+    uint32_t* dstValues = m_TempValues.data();
+
+    // all four histograms in one read of the keys
+    size_t histograms[4][256] = {};
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key = keys[i];
+        ++histograms[0][key & 0xff];
+        ++histograms[1][(key >> 8) & 0xff];
+        ++histograms[2][(key >> 16) & 0xff];
+        ++histograms[3][key >> 24];
+    }
+
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        size_t* histogram = histograms[pass];
+        int shift = pass * 8;
+
+        if (histogram[(srcKeys[0] >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; ++digit)
+        {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t key = srcKeys[i];
+            size_t destination = histogram[(key >> shift) & 0xff]++;
+
+            dstKeys[destination] = key;
+            dstValues[destination] = srcValues[i];
+        }
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys)
+    {
+        std::copy(srcKeys, srcKeys + count, keys);
+        std::copy(srcValues, srcValues + count, values);
+    }
+}
+
+void RadixSorter::SortParallel(ThreadPool& pool, uint32_t* keys, uint32_t* values, size_t count)
+{
+    // a few blocks per worker so stealing can even out a slow one
+    size_t blockCount = std::min(pool.GetWorkerCount() * 4, count / (ParallelThreshold / 4));
+    if (count < ParallelThreshold || blockCount < 2 || pool.GetWorkerCount() < 2)
+    {
+        Sort(keys, values, count);
+        return;
+    }
+
+    size_t blockSize = (count + blockCount - 1) / blockCount;
+    blockCount = (count + blockSize - 1) / blockSize;
+
+    m_TempKeys.resize(count);
+    m_TempValues.resize(count);
+    m_BlockHistograms.resize(blockCount * 256);
+
+    // a digit is the same in every key exactly when its bits are set in all of them or in none
+    std::vector<uint32_t> allBits(blockCount, ~0u);
+    std::vector<uint32_t> anyBits(blockCount, 0u);
+    pool.ParallelFor(blockCount, [&](size_t block, size_t)
+        {
+            size_t last = std::min(count, (block + 1) * blockSize);
+            for (size_t i = block * blockSize; i < last; ++i)
+            {
+                allBits[block] &= keys[i];
+                anyBits[block] |= keys[i];
+            }
+        });
+
+    uint32_t setInAll = ~0u;
+    uint32_t setInAny = 0u;
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        setInAll &= allBits[block];
+        setInAny |= anyBits[block];
+    }
+    uint32_t varyingBits = setInAny & ~setInAll;
+
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* dstKeys = m_TempKeys.data();
+    uint32_t* dstValues = m_TempValues.data();
+
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        int shift = pass * 8;
+        if (((varyingBits >> shift) & 0xff) == 0)
+        {
+            continue;
+        }
+
+        pool.ParallelFor(blockCount, [&](size_t block, size_t)
+            {
+                size_t* histogram = &m_BlockHistograms[block * 256];
+                std::fill(histogram, histogram + 256, 0);
+
+                size_t last = std::min(count, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < last; ++i)
+                {
+                    ++histogram[(srcKeys[i] >> shift) & 0xff];
+                }
+            });
+
+        // every digit's range holds the blocks one after the other, in block order
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; ++digit)
+        {
+            for (size_t block = 0; block < blockCount; ++block)
+            {
+                size_t& entry = m_BlockHistograms[block * 256 + digit];
+                size_t digitCount = entry;
+                entry = offset;
+                offset += digitCount;
+            }
+        }
+
+        pool.ParallelFor(blockCount, [&](size_t block, size_t)
+            {
+                size_t* histogram = &m_BlockHistograms[block * 256];
+
+                size_t last = std::min(count, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < last; ++i)
+                {
+                    uint32_t key = srcKeys[i];
+                    size_t destination = histogram[(key >> shift) & 0xff]++;
+
+                    dstKeys[destination] = key;
+                    dstValues[destination] = srcValues[i];
+                }
+            });
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys)
+    {
+        pool.ParallelFor(blockCount, [&](size_t block, size_t)
+            {
+                size_t first = block * blockSize;
+                size_t last = std::min(count, first + blockSize);
+                std::copy(srcKeys + first, srcKeys + last, keys + first);
+                std::copy(srcValues + first, srcValues + last, values + first);
+            });
+    }
+}
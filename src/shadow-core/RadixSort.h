@@ -0,0 +1,65 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Maps a float to a uint32 key whose unsigned order is the float order. -0 is folded into +0
+// so that values comparing equal as floats also get equal keys.
+inline uint32_t FloatToSortableKey(float value)
+{
+    if (value == 0.0f)
+    {
+        value = 0.0f;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+inline float SortableKeyToFloat(uint32_t key)
+{
+    uint32_t bits = (key & 0x80000000u) ? (key & 0x7fffffffu) : ~key;
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Stable LSD radix sort of (key, value) pairs, 8 bits per pass. Passes where every key has the
+// same digit are skipped. The sorted pairs end up back in keys/values.
+class RadixSorter
+{
+public:
+    void Sort(uint32_t* keys, uint32_t* values, size_t count);
+
+    void Sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+    {
+        Sort(keys.data(), values.data(), keys.size());
+    }
+
+    // The same sort split into contiguous blocks on the pool: every pass counts the digits of
+    // each block, gives each block its own run of every digit's output range and scatters the
+    // blocks in parallel. Blocks keep their order within a digit, so the result is the one of
+    // Sort. Small inputs are sorted on the calling thread.
+    void SortParallel(ThreadPool& pool, uint32_t* keys, uint32_t* values, size_t count);
+
+    size_t GetMemoryUsage() const
+    {
+        return (m_TempKeys.capacity() + m_TempValues.capacity()) * sizeof(uint32_t) + m_BlockHistograms.capacity() * sizeof(size_t);
+    }
+
+    // below this SortParallel does not split the keys, the passes are too short to pay for it
+    static const size_t ParallelThreshold = 1 << 16;
+
+private:
+    std::vector<uint32_t> m_TempKeys;
+    std::vector<uint32_t> m_TempValues;
+
+    // 256 counters per block, turned into the block's output offsets before each scatter
+    std::vector<size_t> m_BlockHistograms;
+};
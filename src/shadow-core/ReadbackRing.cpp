@@ -0,0 +1,53 @@
+#include "ReadbackRing.h"
+
+ReadbackRing::ReadbackRing(uint32_t slotCount) : m_States(slotCount, SlotState::Free)
+{
+}
+
+bool ReadbackRing::Acquire(uint32_t& slot)
+{
+    for (uint32_t i = 0; i < m_States.size(); ++i)
+    {
+        if (m_States[i] == SlotState::Free)
+        {
+            m_States[i] = SlotState::Recording;
+            slot = i;
+            return true;
+        }
+    }
+
+    ++m_Dropped;
+    return false;
+}
+
+void ReadbackRing::Submit(uint32_t slot, uint64_t fenceValue, uint64_t frame)
+{
+    m_States[slot] = SlotState::InFlight;
+
+    Readback readback;
+    readback.slot = slot;
+    readback.fenceValue = fenceValue;
+    readback.frame = frame;
+
+    // fence values of one queue only grow, so the front is always the next to complete
+    m_InFlight.push_back(readback);
+}
+
+bool ReadbackRing::PopCompleted(uint64_t completedValue, Readback& readback)
+{
+    if (m_InFlight.empty() || m_InFlight.front().fenceValue > completedValue)
+    {
+        return false;
+    }
+
+    readback = m_InFlight.front();
+    m_InFlight.pop_front();
+
+    m_States[readback.slot] = SlotState::Reading;
+    return true;
+}
+
+void ReadbackRing::Release(uint32_t slot)
+{
+    m_States[slot] = SlotState::Free;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Slot bookkeeping for a ring of persistently mapped readback buffers. A copy into a slot is
+// keyed by the fence value that signals its completion, so results come back a few frames
+// later without the CPU waiting on the GPU. The buffers themselves belong to the backend, the
+// ring only knows slot indices and fence values.
+//
+// Acquire -> record the copy -> Submit(fence value) -> PopCompleted once the fence passed it ->
+// read the mapped slot -> Release.
+class ReadbackRing
+{
+public:
+    struct Readback
+    {
+        uint32_t slot = 0;
+        uint64_t fenceValue = 0;
+        uint64_t frame = 0;
+    };
+
+    explicit ReadbackRing(uint32_t slotCount);
+
+    // false when every slot is still in flight or being read, the caller skips this readback
+    bool Acquire(uint32_t& slot);
+
+    // the copy into slot was submitted and completes once the fence reaches fenceValue
+    void Submit(uint32_t slot, uint64_t fenceValue, uint64_t frame);
+
+    // Oldest submitted readback whose fence value is at most completedValue, in submission
+    // order. The slot stays reserved until Release.
+    bool PopCompleted(uint64_t completedValue, Readback& readback);
+
+    void Release(uint32_t slot);
+
+    uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_States.size()); }
+
+    size_t GetInFlightCount() const { return m_InFlight.size(); }
+
+    // Acquire calls that found no free slot
+    uint64_t GetDroppedCount() const { return m_Dropped; }
+
+private:
+    enum class SlotState
+    {
+        Free,
+        Recording,
+        InFlight,
+        Reading,
+    };
+
+    std::vector<SlotState> m_States;
+    std::deque<Readback> m_InFlight;
+    uint64_t m_Dropped = 0;
+};
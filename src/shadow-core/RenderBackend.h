@@ -0,0 +1,66 @@
+#pragma once
+#include "AsyncShadowScheduler.h"
+#include "Particle.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// The fields of cbSimulation that change from frame to frame, the rest is set up once by the backend
+struct SimulationStep
+{
+    float deltaTime = 0.0f;
+    uint32_t emitSequence = 0;
+    uint32_t emitCount = 0;
+};
+
+// particles[first, first + count) of the CPU copy
+struct ParticleRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+// What the frame loop needs from a graphics API. The backend owns one set of buffers per shadow
+// slot (particles, shadows, dirty mask and upload staging), the readback buffers and the two
+// queues; FramePipeline decides what goes where and when, through slot indices only.
+//
+// Compute work of a frame is recorded between BeginCompute and SubmitCompute, in the order the
+// calls are made, and reaches the compute queue with SubmitCompute. Anything the CPU hands over
+// (particles, dirty mask, constants) is copied into the slot's upload memory while recording,
+// so the calls must only come once the slot's previous compute work retired, which
+// AsyncShadowScheduler::BeginCompute makes sure of.
+class IRenderBackend
+{
+public:
+    virtual ~IRenderBackend() = default;
+
+    virtual IQueueTimeline& GetComputeQueue() = 0;
+    virtual IQueueTimeline& GetGraphicsQueue() = 0;
+
+    virtual uint32_t GetReadbackSlotCount() const = 0;
+
+    virtual void BeginCompute(uint32_t slot) = 0;
+
+    // copies the listed ranges of particles, the whole CPU array, into the slot's particles
+    virtual void UploadParticles(uint32_t slot, const ParticleRange* ranges, size_t rangeCount, const Particle* particles) = 0;
+
+    // CSSimulate steps the particles of the previous slot into slot, CSEmit refills dead ones
+    virtual void DispatchSimulation(uint32_t slot, const SimulationStep& step) = 0;
+
+    // The shadow pass over the slot's particles. With a dirty mask, laid out as
+    // IncrementalShadowEngine::WriteDirtyMask writes it, only the receivers set in it are
+    // reshaded and every other shadow is copied from the previous slot.
+    virtual void DispatchShadows(uint32_t slot, const uint32_t* dirtyMask) = 0;
+
+    virtual void CopyShadowsToReadback(uint32_t slot, uint32_t readbackSlot) = 0;
+
+    virtual void SubmitCompute() = 0;
+
+    // records and submits the draw of the slot's particles on the graphics queue
+    virtual void Draw(uint32_t slot) = 0;
+
+    virtual void Present() = 0;
+
+    // the shadows of every particle in a readback slot whose copy has completed
+    virtual const float* ReadShadows(uint32_t readbackSlot) = 0;
+};
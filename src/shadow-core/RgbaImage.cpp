@@ -0,0 +1,245 @@
+#include "RgbaImage.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    bool WriteFile(const char* path, const std::vector<uint8_t>& bytes, std::string& error)
+    {
+        std::FILE* file = std::fopen(path, "wb");
+        if (file == nullptr)
+        {
+            error = "cannot write '" + std::string(path) + "'";
+            return false;
+        }
+
+        bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        written = std::fclose(file) == 0 && written;
+        if (!written)
+        {
+            error = "failed writing '" + std::string(path) + "'";
+        }
+        return written;
+    }
+
+    void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+    {
+        bytes.push_back(static_cast<uint8_t>(value >> 24));
+        bytes.push_back(static_cast<uint8_t>(value >> 16));
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = []()
+            {
+                std::array<uint32_t, 256> result;
+                for (uint32_t n = 0; n < 256; ++n)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    result[n] = c;
+                }
+                return result;
+            }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // length, type, data and the CRC of type and data
+    void AppendChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+    {
+        AppendBigEndian(png, static_cast<uint32_t>(data.size()));
+
+        size_t typeStart = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+
+        AppendBigEndian(png, Crc32(png.data() + typeStart, png.size() - typeStart));
+    }
+
+    // the RGB rows, each behind filter type 0, as a zlib stream of stored deflate blocks
+    std::vector<uint8_t> StoreZlib(const RgbaImage& image)
+    {
+        std::vector<uint8_t> raw;
+        raw.reserve(static_cast<size_t>(image.height) * (image.width * 3 + 1));
+        for (uint32_t y = 0; y < image.height; ++y)
+        {
+            raw.push_back(0);
+            for (uint32_t x = 0; x < image.width; ++x)
+            {
+                const uint8_t* pixel = image.Pixel(x, y);
+                raw.insert(raw.end(), pixel, pixel + 3);
+            }
+        }
+
+        const size_t maxBlockSize = 65535;
+
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        size_t offset = 0;
+        do
+        {
+            size_t blockSize = std::min(maxBlockSize, raw.size() - offset);
+            bool last = offset + blockSize == raw.size();
+
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(static_cast<uint8_t>(blockSize));
+            zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+            zlib.push_back(static_cast<uint8_t>(~blockSize));
+            zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+            offset += blockSize;
+        } while (offset < raw.size());
+
+        // Adler-32 of the uncompressed data
+        uint32_t a = 1;
+        uint32_t b = 0;
+        for (uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        AppendBigEndian(zlib, (b << 16) | a);
+
+        return zlib;
+    }
+
+    bool EndsWith(const std::string& value, const char* suffix)
+    {
+        size_t length = std::strlen(suffix);
+        return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+    }
+
+    // the next whitespace separated number of a PPM header, skipping # comments
+    bool ReadHeaderNumber(const unsigned char* data, size_t size, size_t& offset, uint32_t& value)
+    {
+        while (offset < size && (std::isspace(data[offset]) || data[offset] == '#'))
+        {
+            if (data[offset] == '#')
+            {
+                while (offset < size && data[offset] != '\n')
+                {
+                    ++offset;
+                }
+            }
+            else
+            {
+                ++offset;
+            }
+        }
+
+        size_t first = offset;
+        uint64_t number = 0;
+        while (offset < size && std::isdigit(data[offset]) && number <= UINT32_MAX)
+        {
+            number = number * 10 + (data[offset] - '0');
+            ++offset;
+        }
+
+        value = static_cast<uint32_t>(number);
+        return offset > first && number <= UINT32_MAX;
+    }
+}
+
+bool WritePpm(const char* path, const RgbaImage& image, std::string& error)
+{
+    std::string header = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+
+    std::vector<uint8_t> bytes(header.begin(), header.end());
+    bytes.reserve(bytes.size() + static_cast<size_t>(image.width) * image.height * 3);
+    for (size_t i = 0; i < image.pixels.size(); i += 4)
+    {
+        bytes.insert(bytes.end(), image.pixels.begin() + i, image.pixels.begin() + i + 3);
+    }
+
+    return WriteFile(path, bytes, error);
+}
+
+bool WritePng(const char* path, const RgbaImage& image, std::string& error)
+{
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> png(signature, signature + sizeof(signature));
+
+    // 8 bits per channel, color type 2 (RGB), default compression and filtering, no interlace
+    std::vector<uint8_t> header;
+    AppendBigEndian(header, image.width);
+    AppendBigEndian(header, image.height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+    AppendChunk(png, "IHDR", header);
+    AppendChunk(png, "IDAT", StoreZlib(image));
+    AppendChunk(png, "IEND", {});
+
+    return WriteFile(path, png, error);
+}
+
+bool WriteImage(const char* path, const RgbaImage& image, std::string& error)
+{
+    std::string name = path;
+    for (char& c : name)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    return EndsWith(name, ".png") ? WritePng(path, image, error) : WritePpm(path, image, error);
+}
+
+bool ReadPpm(const char* path, RgbaImage& image, std::string& error)
+{
+    MappedFile file;
+    if (!file.Open(path, error))
+    {
+        return false;
+    }
+
+    const unsigned char* data = file.Data();
+    size_t size = file.Size();
+
+    size_t offset = 2;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t maxValue = 0;
+    if (size < 2 || data[0] != 'P' || data[1] != '6'
+        || !ReadHeaderNumber(data, size, offset, width)
+        || !ReadHeaderNumber(data, size, offset, height)
+        || !ReadHeaderNumber(data, size, offset, maxValue)
+        || offset >= size || !std::isspace(data[offset]))
+    {
+        error = "'" + std::string(path) + "' is not a binary PPM";
+        return false;
+    }
+
+    // exactly one whitespace character ends the header
+    ++offset;
+
+    uint64_t pixelCount = static_cast<uint64_t>(width) * height;
+    if (maxValue != 255 || size - offset < pixelCount * 3)
+    {
+        error = "'" + std::string(path) + "' has " + (maxValue != 255 ? "a maxval other than 255" : "fewer pixels than its header says");
+        return false;
+    }
+
+    image.Resize(width, height);
+    for (uint64_t i = 0; i < pixelCount; ++i)
+    {
+        std::memcpy(&image.pixels[i * 4], data + offset + i * 3, 3);
+        image.pixels[i * 4 + 3] = 255;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An RGBA8 image in the layout of DXGI_FORMAT_R8G8B8A8_UNORM, rows top to bottom without padding.
+struct RgbaImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+
+    void Resize(uint32_t newWidth, uint32_t newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    }
+
+    uint8_t* Pixel(uint32_t x, uint32_t y) { return pixels.data() + (static_cast<size_t>(y) * width + x) * 4; }
+    const uint8_t* Pixel(uint32_t x, uint32_t y) const { return pixels.data() + (static_cast<size_t>(y) * width + x) * 4; }
+};
+
+// Both writers drop alpha, as presenting the swap chain does. PPM is binary P6, PNG is RGB with
+// stored (uncompressed) deflate blocks, so neither needs an image library.
+bool WritePpm(const char* path, const RgbaImage& image, std::string& error);
+
+bool WritePng(const char* path, const RgbaImage& image, std::string& error);
+
+// picks WritePng for a .png path and WritePpm for anything else
+bool WriteImage(const char* path, const RgbaImage& image, std::string& error);
+
+// Reads a binary P6 PPM with a maxval of 255, alpha comes back opaque.
+bool ReadPpm(const char* path, RgbaImage& image, std::string& error);
@@ -0,0 +1,178 @@
+#include "SceneGenerator.h"
+#include "SunBasis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+    const float DemoRadius = 20.0f;
+    const float DemoOpacity = 0.1f;
+    const float DemoSpread = 330.0f;
+    const float DemoCount = 1024.0f;
+
+    // particles per unit volume in the demo scene
+    float DemoDensity()
+    {
+        return DemoCount / (4.0f / 3.0f * 3.14159265f * DemoSpread * DemoSpread * DemoSpread);
+    }
+
+    // The <random> distributions are implementation defined and give other numbers with other
+    // standard libraries. mt19937 itself is fully specified, these map its output by hand.
+    float Uniform(std::mt19937& random, float low, float high)
+    {
+        // 24 bits, every value in [0, 1) is exact
+        float unit = static_cast<float>(random() >> 8) * (1.0f / 16777216.0f);
+        return low + (high - low) * unit;
+    }
+
+    uint32_t UniformIndex(std::mt19937& random, uint32_t count)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(random()) * count) >> 32);
+    }
+
+    // Irwin-Hall: 12 uniforms sum to mean 6 and variance 1, close enough to a Gaussian for blobs
+    // and made of additions only, which round alike everywhere (log and cos need not)
+    float StandardNormal(std::mt19937& random)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < 12; ++i)
+        {
+            sum += Uniform(random, 0.0f, 1.0f);
+        }
+        return sum - 6.0f;
+    }
+
+    // cbrt of the count ratio, in double so the rounding to float does not depend on the libm
+    float CountScale(uint32_t count)
+    {
+        return static_cast<float>(std::cbrt(static_cast<double>(count) / DemoCount));
+    }
+
+    Particle MakeParticle(float x, float y, float z)
+    {
+        Particle particle;
+        particle.pos = XMFLOAT3(x, y, z);
+        particle.radius = DemoRadius;
+        particle.opacity = DemoOpacity;
+        return particle;
+    }
+
+    std::vector<Particle> GenerateSphere(uint32_t count)
+    {
+        // same ball as the demo, grown so that the density does not change with count
+        float spread = DemoSpread * CountScale(count);
+
+        return Particle::LoadParticles(XMFLOAT3(0.0f, 0.0f, 0.0f), spread, count);
+    }
+
+    std::vector<Particle> GenerateSlab(uint32_t count, std::mt19937& random)
+    {
+        const float thickness = 4.0f * DemoRadius;
+        float side = std::sqrt(static_cast<float>(count) / (DemoDensity() * thickness));
+
+        std::vector<Particle> particles(count);
+        for (Particle& particle : particles)
+        {
+            float x = Uniform(random, -0.5f * side, 0.5f * side);
+            float z = Uniform(random, -0.5f * side, 0.5f * side);
+            float y = Uniform(random, -0.5f * thickness, 0.5f * thickness);
+            particle = MakeParticle(x, y, z);
+        }
+        return particles;
+    }
+
+    std::vector<Particle> GenerateLine(uint32_t count, const XMFLOAT3& sunDir)
+    {
+        SunBasis basis = SunBasis::FromDirection(sunDir);
+
+        std::vector<Particle> particles(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float depth = (static_cast<float>(i) - 0.5f * static_cast<float>(count)) * DemoRadius;
+            particles[i] = MakeParticle(basis.sunDir.x * depth, basis.sunDir.y * depth, basis.sunDir.z * depth);
+        }
+        return particles;
+    }
+
+    std::vector<Particle> GenerateBlobs(uint32_t count, std::mt19937& random)
+    {
+        // about 4096 particles per blob, blob sizes vary by 4x so that cell occupancy is uneven
+        uint32_t blobCount = std::max(1u, count / 4096);
+
+        float spread = DemoSpread * CountScale(count) * 2.0f;
+
+        std::vector<XMFLOAT3> centers(blobCount);
+        std::vector<float> sigmas(blobCount);
+        for (uint32_t b = 0; b < blobCount; ++b)
+        {
+            // one statement each, the order of the draws must not be left to the compiler
+            centers[b].x = Uniform(random, -spread, spread);
+            centers[b].y = Uniform(random, -spread, spread);
+            centers[b].z = Uniform(random, -spread, spread);
+            sigmas[b] = 0.25f * DemoSpread * Uniform(random, 0.5f, 2.0f);
+        }
+
+        std::vector<Particle> particles(count);
+        for (Particle& particle : particles)
+        {
+            uint32_t b = UniformIndex(random, blobCount);
+            float x = centers[b].x + StandardNormal(random) * sigmas[b];
+            float y = centers[b].y + StandardNormal(random) * sigmas[b];
+            float z = centers[b].z + StandardNormal(random) * sigmas[b];
+            particle = MakeParticle(x, y, z);
+        }
+        return particles;
+    }
+}
+
+const char* GetSceneShapeName(SceneShape shape)
+{
+    switch (shape)
+    {
+    case SceneShape::Slab:
+        return "slab";
+    case SceneShape::Line:
+        return "line";
+    case SceneShape::Blobs:
+        return "blobs";
+    default:
+        return "sphere";
+    }
+}
+
+bool ParseSceneShape(const char* name, SceneShape& shape)
+{
+    const SceneShape shapes[] = { SceneShape::Sphere, SceneShape::Slab, SceneShape::Line, SceneShape::Blobs };
+
+    for (SceneShape candidate : shapes)
+    {
+        if (std::strcmp(name, GetSceneShapeName(candidate)) == 0)
+        {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<Particle> GenerateScene(SceneShape shape, uint32_t count, const XMFLOAT3& sunDir, uint32_t seed)
+{
+    std::mt19937 random(seed);
+
+    switch (shape)
+    {
+    case SceneShape::Slab:
+        return GenerateSlab(count, random);
+    case SceneShape::Line:
+        return GenerateLine(count, sunDir);
+    case SceneShape::Blobs:
+        return GenerateBlobs(count, random);
+    default:
+        return GenerateSphere(count);
+    }
+}
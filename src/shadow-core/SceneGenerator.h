@@ -0,0 +1,28 @@
+#pragma once
+#include "Particle.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Synthetic particle sets for benchmarks and offline tools. Every shape keeps roughly the
+// particle density of the demo scene (1024 particles of radius 20 in a ball of radius 330), so
+// the number of occluders per receiver stays comparable across counts.
+enum class SceneShape
+{
+    Sphere, // Particle::LoadParticles, a uniformly filled ball
+    Slab,   // a thin square slab in the xz plane
+    Line,   // a row of particles along the sun direction, every particle shadows all behind it
+    Blobs,  // clustered Gaussian blobs of different sizes
+};
+
+const char* GetSceneShapeName(SceneShape shape);
+
+// false if name is none of the names GetSceneShapeName returns
+bool ParseSceneShape(const char* name, SceneShape& shape);
+
+// sunDir only matters for SceneShape::Line and seed is ignored by SceneShape::Sphere, which
+// reproduces the demo exactly. The same arguments give the same particles with every compiler
+// and standard library: the random numbers come from Particle::DemoRandom and std::mt19937,
+// both fully specified, mapped to floats by hand instead of through rand() or <random>
+// distributions.
+std::vector<Particle> GenerateScene(SceneShape shape, uint32_t count, const DirectX::XMFLOAT3& sunDir, uint32_t seed = 0);
@@ -0,0 +1,424 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+    const char IndexName[] = "index.txt";
+    const char IndexHeader[] = "shader-cache 1";
+
+    // bumped when the key layout changes, so old blobs are never mistaken for new ones
+    const uint64_t KeyVersion = 1;
+
+    const uint64_t HashBasis = 14695981039346656037ull;
+
+    // FNV-1a over every byte, SnapshotChecksum skips the tail that is not a whole word
+    uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashBasis)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& data)
+    {
+        data.clear();
+
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        uint8_t buffer[64 * 1024];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+
+        bool ok = !std::ferror(file);
+        std::fclose(file);
+        return ok;
+    }
+
+    // writes next to path first and renames, so a reader never sees half a file
+    bool WriteWholeFile(const std::string& path, const void* data, size_t size, std::string& error)
+    {
+        std::string temporary = path + ".tmp";
+
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr)
+        {
+            error = "cannot write '" + temporary + "'";
+            return false;
+        }
+
+        bool written = size == 0 || std::fwrite(data, 1, size, file) == size;
+        written = std::fclose(file) == 0 && written;
+
+        std::error_code code;
+        if (written)
+        {
+            std::filesystem::rename(temporary, path, code);
+        }
+
+        if (!written || code)
+        {
+            std::filesystem::remove(temporary, code);
+            error = "failed writing '" + path + "'";
+            return false;
+        }
+        return true;
+    }
+
+    // the name of an #include "name" line, empty for any other line
+    std::string IncludedName(const std::string& line)
+    {
+        size_t at = line.find_first_not_of(" \t");
+        if (at == std::string::npos || line[at] != '#')
+        {
+            return std::string();
+        }
+
+        at = line.find_first_not_of(" \t", at + 1);
+        if (at == std::string::npos || line.compare(at, 7, "include") != 0)
+        {
+            return std::string();
+        }
+
+        size_t open = line.find('"', at + 7);
+        size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            return std::string();
+        }
+        return line.substr(open + 1, close - open - 1);
+    }
+
+    bool HashFile(const std::filesystem::path& path, std::vector<std::filesystem::path>& visited, uint64_t& hash, std::string& error)
+    {
+        std::filesystem::path normal = path.lexically_normal();
+        if (std::find(visited.begin(), visited.end(), normal) != visited.end())
+        {
+            return true;
+        }
+        visited.push_back(normal);
+
+        std::vector<uint8_t> source;
+        if (!ReadWholeFile(normal.string(), source))
+        {
+            error = "cannot read shader source '" + normal.string() + "'";
+            return false;
+        }
+
+        // the name goes in too, so moving text from one file to another changes the hash
+        std::string name = normal.filename().string();
+        hash = HashBytes(name.data(), name.size(), hash);
+        hash = HashBytes(source.data(), source.size(), hash);
+
+        size_t lineStart = 0;
+        while (lineStart < source.size())
+        {
+            size_t lineEnd = lineStart;
+            while (lineEnd < source.size() && source[lineEnd] != '\n')
+            {
+                ++lineEnd;
+            }
+
+            std::string included = IncludedName(std::string(source.begin() + lineStart, source.begin() + lineEnd));
+            if (!included.empty() && !HashFile(normal.parent_path() / included, visited, hash, error))
+            {
+                return false;
+            }
+            lineStart = lineEnd + 1;
+        }
+        return true;
+    }
+
+    std::string KeyText(uint64_t key)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(key));
+        return text;
+    }
+}
+
+std::string DescribePermutation(const ShaderPermutation& permutation)
+{
+    std::string description = permutation.file + " " + permutation.entryPoint + " " + permutation.target;
+
+    for (const ShaderDefine& define : permutation.defines)
+    {
+        description += " " + define.name + "=" + define.value;
+    }
+
+    char flags[24];
+    std::snprintf(flags, sizeof(flags), " flags=0x%x", permutation.flags);
+    return description + flags;
+}
+
+bool ParsePermutation(const std::string& description, ShaderPermutation& permutation)
+{
+    std::vector<std::string> words;
+    for (size_t start = 0; start < description.size();)
+    {
+        size_t end = description.find(' ', start);
+        if (end == std::string::npos)
+        {
+            end = description.size();
+        }
+        words.push_back(description.substr(start, end - start));
+        start = end + 1;
+    }
+
+    if (words.size() < 4 || words.back().compare(0, 8, "flags=0x") != 0)
+    {
+        return false;
+    }
+
+    const char* flags = words.back().c_str() + 8;
+    char* end;
+    unsigned long value = std::strtoul(flags, &end, 16);
+    if (end == flags || *end != '\0')
+    {
+        return false;
+    }
+
+    ShaderPermutation parsed;
+    parsed.file = words[0];
+    parsed.entryPoint = words[1];
+    parsed.target = words[2];
+    parsed.flags = static_cast<uint32_t>(value);
+
+    for (size_t i = 3; i + 1 < words.size(); ++i)
+    {
+        size_t equals = words[i].find('=');
+        if (equals == std::string::npos || equals == 0)
+        {
+            return false;
+        }
+        parsed.defines.push_back({ words[i].substr(0, equals), words[i].substr(equals + 1) });
+    }
+
+    permutation = parsed;
+    return true;
+}
+
+bool HashShaderSource(const std::string& directory, const std::string& file, uint64_t& hash, std::string& error)
+{
+    std::vector<std::filesystem::path> visited;
+
+    hash = HashBasis;
+    return HashFile(std::filesystem::path(directory) / file, visited, hash, error);
+}
+
+uint64_t ShaderCacheKey(const ShaderPermutation& permutation, uint64_t sourceHash)
+{
+    // the description holds every input but the source, separated so no two differ only in layout
+    std::string description = DescribePermutation(permutation);
+
+    uint64_t key = HashBytes(&KeyVersion, sizeof(KeyVersion));
+    key = HashBytes(&sourceHash, sizeof(sourceHash), key);
+    return HashBytes(description.data(), description.size(), key);
+}
+
+bool ShaderCache::Open(const std::string& directory, std::string& error)
+{
+    m_Directory = directory;
+    m_Entries.clear();
+
+    std::vector<uint8_t> index;
+    if (!ReadWholeFile((std::filesystem::path(directory) / IndexName).string(), index))
+    {
+        return true;
+    }
+
+    std::string text(index.begin(), index.end());
+
+    size_t lineStart = 0;
+    bool first = true;
+    while (lineStart < text.size())
+    {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+        {
+            lineEnd = text.size();
+        }
+
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        lineStart = lineEnd + 1;
+
+        if (first)
+        {
+            first = false;
+            if (line != IndexHeader)
+            {
+                m_Entries.clear();
+                error = "'" + directory + "' holds a shader cache index of another version";
+                return false;
+            }
+            continue;
+        }
+
+        if (line.empty())
+        {
+            continue;
+        }
+
+        // <key> <size> <checksum> <description>
+        const char* cursor = line.c_str();
+        char* end;
+
+        Entry entry;
+        entry.key = std::strtoull(cursor, &end, 16);
+        bool parsed = end == cursor + 16 && *end == ' ';
+
+        cursor = end;
+        entry.size = std::strtoull(cursor, &end, 10);
+        parsed = parsed && end != cursor && *end == ' ';
+
+        cursor = end;
+        entry.checksum = std::strtoull(cursor, &end, 16);
+        parsed = parsed && end != cursor && *end == ' ';
+
+        if (!parsed)
+        {
+            m_Entries.clear();
+            error = "bad shader cache index line '" + line + "'";
+            return false;
+        }
+
+        entry.description = end + 1;
+        m_Entries.push_back(entry);
+    }
+    return true;
+}
+
+bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+    bytecode.clear();
+
+    const Entry* entry = Find(key);
+    if (entry == nullptr || !ReadWholeFile(GetBlobPath(key), bytecode))
+    {
+        bytecode.clear();
+        return false;
+    }
+
+    if (bytecode.size() != entry->size || HashBytes(bytecode.data(), bytecode.size()) != entry->checksum)
+    {
+        bytecode.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ShaderCache::Store(uint64_t key, const std::string& description, const void* bytecode, size_t size, std::string& error)
+{
+    std::error_code code;
+    std::filesystem::create_directories(m_Directory, code);
+    if (code)
+    {
+        error = "cannot create '" + m_Directory + "'";
+        return false;
+    }
+
+    if (!WriteWholeFile(GetBlobPath(key), bytecode, size, error))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m_Entries.size();)
+    {
+        const Entry& old = m_Entries[i];
+        if (old.key == key || old.description == description)
+        {
+            if (old.key != key)
+            {
+                std::filesystem::remove(GetBlobPath(old.key), code);
+            }
+            m_Entries.erase(m_Entries.begin() + i);
+            continue;
+        }
+        ++i;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.size = size;
+    entry.checksum = HashBytes(bytecode, size);
+    entry.description = description;
+    m_Entries.push_back(entry);
+
+    return WriteIndex(error);
+}
+
+size_t ShaderCache::Prune(std::string& error)
+{
+    std::vector<Entry> kept;
+
+    std::vector<uint8_t> bytecode;
+    for (const Entry& entry : m_Entries)
+    {
+        if (Load(entry.key, bytecode))
+        {
+            kept.push_back(entry);
+        }
+    }
+
+    size_t pruned = m_Entries.size() - kept.size();
+    m_Entries.swap(kept);
+
+    if (pruned > 0 && !WriteIndex(error))
+    {
+        return 0;
+    }
+    return pruned;
+}
+
+std::string ShaderCache::GetBlobPath(uint64_t key) const
+{
+    return (std::filesystem::path(m_Directory) / (KeyText(key) + ".cso")).string();
+}
+
+const ShaderCache::Entry* ShaderCache::Find(uint64_t key) const
+{
+    for (const Entry& entry : m_Entries)
+    {
+        if (entry.key == key)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool ShaderCache::WriteIndex(std::string& error) const
+{
+    std::string text = std::string(IndexHeader) + "\n";
+
+    for (const Entry& entry : m_Entries)
+    {
+        char numbers[64];
+        std::snprintf(numbers, sizeof(numbers), "%016llx %llu %016llx ",
+            static_cast<unsigned long long>(entry.key), static_cast<unsigned long long>(entry.size), static_cast<unsigned long long>(entry.checksum));
+
+        text += numbers + entry.description + "\n";
+    }
+
+    return WriteWholeFile((std::filesystem::path(m_Directory) / IndexName).string(), text.data(), text.size(), error);
+}
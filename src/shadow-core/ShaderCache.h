@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderDefine
+{
+    std::string name;
+    std::string value;
+};
+
+// Everything a D3DCompileFromFile call depends on besides the source text.
+struct ShaderPermutation
+{
+    std::string file;           // relative to the shader directory
+    std::string entryPoint;
+    std::string target;         // "vs_5_0", "cs_5_0", ...
+    std::vector<ShaderDefine> defines;
+    uint32_t flags = 0;         // D3DCOMPILE_* flags
+};
+
+// One line of text naming the permutation, e.g. "ComputeShader_SunBasis.hlsl CSMain cs_5_0
+// THREAD_X=32 THREAD_Y=32 flags=0x5". The cache index stores it next to each key.
+std::string DescribePermutation(const ShaderPermutation& permutation);
+
+// The permutation back from DescribePermutation, false when description is not one.
+bool ParsePermutation(const std::string& description, ShaderPermutation& permutation);
+
+// Hash of file and of every file it pulls in with #include "name", followed recursively and
+// resolved against the directory of the including file like D3D_COMPILE_STANDARD_FILE_INCLUDE.
+// Includes inside comments or disabled #if blocks are hashed too, which only costs a recompile.
+bool HashShaderSource(const std::string& directory, const std::string& file, uint64_t& hash, std::string& error);
+
+// The cache key of a permutation compiled from sources with the given HashShaderSource hash.
+// The order of the defines is part of the key, keep it fixed.
+uint64_t ShaderCacheKey(const ShaderPermutation& permutation, uint64_t sourceHash);
+
+// Compiled shaders on disk, one <key>.cso per permutation with the raw bytecode, as fxc writes
+// it, and an index.txt listing key, size, checksum and description of each. A blob is only
+// handed out when its size and checksum match the index, anything else counts as a miss.
+class ShaderCache
+{
+public:
+    struct Entry
+    {
+        uint64_t key;
+        uint64_t size;
+        uint64_t checksum;      // FNV-1a of the bytecode
+        std::string description;
+    };
+
+    // Reads the index of directory. A missing directory or index is an empty cache, error is
+    // only set for an index that cannot be parsed.
+    bool Open(const std::string& directory, std::string& error);
+
+    // false on a miss, bytecode is left empty
+    bool Load(uint64_t key, std::vector<uint8_t>& bytecode) const;
+
+    // Writes the blob and rewrites the index. Entries with the same description are dropped
+    // along with their blobs, they were compiled from older sources.
+    bool Store(uint64_t key, const std::string& description, const void* bytecode, size_t size, std::string& error);
+
+    // Drops the entries whose blob is missing or does not match, returns how many.
+    size_t Prune(std::string& error);
+
+    const std::vector<Entry>& GetEntries() const { return m_Entries; }
+
+    const std::string& GetDirectory() const { return m_Directory; }
+
+    std::string GetBlobPath(uint64_t key) const;
+
+private:
+    const Entry* Find(uint64_t key) const;
+
+    bool WriteIndex(std::string& error) const;
+
+    std::string m_Directory;
+    std::vector<Entry> m_Entries;
+};
@@ -0,0 +1,447 @@
+#include "ShadowEngine.h"
+
+#include <algorithm>
+#include <atomic>
+
+ShadowEngine::ShadowEngine(const SunBasis& basis) : m_Basis(basis)
+{
+}
+
+ShadowStats ShadowEngine::Compute(const Particle* particles, size_t count, float* shadows)
+{
+    ShadowStats stats;
+
+    ProjectParticles(particles, count);
+
+    for (size_t first = 0; first < count; first += ReceiverTileSize)
+    {
+        stats.occluderHits += ShadeTile(particles, count, first, std::min(first + ReceiverTileSize, count), shadows);
+    }
+
+    stats.pairsTested = count > 0 ? static_cast<uint64_t>(count) * (count - 1) : 0;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::Compute(const std::vector<Particle>& particles, std::vector<float>& shadows)
+{
+    shadows.resize(particles.size());
+
+    return Compute(particles.data(), particles.size(), shadows.data());
+}
+
+ShadowStats ShadowEngine::ComputeParallel(ThreadPool& pool, const Particle* particles, size_t count, float* shadows)
+{
+    ShadowStats stats;
+
+    ProjectParticles(particles, count, &pool);
+
+    size_t tileCount = (count + ReceiverTileSize - 1) / ReceiverTileSize;
+    std::atomic<uint64_t> occluderHits{ 0 };
+
+    pool.ParallelFor(tileCount, [&](size_t tile, size_t)
+        {
+            size_t first = tile * ReceiverTileSize;
+            occluderHits += ShadeTile(particles, count, first, std::min(first + ReceiverTileSize, count), shadows);
+        });
+
+    stats.pairsTested = count > 0 ? static_cast<uint64_t>(count) * (count - 1) : 0;
+    stats.occluderHits = occluderHits;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::ComputeParallel(ThreadPool& pool, const std::vector<Particle>& particles, std::vector<float>& shadows)
+{
+    shadows.resize(particles.size());
+
+    return ComputeParallel(pool, particles.data(), particles.size(), shadows.data());
+}
+
+ShadowStats ShadowEngine::ComputeVectorized(const Particle* particles, size_t count, float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+
+    m_Arrays.Assign(particles, count, m_Basis);
+
+    size_t tileCount = (count + ReceiverTileSize - 1) / ReceiverTileSize;
+    std::atomic<uint64_t> occluderHits{ 0 };
+
+    auto shadeTile = [&](size_t tile, size_t)
+        {
+            size_t first = tile * ReceiverTileSize;
+            occluderHits += ShadeReceivers(m_SimdLevel, m_Arrays, first, std::min(first + ReceiverTileSize, count), shadows);
+        };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(tileCount, shadeTile);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tileCount; ++tile)
+        {
+            shadeTile(tile, 0);
+        }
+    }
+
+    stats.pairsTested = count > 0 ? static_cast<uint64_t>(count) * (count - 1) : 0;
+    stats.occluderHits = occluderHits;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::ComputeVectorized(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool)
+{
+    shadows.resize(particles.size());
+
+    return ComputeVectorized(particles.data(), particles.size(), shadows.data(), pool);
+}
+
+ShadowStats ShadowEngine::ComputeSorted(const Particle* particles, size_t count, float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+
+    ProjectParticles(particles, count, pool);
+    SortByDepth(particles, count);
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        stats.pairsTested += count - m_RunStart[k] - 1;
+    }
+
+    size_t tileCount = (count + ReceiverTileSize - 1) / ReceiverTileSize;
+    std::atomic<uint64_t> occluderHits{ 0 };
+
+    auto shadeTile = [&](size_t tile, size_t)
+        {
+            size_t first = tile * ReceiverTileSize;
+            occluderHits += ShadeSortedRange(first, std::min(first + ReceiverTileSize, count), shadows);
+        };
+
+    // tiles near the sun are cheap and tiles far from it are expensive, stealing evens that out
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(tileCount, shadeTile);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tileCount; ++tile)
+        {
+            shadeTile(tile, 0);
+        }
+    }
+
+    stats.occluderHits = occluderHits;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::ComputeSorted(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool)
+{
+    shadows.resize(particles.size());
+
+    return ComputeSorted(particles.data(), particles.size(), shadows.data(), pool);
+}
+
+ShadowStats ShadowEngine::ComputeGrid(const Particle* particles, size_t count, float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+
+    ProjectParticles(particles, count, pool);
+
+    m_Radius.resize(count);
+    m_Opacity.resize(count);
+
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_Radius[i] = particles[i].radius;
+        m_Opacity[i] = particles[i].opacity;
+        maxRadius = std::max(maxRadius, particles[i].radius);
+    }
+
+    if (!m_Grid.Build(m_SunBasisPositions.data(), m_Radius.data(), m_Opacity.data(), count, 2.0f * maxRadius))
+    {
+        // an infinite or NaN position or radius, which the brute-force loop copes with
+        return pool != nullptr ? ComputeParallel(*pool, particles, count, shadows) : Compute(particles, count, shadows);
+    }
+
+    size_t tileCount = (count + ReceiverTileSize - 1) / ReceiverTileSize;
+    std::atomic<uint64_t> occluderHits{ 0 };
+    std::atomic<uint64_t> pairsTested{ 0 };
+
+    auto shadeTile = [&](size_t tile, size_t)
+        {
+            size_t first = tile * ReceiverTileSize;
+            uint64_t tilePairs = 0;
+            occluderHits += m_Grid.ShadeSlots(first, std::min(first + ReceiverTileSize, count), shadows, tilePairs);
+            pairsTested += tilePairs;
+        };
+
+    // dense cells make some tiles far more expensive than others, stealing evens that out
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(tileCount, shadeTile);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tileCount; ++tile)
+        {
+            shadeTile(tile, 0);
+        }
+    }
+
+    stats.pairsTested = pairsTested;
+    stats.occluderHits = occluderHits;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::ComputeGrid(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool)
+{
+    shadows.resize(particles.size());
+
+    return ComputeGrid(particles.data(), particles.size(), shadows.data(), pool);
+}
+
+ShadowStats ShadowEngine::ComputeTiled(const Particle* particles, size_t count, float* shadows, ThreadPool* pool)
+{
+    ShadowStats stats;
+
+    size_t groupCount = (count + ComputeGroupSize - 1) / ComputeGroupSize;
+    std::atomic<uint64_t> occluderHits{ 0 };
+
+    auto shadeGroup = [&](size_t group, size_t)
+        {
+            occluderHits += ShadeGroup(particles, count, group * ComputeGroupSize, shadows);
+        };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(groupCount, shadeGroup);
+    }
+    else
+    {
+        for (size_t group = 0; group < groupCount; ++group)
+        {
+            shadeGroup(group, 0);
+        }
+    }
+
+    stats.pairsTested = count > 0 ? static_cast<uint64_t>(count) * (count - 1) : 0;
+    stats.occluderHits = occluderHits;
+
+    return stats;
+}
+
+ShadowStats ShadowEngine::ComputeTiled(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool)
+{
+    shadows.resize(particles.size());
+
+    return ComputeTiled(particles.data(), particles.size(), shadows.data(), pool);
+}
+
+size_t ShadowEngine::GetMemoryUsage() const
+{
+    return (m_SunBasisPositions.capacity() + m_SortedPositions.capacity()) * sizeof(DirectX::XMFLOAT3)
+        + (m_DepthKeys.capacity() + m_DepthOrder.capacity() + m_RunStart.capacity()) * sizeof(uint32_t)
+        + (m_SortedRadius.capacity() + m_SortedOpacity.capacity() + m_Radius.capacity() + m_Opacity.capacity()) * sizeof(float)
+        + m_Arrays.GetMemoryUsage()
+        + m_Sorter.GetMemoryUsage()
+        + m_Grid.GetMemoryUsage();
+}
+
+void ShadowEngine::ProjectParticles(const Particle* particles, size_t count, ThreadPool* pool)
+{
+    m_SunBasisPositions.resize(count);
+
+    auto project = [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                m_SunBasisPositions[i] = m_Basis.Project(particles[i].pos);
+            }
+        };
+
+    if (pool == nullptr)
+    {
+        project(0, count);
+        return;
+    }
+
+    size_t tileCount = (count + OccluderBlockSize - 1) / OccluderBlockSize;
+
+    pool->ParallelFor(tileCount, [&](size_t tile, size_t)
+        {
+            size_t first = tile * OccluderBlockSize;
+            project(first, std::min(first + OccluderBlockSize, count));
+        });
+}
+
+uint64_t ShadowEngine::ShadeTile(const Particle* particles, size_t count, size_t first, size_t last, float* shadows) const
+{
+    uint64_t occluderHits = 0;
+
+    float tileShadows[ReceiverTileSize];
+    std::fill(tileShadows, tileShadows + (last - first), 1.0f);
+
+    for (size_t block = 0; block < count; block += OccluderBlockSize)
+    {
+        size_t blockEnd = std::min(block + OccluderBlockSize, count);
+
+        for (size_t index = first; index < last; ++index)
+        {
+            float radius = particles[index].radius;
+            DirectX::XMFLOAT3 sunBasisPos = m_SunBasisPositions[index];
+
+            float shadow = tileShadows[index - first];
+
+            for (size_t i = block; i < blockEnd; ++i)
+            {
+                if (i == index)
+                {
+                    continue;
+                }
+
+                if (Occludes(sunBasisPos, radius, m_SunBasisPositions[i], particles[i].radius))
+                {
+                    shadow *= (1.0f - particles[i].opacity);
+                    ++occluderHits;
+                }
+            }
+
+            tileShadows[index - first] = shadow;
+        }
+    }
+
+    std::copy(tileShadows, tileShadows + (last - first), shadows + first);
+
+    return occluderHits;
+}
+
+void ShadowEngine::SortByDepth(const Particle* particles, size_t count)
+{
+    m_DepthKeys.resize(count);
+    m_DepthOrder.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_DepthKeys[i] = FloatToSortableKey(m_SunBasisPositions[i].x);
+        m_DepthOrder[i] = static_cast<uint32_t>(i);
+    }
+
+    m_Sorter.Sort(m_DepthKeys, m_DepthOrder);
+
+    m_SortedPositions.resize(count);
+    m_SortedRadius.resize(count);
+    m_SortedOpacity.resize(count);
+    m_RunStart.resize(count);
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        uint32_t index = m_DepthOrder[k];
+
+        m_SortedPositions[k] = m_SunBasisPositions[index];
+        m_SortedRadius[k] = particles[index].radius;
+        m_SortedOpacity[k] = particles[index].opacity;
+
+        // particles at exactly the same depth still shadow each other
+        bool sameDepth = k > 0 && m_DepthKeys[k] == m_DepthKeys[k - 1];
+        m_RunStart[k] = sameDepth ? m_RunStart[k - 1] : static_cast<uint32_t>(k);
+    }
+}
+
+uint64_t ShadowEngine::ShadeSortedRange(size_t first, size_t last, float* shadows) const
+{
+    uint64_t occluderHits = 0;
+    size_t count = m_SortedPositions.size();
+
+    for (size_t k = first; k < last; ++k)
+    {
+        float radius = m_SortedRadius[k];
+        DirectX::XMFLOAT3 sunBasisPos = m_SortedPositions[k];
+
+        float shadow = 1.0f;
+
+        for (size_t i = m_RunStart[k]; i < count; ++i)
+        {
+            if (i == k)
+            {
+                continue;
+            }
+
+            if (Occludes(sunBasisPos, radius, m_SortedPositions[i], m_SortedRadius[i]))
+            {
+                shadow *= (1.0f - m_SortedOpacity[i]);
+                ++occluderHits;
+            }
+        }
+
+        shadows[m_DepthOrder[k]] = shadow;
+    }
+    return occluderHits;
+}
+
+uint64_t ShadowEngine::ShadeGroup(const Particle* particles, size_t count, size_t groupStart, float* shadows) const
+{
+    uint64_t occluderHits = 0;
+
+    size_t groupEnd = std::min(groupStart + ComputeGroupSize, count);
+    size_t receivers = groupEnd - groupStart;
+
+    // per-thread registers of the shader
+    std::vector<DirectX::XMFLOAT3> sunBasisPos(receivers);
+    std::vector<float> radius(receivers);
+    std::vector<float> shadow(receivers, 1.0f);
+
+    for (size_t thread = 0; thread < receivers; ++thread)
+    {
+        sunBasisPos[thread] = m_Basis.Project(particles[groupStart + thread].pos);
+        radius[thread] = particles[groupStart + thread].radius;
+    }
+
+    // the groupshared tile
+    std::vector<DirectX::XMFLOAT3> tileSunBasisPos(ComputeGroupSize);
+    std::vector<float> tileRadius(ComputeGroupSize);
+    std::vector<float> tileOpacity(ComputeGroupSize);
+
+    for (size_t tileStart = 0; tileStart < count; tileStart += ComputeGroupSize)
+    {
+        size_t tileCount = std::min(tileStart + ComputeGroupSize, count) - tileStart;
+
+        // every thread of the group loads one occluder, then GroupMemoryBarrierWithGroupSync
+        for (size_t thread = 0; thread < tileCount; ++thread)
+        {
+            tileSunBasisPos[thread] = m_Basis.Project(particles[tileStart + thread].pos);
+            tileRadius[thread] = particles[tileStart + thread].radius;
+            tileOpacity[thread] = particles[tileStart + thread].opacity;
+        }
+
+        for (size_t thread = 0; thread < receivers; ++thread)
+        {
+            size_t index = groupStart + thread;
+            float threadShadow = shadow[thread];
+
+            for (size_t i = 0; i < tileCount; ++i)
+            {
+                if (tileStart + i == index)
+                {
+                    continue;
+                }
+
+                if (Occludes(sunBasisPos[thread], radius[thread], tileSunBasisPos[i], tileRadius[i]))
+                {
+                    threadShadow *= (1.0f - tileOpacity[i]);
+                    ++occluderHits;
+                }
+            }
+
+            shadow[thread] = threadShadow;
+        }
+    }
+
+    std::copy(shadow.begin(), shadow.end(), shadows + groupStart);
+
+    return occluderHits;
+}
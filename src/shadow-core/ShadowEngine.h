@@ -0,0 +1,136 @@
+#pragma once
+#include "Particle.hpp"
+#include "ParticleArrays.h"
+#include "RadixSort.h"
+#include "ShadowGrid.h"
+#include "SimdShadowKernel.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ShadowStats
+{
+    uint64_t pairsTested = 0;
+    uint64_t occluderHits = 0;
+};
+
+// The occlusion test of ComputeShader_SunBasis.hlsl, both positions are in the sun basis.
+inline bool Occludes(const DirectX::XMFLOAT3& sunBasisPos, float radius, const DirectX::XMFLOAT3& sunBasisOtherPos, float otherRadius)
+{
+    float dirToOtherX = sunBasisOtherPos.x - sunBasisPos.x;
+    float dirToOtherY = sunBasisOtherPos.y - sunBasisPos.y;
+    float dirToOtherZ = sunBasisOtherPos.z - sunBasisPos.z;
+
+    return dirToOtherX >= 0.0f && std::sqrt(dirToOtherY * dirToOtherY + dirToOtherZ * dirToOtherZ) <= radius + otherRadius;
+}
+
+// CPU implementation of the sun basis self-shadowing pass. It does not touch D3D12, so it runs
+// wherever the shadows have to be computed without a GPU.
+class ShadowEngine
+{
+public:
+    explicit ShadowEngine(const SunBasis& basis);
+
+    // Same algorithm as CSMain in ComputeShader_SunBasis.hlsl. shadows[i] receives what the
+    // shader leaves in sbShadows[i] when the buffer starts out filled with 1.0.
+    ShadowStats Compute(const Particle* particles, size_t count, float* shadows);
+
+    ShadowStats Compute(const std::vector<Particle>& particles, std::vector<float>& shadows);
+
+    // Splits the receivers into tiles of ReceiverTileSize and shades them on the pool. Every
+    // receiver still meets its occluders in index order, so the result matches Compute bit for bit.
+    ShadowStats ComputeParallel(ThreadPool& pool, const Particle* particles, size_t count, float* shadows);
+
+    ShadowStats ComputeParallel(ThreadPool& pool, const std::vector<Particle>& particles, std::vector<float>& shadows);
+
+    // Runs the occluder loop on a structure-of-arrays copy, 8 (AVX2) or 16 (AVX-512) occluders
+    // per iteration, with the instruction set picked from CPUID. See ShadeReceivers for how the
+    // result relates to Compute. Tiles go to the pool when one is given.
+    ShadowStats ComputeVectorized(const Particle* particles, size_t count, float* shadows, ThreadPool* pool = nullptr);
+
+    ShadowStats ComputeVectorized(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool = nullptr);
+
+    // overrides the detected instruction set, e.g. to compare the code paths on one machine
+    void SetSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+
+    SimdLevel GetSimdLevel() const { return m_SimdLevel; }
+
+    // Radix sorts the particles by depth along sunDir, then every receiver scans only the
+    // particles at or ahead of its own depth, the only ones that can pass dirToOther.x >= 0.
+    // The hits are the same as in Compute but get multiplied in depth order.
+    ShadowStats ComputeSorted(const Particle* particles, size_t count, float* shadows, ThreadPool* pool = nullptr);
+
+    ShadowStats ComputeSorted(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool = nullptr);
+
+    // particle indices from the farthest to the nearest to the sun, as sorted by the last ComputeSorted
+    const std::vector<uint32_t>& GetDepthOrder() const { return m_DepthOrder; }
+
+    // Buckets the particles into a ShadowGrid over the sun basis yz plane with cells as wide as
+    // the largest radius + otherRadius, so a receiver only visits the 3x3 cells around it and,
+    // inside them, only the particles ahead of it. Roughly O(N * k) for k neighbours per cell.
+    // Particles with an infinite or NaN position or radius fit no grid, they go the way of
+    // ComputeParallel (or Compute without a pool).
+    ShadowStats ComputeGrid(const Particle* particles, size_t count, float* shadows, ThreadPool* pool = nullptr);
+
+    ShadowStats ComputeGrid(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool = nullptr);
+
+    // Emulates the tiled CSMain of ComputeShader_SunBasis.hlsl: each group of ComputeGroupSize
+    // receivers loads one tile of occluders at a time (projected, with radius and opacity) into
+    // a shared copy and every receiver of the group consumes it before the next tile is loaded.
+    // Occluders are still met in index order, so the result matches Compute bit for bit. Groups
+    // go to the pool when one is given.
+    ShadowStats ComputeTiled(const Particle* particles, size_t count, float* shadows, ThreadPool* pool = nullptr);
+
+    ShadowStats ComputeTiled(const std::vector<Particle>& particles, std::vector<float>& shadows, ThreadPool* pool = nullptr);
+
+    const SunBasis& GetBasis() const { return m_Basis; }
+
+    // bytes of working memory kept between calls by every mode run so far
+    size_t GetMemoryUsage() const;
+
+    // THREAD_X * THREAD_Y of the compute shader, also the number of occluders per shared tile
+    static const size_t ComputeGroupSize = 1024;
+
+    // receivers shaded together, their accumulators stay in registers/L1
+    static const size_t ReceiverTileSize = 256;
+
+    // occluders streamed per pass over a tile, sized to stay resident in L1/L2
+    static const size_t OccluderBlockSize = 1024;
+
+private:
+    void ProjectParticles(const Particle* particles, size_t count, ThreadPool* pool = nullptr);
+
+    uint64_t ShadeTile(const Particle* particles, size_t count, size_t first, size_t last, float* shadows) const;
+
+    void SortByDepth(const Particle* particles, size_t count);
+
+    uint64_t ShadeSortedRange(size_t first, size_t last, float* shadows) const;
+
+    uint64_t ShadeGroup(const Particle* particles, size_t count, size_t groupStart, float* shadows) const;
+
+    SunBasis m_Basis;
+
+    // plays the role of the groupshared sunBasis array
+    std::vector<DirectX::XMFLOAT3> m_SunBasisPositions;
+
+    ParticleArrays m_Arrays;
+    SimdLevel m_SimdLevel = DetectSimdLevel();
+
+    RadixSorter m_Sorter;
+    std::vector<uint32_t> m_DepthKeys;
+    std::vector<uint32_t> m_DepthOrder;
+
+    // particles gathered in depth order, m_RunStart[k] is the first slot with the depth of slot k
+    std::vector<DirectX::XMFLOAT3> m_SortedPositions;
+    std::vector<float> m_SortedRadius;
+    std::vector<float> m_SortedOpacity;
+    std::vector<uint32_t> m_RunStart;
+
+    ShadowGrid m_Grid;
+    std::vector<float> m_Radius;
+    std::vector<float> m_Opacity;
+};
@@ -0,0 +1,41 @@
+#include "ShadowError.h"
+
+#include <cmath>
+
+ShadowErrorStats CompareShadows(const float* exact, const float* approximate, size_t count, double threshold)
+{
+    ShadowErrorStats stats;
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    double sumAbs = 0.0;
+    double sumSquares = 0.0;
+    double sumSigned = 0.0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        double difference = static_cast<double>(approximate[i]) - static_cast<double>(exact[i]);
+        double absError = std::fabs(difference);
+
+        sumAbs += absError;
+        sumSquares += difference * difference;
+        sumSigned += difference;
+
+        if (absError > stats.maxAbsError)
+        {
+            stats.maxAbsError = absError;
+            stats.worstIndex = i;
+        }
+        if (absError > threshold)
+        {
+            ++stats.overThreshold;
+        }
+    }
+
+    stats.meanAbsError = sumAbs / static_cast<double>(count);
+    stats.rmsError = std::sqrt(sumSquares / static_cast<double>(count));
+    stats.meanSignedError = sumSigned / static_cast<double>(count);
+    return stats;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// How far approximate shadow factors are from the exact pairwise ones.
+struct ShadowErrorStats
+{
+    double maxAbsError = 0.0;
+    double meanAbsError = 0.0;
+    double rmsError = 0.0;
+    double meanSignedError = 0.0;   // > 0 when the approximation is too bright on average
+    size_t worstIndex = 0;          // receiver with maxAbsError
+    uint64_t overThreshold = 0;     // receivers off by more than the threshold
+};
+
+ShadowErrorStats CompareShadows(const float* exact, const float* approximate, size_t count, double threshold = 0.01);
@@ -0,0 +1,206 @@
+#include "ShadowGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // the smallest positive float reaches infinity in 277 doublings, the budget is met long before
+    const int MaxCellSizeDoublings = 300;
+}
+
+bool ShadowGrid::Build(const DirectX::XMFLOAT3* sunBasisPositions, const float* radius, const float* opacity, size_t count, float cellSize)
+{
+    // a NaN or infinite extent never fits the cell budget below
+    for (size_t i = 0; i < count; ++i)
+    {
+        const DirectX::XMFLOAT3& position = sunBasisPositions[i];
+        if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z) || !std::isfinite(radius[i]))
+        {
+            Clear();
+            return false;
+        }
+    }
+
+    m_MinY = m_MinZ = 0.0f;
+    float maxY = 0.0f;
+    float maxZ = 0.0f;
+
+    if (count > 0)
+    {
+        m_MinY = maxY = sunBasisPositions[0].y;
+        m_MinZ = maxZ = sunBasisPositions[0].z;
+    }
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        m_MinY = std::min(m_MinY, sunBasisPositions[i].y);
+        m_MinZ = std::min(m_MinZ, sunBasisPositions[i].z);
+        maxY = std::max(maxY, sunBasisPositions[i].y);
+        maxZ = std::max(maxZ, sunBasisPositions[i].z);
+    }
+
+    // finite positions can still be more than FLT_MAX apart
+    float extent = std::max(maxY - m_MinY, maxZ - m_MinZ);
+    if (!std::isfinite(extent))
+    {
+        Clear();
+        return false;
+    }
+
+    if (!(cellSize > 0.0f))
+    {
+        // point-sized particles only hit at distance 0, any cell size works
+        cellSize = extent > 0.0f ? extent / std::sqrt(static_cast<float>(count)) : 1.0f;
+    }
+
+    // a sparse cloud of tiny particles would otherwise allocate mostly empty cells
+    double cellBudget = 4.0 * static_cast<double>(count) + 16.0;
+    for (int doubling = 0;; ++doubling)
+    {
+        double cellsY = std::floor((maxY - m_MinY) / cellSize) + 1.0;
+        double cellsZ = std::floor((maxZ - m_MinZ) / cellSize) + 1.0;
+        if (cellsY * cellsZ <= cellBudget)
+        {
+            m_CellsY = static_cast<uint32_t>(cellsY);
+            m_CellsZ = static_cast<uint32_t>(cellsZ);
+            break;
+        }
+        if (doubling == MaxCellSizeDoublings)
+        {
+            Clear();
+            return false;
+        }
+        cellSize *= 2.0f;
+    }
+    m_CellSize = cellSize;
+
+    // depth sort first, the stable counting sort by cell below keeps every cell in depth order
+    m_SortKeys.resize(count);
+    m_SortValues.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_SortKeys[i] = FloatToSortableKey(sunBasisPositions[i].x);
+        m_SortValues[i] = static_cast<uint32_t>(i);
+    }
+    m_Sorter.Sort(m_SortKeys, m_SortValues);
+
+    size_t cellCount = static_cast<size_t>(m_CellsY) * m_CellsZ;
+    m_CellStart.assign(cellCount + 1, 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ++m_CellStart[CellOf(sunBasisPositions[i].y, sunBasisPositions[i].z) + 1];
+    }
+    for (size_t c = 0; c < cellCount; ++c)
+    {
+        m_CellStart[c + 1] += m_CellStart[c];
+    }
+
+    m_Positions.resize(count);
+    m_Radius.resize(count);
+    m_Opacity.resize(count);
+    m_DepthKeys.resize(count);
+    m_Index.resize(count);
+
+    std::vector<uint32_t> cursor(m_CellStart.begin(), m_CellStart.end() - 1);
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        uint32_t index = m_SortValues[k];
+        uint32_t slot = cursor[CellOf(sunBasisPositions[index].y, sunBasisPositions[index].z)]++;
+
+        m_Positions[slot] = sunBasisPositions[index];
+        m_Radius[slot] = radius[index];
+        m_Opacity[slot] = opacity[index];
+        m_DepthKeys[slot] = m_SortKeys[k];
+        m_Index[slot] = index;
+    }
+    return true;
+}
+
+uint64_t ShadowGrid::ShadeSlots(size_t first, size_t last, float* shadows, uint64_t& pairsTested) const
+{
+    uint64_t occluderHits = 0;
+
+    for (size_t slot = first; slot < last; ++slot)
+    {
+        DirectX::XMFLOAT3 sunBasisPos = m_Positions[slot];
+        float radius = m_Radius[slot];
+        uint32_t depthKey = m_DepthKeys[slot];
+
+        uint32_t cell = CellOf(sunBasisPos.y, sunBasisPos.z);
+        int cellY = static_cast<int>(cell / m_CellsZ);
+        int cellZ = static_cast<int>(cell % m_CellsZ);
+
+        float shadow = 1.0f;
+
+        for (int y = std::max(cellY - 1, 0); y <= std::min(cellY + 1, static_cast<int>(m_CellsY) - 1); ++y)
+        {
+            for (int z = std::max(cellZ - 1, 0); z <= std::min(cellZ + 1, static_cast<int>(m_CellsZ) - 1); ++z)
+            {
+                size_t neighbour = static_cast<size_t>(y) * m_CellsZ + z;
+
+                auto cellBegin = m_DepthKeys.begin() + m_CellStart[neighbour];
+                auto cellEnd = m_DepthKeys.begin() + m_CellStart[neighbour + 1];
+
+                // only particles at or ahead of the receiver's depth can pass dirToOther.x >= 0
+                size_t i = std::lower_bound(cellBegin, cellEnd, depthKey) - m_DepthKeys.begin();
+                size_t end = m_CellStart[neighbour + 1];
+
+                for (; i < end; ++i)
+                {
+                    if (i == slot)
+                    {
+                        continue;
+                    }
+
+                    ++pairsTested;
+
+                    float dirToOtherY = m_Positions[i].y - sunBasisPos.y;
+                    float dirToOtherZ = m_Positions[i].z - sunBasisPos.z;
+
+                    if (std::sqrt(dirToOtherY * dirToOtherY + dirToOtherZ * dirToOtherZ) <= radius + m_Radius[i])
+                    {
+                        shadow *= (1.0f - m_Opacity[i]);
+                        ++occluderHits;
+                    }
+                }
+            }
+        }
+
+        shadows[m_Index[slot]] = shadow;
+    }
+    return occluderHits;
+}
+
+size_t ShadowGrid::GetMemoryUsage() const
+{
+    return m_CellStart.capacity() * sizeof(uint32_t)
+        + m_Positions.capacity() * sizeof(DirectX::XMFLOAT3)
+        + (m_Radius.capacity() + m_Opacity.capacity()) * sizeof(float)
+        + (m_DepthKeys.capacity() + m_Index.capacity() + m_SortKeys.capacity() + m_SortValues.capacity()) * sizeof(uint32_t)
+        + m_Sorter.GetMemoryUsage();
+}
+
+void ShadowGrid::Clear()
+{
+    m_CellSize = 1.0f;
+    m_MinY = m_MinZ = 0.0f;
+    m_CellsY = m_CellsZ = 0;
+
+    m_CellStart.clear();
+    m_Positions.clear();
+    m_Radius.clear();
+    m_Opacity.clear();
+    m_DepthKeys.clear();
+    m_Index.clear();
+}
+
+uint32_t ShadowGrid::CellOf(float y, float z) const
+{
+    uint32_t cellY = std::min(static_cast<uint32_t>((y - m_MinY) / m_CellSize), m_CellsY - 1);
+    uint32_t cellZ = std::min(static_cast<uint32_t>((z - m_MinZ) / m_CellSize), m_CellsZ - 1);
+
+    return cellY * m_CellsZ + cellZ;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "MathTypes.h"
+#include "RadixSort.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the light-perpendicular (yz) plane of the sun basis. Cells are at least as
+// wide as the largest radius + otherRadius, so every occluder of a receiver lies in the 3x3
+// block of cells around it. Inside a cell the particles are kept in depth order, which lets a
+// receiver skip everything behind it with a binary search.
+class ShadowGrid
+{
+public:
+    // Positions are in the sun basis. cellSize is raised if the grid would otherwise need far
+    // more cells than there are particles. Returns false and leaves the grid empty if a position
+    // or radius is infinite or NaN, no cell size covers those.
+    bool Build(const DirectX::XMFLOAT3* sunBasisPositions, const float* radius, const float* opacity, size_t count, float cellSize);
+
+    size_t Size() const { return m_Index.size(); }
+
+    // Shades the receivers stored in slots [first, last) of the cell order. Slot order keeps
+    // neighbouring receivers together, results go to shadows[original index].
+    uint64_t ShadeSlots(size_t first, size_t last, float* shadows, uint64_t& pairsTested) const;
+
+    float GetCellSize() const { return m_CellSize; }
+    uint32_t GetCellsY() const { return m_CellsY; }
+    uint32_t GetCellsZ() const { return m_CellsZ; }
+
+    // bytes held by the grid and its sort buffers
+    size_t GetMemoryUsage() const;
+
+private:
+    void Clear();
+
+    uint32_t CellOf(float y, float z) const;
+
+    float m_CellSize = 1.0f;
+    float m_MinY = 0.0f;
+    float m_MinZ = 0.0f;
+    uint32_t m_CellsY = 0;
+    uint32_t m_CellsZ = 0;
+
+    // m_CellStart[c] .. m_CellStart[c + 1] are the slots of cell c
+    std::vector<uint32_t> m_CellStart;
+
+    std::vector<DirectX::XMFLOAT3> m_Positions;
+    std::vector<float> m_Radius;
+    std::vector<float> m_Opacity;
+    std::vector<uint32_t> m_DepthKeys;
+    std::vector<uint32_t> m_Index;
+
+    RadixSorter m_Sorter;
+    std::vector<uint32_t> m_SortKeys;
+    std::vector<uint32_t> m_SortValues;
+};
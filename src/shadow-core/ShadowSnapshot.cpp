@@ -0,0 +1,468 @@
+#include "ShadowSnapshot.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const char Magic[8] = { 'S', 'H', 'D', 'W', 'S', 'N', 'A', 'P' };
+
+    uint64_t AlignUp(uint64_t value)
+    {
+        return (value + SnapshotAlignment - 1) / SnapshotAlignment * SnapshotAlignment;
+    }
+
+    // checksum of size bytes of data followed by the zero padding of its section
+    uint64_t ChecksumPadded(const float* data, uint64_t size, uint64_t hash)
+    {
+        uint64_t whole = size / SnapshotAlignment * SnapshotAlignment;
+        hash = SnapshotChecksum(data, static_cast<size_t>(whole), hash);
+
+        if (whole < size)
+        {
+            unsigned char tail[SnapshotAlignment] = {};
+            std::memcpy(tail, reinterpret_cast<const unsigned char*>(data) + whole, static_cast<size_t>(size - whole));
+            hash = SnapshotChecksum(tail, sizeof(tail), hash);
+        }
+        return hash;
+    }
+
+    SnapshotHeader MakeHeader(uint64_t count, const DirectX::XMFLOAT3& sunDir)
+    {
+        SnapshotHeader header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = SnapshotVersion;
+        header.headerSize = sizeof(SnapshotHeader);
+        header.count = count;
+        header.sunDir[0] = sunDir.x;
+        header.sunDir[1] = sunDir.y;
+        header.sunDir[2] = sunDir.z;
+        return header;
+    }
+
+    bool IsKnownSection(uint32_t kind)
+    {
+        return kind >= static_cast<uint32_t>(SnapshotSection::PositionX) && kind <= static_cast<uint32_t>(SnapshotSection::Shadow);
+    }
+}
+
+const char* GetSnapshotSectionName(SnapshotSection section)
+{
+    switch (section)
+    {
+    case SnapshotSection::PositionX:
+        return "position_x";
+    case SnapshotSection::PositionY:
+        return "position_y";
+    case SnapshotSection::PositionZ:
+        return "position_z";
+    case SnapshotSection::Radius:
+        return "radius";
+    case SnapshotSection::Opacity:
+        return "opacity";
+    case SnapshotSection::Shadow:
+        return "shadow";
+    default:
+        return "unknown";
+    }
+}
+
+uint64_t SnapshotChecksum(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+SnapshotWriter::SnapshotWriter(uint64_t count, const DirectX::XMFLOAT3& sunDir) : m_Count(count), m_SunDir(sunDir)
+{
+}
+
+bool SnapshotWriter::AddSection(SnapshotSection section, const float* data)
+{
+    if (m_Sources.size() >= SnapshotMaxSections)
+    {
+        return false;
+    }
+
+    for (const Source& source : m_Sources)
+    {
+        if (source.section == section)
+        {
+            return false;
+        }
+    }
+
+    m_Sources.push_back({ section, data });
+    return true;
+}
+
+bool SnapshotWriter::AddParticles(const Particle* particles)
+{
+    size_t first = m_Owned.size();
+    m_Owned.resize(first + 5, std::vector<float>(static_cast<size_t>(m_Count)));
+
+    std::vector<float>* arrays = &m_Owned[first];
+    for (uint64_t i = 0; i < m_Count; ++i)
+    {
+        arrays[0][i] = particles[i].pos.x;
+        arrays[1][i] = particles[i].pos.y;
+        arrays[2][i] = particles[i].pos.z;
+        arrays[3][i] = particles[i].radius;
+        arrays[4][i] = particles[i].opacity;
+    }
+
+    return AddSection(SnapshotSection::PositionX, arrays[0].data())
+        && AddSection(SnapshotSection::PositionY, arrays[1].data())
+        && AddSection(SnapshotSection::PositionZ, arrays[2].data())
+        && AddSection(SnapshotSection::Radius, arrays[3].data())
+        && AddSection(SnapshotSection::Opacity, arrays[4].data());
+}
+
+bool SnapshotWriter::Write(const char* path, std::string& error) const
+{
+    SnapshotHeader header = MakeHeader(m_Count, m_SunDir);
+    header.sectionCount = static_cast<uint32_t>(m_Sources.size());
+
+    uint64_t size = m_Count * sizeof(float);
+    uint64_t offset = sizeof(SnapshotHeader);
+    uint64_t checksum = SnapshotChecksum(nullptr, 0);
+
+    for (size_t i = 0; i < m_Sources.size(); ++i)
+    {
+        SnapshotSectionEntry& entry = header.sections[i];
+        entry.kind = static_cast<uint32_t>(m_Sources[i].section);
+        entry.elementSize = sizeof(float);
+        entry.offset = offset;
+        entry.size = size;
+
+        offset += AlignUp(size);
+        checksum = ChecksumPadded(m_Sources[i].data, size, checksum);
+    }
+    header.checksum = checksum;
+
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        error = "cannot write '" + std::string(path) + "'";
+        return false;
+    }
+
+    const unsigned char padding[SnapshotAlignment] = {};
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const Source& source : m_Sources)
+    {
+        size_t paddingSize = static_cast<size_t>(AlignUp(size) - size);
+
+        written = written
+            && std::fwrite(source.data, 1, static_cast<size_t>(size), file) == size
+            && std::fwrite(padding, 1, paddingSize, file) == paddingSize;
+    }
+
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+    {
+        error = "failed writing '" + std::string(path) + "'";
+    }
+    return written;
+}
+
+SnapshotStreamWriter::~SnapshotStreamWriter()
+{
+    if (m_File != nullptr)
+    {
+        std::fclose(m_File);
+    }
+}
+
+bool SnapshotStreamWriter::Open(const char* path, uint64_t count, const DirectX::XMFLOAT3& sunDir, SnapshotSection section, std::string& error)
+{
+    m_File = std::fopen(path, "wb");
+    if (m_File == nullptr)
+    {
+        error = "cannot write '" + std::string(path) + "'";
+        return false;
+    }
+
+    m_Path = path;
+    m_Header = MakeHeader(count, sunDir);
+    m_Header.sectionCount = 1;
+    m_Header.sections[0].kind = static_cast<uint32_t>(section);
+    m_Header.sections[0].elementSize = sizeof(float);
+    m_Header.sections[0].offset = sizeof(SnapshotHeader);
+    m_Header.sections[0].size = count * sizeof(float);
+
+    m_Written = 0;
+    m_Checksum = SnapshotChecksum(nullptr, 0);
+    m_Failed = false;
+    m_HasPending = false;
+
+    // the real header follows in Close, once the checksum is known
+    m_Failed = std::fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1;
+    return true;
+}
+
+bool SnapshotStreamWriter::Append(const float* values, size_t count)
+{
+    if (m_File == nullptr || m_Failed || m_Written + count > m_Header.count)
+    {
+        m_Failed = true;
+        return false;
+    }
+
+    Hash(values, count);
+    m_Written += count;
+
+    m_Failed = std::fwrite(values, sizeof(float), count, m_File) != count;
+    return !m_Failed;
+}
+
+bool SnapshotStreamWriter::Close(std::string& error)
+{
+    if (m_File == nullptr)
+    {
+        error = "snapshot stream is not open";
+        return false;
+    }
+
+    bool written = !m_Failed && m_Written == m_Header.count;
+    if (written)
+    {
+        const float padding[SnapshotAlignment / sizeof(float)] = {};
+        size_t paddingCount = static_cast<size_t>((AlignUp(m_Written * sizeof(float)) - m_Written * sizeof(float)) / sizeof(float));
+
+        Hash(padding, paddingCount);
+        m_Header.checksum = m_Checksum;
+
+        written = std::fwrite(padding, sizeof(float), paddingCount, m_File) == paddingCount
+            && std::fseek(m_File, 0, SEEK_SET) == 0
+            && std::fwrite(&m_Header, sizeof(m_Header), 1, m_File) == 1;
+    }
+
+    written = std::fclose(m_File) == 0 && written;
+    m_File = nullptr;
+
+    if (!written)
+    {
+        error = "failed writing '" + m_Path + "'";
+    }
+    return written;
+}
+
+void SnapshotStreamWriter::Hash(const float* values, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (m_HasPending)
+    {
+        float word[2] = { m_Pending, values[0] };
+        m_Checksum = SnapshotChecksum(word, sizeof(word), m_Checksum);
+        m_HasPending = false;
+        ++values;
+        --count;
+    }
+
+    size_t whole = count & ~static_cast<size_t>(1);
+    m_Checksum = SnapshotChecksum(values, whole * sizeof(float), m_Checksum);
+
+    if (whole < count)
+    {
+        m_Pending = values[whole];
+        m_HasPending = true;
+    }
+}
+
+bool SnapshotReader::Open(const char* path, std::string& error)
+{
+    m_Header = nullptr;
+
+    if (!m_File.Open(path, error))
+    {
+        return false;
+    }
+
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(m_File.Data());
+    uint64_t fileSize = m_File.Size();
+
+    if (fileSize < sizeof(SnapshotHeader) || std::memcmp(header->magic, Magic, sizeof(Magic)) != 0)
+    {
+        error = "'" + std::string(path) + "' is not a shadow snapshot";
+        return false;
+    }
+
+    if (header->version != SnapshotVersion)
+    {
+        error = "'" + std::string(path) + "' has snapshot version " + std::to_string(header->version) + ", expected " + std::to_string(SnapshotVersion);
+        return false;
+    }
+
+    if (header->headerSize != sizeof(SnapshotHeader))
+    {
+        error = "'" + std::string(path) + "' has a snapshot header of " + std::to_string(header->headerSize) + " bytes, expected " + std::to_string(sizeof(SnapshotHeader));
+        return false;
+    }
+
+    if (header->sectionCount > SnapshotMaxSections || header->count > fileSize / sizeof(float))
+    {
+        error = "'" + std::string(path) + "' has a corrupt header";
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->sectionCount; ++i)
+    {
+        const SnapshotSectionEntry& entry = header->sections[i];
+
+        bool valid = IsKnownSection(entry.kind)
+            && entry.elementSize == sizeof(float)
+            && entry.size == header->count * sizeof(float)
+            && entry.offset % SnapshotAlignment == 0
+            && entry.offset >= sizeof(SnapshotHeader)
+            && entry.offset <= fileSize
+            && AlignUp(entry.size) <= fileSize - entry.offset;
+
+        if (!valid)
+        {
+            error = "'" + std::string(path) + "' has a corrupt section table";
+            return false;
+        }
+    }
+
+    m_Header = header;
+    return true;
+}
+
+DirectX::XMFLOAT3 SnapshotReader::GetSunDir() const
+{
+    return DirectX::XMFLOAT3(m_Header->sunDir[0], m_Header->sunDir[1], m_Header->sunDir[2]);
+}
+
+const float* SnapshotReader::GetSection(SnapshotSection section) const
+{
+    for (uint32_t i = 0; i < m_Header->sectionCount; ++i)
+    {
+        if (m_Header->sections[i].kind == static_cast<uint32_t>(section))
+        {
+            return reinterpret_cast<const float*>(m_File.Data() + m_Header->sections[i].offset);
+        }
+    }
+    return nullptr;
+}
+
+bool SnapshotReader::VerifyChecksum() const
+{
+    size_t size = m_File.Size() - sizeof(SnapshotHeader);
+    return SnapshotChecksum(m_File.Data() + sizeof(SnapshotHeader), size) == m_Header->checksum;
+}
+
+bool ReadShadowsText(const char* path, std::vector<float>& shadows, std::string& error)
+{
+    MappedFile file;
+    if (!file.Open(path, error))
+    {
+        return false;
+    }
+
+    shadows.clear();
+
+    const char* cursor = reinterpret_cast<const char*>(file.Data());
+    const char* end = cursor + file.Size();
+    uint64_t line = 1;
+
+    while (cursor < end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(end - cursor)));
+        if (lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+
+        // "( value,  )", blank lines are skipped
+        const char* p = cursor;
+        while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            ++p;
+        }
+
+        if (p < lineEnd)
+        {
+            float value = 0.0f;
+            bool parsed = *p == '(';
+            if (parsed)
+            {
+                ++p;
+                while (p < lineEnd && *p == ' ')
+                {
+                    ++p;
+                }
+
+                std::from_chars_result result = std::from_chars(p, lineEnd, value);
+                parsed = result.ec == std::errc() && result.ptr < lineEnd && *result.ptr == ',';
+            }
+
+            if (!parsed)
+            {
+                error = std::string(path) + ":" + std::to_string(line) + ": expected \"( value,  )\"";
+                return false;
+            }
+            shadows.push_back(value);
+        }
+
+        cursor = lineEnd + 1;
+        ++line;
+    }
+    return true;
+}
+
+bool WriteShadowsText(const char* path, const float* shadows, uint64_t count, std::string& error)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        error = "cannot write '" + std::string(path) + "'";
+        return false;
+    }
+
+    // formatted into one buffer per block of lines, with the precision of the old std::ostream dump
+    const size_t linesPerBlock = 4096;
+    std::vector<char> buffer(linesPerBlock * 32);
+
+    bool written = true;
+    for (uint64_t first = 0; first < count && written; first += linesPerBlock)
+    {
+        uint64_t last = first + linesPerBlock < count ? first + linesPerBlock : count;
+
+        char* out = buffer.data();
+        for (uint64_t i = first; i < last; ++i)
+        {
+            *out++ = '(';
+            *out++ = ' ';
+            out = std::to_chars(out, out + 16, shadows[i], std::chars_format::general, 6).ptr;
+            // CRLF, what std::endl wrote through the old text mode stream on Windows
+            std::memcpy(out, ",  )\r\n", 6);
+            out += 6;
+        }
+
+        size_t size = static_cast<size_t>(out - buffer.data());
+        written = std::fwrite(buffer.data(), 1, size, file) == size;
+    }
+
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+    {
+        error = "failed writing '" + std::string(path) + "'";
+    }
+    return written;
+}
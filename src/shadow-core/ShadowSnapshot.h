@@ -0,0 +1,152 @@
+#pragma once
+#include "MappedFile.h"
+#include "Particle.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Binary container for particles and their shadow factors, meant to be mapped and read in
+// place. The file is a SnapshotHeader followed by sections of count little-endian floats, one
+// per attribute (structure of arrays). Every section starts on a SnapshotAlignment boundary and
+// is zero padded up to the next one. The checksum covers everything after the header.
+//
+// A snapshot may hold any subset of the sections, a converted results.txt only has shadows.
+
+enum class SnapshotSection : uint32_t
+{
+    PositionX = 1,
+    PositionY = 2,
+    PositionZ = 3,
+    Radius = 4,
+    Opacity = 5,
+    Shadow = 6,
+};
+
+const char* GetSnapshotSectionName(SnapshotSection section);
+
+const uint32_t SnapshotVersion = 1;
+const uint64_t SnapshotAlignment = 64;
+const uint32_t SnapshotMaxSections = 8;
+
+struct SnapshotSectionEntry
+{
+    uint32_t kind;          // SnapshotSection
+    uint32_t elementSize;   // bytes per element, 4 for every section of version 1
+    uint64_t offset;        // from the start of the file, a multiple of SnapshotAlignment
+    uint64_t size;          // count * elementSize, without the padding
+};
+
+struct SnapshotHeader
+{
+    char magic[8];          // "SHDWSNAP"
+    uint32_t version;
+    uint32_t headerSize;    // sizeof(SnapshotHeader), the first section starts here
+    uint64_t count;
+    float sunDir[3];
+    uint32_t sectionCount;
+    uint64_t checksum;      // SnapshotChecksum of the bytes from headerSize to the end of the file
+    SnapshotSectionEntry sections[SnapshotMaxSections];
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(SnapshotHeader) == 256, "the snapshot header is part of the file format");
+
+// FNV-1a over little-endian 64-bit words. size must be a multiple of 8, padded sections are.
+uint64_t SnapshotChecksum(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// Collects sections and writes them in one pass. AddSection keeps the pointer, the data must
+// stay alive until Write; AddParticles copies the particles into its own arrays.
+class SnapshotWriter
+{
+public:
+    SnapshotWriter(uint64_t count, const DirectX::XMFLOAT3& sunDir);
+
+    // false if the section was already added or there are too many sections
+    bool AddSection(SnapshotSection section, const float* data);
+
+    // adds PositionX, PositionY, PositionZ, Radius and Opacity, particles holds count entries
+    bool AddParticles(const Particle* particles);
+
+    bool Write(const char* path, std::string& error) const;
+
+private:
+    struct Source
+    {
+        SnapshotSection section;
+        const float* data;
+    };
+
+    uint64_t m_Count;
+    DirectX::XMFLOAT3 m_SunDir;
+
+    std::vector<Source> m_Sources;
+    std::vector<std::vector<float>> m_Owned;
+};
+
+// Writes a snapshot with a single section whose values arrive in order, a block at a time, so
+// they never have to be in memory together. The header is written last, by Close.
+class SnapshotStreamWriter
+{
+public:
+    SnapshotStreamWriter() = default;
+    ~SnapshotStreamWriter();
+
+    SnapshotStreamWriter(const SnapshotStreamWriter&) = delete;
+    SnapshotStreamWriter& operator=(const SnapshotStreamWriter&) = delete;
+
+    bool Open(const char* path, uint64_t count, const DirectX::XMFLOAT3& sunDir, SnapshotSection section, std::string& error);
+
+    // the values after the ones appended so far
+    bool Append(const float* values, size_t count);
+
+    // false unless exactly count values were appended and everything reached the file
+    bool Close(std::string& error);
+
+private:
+    void Hash(const float* values, size_t count);
+
+    std::FILE* m_File = nullptr;
+    std::string m_Path;
+    SnapshotHeader m_Header = {};
+
+    uint64_t m_Written = 0;
+    uint64_t m_Checksum = 0;
+    bool m_Failed = false;
+
+    // a float waiting for the second half of its checksum word
+    float m_Pending = 0.0f;
+    bool m_HasPending = false;
+};
+
+// A snapshot mapped into memory. Open only checks the header and the section bounds, which is
+// constant work, the section data is not touched until it is read.
+class SnapshotReader
+{
+public:
+    bool Open(const char* path, std::string& error);
+
+    uint64_t GetCount() const { return m_Header->count; }
+
+    DirectX::XMFLOAT3 GetSunDir() const;
+
+    // nullptr if the snapshot has no such section
+    const float* GetSection(SnapshotSection section) const;
+
+    // reads the whole file, false when the data does not match the header checksum
+    bool VerifyChecksum() const;
+
+    const SnapshotHeader& GetHeader() const { return *m_Header; }
+
+private:
+    MappedFile m_File;
+    const SnapshotHeader* m_Header = nullptr;
+};
+
+// Parses the text dump the demo used to write, one "( shadow,  )" line per particle.
+bool ReadShadowsText(const char* path, std::vector<float>& shadows, std::string& error);
+
+// Writes shadows in the same text format and with the same CRLF line ends, for tools that
+// still read it.
+bool WriteShadowsText(const char* path, const float* shadows, uint64_t count, std::string& error);
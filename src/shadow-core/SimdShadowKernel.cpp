@@ -0,0 +1,302 @@
+#include "SimdShadowKernel.h"
+
+#include <algorithm>
+#include <bitset>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+// MSVC accepts any intrinsic in any function, GCC and Clang need the target enabled per function
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+namespace
+{
+    // occluders streamed per pass over the receivers, a multiple of ParticleArrays::Padding
+    const size_t OccluderBlockSize = 1024;
+
+    uint64_t ShadeScalar(const ParticleArrays& arrays, size_t first, size_t last, float* shadows)
+    {
+        const float* depth = arrays.Depth();
+        const float* up = arrays.Up();
+        const float* forward = arrays.Forward();
+        const float* radius = arrays.Radius();
+        const float* opacity = arrays.Opacity();
+
+        uint64_t occluderHits = 0;
+        size_t count = arrays.Size();
+
+        for (size_t index = first; index < last; ++index)
+        {
+            float shadow = 1.0f;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                float dirToOtherX = depth[i] - depth[index];
+                float dirToOtherY = up[i] - up[index];
+                float dirToOtherZ = forward[i] - forward[index];
+                float reach = radius[i] + radius[index];
+
+                if (i != index && dirToOtherX >= 0.0f && dirToOtherY * dirToOtherY + dirToOtherZ * dirToOtherZ <= reach * reach)
+                {
+                    shadow *= (1.0f - opacity[i]);
+                    ++occluderHits;
+                }
+            }
+
+            shadows[index] = shadow;
+        }
+        return occluderHits;
+    }
+
+#if SIMD_X86
+    SIMD_TARGET_AVX2 uint64_t ShadeAvx2(const ParticleArrays& arrays, size_t first, size_t last, float* shadows)
+    {
+        const float* depth = arrays.Depth();
+        const float* up = arrays.Up();
+        const float* forward = arrays.Forward();
+        const float* radius = arrays.Radius();
+        const float* opacity = arrays.Opacity();
+
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        uint64_t occluderHits = 0;
+        size_t paddedCount = arrays.PaddedSize();
+
+        std::fill(shadows + first, shadows + last, 1.0f);
+
+        for (size_t block = 0; block < paddedCount; block += OccluderBlockSize)
+        {
+            size_t blockEnd = std::min(block + OccluderBlockSize, paddedCount);
+
+            for (size_t index = first; index < last; ++index)
+            {
+                const __m256 curDepth = _mm256_set1_ps(depth[index]);
+                const __m256 curUp = _mm256_set1_ps(up[index]);
+                const __m256 curForward = _mm256_set1_ps(forward[index]);
+                const __m256 curRadius = _mm256_set1_ps(radius[index]);
+
+                __m256 transmittance = one;
+
+                for (size_t i = block; i < blockEnd; i += 8)
+                {
+                    __m256 dirToOtherX = _mm256_sub_ps(_mm256_load_ps(depth + i), curDepth);
+                    __m256 dirToOtherY = _mm256_sub_ps(_mm256_load_ps(up + i), curUp);
+                    __m256 dirToOtherZ = _mm256_sub_ps(_mm256_load_ps(forward + i), curForward);
+                    __m256 reach = _mm256_add_ps(_mm256_load_ps(radius + i), curRadius);
+
+                    __m256 distanceSq = _mm256_add_ps(_mm256_mul_ps(dirToOtherY, dirToOtherY), _mm256_mul_ps(dirToOtherZ, dirToOtherZ));
+
+                    __m256 mask = _mm256_and_ps(
+                        _mm256_cmp_ps(dirToOtherX, zero, _CMP_GE_OQ),
+                        _mm256_cmp_ps(distanceSq, _mm256_mul_ps(reach, reach), _CMP_LE_OQ));
+
+                    // the receiver is no occluder of itself. Compared as an offset into the 8 lanes, 32-bit
+                    // particle indices would wrap past 2^31; index < i wraps to a huge offset.
+                    size_t selfLane = index - i;
+                    if (selfLane < 8)
+                    {
+                        __m256i self = _mm256_cmpeq_epi32(laneOffsets, _mm256_set1_epi32(static_cast<int>(selfLane)));
+                        mask = _mm256_andnot_ps(_mm256_castsi256_ps(self), mask);
+                    }
+
+                    __m256 occluderTransmittance = _mm256_sub_ps(one, _mm256_load_ps(opacity + i));
+                    transmittance = _mm256_mul_ps(transmittance, _mm256_blendv_ps(one, occluderTransmittance, mask));
+
+                    occluderHits += std::bitset<8>(static_cast<unsigned>(_mm256_movemask_ps(mask))).count();
+                }
+
+                alignas(32) float lanes[8];
+                _mm256_store_ps(lanes, transmittance);
+
+                float shadow = shadows[index];
+                for (float lane : lanes)
+                {
+                    shadow *= lane;
+                }
+                shadows[index] = shadow;
+            }
+        }
+        return occluderHits;
+    }
+
+    SIMD_TARGET_AVX512 uint64_t ShadeAvx512(const ParticleArrays& arrays, size_t first, size_t last, float* shadows)
+    {
+        const float* depth = arrays.Depth();
+        const float* up = arrays.Up();
+        const float* forward = arrays.Forward();
+        const float* radius = arrays.Radius();
+        const float* opacity = arrays.Opacity();
+
+        const __m512 one = _mm512_set1_ps(1.0f);
+        const __m512 zero = _mm512_setzero_ps();
+
+        uint64_t occluderHits = 0;
+        size_t paddedCount = arrays.PaddedSize();
+
+        std::fill(shadows + first, shadows + last, 1.0f);
+
+        for (size_t block = 0; block < paddedCount; block += OccluderBlockSize)
+        {
+            size_t blockEnd = std::min(block + OccluderBlockSize, paddedCount);
+
+            for (size_t index = first; index < last; ++index)
+            {
+                const __m512 curDepth = _mm512_set1_ps(depth[index]);
+                const __m512 curUp = _mm512_set1_ps(up[index]);
+                const __m512 curForward = _mm512_set1_ps(forward[index]);
+                const __m512 curRadius = _mm512_set1_ps(radius[index]);
+
+                __m512 transmittance = one;
+
+                for (size_t i = block; i < blockEnd; i += 16)
+                {
+                    __m512 dirToOtherX = _mm512_sub_ps(_mm512_load_ps(depth + i), curDepth);
+                    __m512 dirToOtherY = _mm512_sub_ps(_mm512_load_ps(up + i), curUp);
+                    __m512 dirToOtherZ = _mm512_sub_ps(_mm512_load_ps(forward + i), curForward);
+                    __m512 reach = _mm512_add_ps(_mm512_load_ps(radius + i), curRadius);
+
+                    __m512 distanceSq = _mm512_add_ps(_mm512_mul_ps(dirToOtherY, dirToOtherY), _mm512_mul_ps(dirToOtherZ, dirToOtherZ));
+
+                    __mmask16 mask = _mm512_cmp_ps_mask(dirToOtherX, zero, _CMP_GE_OQ)
+                        & _mm512_cmp_ps_mask(distanceSq, _mm512_mul_ps(reach, reach), _CMP_LE_OQ);
+
+                    // like ShadeAvx2, by lane offset
+                    size_t selfLane = index - i;
+                    if (selfLane < 16)
+                    {
+                        mask &= static_cast<__mmask16>(~(1u << selfLane));
+                    }
+
+                    __m512 occluderTransmittance = _mm512_sub_ps(one, _mm512_load_ps(opacity + i));
+                    transmittance = _mm512_mask_mul_ps(transmittance, mask, transmittance, occluderTransmittance);
+
+                    occluderHits += std::bitset<16>(static_cast<unsigned>(mask)).count();
+                }
+
+                alignas(64) float lanes[16];
+                _mm512_store_ps(lanes, transmittance);
+
+                float shadow = shadows[index];
+                for (float lane : lanes)
+                {
+                    shadow *= lane;
+                }
+                shadows[index] = shadow;
+            }
+        }
+        return occluderHits;
+    }
+
+    void CpuId(int info[4], int leaf, int subleaf)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, leaf, subleaf);
+#else
+        unsigned int a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = static_cast<int>(a);
+        info[1] = static_cast<int>(b);
+        info[2] = static_cast<int>(c);
+        info[3] = static_cast<int>(d);
+#endif
+    }
+
+    uint64_t ReadXcr0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+#endif
+}
+
+SimdLevel DetectSimdLevel()
+{
+#if SIMD_X86
+    int info[4];
+
+    CpuId(info, 0, 0);
+    int maxLeaf = info[0];
+    if (maxLeaf < 7)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    CpuId(info, 1, 0);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    // the OS has to save the YMM (and for AVX-512 the opmask/ZMM) state on context switches
+    uint64_t xcr0 = ReadXcr0();
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+    CpuId(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    bool avx512f = (info[1] & (1 << 16)) != 0;
+
+    if (avx512f && zmmState)
+    {
+        return SimdLevel::Avx512;
+    }
+    if (avx2 && ymmState)
+    {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+uint64_t ShadeReceivers(SimdLevel level, const ParticleArrays& arrays, size_t first, size_t last, float* shadows)
+{
+#if SIMD_X86
+    switch (level)
+    {
+    case SimdLevel::Avx512:
+        return ShadeAvx512(arrays, first, last, shadows);
+    case SimdLevel::Avx2:
+        return ShadeAvx2(arrays, first, last, shadows);
+    default:
+        break;
+    }
+#endif
+    return ShadeScalar(arrays, first, last, shadows);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "ParticleArrays.h"
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+// Widest instruction set both the CPU and the OS support, read once from CPUID/XGETBV.
+SimdLevel DetectSimdLevel();
+
+const char* GetSimdLevelName(SimdLevel level);
+
+// Shades the receivers [first, last) of arrays against all of its occluders and writes their
+// shadow factors to shadows[first..last). Distances are compared squared and every lane keeps
+// its own product of (1 - opacity), so results match the scalar path up to float rounding.
+// Returns the number of occluders that hit.
+uint64_t ShadeReceivers(SimdLevel level, const ParticleArrays& arrays, size_t first, size_t last, float* shadows);
@@ -0,0 +1,490 @@
+#include "SoftwareRenderBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        // FNV-1a
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+SoftwareQueue::SoftwareQueue(SoftwareRenderBackend& backend, uint32_t agent) : m_Backend(&backend), m_Agent(agent)
+{
+}
+
+uint64_t SoftwareQueue::Signal()
+{
+    uint64_t value = ++m_LastSignaled;
+
+    SoftwareRenderBackend::Clock& clock = m_Backend->GetClock(m_Agent);
+    clock[m_Agent] = value;
+    m_Backend->m_SignalClocks[m_Agent].push_back(clock);
+
+    Operation operation = { Operation::Kind::Signal, nullptr, nullptr, value };
+    m_Operations.push_back(std::move(operation));
+    ++m_PendingSignals;
+
+    // the GPU runs behind the CPU by up to the latency
+    while (m_PendingSignals > m_Backend->m_Latency && RunNext())
+    {
+    }
+    return value;
+}
+
+uint64_t SoftwareQueue::GetCompletedValue() const
+{
+    m_Backend->ObserveCompleted(*this, m_Completed);
+    return m_Completed;
+}
+
+void SoftwareQueue::GpuWait(const IQueueTimeline& other, uint64_t value)
+{
+    const SoftwareQueue& queue = static_cast<const SoftwareQueue&>(other);
+
+    SoftwareRenderBackend::Clock& clock = m_Backend->GetClock(m_Agent);
+    m_Backend->Merge(clock, m_Backend->GetSignalClock(queue, value));
+    clock[queue.m_Agent] = std::max(clock[queue.m_Agent], value);
+
+    Operation operation = { Operation::Kind::Wait, nullptr, &queue, value };
+    m_Operations.push_back(std::move(operation));
+}
+
+void SoftwareQueue::CpuWait(uint64_t value)
+{
+    if (!RunUntil(value))
+    {
+        m_Backend->ReportHazard(std::string("the CPU waits for ") + m_Backend->GetAgentName(m_Agent) + " to reach " + std::to_string(value)
+            + ", which nothing submitted signals; this hangs on a GPU");
+    }
+
+    m_Backend->ObserveCompleted(*this, std::min(value, m_Completed));
+}
+
+void SoftwareQueue::Submit(std::function<void()> work)
+{
+    Operation operation = { Operation::Kind::Work, std::move(work), nullptr, 0 };
+    m_Operations.push_back(std::move(operation));
+}
+
+bool SoftwareQueue::RunNext()
+{
+    if (m_Operations.empty())
+    {
+        return false;
+    }
+
+    Operation& operation = m_Operations.front();
+
+    switch (operation.kind)
+    {
+    case Operation::Kind::Work:
+    {
+        auto start = std::chrono::steady_clock::now();
+        operation.work();
+        m_Backend->m_KernelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        break;
+    }
+
+    case Operation::Kind::Signal:
+        m_Completed = operation.value;
+        --m_PendingSignals;
+        break;
+
+    case Operation::Kind::Wait:
+    {
+        SoftwareQueue& other = const_cast<SoftwareQueue&>(*operation.other);
+
+        if (other.m_Completed < operation.value)
+        {
+            // stalls until the CPU submits the signal, nothing to run here meanwhile
+            if (operation.value > other.m_LastSignaled)
+            {
+                return false;
+            }
+
+            if (other.m_Running)
+            {
+                m_Backend->ReportHazard(std::string(m_Backend->GetAgentName(m_Agent)) + " and " + m_Backend->GetAgentName(other.m_Agent)
+                    + " wait for each other, a deadlock on a GPU; the wait for " + std::to_string(operation.value) + " is skipped");
+            }
+            else
+            {
+                other.RunUntil(operation.value);
+            }
+        }
+        break;
+    }
+    }
+
+    m_Operations.pop_front();
+    return true;
+}
+
+bool SoftwareQueue::RunUntil(uint64_t value)
+{
+    bool running = m_Running;
+    m_Running = true;
+
+    while (m_Completed < value && RunNext())
+    {
+    }
+
+    m_Running = running;
+    return m_Completed >= value;
+}
+
+SoftwareRenderBackend::SoftwareRenderBackend(const std::vector<Particle>& particles, const SunBasis& basis, const SimulationSettings* simulation, uint32_t latency, ThreadPool* pool)
+    : m_ParticleCount(particles.size()), m_ReceiverCount(particles.empty() ? 0 : particles.size() - 1), m_Latency(latency), m_Pool(pool), m_Engine(basis),
+    m_ComputeQueue(*this, Compute), m_GraphicsQueue(*this, Graphics), m_Simulating(simulation != nullptr)
+{
+    for (std::vector<Clock>& clocks : m_SignalClocks)
+    {
+        clocks.push_back(Clock{});
+    }
+
+    const char* slotResourceNames[SlotResourceCount] = { "particles", "shadows", "particle staging", "dirty mask", "cbSimulation", "cbCS", "compute allocator" };
+
+    for (uint32_t slot = 0; slot < AsyncShadowScheduler::SlotCount; ++slot)
+    {
+        m_Particles[slot] = particles;
+        m_Shadows[slot].assign(m_ParticleCount, 1.0f);
+        m_Staging[slot].resize(m_ParticleCount);
+        m_DirtyMask[slot].resize((m_ReceiverCount + 31) / 32);
+
+        for (uint32_t resource = 0; resource < SlotResourceCount; ++resource)
+        {
+            Resource entry;
+            entry.name = std::string(slotResourceNames[resource]) + "[" + std::to_string(slot) + "]";
+            m_SlotResources.push_back(entry);
+        }
+    }
+
+    for (uint32_t slot = 0; slot < readbackSlotCount; ++slot)
+    {
+        m_Readback[slot].resize(m_ParticleCount);
+        m_ReadbackResources[slot].name = "readback[" + std::to_string(slot) + "]";
+    }
+
+    if (simulation != nullptr)
+    {
+        m_SimulationSettings = *simulation;
+        m_Motion = MakeInitialMotion(m_SimulationSettings, m_ReceiverCount);
+    }
+}
+
+bool SoftwareRenderBackend::IsValidParticleSet(const std::vector<Particle>& particles, std::string& error)
+{
+    if (particles.empty())
+    {
+        error = "no particles, at least the light source is needed";
+        return false;
+    }
+    return true;
+}
+
+void SoftwareRenderBackend::BeginCompute(uint32_t slot)
+{
+    // resetting the command allocator, the list that used it must have retired
+    Access(Cpu, GetSlotResource(slot, SlotAllocator), true);
+
+    m_ComputeSlot = slot;
+    m_ComputeList.clear();
+}
+
+void SoftwareRenderBackend::UploadParticles(uint32_t slot, const ParticleRange* ranges, size_t rangeCount, const Particle* particles)
+{
+    Access(Cpu, GetSlotResource(slot, SlotStaging), true);
+
+    for (size_t i = 0; i < rangeCount; ++i)
+    {
+        std::memcpy(&m_Staging[slot][ranges[i].first], &particles[ranges[i].first], ranges[i].count * sizeof(Particle));
+    }
+
+    Access(Compute, GetSlotResource(slot, SlotStaging), false);
+    Access(Compute, GetSlotResource(slot, SlotParticles), true);
+
+    std::vector<ParticleRange> copies(ranges, ranges + rangeCount);
+    Record([this, slot, copies]()
+        {
+            for (const ParticleRange& range : copies)
+            {
+                std::memcpy(&m_Particles[slot][range.first], &m_Staging[slot][range.first], range.count * sizeof(Particle));
+            }
+        });
+}
+
+void SoftwareRenderBackend::DispatchSimulation(uint32_t slot, const SimulationStep& step)
+{
+    Access(Cpu, GetSlotResource(slot, SlotSimulationConstants), true);
+    m_SimulationStep[slot] = step;
+
+    Access(Compute, GetSlotResource(slot, SlotSimulationConstants), false);
+    Access(Compute, GetSlotResource(PreviousSlot(slot), SlotParticles), false);
+    Access(Compute, GetSlotResource(slot, SlotParticles), true);
+
+    uint64_t frame = m_Profiler != nullptr ? m_Profiler->GetFrame() : 0;
+    Record([this, slot, frame]()
+        {
+            ProfileScope scope(m_Profiler, "Simulation", ProfileTrack::Compute, frame);
+            RunSimulation(slot);
+        });
+}
+
+void SoftwareRenderBackend::DispatchShadows(uint32_t slot, const uint32_t* dirtyMask)
+{
+    Access(Cpu, GetSlotResource(slot, SlotShadowConstants), true);
+    m_Incremental[slot] = dirtyMask != nullptr;
+
+    if (dirtyMask != nullptr)
+    {
+        Access(Cpu, GetSlotResource(slot, SlotDirtyMask), true);
+        std::memcpy(m_DirtyMask[slot].data(), dirtyMask, m_DirtyMask[slot].size() * sizeof(uint32_t));
+
+        Access(Compute, GetSlotResource(slot, SlotDirtyMask), false);
+        Access(Compute, GetSlotResource(PreviousSlot(slot), SlotShadows), false);
+    }
+
+    Access(Compute, GetSlotResource(slot, SlotShadowConstants), false);
+    Access(Compute, GetSlotResource(slot, SlotParticles), false);
+    Access(Compute, GetSlotResource(slot, SlotShadows), true);
+
+    uint64_t frame = m_Profiler != nullptr ? m_Profiler->GetFrame() : 0;
+    Record([this, slot, frame]()
+        {
+            ProfileScope scope(m_Profiler, "Shadows", ProfileTrack::Compute, frame);
+            RunShadows(slot);
+        });
+}
+
+void SoftwareRenderBackend::CopyShadowsToReadback(uint32_t slot, uint32_t readbackSlot)
+{
+    Access(Compute, GetSlotResource(slot, SlotShadows), false);
+    Access(Compute, m_ReadbackResources[readbackSlot], true);
+
+    Record([this, slot, readbackSlot]() { m_Readback[readbackSlot] = m_Shadows[slot]; });
+}
+
+void SoftwareRenderBackend::SubmitCompute()
+{
+    Access(Compute, GetSlotResource(m_ComputeSlot, SlotAllocator), false);
+
+    for (std::function<void()>& work : m_ComputeList)
+    {
+        m_ComputeQueue.Submit(std::move(work));
+    }
+    m_ComputeList.clear();
+}
+
+void SoftwareRenderBackend::Draw(uint32_t slot)
+{
+    Access(Graphics, GetSlotResource(slot, SlotParticles), false);
+    Access(Graphics, GetSlotResource(slot, SlotShadows), false);
+
+    uint64_t frame = m_Frame;
+    bool cull = m_FrustumCull;
+    Frustum frustum = m_Frustum;
+    uint64_t profileFrame = m_Profiler != nullptr ? m_Profiler->GetFrame() : 0;
+    m_GraphicsQueue.Submit([this, slot, frame, cull, frustum, profileFrame]()
+        {
+            ProfileScope scope(m_Profiler, "Draw", ProfileTrack::Graphics, profileFrame);
+
+            SoftwareDrawCall draw;
+            draw.frame = frame;
+            draw.slot = slot;
+            draw.instanceCount = static_cast<uint32_t>(m_ParticleCount);
+            if (cull)
+            {
+                draw.instanceCount = static_cast<uint32_t>(m_Culler.Cull(m_Particles[slot].data(), m_ParticleCount, frustum, nullptr, m_Pool).size());
+            }
+            draw.contentHash = HashBytes(m_Particles[slot].data(), m_ParticleCount * sizeof(Particle));
+            draw.contentHash = HashBytes(m_Shadows[slot].data(), m_ParticleCount * sizeof(float), draw.contentHash);
+            m_DrawCalls.push_back(draw);
+        });
+}
+
+void SoftwareRenderBackend::SetFrustum(const Frustum* frustum)
+{
+    m_FrustumCull = frustum != nullptr;
+    if (frustum != nullptr)
+    {
+        m_Frustum = *frustum;
+    }
+}
+
+void SoftwareRenderBackend::Present()
+{
+    ++m_Frame;
+}
+
+const float* SoftwareRenderBackend::ReadShadows(uint32_t readbackSlot)
+{
+    Access(Cpu, m_ReadbackResources[readbackSlot], false);
+    return m_Readback[readbackSlot].data();
+}
+
+void SoftwareRenderBackend::Access(uint32_t agent, Resource& resource, bool write)
+{
+    const Clock& clock = GetClock(agent);
+
+    // work recorded now completes with the queue's next signal
+    uint64_t value = agent == Cpu ? 0 : (agent == Compute ? m_ComputeQueue : m_GraphicsQueue).GetLastSignaled() + 1;
+
+    const char* access = write ? " writes " : " reads ";
+
+    if (resource.writer != Cpu && resource.writer != agent && clock[resource.writer] < resource.writeValue)
+    {
+        ReportHazard(std::string(GetAgentName(agent)) + access + resource.name + ", written by " + GetAgentName(resource.writer)
+            + " before its signal " + std::to_string(resource.writeValue) + ", without waiting for it");
+    }
+
+    if (write)
+    {
+        for (uint32_t reader = Compute; reader < AgentCount; ++reader)
+        {
+            if (reader != agent && clock[reader] < resource.reads[reader])
+            {
+                ReportHazard(std::string(GetAgentName(agent)) + access + resource.name + ", read by " + GetAgentName(reader)
+                    + " before its signal " + std::to_string(resource.reads[reader]) + ", without waiting for it");
+            }
+        }
+
+        resource.writer = agent;
+        resource.writeValue = value;
+        resource.reads = Clock{};
+    }
+    else if (agent != Cpu)
+    {
+        resource.reads[agent] = std::max(resource.reads[agent], value);
+    }
+}
+
+void SoftwareRenderBackend::ReportHazard(const std::string& message)
+{
+    if (m_Hazards.size() < MaxHazardMessages)
+    {
+        m_Hazards.push_back("frame " + std::to_string(m_Frame) + ": " + message);
+    }
+    ++m_HazardCount;
+}
+
+SoftwareRenderBackend::Clock& SoftwareRenderBackend::GetClock(uint32_t agent)
+{
+    return m_Clocks[agent];
+}
+
+const char* SoftwareRenderBackend::GetAgentName(uint32_t agent) const
+{
+    const char* names[AgentCount] = { "the CPU", "compute", "graphics" };
+    return names[agent];
+}
+
+const SoftwareRenderBackend::Clock& SoftwareRenderBackend::GetSignalClock(const SoftwareQueue& queue, uint64_t value) const
+{
+    const std::vector<Clock>& clocks = m_SignalClocks[queue.m_Agent];
+
+    // a wait on a value not signaled yet only learns the value itself
+    return clocks[static_cast<size_t>(std::min<uint64_t>(value, clocks.size() - 1))];
+}
+
+void SoftwareRenderBackend::ObserveCompleted(const SoftwareQueue& queue, uint64_t value)
+{
+    Clock& clock = m_Clocks[Cpu];
+    Merge(clock, GetSignalClock(queue, value));
+    clock[queue.m_Agent] = std::max(clock[queue.m_Agent], value);
+}
+
+void SoftwareRenderBackend::Merge(Clock& clock, const Clock& other) const
+{
+    for (size_t i = 0; i < clock.size(); ++i)
+    {
+        clock[i] = std::max(clock[i], other[i]);
+    }
+}
+
+void SoftwareRenderBackend::Record(std::function<void()> work)
+{
+    m_ComputeList.push_back(std::move(work));
+}
+
+void SoftwareRenderBackend::RunSimulation(uint32_t slot)
+{
+    const SimulationStep& step = m_SimulationStep[slot];
+
+    // CSSimulate: the light and anything else past the simulated ones is copied as it is
+    std::vector<Particle>& particles = m_Particles[slot];
+    particles = m_Particles[PreviousSlot(slot)];
+
+    for (size_t i = 0; i < m_Motion.size(); ++i)
+    {
+        ParticleMotion& motion = m_Motion[i];
+
+        if (motion.age < motion.lifetime && IntegrateParticle(m_SimulationSettings, step.deltaTime, particles[i], motion))
+        {
+            m_DeadList.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // CSEmit, clamped to the dead count left by CSSimulate
+    uint32_t emitCount = static_cast<uint32_t>(std::min<size_t>(step.emitCount, m_DeadList.size()));
+
+    for (uint32_t i = 0; i < emitCount; ++i)
+    {
+        uint32_t index = m_DeadList.back();
+        m_DeadList.pop_back();
+
+        EmitParticle(m_SimulationSettings, step.emitSequence + i, particles[index], m_Motion[index]);
+    }
+}
+
+void SoftwareRenderBackend::RunShadows(uint32_t slot)
+{
+    const std::vector<Particle>& particles = m_Particles[slot];
+    std::vector<float>& shadows = m_Shadows[slot];
+
+    size_t receivers = m_ReceiverCount;
+
+    m_FullShadows.resize(receivers);
+    if (m_Pool != nullptr)
+    {
+        m_Engine.ComputeParallel(*m_Pool, particles.data(), receivers, m_FullShadows.data());
+    }
+    else
+    {
+        m_Engine.Compute(particles.data(), receivers, m_FullShadows.data());
+    }
+
+    if (!m_Incremental[slot])
+    {
+        std::copy(m_FullShadows.begin(), m_FullShadows.end(), shadows.begin());
+        return;
+    }
+
+    // clean receivers keep the previous slot's shadow, which has to be what a full pass gives
+    const std::vector<float>& previous = m_Shadows[PreviousSlot(slot)];
+    const std::vector<uint32_t>& mask = m_DirtyMask[slot];
+
+    for (size_t i = 0; i < receivers; ++i)
+    {
+        if ((mask[i / 32] & (1u << (i % 32))) != 0)
+        {
+            shadows[i] = m_FullShadows[i];
+        }
+        else
+        {
+            m_StaleShadows += previous[i] != m_FullShadows[i] ? 1 : 0;
+            shadows[i] = previous[i];
+        }
+    }
+}
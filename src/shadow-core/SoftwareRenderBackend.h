@@ -0,0 +1,299 @@
+#pragma once
+#include "AsyncShadowScheduler.h"
+#include "FrustumCull.h"
+#include "Particle.hpp"
+#include "ParticleSimulation.h"
+#include "Profiler.h"
+#include "RenderBackend.h"
+#include "ShadowEngine.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+class SoftwareRenderBackend;
+
+// IQueueTimeline of SoftwareRenderBackend. Submitted work is queued and runs on the calling
+// thread once the queue holds more signals than the backend's latency allows, or when the CPU
+// or the other queue waits for it, so results arrive frames late the way they do from a GPU.
+class SoftwareQueue : public IQueueTimeline
+{
+public:
+    SoftwareQueue(SoftwareRenderBackend& backend, uint32_t agent);
+
+    SoftwareQueue(const SoftwareQueue&) = delete;
+    SoftwareQueue& operator=(const SoftwareQueue&) = delete;
+
+    uint64_t Signal() override;
+
+    // what has run so far, the CPU learns that much about the queue
+    uint64_t GetCompletedValue() const override;
+
+    // other has to be the other queue of the same backend
+    void GpuWait(const IQueueTimeline& other, uint64_t value) override;
+
+    void CpuWait(uint64_t value) override;
+
+    // queues work behind everything submitted so far
+    void Submit(std::function<void()> work);
+
+    uint64_t GetLastSignaled() const { return m_LastSignaled; }
+
+private:
+    friend class SoftwareRenderBackend;
+
+    struct Operation
+    {
+        enum class Kind
+        {
+            Work,
+            Signal,
+            Wait,
+        };
+
+        Kind kind;
+        std::function<void()> work;
+        const SoftwareQueue* other;
+        uint64_t value;
+    };
+
+    // Runs the oldest operation. False when it is a wait for a value nothing signaled yet, the
+    // queue then stalls like a GPU would.
+    bool RunNext();
+
+    // false when value can not be reached without a signal that was never submitted
+    bool RunUntil(uint64_t value);
+
+    SoftwareRenderBackend* m_Backend;
+    uint32_t m_Agent;
+
+    std::deque<Operation> m_Operations;
+    uint64_t m_LastSignaled = 0;
+    uint64_t m_Completed = 0;
+    size_t m_PendingSignals = 0;
+
+    // set while RunUntil runs, a wait that comes back to this queue is a deadlock
+    bool m_Running = false;
+};
+
+// a draw call as SoftwareRenderBackend ran it
+struct SoftwareDrawCall
+{
+    uint64_t frame;             // Present calls before the draw was submitted
+    uint32_t slot;
+    uint32_t instanceCount;     // the particles that survived the frustum cull, all of them without one
+    uint64_t contentHash;       // FNV-1a of the particles and shadows the draw read, when it ran
+};
+
+// IRenderBackend that runs the kernels natively: the shadow pass through ShadowEngine::Compute,
+// the simulation stage through IntegrateParticle and EmitParticle in the order of ParticleSimulation,
+// and draws are only recorded. The frames it runs are deterministic, whatever the latency.
+//
+// Besides running them, every access of queued work and of the CPU to a resource is checked
+// against the fence waits that order it. Two accesses from different queues, or from a queue
+// and the CPU, of which one writes, have to be ordered by a GpuWait or CpuWait on the signal that
+// follows the first one, otherwise a hazard is reported: on a GPU the two could overlap. The
+// check follows the waits and not what happened to run first, so a missing wait is caught even
+// when the work it should have ordered already ran.
+class SoftwareRenderBackend : public IRenderBackend
+{
+public:
+    // Every slot starts out with particles, the last one is the light. With simulation the
+    // particles before the light get the motion of MakeInitialMotion, as in DeviceContext.
+    // latency is how many signaled submissions each queue may hold back before running them.
+    // particles have to be checked with IsValidParticleSet first, an empty set runs frames
+    // without receivers.
+    SoftwareRenderBackend(const std::vector<Particle>& particles, const SunBasis& basis, const SimulationSettings* simulation, uint32_t latency = 0, ThreadPool* pool = nullptr);
+
+    SoftwareRenderBackend(const SoftwareRenderBackend&) = delete;
+    SoftwareRenderBackend& operator=(const SoftwareRenderBackend&) = delete;
+
+    // false with a message when particles lack the light source, the one particle every frame needs
+    static bool IsValidParticleSet(const std::vector<Particle>& particles, std::string& error);
+
+    IQueueTimeline& GetComputeQueue() override { return m_ComputeQueue; }
+    IQueueTimeline& GetGraphicsQueue() override { return m_GraphicsQueue; }
+
+    uint32_t GetReadbackSlotCount() const override { return readbackSlotCount; }
+
+    void BeginCompute(uint32_t slot) override;
+
+    void UploadParticles(uint32_t slot, const ParticleRange* ranges, size_t rangeCount, const Particle* particles) override;
+
+    void DispatchSimulation(uint32_t slot, const SimulationStep& step) override;
+
+    void DispatchShadows(uint32_t slot, const uint32_t* dirtyMask) override;
+
+    void CopyShadowsToReadback(uint32_t slot, uint32_t readbackSlot) override;
+
+    void SubmitCompute() override;
+
+    void Draw(uint32_t slot) override;
+
+    void Present() override;
+
+    const float* ReadShadows(uint32_t readbackSlot) override;
+
+    // what the work that ran so far left in a slot
+    const std::vector<Particle>& GetParticles(uint32_t slot) const { return m_Particles[slot]; }
+    const std::vector<float>& GetShadows(uint32_t slot) const { return m_Shadows[slot]; }
+
+    const std::vector<SoftwareDrawCall>& GetDrawCalls() const { return m_DrawCalls; }
+
+    // Draws submitted from now on cull against frustum the way D3D12RenderBackend does before
+    // ExecuteIndirect, through FrustumCuller. nullptr draws every particle again.
+    void SetFrustum(const Frustum* frustum);
+
+    // Times the kernels on the track of the queue that runs them, counted to the frame that
+    // recorded them, the way the D3D12 backend's timestamps are. nullptr stops.
+    void SetProfiler(Profiler* profiler) { m_Profiler = profiler; }
+
+    uint64_t GetHazardCount() const { return m_HazardCount; }
+
+    // the first MaxHazardMessages hazards, e.g. "frame 3: compute writes shadows[1], read by graphics ..."
+    const std::vector<std::string>& GetHazards() const { return m_Hazards; }
+
+    // Receivers an incremental pass left out of its mask although their shadow changed. Every
+    // pass also computes the full result to find them, which the kernel time includes.
+    uint64_t GetStaleShadowCount() const { return m_StaleShadows; }
+
+    // seconds spent running queued work, the frame time minus this is the CPU side of the frame
+    double GetKernelSeconds() const { return m_KernelSeconds; }
+
+    static const uint32_t readbackSlotCount = 3;
+
+    static const size_t MaxHazardMessages = 32;
+
+private:
+    friend class SoftwareQueue;
+
+    enum Agent : uint32_t
+    {
+        Cpu,
+        Compute,
+        Graphics,
+        AgentCount
+    };
+
+    // the newest value of each queue an agent is known to be ordered after
+    using Clock = std::array<uint64_t, AgentCount>;
+
+    struct Resource
+    {
+        std::string name;
+
+        // the queue that last wrote it and the signal value that follows the write, 0 when no
+        // queue did; accesses of the CPU are ordered before anything it submits later
+        uint32_t writer = Cpu;
+        uint64_t writeValue = 0;
+
+        // per queue, the signal value that follows its last read since the write
+        Clock reads = {};
+    };
+
+    // the buffers and upload memory of each slot, and its compute command allocator
+    enum SlotResource
+    {
+        SlotParticles,
+        SlotShadows,
+        SlotStaging,
+        SlotDirtyMask,
+        SlotSimulationConstants,
+        SlotShadowConstants,
+        SlotAllocator,
+        SlotResourceCount
+    };
+
+    Resource& GetSlotResource(uint32_t slot, SlotResource resource) { return m_SlotResources[slot * SlotResourceCount + resource]; }
+
+    // checks an access by agent against the fence waits that order it, then records it
+    void Access(uint32_t agent, Resource& resource, bool write);
+
+    void ReportHazard(const std::string& message);
+
+    // what agent knows about every queue at the point it has recorded up to
+    Clock& GetClock(uint32_t agent);
+
+    const char* GetAgentName(uint32_t agent) const;
+
+    // the clock of queue as of its signal value, or as of now when the value was not signaled yet
+    const Clock& GetSignalClock(const SoftwareQueue& queue, uint64_t value) const;
+
+    // the CPU saw queue complete value
+    void ObserveCompleted(const SoftwareQueue& queue, uint64_t value);
+
+    void Merge(Clock& clock, const Clock& other) const;
+
+    // records work for the compute list, it reaches the queue with SubmitCompute
+    void Record(std::function<void()> work);
+
+    // the kernels, run from the queues
+    void RunSimulation(uint32_t slot);
+    void RunShadows(uint32_t slot);
+
+    uint32_t PreviousSlot(uint32_t slot) const { return (slot + AsyncShadowScheduler::SlotCount - 1) % AsyncShadowScheduler::SlotCount; }
+
+    size_t m_ParticleCount;
+
+    // the light source is left out, as particlesCount of cbCS does
+    size_t m_ReceiverCount;
+    uint32_t m_Latency;
+    ThreadPool* m_Pool;
+
+    ShadowEngine m_Engine;
+
+    SoftwareQueue m_ComputeQueue;
+    SoftwareQueue m_GraphicsQueue;
+
+    // the signal clocks of each queue, indexed by value
+    std::vector<Clock> m_SignalClocks[AgentCount];
+
+    // what each queue knows at the point it has been recorded up to, and what the CPU knows
+    Clock m_Clocks[AgentCount] = {};
+
+    std::vector<Particle> m_Particles[AsyncShadowScheduler::SlotCount];
+    std::vector<float> m_Shadows[AsyncShadowScheduler::SlotCount];
+    std::vector<Particle> m_Staging[AsyncShadowScheduler::SlotCount];
+    std::vector<uint32_t> m_DirtyMask[AsyncShadowScheduler::SlotCount];
+
+    // what the CPU wrote into each slot's constant buffers, read when the dispatch runs
+    SimulationStep m_SimulationStep[AsyncShadowScheduler::SlotCount];
+    bool m_Incremental[AsyncShadowScheduler::SlotCount] = {};
+
+    std::vector<float> m_Readback[readbackSlotCount];
+
+    std::vector<Resource> m_SlotResources;
+    Resource m_ReadbackResources[readbackSlotCount];
+
+    // simulation state only the compute queue touches
+    bool m_Simulating;
+    SimulationSettings m_SimulationSettings;
+    std::vector<ParticleMotion> m_Motion;
+    std::vector<uint32_t> m_DeadList;
+
+    std::vector<float> m_FullShadows;
+
+    uint32_t m_ComputeSlot = 0;
+    std::vector<std::function<void()>> m_ComputeList;
+
+    std::vector<SoftwareDrawCall> m_DrawCalls;
+    uint64_t m_Frame = 0;
+
+    bool m_FrustumCull = false;
+    Frustum m_Frustum;
+    FrustumCuller m_Culler;
+
+    Profiler* m_Profiler = nullptr;
+
+    uint64_t m_HazardCount = 0;
+    std::vector<std::string> m_Hazards;
+    uint64_t m_StaleShadows = 0;
+
+    double m_KernelSeconds = 0.0;
+};
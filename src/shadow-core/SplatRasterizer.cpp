@@ -0,0 +1,523 @@
+#include "SplatRasterizer.h"
+
+#include "Billboard.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+// MSVC accepts any intrinsic in any function, GCC and Clang need the target enabled per function
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // sprites set up per task before binning
+    const size_t SetupBlockSize = 4096;
+
+    struct Float4
+    {
+        float x, y, z, w;
+    };
+
+    // mul(float4(position, w), matrix) with a row vector, as the shaders do
+    Float4 Transform(const XMFLOAT3& position, float w, const XMFLOAT4X4& matrix)
+    {
+        Float4 result;
+        result.x = position.x * matrix.m[0][0] + position.y * matrix.m[1][0] + position.z * matrix.m[2][0] + w * matrix.m[3][0];
+        result.y = position.x * matrix.m[0][1] + position.y * matrix.m[1][1] + position.z * matrix.m[2][1] + w * matrix.m[3][1];
+        result.z = position.x * matrix.m[0][2] + position.y * matrix.m[1][2] + position.z * matrix.m[2][2] + w * matrix.m[3][2];
+        result.w = position.x * matrix.m[0][3] + position.y * matrix.m[1][3] + position.z * matrix.m[2][3] + w * matrix.m[3][3];
+        return result;
+    }
+
+    XMFLOAT3 Normalize(const XMFLOAT3& v)
+    {
+        float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+    }
+
+    XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    uint8_t ToUnorm8(float value)
+    {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint8_t>(value * 255.0f + 0.5f);
+    }
+
+    // Covers the pixels [x, x + count) of row y of the tile whose depth row is depthRow, the first
+    // of them at depthRow[0]. A pixel is covered when its center lies in the sprite's disc and its
+    // depth is in [0, 1] and less than the stored one, which it then replaces. covered[i] is set
+    // to 1 or 0 for every pixel.
+    void CoverRowScalar(const SplatSprite& sprite, int32_t x, int32_t y, int32_t count, float* depthRow, uint8_t* covered)
+    {
+        const float (&toQuad)[3][3] = sprite.toQuad;
+
+        float py = static_cast<float>(y) + 0.5f;
+
+        for (int32_t i = 0; i < count; ++i)
+        {
+            float px = static_cast<float>(x + i) + 0.5f;
+
+            float a = toQuad[0][0] * px + toQuad[0][1] * py + toQuad[0][2];
+            float b = toQuad[1][0] * px + toQuad[1][1] * py + toQuad[1][2];
+            float c = toQuad[2][0] * px + toQuad[2][1] * py + toQuad[2][2];
+
+            float u = a / c;
+            float v = b / c;
+
+            // PSMain discards length(tex - 0.5) > 0.5
+            float du = u - 0.5f;
+            float dv = v - 0.5f;
+            bool inside = du * du + dv * dv <= 0.25f;
+
+            float z = (sprite.depth[0] + u * sprite.depth[1] + v * sprite.depth[2]) / (sprite.clipW[0] + u * sprite.clipW[1] + v * sprite.clipW[2]);
+
+            bool pass = inside && z >= 0.0f && z <= 1.0f && z < depthRow[i];
+            if (pass)
+            {
+                depthRow[i] = z;
+            }
+            covered[i] = pass ? 1 : 0;
+        }
+    }
+
+#if SIMD_X86
+    // CoverRowScalar 8 pixels at a time with the same operations in the same order. Reads and
+    // writes back depthRow up to the next multiple of 8, lanes past count keep their depth.
+    SIMD_TARGET_AVX2 void CoverRowAvx2(const SplatSprite& sprite, int32_t x, int32_t y, int32_t count, float* depthRow, uint8_t* covered)
+    {
+        const float (&toQuad)[3][3] = sprite.toQuad;
+
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        float py = static_cast<float>(y) + 0.5f;
+        const __m256 rowA = _mm256_set1_ps(toQuad[0][1] * py);
+        const __m256 rowB = _mm256_set1_ps(toQuad[1][1] * py);
+        const __m256 rowC = _mm256_set1_ps(toQuad[2][1] * py);
+
+        for (int32_t i = 0; i < count; i += 8)
+        {
+            __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(i), laneOffsets);
+            __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), lanes)), half);
+
+            __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(toQuad[0][0]), px), rowA), _mm256_set1_ps(toQuad[0][2]));
+            __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(toQuad[1][0]), px), rowB), _mm256_set1_ps(toQuad[1][2]));
+            __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(toQuad[2][0]), px), rowC), _mm256_set1_ps(toQuad[2][2]));
+
+            __m256 u = _mm256_div_ps(a, c);
+            __m256 v = _mm256_div_ps(b, c);
+
+            __m256 du = _mm256_sub_ps(u, half);
+            __m256 dv = _mm256_sub_ps(v, half);
+            __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(du, du), _mm256_mul_ps(dv, dv)), quarter, _CMP_LE_OQ);
+
+            __m256 clipZ = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(sprite.depth[0]), _mm256_mul_ps(u, _mm256_set1_ps(sprite.depth[1]))), _mm256_mul_ps(v, _mm256_set1_ps(sprite.depth[2])));
+            __m256 clipW = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(sprite.clipW[0]), _mm256_mul_ps(u, _mm256_set1_ps(sprite.clipW[1]))), _mm256_mul_ps(v, _mm256_set1_ps(sprite.clipW[2])));
+            __m256 z = _mm256_div_ps(clipZ, clipW);
+
+            __m256 stored = _mm256_loadu_ps(depthRow + i);
+
+            __m256 pass = _mm256_and_ps(inside, _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(z, zero, _CMP_GE_OQ), _mm256_cmp_ps(z, one, _CMP_LE_OQ)),
+                _mm256_cmp_ps(z, stored, _CMP_LT_OQ)));
+            pass = _mm256_and_ps(pass, _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), lanes)));
+
+            _mm256_storeu_ps(depthRow + i, _mm256_blendv_ps(stored, z, pass));
+
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(pass));
+            for (int32_t lane = 0; lane < 8 && i + lane < count; ++lane)
+            {
+                covered[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+            }
+        }
+    }
+#endif
+}
+
+SplatCamera SplatCamera::LookTo(const XMFLOAT3& position, const XMFLOAT3& lookDirection, const XMFLOAT3& up,
+    float fovY, float aspectRatio, float nearPlane, float farPlane)
+{
+    // XMMatrixLookToRH: the camera looks down its -z axis
+    XMFLOAT3 axisZ = Normalize(XMFLOAT3(-lookDirection.x, -lookDirection.y, -lookDirection.z));
+    XMFLOAT3 axisX = Normalize(Cross(up, axisZ));
+    XMFLOAT3 axisY = Cross(axisZ, axisX);
+
+    XMFLOAT4X4 view(
+        axisX.x, axisY.x, axisZ.x, 0.0f,
+        axisX.y, axisY.y, axisZ.y, 0.0f,
+        axisX.z, axisY.z, axisZ.z, 0.0f,
+        -Dot(axisX, position), -Dot(axisY, position), -Dot(axisZ, position), 1.0f);
+
+    // XMMatrixPerspectiveFovRH
+    float height = 1.0f / std::tan(0.5f * fovY);
+    float width = height / aspectRatio;
+    float range = farPlane / (nearPlane - farPlane);
+
+    XMFLOAT4X4 projection(
+        width, 0.0f, 0.0f, 0.0f,
+        0.0f, height, 0.0f, 0.0f,
+        0.0f, 0.0f, range, -1.0f,
+        0.0f, 0.0f, range * nearPlane, 0.0f);
+
+    SplatCamera camera;
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += view.m[row][k] * projection.m[k][column];
+            }
+            camera.wvpMat.m[row][column] = sum;
+        }
+    }
+
+    // the view matrix is a rotation and a translation, its inverse has the axes as rows
+    camera.invViewMat = XMFLOAT4X4(
+        axisX.x, axisX.y, axisX.z, 0.0f,
+        axisY.x, axisY.y, axisY.z, 0.0f,
+        axisZ.x, axisZ.y, axisZ.z, 0.0f,
+        position.x, position.y, position.z, 1.0f);
+
+    return camera;
+}
+
+SplatCamera SplatCamera::Demo(float aspectRatio)
+{
+    // Camera::Init and DeviceContext::LoadMatrices
+    return LookTo(XMFLOAT3(0.0f, 0.0f, 1500.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), 0.8f, aspectRatio, 1.0f, 5000.0f);
+}
+
+SplatRasterizer::SplatRasterizer(const SplatSettings& settings)
+    : m_Settings(settings), m_SimdLevel(DetectSimdLevel())
+{
+}
+
+bool SplatRasterizer::SetupSprite(const Particle& particle, float shadow, uint32_t index, const SplatCamera& camera, SplatSprite& sprite, bool& clipped) const
+{
+    clipped = false;
+
+    // clip space of the corners at texcoords (0, 0), (1, 0) and (0, 1), the quad is their parallelogram
+    XMFLOAT3 origin = ExpandBillboard(particle.pos, particle.radius, camera.invViewMat, 0).position;
+    XMFLOAT3 right = ExpandBillboard(particle.pos, particle.radius, camera.invViewMat, 1).position;
+    XMFLOAT3 down = ExpandBillboard(particle.pos, particle.radius, camera.invViewMat, 2).position;
+
+    Float4 clipOrigin = Transform(origin, 1.0f, camera.wvpMat);
+    Float4 clipU = Transform(XMFLOAT3(right.x - origin.x, right.y - origin.y, right.z - origin.z), 0.0f, camera.wvpMat);
+    Float4 clipV = Transform(XMFLOAT3(down.x - origin.x, down.y - origin.y, down.z - origin.z), 0.0f, camera.wvpMat);
+
+    // anything at or behind w = 0 would have to be clipped
+    float cornerW[4] = { clipOrigin.w, clipOrigin.w + clipU.w, clipOrigin.w + clipV.w, clipOrigin.w + clipU.w + clipV.w };
+    for (float w : cornerW)
+    {
+        if (!(w > 0.0f))
+        {
+            clipped = true;
+            return false;
+        }
+    }
+
+    // homogeneous pixel coordinates, (x, y, w) = toPixel * (u, v, 1) with y pointing down
+    double halfWidth = 0.5 * m_Settings.width;
+    double halfHeight = 0.5 * m_Settings.height;
+
+    double toPixel[3][3] =
+    {
+        { halfWidth * (clipU.x + clipU.w), halfWidth * (clipV.x + clipV.w), halfWidth * (clipOrigin.x + clipOrigin.w) },
+        { halfHeight * (clipU.w - clipU.y), halfHeight * (clipV.w - clipV.y), halfHeight * (clipOrigin.w - clipOrigin.y) },
+        { clipU.w, clipV.w, clipOrigin.w },
+    };
+
+    double determinant =
+        toPixel[0][0] * (toPixel[1][1] * toPixel[2][2] - toPixel[1][2] * toPixel[2][1])
+        - toPixel[0][1] * (toPixel[1][0] * toPixel[2][2] - toPixel[1][2] * toPixel[2][0])
+        + toPixel[0][2] * (toPixel[1][0] * toPixel[2][1] - toPixel[1][1] * toPixel[2][0]);
+
+    // a sprite seen edge on covers nothing
+    if (!std::isfinite(determinant) || determinant == 0.0)
+    {
+        return false;
+    }
+
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+        {
+            // the cofactor of the transposed position
+            int r0 = (column + 1) % 3;
+            int r1 = (column + 2) % 3;
+            int c0 = (row + 1) % 3;
+            int c1 = (row + 2) % 3;
+            double cofactor = toPixel[r0][c0] * toPixel[r1][c1] - toPixel[r0][c1] * toPixel[r1][c0];
+            sprite.toQuad[row][column] = static_cast<float>(cofactor / determinant);
+        }
+    }
+
+    sprite.depth[0] = clipOrigin.z;
+    sprite.depth[1] = clipU.z;
+    sprite.depth[2] = clipV.z;
+    sprite.clipW[0] = clipOrigin.w;
+    sprite.clipW[1] = clipU.w;
+    sprite.clipW[2] = clipV.w;
+
+    // the pixels whose centers lie between the outermost corners
+    double minX = HUGE_VAL, minY = HUGE_VAL, maxX = -HUGE_VAL, maxY = -HUGE_VAL;
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        double u = (corner & 1) ? 1.0 : 0.0;
+        double v = (corner & 2) ? 1.0 : 0.0;
+        double w = toPixel[2][0] * u + toPixel[2][1] * v + toPixel[2][2];
+        double x = (toPixel[0][0] * u + toPixel[0][1] * v + toPixel[0][2]) / w;
+        double y = (toPixel[1][0] * u + toPixel[1][1] * v + toPixel[1][2]) / w;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+
+    double width = m_Settings.width;
+    double height = m_Settings.height;
+    sprite.minX = static_cast<int32_t>(std::max(0.0, std::ceil(std::max(-1.0, minX) - 0.5)));
+    sprite.minY = static_cast<int32_t>(std::max(0.0, std::ceil(std::max(-1.0, minY) - 0.5)));
+    sprite.maxX = static_cast<int32_t>(std::min(width, std::floor(std::min(width + 1.0, maxX) - 0.5) + 1.0));
+    sprite.maxY = static_cast<int32_t>(std::min(height, std::floor(std::min(height + 1.0, maxY) - 0.5) + 1.0));
+
+    if (sprite.minX >= sprite.maxX || sprite.minY >= sprite.maxY)
+    {
+        return false;
+    }
+
+    // LoadParticle in VertexShader.hlsl
+    float color[3] =
+    {
+        static_cast<float>(particle.color & 0xFF) / 255.0f,
+        static_cast<float>((particle.color >> 8) & 0xFF) / 255.0f,
+        static_cast<float>((particle.color >> 16) & 0xFF) / 255.0f,
+    };
+    float opacity = particle.opacity;
+
+    if (index == m_Settings.lightSourceIndex)
+    {
+        color[0] = color[1] = color[2] = 1.0f;
+        opacity = 1.0f;
+    }
+
+    // blending reads the pixel shader output clamped to the range of the UNORM target
+    float alpha = std::min(std::max(opacity, 0.0f), 1.0f);
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        float value = std::min(std::max(color[channel] * shadow, 0.0f), 1.0f);
+        sprite.color[channel] = value * alpha;
+    }
+    sprite.opacity = alpha;
+
+    return true;
+}
+
+uint64_t SplatRasterizer::RasterizeTile(uint32_t tile, float* depth, RgbaImage& image) const
+{
+    int32_t tileX = static_cast<int32_t>((tile % m_TilesX) * TileSize);
+    int32_t tileY = static_cast<int32_t>((tile / m_TilesX) * TileSize);
+    int32_t tileMaxX = std::min(tileX + static_cast<int32_t>(TileSize), static_cast<int32_t>(m_Settings.width));
+    int32_t tileMaxY = std::min(tileY + static_cast<int32_t>(TileSize), static_cast<int32_t>(m_Settings.height));
+
+    uint8_t clear[4];
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        clear[channel] = ToUnorm8(m_Settings.clearColor[channel]);
+    }
+
+    for (int32_t y = tileY; y < tileMaxY; ++y)
+    {
+        for (int32_t x = tileX; x < tileMaxX; ++x)
+        {
+            std::copy(clear, clear + 4, image.Pixel(x, y));
+        }
+    }
+    std::fill(depth, depth + DepthScratchSize, 1.0f);
+
+    auto coverRow = CoverRowScalar;
+#if SIMD_X86
+    if (m_SimdLevel != SimdLevel::Scalar)
+    {
+        coverRow = CoverRowAvx2;
+    }
+#endif
+
+    uint64_t shadedPixels = 0;
+    uint8_t covered[TileSize];
+
+    for (uint32_t index : m_Bins[tile])
+    {
+        const SplatSprite& sprite = m_Sprites[index];
+
+        int32_t minX = std::max(sprite.minX, tileX);
+        int32_t maxX = std::min(sprite.maxX, tileMaxX);
+        int32_t minY = std::max(sprite.minY, tileY);
+        int32_t maxY = std::min(sprite.maxY, tileMaxY);
+
+        float inverseAlpha = 1.0f - sprite.opacity;
+        uint8_t alpha = ToUnorm8(sprite.opacity);
+
+        for (int32_t y = minY; y < maxY; ++y)
+        {
+            float* depthRow = depth + (y - tileY) * TileSize + (minX - tileX);
+            coverRow(sprite, minX, y, maxX - minX, depthRow, covered);
+
+            uint8_t* pixel = image.Pixel(minX, y);
+            for (int32_t i = 0; i < maxX - minX; ++i, pixel += 4)
+            {
+                if (!covered[i])
+                {
+                    continue;
+                }
+
+                // SrcAlpha / InvSrcAlpha for color, alpha is written as it comes (One / Zero)
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    pixel[channel] = ToUnorm8(sprite.color[channel] + static_cast<float>(pixel[channel]) / 255.0f * inverseAlpha);
+                }
+                pixel[3] = alpha;
+                ++shadedPixels;
+            }
+        }
+    }
+    return shadedPixels;
+}
+
+SplatStats SplatRasterizer::Render(const Particle* particles, const float* shadows, size_t count, const SplatCamera& camera, RgbaImage& image,
+    ThreadPool* pool, const uint32_t* drawOrder)
+{
+    SplatStats stats;
+
+    image.Resize(m_Settings.width, m_Settings.height);
+
+    m_TilesX = (m_Settings.width + TileSize - 1) / TileSize;
+    m_TilesY = (m_Settings.height + TileSize - 1) / TileSize;
+    size_t tileCount = static_cast<size_t>(m_TilesX) * m_TilesY;
+
+    // per draw position, 0 off screen, 1 drawn, 2 clipped
+    m_Sprites.resize(count);
+    m_Visible.assign(count, 0);
+
+    auto setupBlock = [&](size_t block, size_t)
+        {
+            size_t first = block * SetupBlockSize;
+            size_t last = std::min(first + SetupBlockSize, count);
+            for (size_t drawn = first; drawn < last; ++drawn)
+            {
+                size_t i = drawOrder != nullptr ? drawOrder[drawn] : drawn;
+                bool clipped = false;
+                float shadow = shadows != nullptr ? shadows[i] : 1.0f;
+                if (SetupSprite(particles[i], shadow, static_cast<uint32_t>(i), camera, m_Sprites[drawn], clipped))
+                {
+                    m_Visible[drawn] = 1;
+                }
+                else if (clipped)
+                {
+                    m_Visible[drawn] = 2;
+                }
+            }
+        };
+
+    size_t blockCount = (count + SetupBlockSize - 1) / SetupBlockSize;
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(blockCount, setupBlock);
+    }
+    else
+    {
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            setupBlock(block, 0);
+        }
+    }
+
+    // binned in draw order, so every tile draws its sprites in the order of the draw call
+    m_Bins.resize(tileCount);
+    for (std::vector<uint32_t>& bin : m_Bins)
+    {
+        bin.clear();
+    }
+
+    for (size_t drawn = 0; drawn < count; ++drawn)
+    {
+        if (m_Visible[drawn] == 2)
+        {
+            ++stats.clippedSprites;
+        }
+        if (m_Visible[drawn] != 1)
+        {
+            continue;
+        }
+
+        const SplatSprite& sprite = m_Sprites[drawn];
+        for (uint32_t tileY = sprite.minY / TileSize; tileY <= (sprite.maxY - 1) / TileSize; ++tileY)
+        {
+            for (uint32_t tileX = sprite.minX / TileSize; tileX <= (sprite.maxX - 1) / TileSize; ++tileX)
+            {
+                m_Bins[tileY * m_TilesX + tileX].push_back(static_cast<uint32_t>(drawn));
+                ++stats.binnedSprites;
+            }
+        }
+        ++stats.drawnSprites;
+    }
+
+    size_t workerCount = pool != nullptr ? pool->GetWorkerCount() : 1;
+    m_DepthScratch.resize(std::max(workerCount, m_DepthScratch.size()));
+    for (std::vector<float>& scratch : m_DepthScratch)
+    {
+        scratch.resize(DepthScratchSize);
+    }
+
+    std::vector<uint64_t> shadedPixels(tileCount);
+    auto rasterizeTile = [&](size_t tile, size_t worker)
+        {
+            shadedPixels[tile] = RasterizeTile(static_cast<uint32_t>(tile), m_DepthScratch[worker].data(), image);
+        };
+
+    // tiles under the dense middle of the scene cost far more than the rest, stealing evens that out
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(tileCount, rasterizeTile);
+    }
+    else
+    {
+        for (size_t tile = 0; tile < tileCount; ++tile)
+        {
+            rasterizeTile(tile, 0);
+        }
+    }
+
+    for (uint64_t pixels : shadedPixels)
+    {
+        stats.shadedPixels += pixels;
+    }
+    return stats;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "MathTypes.h"
+#include "Particle.hpp"
+#include "RgbaImage.h"
+#include "SimdShadowKernel.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The two matrices of cbPerObject the sprites are drawn with, row major like the constant buffer.
+struct SplatCamera
+{
+    DirectX::XMFLOAT4X4 wvpMat;
+    DirectX::XMFLOAT4X4 invViewMat;
+
+    // What DeviceContext::LoadMatrices stores for Camera: XMMatrixLookToRH(position, lookDirection,
+    // up) times XMMatrixPerspectiveFovRH(fovY, aspectRatio, nearPlane, farPlane), and the inverse
+    // of the view matrix, written out so no DirectXMath functions are needed.
+    static SplatCamera LookTo(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& lookDirection, const DirectX::XMFLOAT3& up,
+        float fovY, float aspectRatio, float nearPlane, float farPlane);
+
+    // the camera the demo starts with, at (0, 0, 1500) looking down -z
+    static SplatCamera Demo(float aspectRatio);
+};
+
+struct SplatSettings
+{
+    uint32_t width = 800;
+    uint32_t height = 600;
+
+    // the clear color of D3D12RenderBackend::Draw
+    float clearColor[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
+
+    // drawn white and opaque the way LoadParticle in VertexShader.hlsl draws the light source,
+    // UINT32_MAX for none
+    uint32_t lightSourceIndex = UINT32_MAX;
+};
+
+struct SplatStats
+{
+    uint64_t drawnSprites = 0;      // sprites with at least one pixel on screen
+    uint64_t binnedSprites = 0;     // sprite and tile pairs, every sprite counted once per tile it touches
+    uint64_t shadedPixels = 0;      // pixels inside a disc that passed the depth test
+    uint64_t clippedSprites = 0;    // sprites with a corner behind the camera, which are skipped
+};
+
+// What SplatRasterizer needs of one sprite, in pixel space.
+struct SplatSprite
+{
+    // maps (x, y, 1) at a pixel center to (u, v, 1) of the quad up to a common factor, rows give u, v and the factor
+    float toQuad[3][3];
+
+    // clip space z and w are linear in the texcoords: z = depth[0] + u * depth[1] + v * depth[2]
+    float depth[3];
+    float clipW[3];
+
+    // PSMain's color * shadow, premultiplied by opacity, and the opacity
+    float color[3];
+    float opacity;
+
+    // pixel bounds, min inclusive and max exclusive, clamped to the screen
+    int32_t minX, minY, maxX, maxY;
+};
+
+// CPU version of the sprite draw: GSMain (or VSSpriteMain) expands every particle into a camera
+// facing quad with ExpandBillboard, PSMain discards what lies outside the inscribed disc and
+// writes color * shadow with opacity as alpha, blended SrcAlpha / InvSrcAlpha into an RGBA8
+// target over a LESS depth test with depth writes, as the pipeline state of the demo sets up.
+//
+// The screen is split into tiles of TileSize pixels. Sprites are set up and binned into the tiles
+// they overlap in draw order, then tiles are rasterized independently, on the pool when one is
+// given, each with a depth buffer of its own. Inside a tile a sprite meets the pixels in draw
+// order, so the image does not depend on the thread count or the instruction set: the coverage and
+// depth of 8 pixels a row at a time (AVX2) use the same float operations as the scalar path.
+//
+// Quads are sampled at pixel centers through the inverse of their projective map, which is what
+// perspective correct interpolation over the two triangles of the strip comes down to. Sprites
+// that reach behind the camera would have to be clipped, they are left out.
+class SplatRasterizer
+{
+public:
+    static const uint32_t TileSize = 32;
+
+    explicit SplatRasterizer(const SplatSettings& settings);
+
+    // shadows may be nullptr, every particle is then unshadowed. drawOrder, when given, holds the
+    // count particle indices that are drawn, in order, e.g. from DepthSorter or FrustumCuller,
+    // otherwise the first count particles are drawn in index order like a draw without a sort.
+    SplatStats Render(const Particle* particles, const float* shadows, size_t count, const SplatCamera& camera, RgbaImage& image,
+        ThreadPool* pool = nullptr, const uint32_t* drawOrder = nullptr);
+
+    // overrides the detected instruction set, e.g. to compare the code paths on one machine
+    void SetSimdLevel(SimdLevel level) { m_SimdLevel = level; }
+
+    SimdLevel GetSimdLevel() const { return m_SimdLevel; }
+
+    const SplatSettings& GetSettings() const { return m_Settings; }
+
+private:
+    // false when the sprite covers no pixel center or has to be clipped, which sets clipped
+    bool SetupSprite(const Particle& particle, float shadow, uint32_t index, const SplatCamera& camera, SplatSprite& sprite, bool& clipped) const;
+
+    // draws the sprites binned into tile straight into its pixels of image, depth is scratch of
+    // DepthScratchSize floats; returns the shaded pixels
+    uint64_t RasterizeTile(uint32_t tile, float* depth, RgbaImage& image) const;
+
+    // a tile of depth plus room for a full vector read past the last row
+    static const size_t DepthScratchSize = TileSize * TileSize + 8;
+
+    SplatSettings m_Settings;
+    SimdLevel m_SimdLevel;
+
+    uint32_t m_TilesX = 0;
+    uint32_t m_TilesY = 0;
+
+    // per draw position
+    std::vector<SplatSprite> m_Sprites;
+    std::vector<uint8_t> m_Visible;
+
+    // the draw positions of the sprites of every tile, in draw order
+    std::vector<std::vector<uint32_t>> m_Bins;
+
+    std::vector<std::vector<float>> m_DepthScratch;
+};
@@ -0,0 +1,277 @@
+#include "StreamingBaker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    struct InputSections
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* radius;
+        const float* opacity;
+    };
+
+    InputSections GetSections(const SnapshotReader& input)
+    {
+        InputSections sections;
+        sections.x = input.GetSection(SnapshotSection::PositionX);
+        sections.y = input.GetSection(SnapshotSection::PositionY);
+        sections.z = input.GetSection(SnapshotSection::PositionZ);
+        sections.radius = input.GetSection(SnapshotSection::Radius);
+        sections.opacity = input.GetSection(SnapshotSection::Opacity);
+        return sections;
+    }
+
+    DirectX::XMFLOAT3 PositionAt(const InputSections& sections, uint64_t i)
+    {
+        return DirectX::XMFLOAT3(sections.x[i], sections.y[i], sections.z[i]);
+    }
+}
+
+StreamingShadowBaker::StreamingShadowBaker(const StreamingBakeSettings& settings) : m_Settings(settings)
+{
+}
+
+bool StreamingShadowBaker::Bake(const SnapshotReader& input, const char* outputPath, ThreadPool* pool, StreamingBakeStats& stats, std::string& error)
+{
+    stats = StreamingBakeStats();
+
+    InputSections sections = GetSections(input);
+    if (sections.x == nullptr || sections.y == nullptr || sections.z == nullptr || sections.radius == nullptr || sections.opacity == nullptr)
+    {
+        error = "the input needs position, radius and opacity sections";
+        return false;
+    }
+
+    DirectX::XMFLOAT3 sunDir = input.GetSunDir();
+    if (!SunBasis::IsValidDirection(sunDir))
+    {
+        error = "the input has no valid sun direction, the depth order is undefined";
+        return false;
+    }
+
+    SunBasis basis = SunBasis::FromDirection(sunDir);
+    uint64_t count = input.GetCount();
+
+    Bounds bounds;
+    if (!Scan(input, basis, bounds, error))
+    {
+        return false;
+    }
+
+    // the grid reaches one cell past the receivers on every side, so bilinear samples never clamp
+    float cellSize = m_Settings.cellSize > 0.0f ? m_Settings.cellSize : 0.5f * bounds.maxRadius;
+    if (!(cellSize > 0.0f))
+    {
+        // point-sized particles, nothing reaches further than its own centre
+        float extent = std::max(bounds.maxY - bounds.minY, bounds.maxZ - bounds.minZ);
+        cellSize = extent > 0.0f ? extent / 1024.0f : 1.0f;
+    }
+
+    while (true)
+    {
+        double cellsY = std::floor((bounds.maxY - bounds.minY) / cellSize) + 3.0;
+        double cellsZ = std::floor((bounds.maxZ - bounds.minZ) / cellSize) + 3.0;
+        if (cellsY * cellsZ <= static_cast<double>(std::max<uint64_t>(m_Settings.maxCells, 9)))
+        {
+            m_CellsY = static_cast<uint32_t>(cellsY);
+            m_CellsZ = static_cast<uint32_t>(cellsZ);
+            break;
+        }
+        cellSize *= 2.0f;
+    }
+
+    m_CellSize = cellSize;
+    m_OriginY = bounds.minY - cellSize;
+    m_OriginZ = bounds.minZ - cellSize;
+    m_Transmittance.assign(static_cast<size_t>(m_CellsY) * m_CellsZ, 1.0f);
+
+    stats.cellSize = m_CellSize;
+    stats.cellsY = m_CellsY;
+    stats.cellsZ = m_CellsZ;
+
+    SnapshotStreamWriter output;
+    if (!output.Open(outputPath, count, sunDir, SnapshotSection::Shadow, error))
+    {
+        return false;
+    }
+
+    ShadowEngine engine(basis);
+
+    std::vector<Particle> slab;
+    std::vector<DirectX::XMFLOAT3> sunBasisPositions;
+    std::vector<float> shadows;
+
+    for (uint64_t first = 0; first < count;)
+    {
+        uint64_t last = FindSlabEnd(input, basis, first);
+        size_t slabCount = static_cast<size_t>(last - first);
+
+        slab.resize(slabCount);
+        sunBasisPositions.resize(slabCount);
+        for (size_t i = 0; i < slabCount; ++i)
+        {
+            slab[i].pos = PositionAt(sections, first + i);
+            slab[i].radius = sections.radius[first + i];
+            slab[i].opacity = sections.opacity[first + i];
+            sunBasisPositions[i] = basis.Project(slab[i].pos);
+        }
+
+        // exact within the slab, then everything upstream through the grid
+        ShadowStats slabStats = engine.ComputeGrid(slab, shadows, pool);
+        SampleTransmittance(sunBasisPositions, shadows);
+
+        if (!output.Append(shadows.data(), shadows.size()))
+        {
+            output.Close(error);
+            return false;
+        }
+
+        // the slab only starts shading receivers once it is upstream of them
+        stats.cellsSplatted += SplatSlab(sunBasisPositions, slab, bounds.maxRadius);
+
+        stats.slabs++;
+        stats.largestSlab = std::max<uint64_t>(stats.largestSlab, slabCount);
+        stats.pairsTested += slabStats.pairsTested;
+        stats.occluderHits += slabStats.occluderHits;
+
+        size_t memory = engine.GetMemoryUsage()
+            + slab.capacity() * sizeof(Particle)
+            + sunBasisPositions.capacity() * sizeof(DirectX::XMFLOAT3)
+            + shadows.capacity() * sizeof(float)
+            + m_Transmittance.capacity() * sizeof(float);
+        stats.memoryBytes = std::max(stats.memoryBytes, memory);
+
+        first = last;
+    }
+
+    stats.particles = count;
+
+    return output.Close(error);
+}
+
+bool StreamingShadowBaker::Scan(const SnapshotReader& input, const SunBasis& basis, Bounds& bounds, std::string& error) const
+{
+    InputSections sections = GetSections(input);
+    uint64_t count = input.GetCount();
+
+    bounds = Bounds{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    float previousDepth = INFINITY;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        DirectX::XMFLOAT3 sunBasisPos = basis.Project(PositionAt(sections, i));
+
+        // the cell size search of Bake never ends on a non-finite extent
+        if (!std::isfinite(sunBasisPos.x) || !std::isfinite(sunBasisPos.y) || !std::isfinite(sunBasisPos.z) || !std::isfinite(sections.radius[i]))
+        {
+            error = "particle " + std::to_string(i) + " has an infinite or NaN position or radius";
+            return false;
+        }
+
+        if (sunBasisPos.x > previousDepth)
+        {
+            error = "particle " + std::to_string(i) + " is nearer to the sun than the one before it, the input must be sorted from the nearest to the farthest";
+            return false;
+        }
+        previousDepth = sunBasisPos.x;
+
+        if (i == 0)
+        {
+            bounds.minY = bounds.maxY = sunBasisPos.y;
+            bounds.minZ = bounds.maxZ = sunBasisPos.z;
+        }
+
+        bounds.minY = std::min(bounds.minY, sunBasisPos.y);
+        bounds.minZ = std::min(bounds.minZ, sunBasisPos.z);
+        bounds.maxY = std::max(bounds.maxY, sunBasisPos.y);
+        bounds.maxZ = std::max(bounds.maxZ, sunBasisPos.z);
+        bounds.maxRadius = std::max(bounds.maxRadius, sections.radius[i]);
+    }
+
+    if (!std::isfinite(bounds.maxY - bounds.minY) || !std::isfinite(bounds.maxZ - bounds.minZ))
+    {
+        error = "the particles spread further than a float can measure";
+        return false;
+    }
+    return true;
+}
+
+uint64_t StreamingShadowBaker::FindSlabEnd(const SnapshotReader& input, const SunBasis& basis, uint64_t first) const
+{
+    InputSections sections = GetSections(input);
+    uint64_t count = input.GetCount();
+
+    uint64_t last = std::min(first + std::max<uint64_t>(m_Settings.slabSize, 1), count);
+
+    // particles at equal depth occlude each other (dirToOther.x >= 0 both ways), keep them together
+    float lastDepth = SunBasis::Dot(PositionAt(sections, last - 1), basis.sunDir);
+    while (last < count && SunBasis::Dot(PositionAt(sections, last), basis.sunDir) == lastDepth)
+    {
+        ++last;
+    }
+    return last;
+}
+
+void StreamingShadowBaker::SampleTransmittance(const std::vector<DirectX::XMFLOAT3>& sunBasisPositions, std::vector<float>& shadows) const
+{
+    for (size_t i = 0; i < sunBasisPositions.size(); ++i)
+    {
+        float u = (sunBasisPositions[i].y - m_OriginY) / m_CellSize - 0.5f;
+        float v = (sunBasisPositions[i].z - m_OriginZ) / m_CellSize - 0.5f;
+
+        float y0 = std::min(std::max(std::floor(u), 0.0f), static_cast<float>(m_CellsY - 2));
+        float z0 = std::min(std::max(std::floor(v), 0.0f), static_cast<float>(m_CellsZ - 2));
+        float ty = std::min(std::max(u - y0, 0.0f), 1.0f);
+        float tz = std::min(std::max(v - z0, 0.0f), 1.0f);
+
+        const float* row0 = &m_Transmittance[static_cast<size_t>(y0) * m_CellsZ + static_cast<size_t>(z0)];
+        const float* row1 = row0 + m_CellsZ;
+
+        float t0 = row0[0] + (row0[1] - row0[0]) * tz;
+        float t1 = row1[0] + (row1[1] - row1[0]) * tz;
+
+        shadows[i] *= t0 + (t1 - t0) * ty;
+    }
+}
+
+uint64_t StreamingShadowBaker::SplatSlab(const std::vector<DirectX::XMFLOAT3>& sunBasisPositions, const std::vector<Particle>& slab, float maxRadius)
+{
+    uint64_t cellsSplatted = 0;
+
+    for (size_t i = 0; i < slab.size(); ++i)
+    {
+        float y = sunBasisPositions[i].y;
+        float z = sunBasisPositions[i].z;
+
+        // the cells whose centre a receiver of any radius could occupy while touching this occluder
+        float reach = slab[i].radius + maxRadius;
+        float transmittance = 1.0f - slab[i].opacity;
+
+        int firstY = std::max(static_cast<int>(std::ceil((y - reach - m_OriginY) / m_CellSize - 0.5f)), 0);
+        int lastY = std::min(static_cast<int>(std::floor((y + reach - m_OriginY) / m_CellSize - 0.5f)), static_cast<int>(m_CellsY) - 1);
+        int firstZ = std::max(static_cast<int>(std::ceil((z - reach - m_OriginZ) / m_CellSize - 0.5f)), 0);
+        int lastZ = std::min(static_cast<int>(std::floor((z + reach - m_OriginZ) / m_CellSize - 0.5f)), static_cast<int>(m_CellsZ) - 1);
+
+        for (int cellY = firstY; cellY <= lastY; ++cellY)
+        {
+            float dy = m_OriginY + (static_cast<float>(cellY) + 0.5f) * m_CellSize - y;
+            float* row = &m_Transmittance[static_cast<size_t>(cellY) * m_CellsZ];
+
+            for (int cellZ = firstZ; cellZ <= lastZ; ++cellZ)
+            {
+                float dz = m_OriginZ + (static_cast<float>(cellZ) + 0.5f) * m_CellSize - z;
+
+                if (std::sqrt(dy * dy + dz * dz) <= reach)
+                {
+                    row[cellZ] *= transmittance;
+                    ++cellsSplatted;
+                }
+            }
+        }
+    }
+    return cellsSplatted;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "ShadowEngine.h"
+#include "ShadowSnapshot.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StreamingBakeSettings
+{
+    // particles shaded together, a slab is extended so equal depths never straddle two slabs
+    uint64_t slabSize = 1 << 20;
+
+    // width of a transmittance cell in the yz plane, <= 0 picks half the largest radius
+    float cellSize = 0.0f;
+
+    // upper bound on the transmittance cells, cellSize grows until the grid fits
+    uint64_t maxCells = 1 << 24;
+};
+
+struct StreamingBakeStats
+{
+    uint64_t particles = 0;
+    uint64_t slabs = 0;
+    uint64_t largestSlab = 0;
+    uint64_t pairsTested = 0;    // exact tests inside the slabs
+    uint64_t occluderHits = 0;   // exact hits inside the slabs
+    uint64_t cellsSplatted = 0;  // transmittance cells updated by retired slabs
+    float cellSize = 0.0f;       // after the maxCells clamp
+    uint32_t cellsY = 0;
+    uint32_t cellsZ = 0;
+    size_t memoryBytes = 0;      // peak working memory, the mapped input not included
+};
+
+// Out-of-core version of the sun basis shadow pass for particle sets larger than memory.
+//
+// The input snapshot holds positions, radii and opacities sorted from the nearest to the sun to
+// the farthest (non-increasing depth along the header's sunDir). It is swept in that order, one
+// slab of consecutive particles at a time, which is the order light travels through the set:
+// every occluder of a receiver (dirToOther.x >= 0) is in the receiver's slab or upstream of it.
+//
+// - inside a slab the shadows are exact, ShadowEngine::ComputeGrid shades the slab on its own
+// - upstream slabs are folded into a transmittance grid over the yz plane of the sun basis, the
+//   product of (1 - opacity) of the occluders reaching each cell centre, and receivers sample
+//   it bilinearly
+//
+// A retired occluder reaches a cell when the cell centre is within its radius plus the largest
+// radius of the set, so the grid matches Compute up to the cell size when all radii are equal
+// and over-shadows smaller receivers otherwise. Memory is one slab plus the grid, whatever the
+// particle count; shadows are appended to the output as each slab finishes.
+class StreamingShadowBaker
+{
+public:
+    explicit StreamingShadowBaker(const StreamingBakeSettings& settings = StreamingBakeSettings());
+
+    // Writes a single shadow section in the input's particle order to outputPath. Nothing is
+    // written when the input lacks a section or is not sorted.
+    bool Bake(const SnapshotReader& input, const char* outputPath, ThreadPool* pool, StreamingBakeStats& stats, std::string& error);
+
+private:
+    struct Bounds
+    {
+        float minY;
+        float minZ;
+        float maxY;
+        float maxZ;
+        float maxRadius;
+    };
+
+    // checks the depth order and measures the yz extent and the largest radius
+    bool Scan(const SnapshotReader& input, const SunBasis& basis, Bounds& bounds, std::string& error) const;
+
+    // end of the slab starting at first, moved past any particles sharing the last depth
+    uint64_t FindSlabEnd(const SnapshotReader& input, const SunBasis& basis, uint64_t first) const;
+
+    void SampleTransmittance(const std::vector<DirectX::XMFLOAT3>& sunBasisPositions, std::vector<float>& shadows) const;
+
+    uint64_t SplatSlab(const std::vector<DirectX::XMFLOAT3>& sunBasisPositions, const std::vector<Particle>& slab, float maxRadius);
+
+    StreamingBakeSettings m_Settings;
+
+    // transmittance at cell centres, cell (y, z) is centred on m_OriginY + (y + 0.5) * m_CellSize
+    std::vector<float> m_Transmittance;
+    float m_OriginY = 0.0f;
+    float m_OriginZ = 0.0f;
+    float m_CellSize = 1.0f;
+    uint32_t m_CellsY = 0;
+    uint32_t m_CellsZ = 0;
+};
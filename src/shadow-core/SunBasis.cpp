@@ -0,0 +1,38 @@
+#include "SunBasis.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+SunBasis SunBasis::FromDirection(const XMFLOAT3& direction)
+{
+    XMFLOAT3 n(0.0f, 0.0f, 1.0f);
+    if (IsValidDirection(direction))
+    {
+        // down to the largest component first, the squares of very small or large ones would
+        // round to zero or overflow
+        float scale = std::max({ std::fabs(direction.x), std::fabs(direction.y), std::fabs(direction.z) });
+        XMFLOAT3 scaled(direction.x / scale, direction.y / scale, direction.z / scale);
+
+        float length = std::sqrt(Dot(scaled, scaled));
+        n = XMFLOAT3(scaled.x / length, scaled.y / length, scaled.z / length);
+    }
+
+    // copysign keeps -0 on the negative side, so n = (0, 0, -1) does not divide by zero
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+
+    SunBasis basis;
+    basis.sunDir = n;
+    basis.up = XMFLOAT3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    basis.forward = XMFLOAT3(b, sign + n.y * n.y * a, -n.y);
+    return basis;
+}
+
+bool SunBasis::IsValidDirection(const XMFLOAT3& direction)
+{
+    bool finite = std::isfinite(direction.x) && std::isfinite(direction.y) && std::isfinite(direction.z);
+    return finite && (direction.x != 0.0f || direction.y != 0.0f || direction.z != 0.0f);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "MathTypes.h"
+
+// Basis with sunDir as the first axis. A position projected onto it has its depth along the
+// light in x and its place in the light-perpendicular plane in yz (see README-updates.md).
+struct SunBasis
+{
+    DirectX::XMFLOAT3 sunDir;
+    DirectX::XMFLOAT3 up;
+    DirectX::XMFLOAT3 forward;
+
+    // Orthonormal basis around any valid direction, which gets normalized. up and forward
+    // come from the branchless construction of Duff et al. (2017), a fixed version of
+    // Frisvad's (2012). They vary continuously with sunDir except across the sunDir.z = 0 plane.
+    // This is the basis ComputeShader_SunBasis.hlsl receives in cbCS. An invalid direction has
+    // no basis and gets the one of (0, 0, 1) rather than NaNs, directions that come from input
+    // have to be checked with IsValidDirection first.
+    static SunBasis FromDirection(const DirectX::XMFLOAT3& direction);
+
+    // false for a zero, infinite or NaN direction
+    static bool IsValidDirection(const DirectX::XMFLOAT3& direction);
+
+    DirectX::XMFLOAT3 Project(const DirectX::XMFLOAT3& position) const
+    {
+        return DirectX::XMFLOAT3(
+            Dot(position, sunDir),
+            Dot(position, up),
+            Dot(position, forward));
+    }
+
+    static float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    static DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+    {
+        return DirectX::XMFLOAT3(
+            a.y * b.z - a.z * b.y,
+            a.z * b.x - a.x * b.z,
+            a.x * b.y - a.y * b.x);
+    }
+};
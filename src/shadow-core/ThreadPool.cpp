@@ -0,0 +1,190 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // the pool a worker thread belongs to, to recognize nested ParallelFor calls
+    thread_local const ThreadPool* t_Pool = nullptr;
+    thread_local size_t t_WorkerIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+    workerCount = std::max<size_t>(workerCount, 1);
+
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        m_Workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_JobMutex);
+        m_Stopping = true;
+    }
+    m_JobAvailable.notify_all();
+
+    for (auto& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t taskCount, const Task& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    Job job;
+    job.task = &task;
+    job.tasksRemaining = taskCount;
+
+    // nested in a task of this pool
+    if (t_Pool == this)
+    {
+        for (size_t i = 0; i < taskCount; ++i)
+        {
+            RunTask(t_WorkerIndex, { &job, i }, false);
+        }
+        return;
+    }
+
+    size_t workerCount = m_Workers.size();
+    size_t tasksPerWorker = (taskCount + workerCount - 1) / workerCount;
+
+    for (size_t w = 0; w < workerCount; ++w)
+    {
+        size_t first = std::min(w * tasksPerWorker, taskCount);
+        size_t last = std::min(first + tasksPerWorker, taskCount);
+
+        std::lock_guard<std::mutex> lock(m_Workers[w]->mutex);
+        for (size_t i = first; i < last; ++i)
+        {
+            m_Workers[w]->tasks.push_back({ &job, i });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_JobMutex);
+        m_TasksQueued += static_cast<ptrdiff_t>(taskCount);
+    }
+    m_JobAvailable.notify_all();
+
+    // a worker is done with the job once it counted its last task down, the job may go then
+    std::unique_lock<std::mutex> lock(m_JobMutex);
+    m_JobDone.wait(lock, [&job] { return job.tasksRemaining == 0; });
+}
+
+std::vector<WorkerStats> ThreadPool::GetStats() const
+{
+    std::vector<WorkerStats> stats;
+    stats.reserve(m_Workers.size());
+
+    for (const auto& worker : m_Workers)
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        stats.push_back(worker->stats);
+    }
+    return stats;
+}
+
+void ThreadPool::ResetStats()
+{
+    for (auto& worker : m_Workers)
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stats = {};
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t workerIndex)
+{
+    t_Pool = this;
+    t_WorkerIndex = workerIndex;
+
+    while (true)
+    {
+        // tasks of any call, several may be running at once
+        QueuedTask task;
+        bool stolen;
+        if (PopTask(workerIndex, task, stolen))
+        {
+            RunTask(workerIndex, task, stolen);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_JobMutex);
+        m_JobAvailable.wait(lock, [this] { return m_Stopping || m_TasksQueued > 0; });
+
+        if (m_Stopping)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::RunTask(size_t workerIndex, const QueuedTask& task, bool stolen)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    (*task.job->task)(task.taskIndex, workerIndex);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    {
+        Worker& worker = *m_Workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        ++worker.stats.tasksExecuted;
+        worker.stats.tasksStolen += stolen ? 1 : 0;
+        worker.stats.busySeconds += elapsed;
+    }
+
+    // the caller may return and destroy the job right after this, it is not touched again
+    if (--task.job->tasksRemaining == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_JobMutex);
+        m_JobDone.notify_all();
+    }
+}
+
+bool ThreadPool::PopTask(size_t workerIndex, QueuedTask& task, bool& stolen)
+{
+    {
+        Worker& own = *m_Workers[workerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            --m_TasksQueued;
+            stolen = false;
+            return true;
+        }
+    }
+
+    size_t workerCount = m_Workers.size();
+    for (size_t offset = 1; offset < workerCount; ++offset)
+    {
+        Worker& victim = *m_Workers[(workerIndex + offset) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --m_TasksQueued;
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
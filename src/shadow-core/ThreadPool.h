@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerStats
+{
+    uint64_t tasksExecuted = 0;
+    uint64_t tasksStolen = 0;
+    double busySeconds = 0.0;
+};
+
+// Fixed set of worker threads, each with its own task deque. A worker drains its deque from
+// the back and, once it is empty, steals from the front of the other workers' deques.
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t taskIndex, size_t workerIndex)>;
+
+    explicit ThreadPool(size_t workerCount = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    // Runs task(i, worker) for every i in [0, taskCount) and returns once all of them finished.
+    // Tasks are dealt out to the workers in contiguous runs so neighbouring tiles stay together.
+    // Several threads may call it at once, every call only waits for its own tasks. Called from a
+    // task of this pool it runs the nested tasks in order on the calling worker: the other workers
+    // may all be busy with the outer call, waiting for them could block forever.
+    void ParallelFor(size_t taskCount, const Task& task);
+
+    size_t GetWorkerCount() const { return m_Workers.size(); }
+
+    // Counters accumulated since the last ResetStats, one entry per worker.
+    std::vector<WorkerStats> GetStats() const;
+
+    void ResetStats();
+
+private:
+    // one ParallelFor call, on the caller's stack until its last task finished
+    struct Job
+    {
+        const Task* task;
+        std::atomic<size_t> tasksRemaining;
+    };
+
+    struct QueuedTask
+    {
+        Job* job;
+        size_t taskIndex;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+        WorkerStats stats;
+    };
+
+    void WorkerLoop(size_t workerIndex);
+
+    bool PopTask(size_t workerIndex, QueuedTask& task, bool& stolen);
+
+    void RunTask(size_t workerIndex, const QueuedTask& task, bool stolen);
+
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_JobMutex;
+    std::condition_variable m_JobAvailable;
+    std::condition_variable m_JobDone;
+
+    // tasks in the deques, below zero for a moment when a worker pops a task before the call
+    // that queued it has counted it
+    std::atomic<ptrdiff_t> m_TasksQueued{ 0 };
+    bool m_Stopping = false;
+};
@@ -0,0 +1,99 @@
+#include "YzHashIndex.h"
+
+#include <algorithm>
+
+namespace
+{
+    // order inside a cell does not matter
+    bool RemoveEntry(std::vector<uint32_t>& entries, uint32_t index)
+    {
+        auto entry = std::find(entries.begin(), entries.end(), index);
+        if (entry == entries.end())
+        {
+            return false;
+        }
+
+        *entry = entries.back();
+        entries.pop_back();
+        return true;
+    }
+
+    float ValidCellSize(float cellSize)
+    {
+        return cellSize > 0.0f && std::isfinite(cellSize) ? cellSize : 1.0f;
+    }
+}
+
+YzHashIndex::YzHashIndex(float cellSize) : m_CellSize(ValidCellSize(cellSize))
+{
+}
+
+void YzHashIndex::Clear(float cellSize)
+{
+    m_CellSize = ValidCellSize(cellSize);
+    m_Cells.clear();
+    m_Unplaced.clear();
+}
+
+void YzHashIndex::Insert(uint32_t index, float y, float z)
+{
+    float cellY = CellCoordinate(y);
+    float cellZ = CellCoordinate(z);
+    if (!IsPlaced(cellY, cellZ))
+    {
+        m_Unplaced.push_back(index);
+        return;
+    }
+
+    m_Cells[Key(cellY, cellZ)].push_back(index);
+}
+
+void YzHashIndex::Remove(uint32_t index, float y, float z)
+{
+    float cellY = CellCoordinate(y);
+    float cellZ = CellCoordinate(z);
+    if (!IsPlaced(cellY, cellZ))
+    {
+        RemoveEntry(m_Unplaced, index);
+        return;
+    }
+
+    auto cell = m_Cells.find(Key(cellY, cellZ));
+    if (cell == m_Cells.end())
+    {
+        return;
+    }
+
+    std::vector<uint32_t>& entries = cell->second;
+    if (!RemoveEntry(entries, index))
+    {
+        return;
+    }
+
+    if (entries.empty())
+    {
+        m_Cells.erase(cell);
+    }
+}
+
+void YzHashIndex::Move(uint32_t index, float oldY, float oldZ, float newY, float newZ)
+{
+    if (CellCoordinate(oldY) == CellCoordinate(newY) && CellCoordinate(oldZ) == CellCoordinate(newZ))
+    {
+        return;
+    }
+
+    Remove(index, oldY, oldZ);
+    Insert(index, newY, newZ);
+}
+
+size_t YzHashIndex::GetMemoryUsage() const
+{
+    size_t bytes = m_Cells.bucket_count() * sizeof(void*) + m_Unplaced.capacity() * sizeof(uint32_t);
+
+    for (const auto& cell : m_Cells)
+    {
+        bytes += sizeof(cell) + 2 * sizeof(void*) + cell.second.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Persistent spatial hash over the yz plane of the sun basis. Unlike ShadowGrid it is not
+// rebuilt per pass: particles are inserted, moved and removed one at a time, so a frame where a
+// few particles changed only touches their cells. The cell size only affects speed, a query
+// with any reach visits every cell the reach overlaps.
+//
+// Cell coordinates are clamped to +-2^30, so far away entries share the border cells, and an
+// entry with a NaN coordinate is kept apart and handed to every query. A query that overlaps
+// more cells than are occupied walks the occupied ones instead.
+class YzHashIndex
+{
+public:
+    explicit YzHashIndex(float cellSize = 1.0f);
+
+    // drops every entry and sets a new cell size
+    void Clear(float cellSize);
+
+    void Insert(uint32_t index, float y, float z);
+
+    void Remove(uint32_t index, float y, float z);
+
+    // same as Remove at the old place and Insert at the new one, a no-op within one cell
+    void Move(uint32_t index, float oldY, float oldZ, float newY, float newZ);
+
+    // Calls visit(index) for every entry in the cells overlapping the square of half width reach
+    // around (y, z). The caller does the exact distance test.
+    template <typename Visit>
+    void Query(float y, float z, float reach, const Visit& visit) const
+    {
+        for (uint32_t index : m_Unplaced)
+        {
+            visit(index);
+        }
+
+        float firstY = CellCoordinate(y - reach);
+        float lastY = CellCoordinate(y + reach);
+        float firstZ = CellCoordinate(z - reach);
+        float lastZ = CellCoordinate(z + reach);
+
+        // a NaN query could be anywhere
+        bool anywhere = std::isnan(firstY) || std::isnan(lastY) || std::isnan(firstZ) || std::isnan(lastZ);
+        if (!anywhere && (firstY > lastY || firstZ > lastZ))
+        {
+            return;
+        }
+
+        double span = anywhere ? 0.0 : (static_cast<double>(lastY) - firstY + 1.0) * (static_cast<double>(lastZ) - firstZ + 1.0);
+        if (anywhere || span > static_cast<double>(m_Cells.size()))
+        {
+            for (const auto& cell : m_Cells)
+            {
+                float cellY = static_cast<float>(static_cast<int32_t>(static_cast<uint32_t>(cell.first >> 32)));
+                float cellZ = static_cast<float>(static_cast<int32_t>(static_cast<uint32_t>(cell.first)));
+                if (anywhere || (cellY >= firstY && cellY <= lastY && cellZ >= firstZ && cellZ <= lastZ))
+                {
+                    for (uint32_t index : cell.second)
+                    {
+                        visit(index);
+                    }
+                }
+            }
+            return;
+        }
+
+        // within +-2^30 the counters cannot overflow
+        for (int32_t cellY = static_cast<int32_t>(firstY); cellY <= static_cast<int32_t>(lastY); ++cellY)
+        {
+            for (int32_t cellZ = static_cast<int32_t>(firstZ); cellZ <= static_cast<int32_t>(lastZ); ++cellZ)
+            {
+                auto cell = m_Cells.find(Key(cellY, cellZ));
+                if (cell == m_Cells.end())
+                {
+                    continue;
+                }
+
+                for (uint32_t index : cell->second)
+                {
+                    visit(index);
+                }
+            }
+        }
+    }
+
+    float GetCellSize() const { return m_CellSize; }
+
+    size_t GetCellCount() const { return m_Cells.size(); }
+
+    // bytes held by the buckets, an estimate of the hash table overhead included
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr float MaxCell = 1073741824.0f;
+
+    // the cell of value, clamped to +-MaxCell so it fits an int32_t; NaN stays NaN
+    float CellCoordinate(float value) const
+    {
+        float cell = std::floor(value / m_CellSize);
+        return cell < -MaxCell ? -MaxCell : (cell > MaxCell ? MaxCell : cell);
+    }
+
+    static bool IsPlaced(float cellY, float cellZ)
+    {
+        return !std::isnan(cellY) && !std::isnan(cellZ);
+    }
+
+    static uint64_t Key(float cellY, float cellZ)
+    {
+        return Key(static_cast<int32_t>(cellY), static_cast<int32_t>(cellZ));
+    }
+
+    static uint64_t Key(int32_t cellY, int32_t cellZ)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cellY)) << 32) | static_cast<uint32_t>(cellZ);
+    }
+
+    float m_CellSize;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_Cells;
+
+    // entries with a NaN coordinate
+    std::vector<uint32_t> m_Unplaced;
+};
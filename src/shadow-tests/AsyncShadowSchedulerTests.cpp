@@ -0,0 +1,190 @@
+#include "Test.h"
+
+#include "AsyncShadowScheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Records what the scheduler asks of a queue. Nothing retires on its own, a CpuWait stands
+    // for the GPU catching up to the value waited for.
+    class MockQueue : public IQueueTimeline
+    {
+    public:
+        struct Wait
+        {
+            const IQueueTimeline* other;
+            uint64_t value;
+        };
+
+        uint64_t Signal() override { return ++m_Signaled; }
+
+        uint64_t GetCompletedValue() const override { return m_Completed; }
+
+        void GpuWait(const IQueueTimeline& other, uint64_t value) override { gpuWaits.push_back({ &other, value }); }
+
+        void CpuWait(uint64_t value) override
+        {
+            cpuWaits.push_back(value);
+            m_Completed = std::max(m_Completed, value);
+        }
+
+        uint64_t GetSignaled() const { return m_Signaled; }
+
+        std::vector<Wait> gpuWaits;
+        std::vector<uint64_t> cpuWaits;
+
+    private:
+        uint64_t m_Signaled = 0;
+        uint64_t m_Completed = 0;
+    };
+
+    // one frame as FramePipeline runs it, returns the compute and the draw slot
+    void RunFrame(AsyncShadowScheduler& scheduler, uint32_t& computeSlot, uint32_t& drawSlot)
+    {
+        computeSlot = scheduler.BeginCompute();
+        scheduler.EndCompute();
+        drawSlot = scheduler.BeginDraw();
+        scheduler.EndDraw();
+    }
+}
+
+TEST(SchedulerFirstFrameWaitsForNothing)
+{
+    MockQueue compute;
+    MockQueue graphics;
+    AsyncShadowScheduler scheduler(compute, graphics);
+
+    CHECK_EQ(0u, scheduler.BeginCompute());
+    CHECK(compute.cpuWaits.empty());
+    CHECK(compute.gpuWaits.empty());
+
+    scheduler.EndCompute();
+    CHECK_EQ(1u, compute.GetSignaled());
+    CHECK_EQ(1u, scheduler.GetComputeValue(0));
+
+    // nothing was computed before, the draw reads the untouched slot without waiting
+    CHECK_EQ(1u, scheduler.BeginDraw());
+    CHECK(graphics.gpuWaits.empty());
+
+    scheduler.EndDraw();
+    CHECK_EQ(1u, graphics.GetSignaled());
+    CHECK_EQ(0u, scheduler.GetNewestSlot());
+    CHECK_EQ(1u, scheduler.GetFrame());
+}
+
+TEST(SchedulerDrawWaitsForThePreviousCompute)
+{
+    MockQueue compute;
+    MockQueue graphics;
+    AsyncShadowScheduler scheduler(compute, graphics);
+
+    uint32_t computeSlot;
+    uint32_t drawSlot;
+    RunFrame(scheduler, computeSlot, drawSlot);
+
+    // frame 1 computes into slot 1 and draws slot 0, written by frame 0 (compute value 1)
+    CHECK_EQ(1u, scheduler.BeginCompute());
+    scheduler.EndCompute();
+
+    CHECK_EQ(0u, scheduler.BeginDraw());
+    CHECK_EQ(size_t(1), graphics.gpuWaits.size());
+    CHECK(graphics.gpuWaits[0].other == &compute);
+    CHECK_EQ(1u, graphics.gpuWaits[0].value);
+
+    scheduler.EndDraw();
+    CHECK_EQ(1u, scheduler.GetNewestSlot());
+}
+
+TEST(SchedulerComputeWaitsForTheDrawThatReadTheSlot)
+{
+    MockQueue compute;
+    MockQueue graphics;
+    AsyncShadowScheduler scheduler(compute, graphics);
+
+    uint32_t computeSlot;
+    uint32_t drawSlot;
+
+    // frame 0 draws slot 1 (graphics value 1), so frame 1 may only write slot 1 after that draw
+    RunFrame(scheduler, computeSlot, drawSlot);
+
+    CHECK_EQ(1u, scheduler.BeginCompute());
+    CHECK(compute.cpuWaits.empty());
+    CHECK_EQ(size_t(1), compute.gpuWaits.size());
+    CHECK(compute.gpuWaits[0].other == &graphics);
+    CHECK_EQ(1u, compute.gpuWaits[0].value);
+    scheduler.EndCompute();
+    scheduler.BeginDraw();
+    scheduler.EndDraw();
+
+    // frame 2 writes slot 0 again: the CPU waits for frame 0's compute (its allocator gets
+    // reset) and the GPU for frame 1's draw of slot 0 (graphics value 2)
+    CHECK_EQ(0u, scheduler.BeginCompute());
+    CHECK_EQ(size_t(1), compute.cpuWaits.size());
+    CHECK_EQ(1u, compute.cpuWaits[0]);
+    CHECK_EQ(size_t(2), compute.gpuWaits.size());
+    CHECK(compute.gpuWaits[1].other == &graphics);
+    CHECK_EQ(2u, compute.gpuWaits[1].value);
+}
+
+TEST(SchedulerSlotsAlternate)
+{
+    MockQueue compute;
+    MockQueue graphics;
+    AsyncShadowScheduler scheduler(compute, graphics);
+
+    for (uint64_t frame = 0; frame < 10; ++frame)
+    {
+        CHECK_EQ(frame, scheduler.GetFrame());
+
+        uint32_t computeSlot;
+        uint32_t drawSlot;
+        RunFrame(scheduler, computeSlot, drawSlot);
+
+        CHECK_EQ(static_cast<uint32_t>(frame % AsyncShadowScheduler::SlotCount), computeSlot);
+        CHECK_EQ(static_cast<uint32_t>((frame + AsyncShadowScheduler::SlotCount - 1) % AsyncShadowScheduler::SlotCount), drawSlot);
+        CHECK(computeSlot != drawSlot);
+        CHECK_EQ(computeSlot, scheduler.GetNewestSlot());
+
+        // every draw after the first waits for the compute value of the frame before it
+        if (frame > 0)
+        {
+            CHECK_EQ(frame, graphics.gpuWaits.back().value);
+        }
+    }
+
+    CHECK_EQ(10u, compute.GetSignaled());
+    CHECK_EQ(10u, graphics.GetSignaled());
+    CHECK_EQ(size_t(9), graphics.gpuWaits.size());
+}
+
+TEST(SchedulerFlushWaitsForEverySlot)
+{
+    MockQueue compute;
+    MockQueue graphics;
+    AsyncShadowScheduler scheduler(compute, graphics);
+
+    uint32_t computeSlot;
+    uint32_t drawSlot;
+    RunFrame(scheduler, computeSlot, drawSlot);
+    RunFrame(scheduler, computeSlot, drawSlot);
+    RunFrame(scheduler, computeSlot, drawSlot);
+
+    compute.cpuWaits.clear();
+    graphics.cpuWaits.clear();
+    scheduler.Flush();
+
+    // frame 2 wrote slot 0 (compute value 3) and frame 1 slot 1 (2), frame 2 drew slot 1
+    // (graphics value 3) and frame 1 slot 0 (2)
+    CHECK_EQ(3u, compute.GetCompletedValue());
+    CHECK_EQ(3u, graphics.GetCompletedValue());
+    CHECK(std::find(compute.cpuWaits.begin(), compute.cpuWaits.end(), 3u) != compute.cpuWaits.end());
+    CHECK(std::find(compute.cpuWaits.begin(), compute.cpuWaits.end(), 2u) != compute.cpuWaits.end());
+    CHECK(std::find(graphics.cpuWaits.begin(), graphics.cpuWaits.end(), 3u) != graphics.cpuWaits.end());
+    CHECK(std::find(graphics.cpuWaits.begin(), graphics.cpuWaits.end(), 2u) != graphics.cpuWaits.end());
+
+    // the next frame picks up where the flushed ones left off
+    CHECK_EQ(3u, scheduler.GetFrame());
+    CHECK_EQ(1u, scheduler.BeginCompute());
+}
@@ -0,0 +1,106 @@
+#include "Test.h"
+
+#include "Billboard.h"
+
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    const XMFLOAT4X4 Identity(
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
+
+    // A camera at (50, 60, 70) looking along +x: its right is -z, up stays +y. The rows of the
+    // inverse view are those axes in world space, then the camera position, which a sprite
+    // must not pick up.
+    const XMFLOAT4X4 LookAlongX(
+        0.0f, 0.0f, -1.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        1.0f, 0.0f, 0.0f, 0.0f,
+        50.0f, 60.0f, 70.0f, 1.0f);
+
+    void CheckVertex(const XMFLOAT3& position, float u, float v, const BillboardVertex& vertex)
+    {
+        CHECK_EQ(position.x, vertex.position.x);
+        CHECK_EQ(position.y, vertex.position.y);
+        CHECK_EQ(position.z, vertex.position.z);
+        CHECK_EQ(u, vertex.texcoord.x);
+        CHECK_EQ(v, vertex.texcoord.y);
+    }
+}
+
+TEST(BillboardCornersFaceAnUnrotatedCamera)
+{
+    XMFLOAT3 center(10.0f, 20.0f, 30.0f);
+
+    // triangle strip order: top left, top right, bottom left, bottom right, v grows downwards
+    CheckVertex(XMFLOAT3(8.0f, 22.0f, 30.0f), 0.0f, 0.0f, ExpandBillboard(center, 2.0f, Identity, 0));
+    CheckVertex(XMFLOAT3(12.0f, 22.0f, 30.0f), 1.0f, 0.0f, ExpandBillboard(center, 2.0f, Identity, 1));
+    CheckVertex(XMFLOAT3(8.0f, 18.0f, 30.0f), 0.0f, 1.0f, ExpandBillboard(center, 2.0f, Identity, 2));
+    CheckVertex(XMFLOAT3(12.0f, 18.0f, 30.0f), 1.0f, 1.0f, ExpandBillboard(center, 2.0f, Identity, 3));
+}
+
+TEST(BillboardFollowsTheCameraAxes)
+{
+    XMFLOAT3 center(10.0f, 20.0f, 30.0f);
+
+    CheckVertex(XMFLOAT3(10.0f, 23.0f, 33.0f), 0.0f, 0.0f, ExpandBillboard(center, 3.0f, LookAlongX, 0));
+    CheckVertex(XMFLOAT3(10.0f, 23.0f, 27.0f), 1.0f, 0.0f, ExpandBillboard(center, 3.0f, LookAlongX, 1));
+    CheckVertex(XMFLOAT3(10.0f, 17.0f, 33.0f), 0.0f, 1.0f, ExpandBillboard(center, 3.0f, LookAlongX, 2));
+    CheckVertex(XMFLOAT3(10.0f, 17.0f, 27.0f), 1.0f, 1.0f, ExpandBillboard(center, 3.0f, LookAlongX, 3));
+
+    // every corner lies in the plane through the center facing the camera, radius away per axis
+    for (uint32_t corner = 0; corner < BillboardCornerCount; ++corner)
+    {
+        BillboardVertex vertex = ExpandBillboard(center, 3.0f, LookAlongX, corner);
+        CHECK_EQ(center.x, vertex.position.x);
+        CHECK_NEAR(3.0, std::fabs(vertex.position.y - center.y), 1e-6);
+        CHECK_NEAR(3.0, std::fabs(vertex.position.z - center.z), 1e-6);
+    }
+}
+
+TEST(BillboardCornerWraps)
+{
+    XMFLOAT3 center(1.0f, 2.0f, 3.0f);
+
+    for (uint32_t corner = 0; corner < BillboardCornerCount; ++corner)
+    {
+        BillboardVertex expected = ExpandBillboard(center, 5.0f, LookAlongX, corner);
+        BillboardVertex wrapped = ExpandBillboard(center, 5.0f, LookAlongX, corner + BillboardCornerCount);
+        CheckVertex(expected.position, expected.texcoord.x, expected.texcoord.y, wrapped);
+    }
+}
+
+TEST(BillboardsAreLaidOutPerParticle)
+{
+    std::vector<Particle> particles(3);
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        particles[i].pos = XMFLOAT3(100.0f * i, -50.0f * i, 7.0f);
+        particles[i].radius = 1.0f + i;
+        particles[i].opacity = 0.5f;
+    }
+
+    std::vector<BillboardVertex> vertices(particles.size() * BillboardCornerCount);
+    ExpandBillboards(particles.data(), particles.size(), LookAlongX, vertices.data());
+
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        for (uint32_t corner = 0; corner < BillboardCornerCount; ++corner)
+        {
+            BillboardVertex expected = ExpandBillboard(particles[i].pos, particles[i].radius, LookAlongX, corner);
+            CheckVertex(expected.position, expected.texcoord.x, expected.texcoord.y, vertices[i * BillboardCornerCount + corner]);
+        }
+    }
+
+    // nothing written for no particles
+    BillboardVertex untouched;
+    untouched.position = XMFLOAT3(-1.0f, -1.0f, -1.0f);
+    untouched.texcoord = XMFLOAT2(-1.0f, -1.0f);
+    ExpandBillboards(particles.data(), 0, Identity, &untouched);
+    CHECK_EQ(-1.0f, untouched.position.x);
+}
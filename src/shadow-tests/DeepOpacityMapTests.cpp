@@ -0,0 +1,122 @@
+#include "Test.h"
+
+#include "DeepOpacityMap.h"
+#include "SceneGenerator.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    const XMFLOAT3 DemoSun(-700.0f, 500.0f, 0.0f);
+
+    // the map has to give exactly the shadows of the pairwise pass, which it falls back to
+    void CheckFallsBack(const std::vector<Particle>& particles, ThreadPool& pool)
+    {
+        SunBasis basis = SunBasis::FromDirection(DemoSun);
+
+        ShadowEngine engine(basis);
+        std::vector<float> expected;
+        ShadowStats expectedStats = engine.Compute(particles, expected);
+
+        DeepOpacityMap map(basis);
+        for (ThreadPool* modePool : { static_cast<ThreadPool*>(nullptr), &pool })
+        {
+            std::vector<float> shadows;
+            ShadowStats stats = map.Compute(particles, shadows, modePool);
+            CHECK_EQ(expected.size(), shadows.size());
+            CHECK(std::memcmp(expected.data(), shadows.data(), expected.size() * sizeof(float)) == 0);
+            CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+        }
+    }
+
+    void CheckInRange(const std::vector<float>& shadows)
+    {
+        size_t outside = 0;
+        for (float shadow : shadows)
+        {
+            outside += shadow >= 0.0f && shadow <= 1.0f ? 0 : 1;
+        }
+        CHECK_EQ(size_t(0), outside);
+    }
+}
+
+TEST(DeepOpacityMapApproximatesCompute)
+{
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, 2000, DemoSun);
+
+    ShadowEngine engine(basis);
+    std::vector<float> expected;
+    engine.Compute(particles, expected);
+
+    DeepOpacityMap map(basis);
+    std::vector<float> shadows;
+    ShadowStats stats = map.Compute(particles, shadows);
+    CHECK(stats.pairsTested > 0);
+    CHECK_EQ(uint64_t(0), stats.occluderHits);
+    CheckInRange(shadows);
+
+    // an approximation: close on average, not per particle
+    double error = 0.0;
+    for (size_t i = 0; i < shadows.size(); ++i)
+    {
+        error += std::fabs(static_cast<double>(shadows[i]) - expected[i]);
+    }
+    CHECK(error / static_cast<double>(shadows.size()) < 0.1);
+}
+
+TEST(DeepOpacityMapNonFiniteInput)
+{
+    ThreadPool pool(4);
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    const std::vector<Particle> scene = GenerateScene(SceneShape::Blobs, 300, DemoSun, 2);
+
+    std::vector<Particle> particles = scene;
+    particles[17].pos.x = nan;
+    CheckFallsBack(particles, pool);
+
+    particles = scene;
+    particles[0].pos.y = infinity;
+    CheckFallsBack(particles, pool);
+
+    particles = scene;
+    particles[299].pos.z = -infinity;
+    CheckFallsBack(particles, pool);
+
+    particles = scene;
+    particles[5].radius = infinity;
+    CheckFallsBack(particles, pool);
+
+    particles = scene;
+    particles[5].radius = nan;
+    CheckFallsBack(particles, pool);
+
+    // finite, but the extent or the spare cells around it overflow
+    particles = scene;
+    particles[1].pos = XMFLOAT3(0.0f, 3e38f, 0.0f);
+    particles[2].pos = XMFLOAT3(0.0f, -3e38f, 0.0f);
+    CheckFallsBack(particles, pool);
+
+    particles = scene;
+    particles[1].pos = XMFLOAT3(0.0f, 0.0f, 2e38f);
+    CheckFallsBack(particles, pool);
+}
+
+TEST(DeepOpacityMapHugeRadius)
+{
+    // a radius far beyond the grid reaches every cell without the cell range leaving an int
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, 200, DemoSun);
+    particles[3].radius = 1e30f;
+    particles[4].radius = 3e38f;
+
+    DeepOpacityMap map(SunBasis::FromDirection(DemoSun));
+    std::vector<float> shadows;
+    map.Compute(particles, shadows);
+    CheckInRange(shadows);
+}
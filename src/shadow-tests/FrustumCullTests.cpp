@@ -0,0 +1,196 @@
+#include "Test.h"
+
+#include "FrustumCull.h"
+
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // An orthographic box, x and y in [-10, 10] and z in [0, 100]: clip = (x / 10, y / 10, z / 100, 1).
+    const XMFLOAT4X4 Box(
+        0.1f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.1f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.01f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
+
+    void CheckPlane(const XMFLOAT4& expected, const XMFLOAT4& plane)
+    {
+        CHECK_NEAR(expected.x, plane.x, 1e-6);
+        CHECK_NEAR(expected.y, plane.y, 1e-6);
+        CHECK_NEAR(expected.z, plane.z, 1e-6);
+        CHECK_NEAR(expected.w, plane.w, 1e-4);
+    }
+
+    Particle MakeParticle(float x, float y, float z, float radius)
+    {
+        Particle particle;
+        particle.pos = XMFLOAT3(x, y, z);
+        particle.radius = radius;
+        particle.opacity = 0.1f;
+        return particle;
+    }
+
+    // particles in and around the box, a mix of all three outcomes in every block
+    std::vector<Particle> MakeScatteredParticles(size_t count)
+    {
+        std::vector<Particle> particles;
+        for (size_t i = 0; i < count; ++i)
+        {
+            float x = -30.0f + static_cast<float>((i * 7) % 61);
+            float y = -15.0f + static_cast<float>((i * 13) % 31);
+            float z = -20.0f + static_cast<float>((i * 29) % 141);
+            particles.push_back(MakeParticle(x, y, z, 0.5f + static_cast<float>(i % 5)));
+        }
+        return particles;
+    }
+
+    // what Cull has to return: the entries of the draw order that intersect, in that order
+    std::vector<uint32_t> ExpectedVisible(const std::vector<Particle>& particles, const Frustum& frustum, const std::vector<uint32_t>* drawOrder)
+    {
+        std::vector<uint32_t> visible;
+        for (size_t drawn = 0; drawn < particles.size(); ++drawn)
+        {
+            uint32_t index = drawOrder != nullptr ? (*drawOrder)[drawn] : static_cast<uint32_t>(drawn);
+            if (frustum.Intersects(particles[index].pos, SpriteBoundingRadius(particles[index].radius)))
+            {
+                visible.push_back(index);
+            }
+        }
+        return visible;
+    }
+}
+
+TEST(FrustumPlanesOfABox)
+{
+    Frustum frustum = Frustum::FromViewProjection(Box);
+
+    // left, right, bottom, top, near, far, normalized and facing inwards
+    CheckPlane(XMFLOAT4(1.0f, 0.0f, 0.0f, 10.0f), frustum.planes[0]);
+    CheckPlane(XMFLOAT4(-1.0f, 0.0f, 0.0f, 10.0f), frustum.planes[1]);
+    CheckPlane(XMFLOAT4(0.0f, 1.0f, 0.0f, 10.0f), frustum.planes[2]);
+    CheckPlane(XMFLOAT4(0.0f, -1.0f, 0.0f, 10.0f), frustum.planes[3]);
+    CheckPlane(XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f), frustum.planes[4]);
+    CheckPlane(XMFLOAT4(0.0f, 0.0f, -1.0f, 100.0f), frustum.planes[5]);
+}
+
+TEST(FrustumPlanesOfAPerspective)
+{
+    // 90 degree field of view, square, near 1 and far 101, as XMMatrixPerspectiveFovLH builds it
+    const float q = 101.0f / 100.0f;
+    const XMFLOAT4X4 perspective(
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, q, 1.0f,
+        0.0f, 0.0f, -q, 0.0f);
+
+    Frustum frustum = Frustum::FromViewProjection(perspective);
+
+    const float s = 0.70710678f;
+    CheckPlane(XMFLOAT4(s, 0.0f, s, 0.0f), frustum.planes[0]);
+    CheckPlane(XMFLOAT4(-s, 0.0f, s, 0.0f), frustum.planes[1]);
+    CheckPlane(XMFLOAT4(0.0f, s, s, 0.0f), frustum.planes[2]);
+    CheckPlane(XMFLOAT4(0.0f, -s, s, 0.0f), frustum.planes[3]);
+    CheckPlane(XMFLOAT4(0.0f, 0.0f, 1.0f, -1.0f), frustum.planes[4]);
+    CheckPlane(XMFLOAT4(0.0f, 0.0f, -1.0f, 101.0f), frustum.planes[5]);
+
+    CHECK(frustum.Intersects(XMFLOAT3(0.0f, 0.0f, 50.0f), 1.0f));
+    CHECK(frustum.Intersects(XMFLOAT3(40.0f, 0.0f, 50.0f), 1.0f));
+    CHECK(!frustum.Intersects(XMFLOAT3(60.0f, 0.0f, 50.0f), 1.0f));
+    CHECK(!frustum.Intersects(XMFLOAT3(0.0f, 0.0f, -5.0f), 1.0f));
+}
+
+TEST(FrustumSpheresAgainstEveryPlane)
+{
+    Frustum frustum = Frustum::FromViewProjection(Box);
+
+    CHECK(frustum.Intersects(XMFLOAT3(0.0f, 0.0f, 50.0f), 1.0f));
+
+    // for each plane a point on it and the outward direction
+    const XMFLOAT3 onPlane[6] =
+    {
+        XMFLOAT3(-10.0f, 0.0f, 50.0f), XMFLOAT3(10.0f, 0.0f, 50.0f),
+        XMFLOAT3(0.0f, -10.0f, 50.0f), XMFLOAT3(0.0f, 10.0f, 50.0f),
+        XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 100.0f),
+    };
+    const XMFLOAT3 outward[6] =
+    {
+        XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f),
+        XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f),
+        XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f),
+    };
+
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        auto at = [&](float distance)
+            {
+                return XMFLOAT3(onPlane[plane].x + outward[plane].x * distance, onPlane[plane].y + outward[plane].y * distance, onPlane[plane].z + outward[plane].z * distance);
+            };
+
+        // inside, straddling with the center in or out, touching, and outside
+        CHECK(frustum.Intersects(at(-3.0f), 2.0f));
+        CHECK(frustum.Intersects(at(-1.0f), 2.0f));
+        CHECK(frustum.Intersects(at(1.0f), 2.0f));
+        CHECK(frustum.Intersects(at(2.0f), 2.0f));
+        CHECK(!frustum.Intersects(at(2.5f), 2.0f));
+
+        // Cull tests the sprite's bounding sphere, radius * sqrt(2)
+        std::vector<Particle> particles = { MakeParticle(at(2.5f).x, at(2.5f).y, at(2.5f).z, 2.0f), MakeParticle(at(3.0f).x, at(3.0f).y, at(3.0f).z, 2.0f) };
+        FrustumCuller culler;
+        const std::vector<uint32_t>& visible = culler.Cull(particles.data(), particles.size(), frustum);
+        CHECK(visible == std::vector<uint32_t>{ 0 });
+    }
+}
+
+TEST(FrustumCullCompactsInOrder)
+{
+    Frustum frustum = Frustum::FromViewProjection(Box);
+
+    // several blocks, the last one partial
+    const size_t count = 3 * FrustumCuller::BlockSize + 17;
+    std::vector<Particle> particles = MakeScatteredParticles(count);
+
+    FrustumCuller culler;
+    std::vector<uint32_t> expected = ExpectedVisible(particles, frustum, nullptr);
+    CHECK(culler.Cull(particles.data(), count, frustum) == expected);
+
+    // some culled and some kept in every block
+    CHECK(expected.size() > count / 10);
+    CHECK(expected.size() < count - count / 10);
+
+    // a draw order: the survivors come back as particle indices, in that order
+    std::vector<uint32_t> drawOrder(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        drawOrder[i] = static_cast<uint32_t>((i * 4099) % count);
+    }
+    expected = ExpectedVisible(particles, frustum, &drawOrder);
+    CHECK(culler.Cull(particles.data(), count, frustum, drawOrder.data()) == expected);
+    CHECK(culler.GetVisible() == expected);
+
+    // nothing, and fewer than one block
+    CHECK(culler.Cull(particles.data(), 0, frustum).empty());
+    CHECK(culler.Cull(particles.data(), 5, frustum) == ExpectedVisible(std::vector<Particle>(particles.begin(), particles.begin() + 5), frustum, nullptr));
+}
+
+TEST(FrustumCullWithPoolMatchesWithout)
+{
+    Frustum frustum = Frustum::FromViewProjection(Box);
+    ThreadPool pool(4);
+
+    const size_t count = 5 * FrustumCuller::BlockSize + 1;
+    std::vector<Particle> particles = MakeScatteredParticles(count);
+
+    std::vector<uint32_t> drawOrder(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        drawOrder[i] = static_cast<uint32_t>(count - 1 - i);
+    }
+
+    FrustumCuller serial;
+    FrustumCuller parallel;
+    CHECK(parallel.Cull(particles.data(), count, frustum, nullptr, &pool) == serial.Cull(particles.data(), count, frustum));
+    CHECK(parallel.Cull(particles.data(), count, frustum, drawOrder.data(), &pool) == serial.Cull(particles.data(), count, frustum, drawOrder.data()));
+    CHECK(!parallel.GetVisible().empty());
+}
@@ -0,0 +1,152 @@
+#include "Test.h"
+
+#include "IncrementalShadowEngine.h"
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // Shade multiplies a receiver's factors in cell order, Compute in index order
+    const double ReorderTolerance = 1e-5;
+
+    const XMFLOAT3 DemoSun(-700.0f, 500.0f, 0.0f);
+
+    double MaxDifference(const std::vector<float>& expected, const std::vector<float>& actual)
+    {
+        CHECK_EQ(expected.size(), actual.size());
+
+        double difference = 0.0;
+        for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+        {
+            difference = std::max(difference, std::fabs(static_cast<double>(expected[i]) - actual[i]));
+        }
+        return difference;
+    }
+
+    // the incremental shadows have to match a full pass over the same particles
+    void CheckAgainstCompute(const SunBasis& basis, const std::vector<Particle>& particles, const std::vector<float>& shadows)
+    {
+        ShadowEngine engine(basis);
+        std::vector<float> expected;
+        engine.Compute(particles, expected);
+        CHECK_NEAR(0.0, MaxDifference(expected, shadows), ReorderTolerance);
+    }
+
+    // every entry the index visits for one query
+    std::vector<uint32_t> Visited(const YzHashIndex& index, float y, float z, float reach)
+    {
+        std::vector<uint32_t> visited;
+        index.Query(y, z, reach, [&](uint32_t entry) { visited.push_back(entry); });
+        std::sort(visited.begin(), visited.end());
+        return visited;
+    }
+}
+
+TEST(IncrementalMatchesComputeAfterMoves)
+{
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+    std::vector<Particle> particles = GenerateScene(SceneShape::Blobs, 2000, DemoSun, 6);
+
+    IncrementalShadowEngine incremental(basis);
+    incremental.Reset(particles.data(), particles.size());
+    CHECK_EQ(particles.size(), incremental.GetDirty().size());
+
+    std::vector<float> shadows(particles.size(), -1.0f);
+    incremental.Shade(shadows.data());
+    CheckAgainstCompute(basis, particles, shadows);
+    CHECK(incremental.GetDirty().empty());
+
+    ThreadPool pool(4);
+    for (int frame = 0; frame < 8; ++frame)
+    {
+        // a few particles move, one grows and one fades; 17 is listed twice
+        std::vector<uint32_t> changed = { 17, static_cast<uint32_t>(100 + frame * 211), 1999, 17 };
+        for (uint32_t index : changed)
+        {
+            particles[index].pos.x += 3.0f * static_cast<float>(frame + 1);
+            particles[index].pos.y -= 2.0f;
+            particles[index].pos.z += 5.0f;
+        }
+        particles[500].radius *= 1.5f;
+        particles[501].opacity = 0.9f;
+        changed.push_back(500);
+        changed.push_back(501);
+
+        incremental.Update(particles.data(), changed.data(), changed.size());
+
+        // only the neighbourhoods of the changed particles are reshaded
+        size_t dirty = incremental.GetDirty().size();
+        CHECK(dirty >= 5);
+        CHECK(dirty < particles.size() / 2);
+
+        incremental.Shade(shadows.data(), frame % 2 == 0 ? &pool : nullptr);
+        CheckAgainstCompute(basis, particles, shadows);
+    }
+}
+
+TEST(IncrementalNonFiniteAndHugeInput)
+{
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+    const std::vector<Particle> scene = GenerateScene(SceneShape::Sphere, 400, DemoSun);
+
+    // a NaN particle, one far beyond the int range of any cell and a radius covering everything
+    std::vector<Particle> particles = scene;
+    particles[3].pos.y = std::numeric_limits<float>::quiet_NaN();
+    particles[4].pos = XMFLOAT3(0.0f, 3e38f, -3e38f);
+    particles[5].radius = 1e30f;
+
+    IncrementalShadowEngine incremental(basis);
+    incremental.Reset(particles.data(), particles.size());
+    std::vector<float> shadows(particles.size());
+    incremental.Shade(shadows.data());
+    CheckAgainstCompute(basis, particles, shadows);
+
+    // into and out of the non-finite and the far away places
+    const uint32_t changed[] = { 3, 4, 6, 7 };
+    particles[3].pos = scene[3].pos;
+    particles[4].pos = scene[4].pos;
+    particles[6].pos.z = std::numeric_limits<float>::infinity();
+    particles[7].pos.x = std::numeric_limits<float>::quiet_NaN();
+    incremental.Update(particles.data(), changed, 4);
+    incremental.Shade(shadows.data());
+    CheckAgainstCompute(basis, particles, shadows);
+}
+
+TEST(YzHashIndexQueriesWithAnyReach)
+{
+    YzHashIndex index(1.0f);
+    index.Insert(0, 0.5f, 0.5f);
+    index.Insert(1, 10.5f, -3.5f);
+    index.Insert(2, 2.1e9f, 0.0f);
+    index.Insert(3, -3e38f, 3e38f);
+    index.Insert(4, std::numeric_limits<float>::quiet_NaN(), 0.0f);
+
+    const std::vector<uint32_t> all = { 0, 1, 2, 3, 4 };
+
+    // a small query finds its own cell and the NaN entry, nothing far away
+    CHECK(Visited(index, 0.0f, 0.0f, 1.0f) == std::vector<uint32_t>({ 0, 4 }));
+
+    // next to the largest cell: the loop has to end there
+    CHECK(Visited(index, 2.1e9f, 0.0f, 1.0f) == std::vector<uint32_t>({ 2, 4 }));
+    CHECK(Visited(index, 3e38f, 0.0f, 1e38f) == std::vector<uint32_t>({ 2, 4 }));
+
+    // reaches of billions of cells walk the occupied ones
+    CHECK(Visited(index, 0.0f, 0.0f, 1e30f) == all);
+    CHECK(Visited(index, 0.0f, 0.0f, std::numeric_limits<float>::infinity()) == all);
+    CHECK(Visited(index, 0.0f, 0.0f, 20.0f) == std::vector<uint32_t>({ 0, 1, 4 }));
+
+    // a NaN query or reach could be anywhere
+    CHECK(Visited(index, std::numeric_limits<float>::quiet_NaN(), 0.0f, 1.0f) == all);
+    CHECK(Visited(index, 0.0f, 0.0f, std::numeric_limits<float>::quiet_NaN()) == all);
+
+    index.Remove(4, std::numeric_limits<float>::quiet_NaN(), 1.0f);
+    index.Move(3, -3e38f, 3e38f, 0.25f, 0.75f);
+    CHECK(Visited(index, 0.0f, 0.0f, 1.0f) == std::vector<uint32_t>({ 0, 3 }));
+    CHECK_EQ(size_t(3), index.GetCellCount());
+}
@@ -0,0 +1,227 @@
+#include "Test.h"
+
+#include "ParticleSimulation.h"
+#include "SceneGenerator.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // every particle lives exactly one second
+    SimulationSettings OneSecondSettings(float emissionRate)
+    {
+        SimulationSettings settings;
+        settings.lifetimeMin = 1.0f;
+        settings.lifetimeMax = 1.0f;
+        settings.emissionRate = emissionRate;
+        settings.radius = 7.0f;
+        settings.opacity = 0.5f;
+        return settings;
+    }
+
+    std::vector<Particle> MakeParticles(size_t count)
+    {
+        return GenerateScene(SceneShape::Sphere, static_cast<uint32_t>(count), XMFLOAT3(1.0f, 0.0f, 0.0f));
+    }
+
+    template <typename T>
+    bool SameBytes(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+}
+
+TEST(SimulationIntegratesOneStep)
+{
+    SimulationSettings settings;
+    settings.gravity = XMFLOAT3(0.0f, -10.0f, 0.0f);
+    settings.drag = 0.5f;
+
+    Particle particle;
+    particle.pos = XMFLOAT3(1.0f, 2.0f, 3.0f);
+    particle.radius = 20.0f;
+    particle.opacity = 0.1f;
+
+    ParticleMotion motion;
+    motion.velocity = XMFLOAT3(2.0f, 0.0f, 4.0f);
+    motion.age = 1.0f;
+    motion.lifetime = 5.0f;
+
+    // v += (g - drag * v) * dt, then p += v * dt with the new v
+    CHECK(!IntegrateParticle(settings, 0.1f, particle, motion));
+    CHECK_NEAR(1.9, motion.velocity.x, 1e-6);
+    CHECK_NEAR(-1.0, motion.velocity.y, 1e-6);
+    CHECK_NEAR(3.8, motion.velocity.z, 1e-6);
+    CHECK_NEAR(1.19, particle.pos.x, 1e-6);
+    CHECK_NEAR(1.9, particle.pos.y, 1e-6);
+    CHECK_NEAR(3.38, particle.pos.z, 1e-6);
+    CHECK_NEAR(1.1, motion.age, 1e-6);
+    CHECK_EQ(20.0f, particle.radius);
+    CHECK_EQ(0.1f, particle.opacity);
+}
+
+TEST(SimulationKillsAtTheEndOfTheLifetime)
+{
+    SimulationSettings settings;
+
+    Particle particle;
+    particle.pos = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    particle.radius = 20.0f;
+    particle.opacity = 0.1f;
+
+    ParticleMotion motion;
+    motion.velocity = XMFLOAT3(1.0f, 0.0f, 0.0f);
+    motion.age = 0.25f;
+    motion.lifetime = 0.75f;
+
+    CHECK(!IntegrateParticle(settings, 0.25f, particle, motion));
+    CHECK_EQ(0.5f, motion.age);
+
+    // age reaches the lifetime exactly: dead, cleared so it neither draws nor shadows
+    CHECK(IntegrateParticle(settings, 0.25f, particle, motion));
+    CHECK_EQ(0.0f, particle.radius);
+    CHECK_EQ(0.0f, particle.opacity);
+    CHECK_EQ(0.0f, motion.velocity.x);
+    CHECK_EQ(0.0f, motion.age);
+    CHECK_EQ(0.0f, motion.lifetime);
+}
+
+TEST(SimulationReusesTheLastKilledSlotFirst)
+{
+    const size_t count = 10;
+    SimulationSettings settings = OneSecondSettings(1.0f);
+    std::vector<Particle> particles = MakeParticles(count);
+
+    ParticleSimulation simulation(settings);
+    simulation.Reset(particles.data(), count);
+    CHECK_EQ(count, simulation.GetAliveCount());
+
+    // everything dies, in index order onto the dead list, then two are emitted from its top
+    SimulationStepStats stats = simulation.Step(2.0f);
+    CHECK_EQ(uint32_t(count), stats.killed);
+    CHECK_EQ(2u, stats.emitted);
+    CHECK_EQ(2u, stats.alive);
+
+    std::vector<uint32_t> expectedDead = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    CHECK(simulation.GetDeadList() == expectedDead);
+
+    // slot 9 got the first emission, sequence numbers go on from the initial particles
+    Particle emitted;
+    ParticleMotion emittedMotion;
+    EmitParticle(settings, uint32_t(count), emitted, emittedMotion);
+    CHECK_EQ(emitted.pos.x, simulation.GetParticles()[9].pos.x);
+    CHECK_EQ(emitted.pos.y, simulation.GetParticles()[9].pos.y);
+    CHECK_EQ(7.0f, simulation.GetParticles()[9].radius);
+    EmitParticle(settings, uint32_t(count + 1), emitted, emittedMotion);
+    CHECK_EQ(emitted.pos.x, simulation.GetParticles()[8].pos.x);
+
+    // half a second: the new ones live on, half a particle is due
+    stats = simulation.Step(0.5f);
+    CHECK_EQ(0u, stats.killed);
+    CHECK_EQ(0u, stats.emitted);
+
+    // slots 8 and 9 die and go on top, 9 is reused first
+    stats = simulation.Step(0.5f);
+    CHECK_EQ(2u, stats.killed);
+    CHECK_EQ(1u, stats.emitted);
+    expectedDead.push_back(8);
+    CHECK(simulation.GetDeadList() == expectedDead);
+
+    EmitParticle(settings, uint32_t(count + 2), emitted, emittedMotion);
+    CHECK_EQ(emitted.pos.z, simulation.GetParticles()[9].pos.z);
+    CHECK_EQ(0.0f, simulation.GetParticles()[8].radius);
+}
+
+TEST(SimulationEmitsNoMoreThanTheDeadSlots)
+{
+    const size_t count = 10;
+    ParticleSimulation simulation(OneSecondSettings(1000.0f));
+    std::vector<Particle> particles = MakeParticles(count);
+    simulation.Reset(particles.data(), count);
+
+    // 2000 due, 10 slots free
+    SimulationStepStats stats = simulation.Step(2.0f);
+    CHECK_EQ(10u, stats.killed);
+    CHECK_EQ(10u, stats.emitted);
+    CHECK_EQ(10u, stats.alive);
+    CHECK(simulation.GetDeadList().empty());
+
+    // all alive, 100 due, nothing free
+    stats = simulation.Step(0.1f);
+    CHECK_EQ(0u, stats.killed);
+    CHECK_EQ(0u, stats.emitted);
+    CHECK_EQ(10u, stats.alive);
+}
+
+TEST(EmissionClockCarriesFractions)
+{
+    EmissionClock clock(100);
+    CHECK_EQ(100u, clock.GetSequence());
+
+    // 2.5 per step: 2, 3, 2, 3
+    CHECK_EQ(2u, clock.Advance(2.5f, 1.0f));
+    CHECK_EQ(3u, clock.Advance(2.5f, 1.0f));
+    CHECK_EQ(2u, clock.Advance(2.5f, 1.0f));
+    CHECK_EQ(3u, clock.Advance(2.5f, 1.0f));
+    CHECK_EQ(110u, clock.GetSequence());
+
+    // a quarter per step adds up to one every fourth step
+    EmissionClock slow;
+    CHECK_EQ(0u, slow.Advance(1.0f, 0.25f));
+    CHECK_EQ(0u, slow.Advance(1.0f, 0.25f));
+    CHECK_EQ(0u, slow.Advance(1.0f, 0.25f));
+    CHECK_EQ(1u, slow.Advance(1.0f, 0.25f));
+    CHECK_EQ(1u, slow.GetSequence());
+
+    // a negative rate emits nothing and keeps what is pending
+    CHECK_EQ(0u, slow.Advance(-5.0f, 1.0f));
+    CHECK_EQ(0u, slow.Advance(2.0f, 0.25f));
+    CHECK_EQ(1u, slow.Advance(2.0f, 0.25f));
+}
+
+TEST(SimulationWithPoolMatchesWithout)
+{
+    SimulationSettings settings;
+    settings.gravity = XMFLOAT3(0.0f, -9.8f, 0.0f);
+    settings.drag = 0.1f;
+    settings.emitVelocity = XMFLOAT3(0.0f, 0.0f, -20.0f);
+    settings.velocitySpread = 10.0f;
+    settings.lifetimeMin = 0.5f;
+    settings.lifetimeMax = 2.0f;
+    settings.emissionRate = 8000.0f;
+    settings.seed = 17;
+
+    // several chunks, the last one partial
+    const size_t count = 3 * ParticleSimulation::ChunkSize + 123;
+    std::vector<Particle> particles = MakeParticles(count);
+
+    ParticleSimulation serial(settings);
+    ParticleSimulation parallel(settings);
+    serial.Reset(particles.data(), count);
+    parallel.Reset(particles.data(), count);
+
+    ThreadPool pool(4);
+    uint32_t killed = 0;
+    for (int frame = 0; frame < 60; ++frame)
+    {
+        float deltaTime = frame % 3 == 0 ? 1.0f / 30.0f : 1.0f / 60.0f;
+
+        SimulationStepStats serialStats = serial.Step(deltaTime);
+        SimulationStepStats parallelStats = parallel.Step(deltaTime, &pool);
+
+        CHECK_EQ(serialStats.killed, parallelStats.killed);
+        CHECK_EQ(serialStats.emitted, parallelStats.emitted);
+        CHECK_EQ(serialStats.alive, parallelStats.alive);
+        killed += serialStats.killed;
+    }
+
+    CHECK(SameBytes(serial.GetParticles(), parallel.GetParticles()));
+    CHECK(SameBytes(serial.GetMotion(), parallel.GetMotion()));
+    CHECK(serial.GetDeadList() == parallel.GetDeadList());
+
+    // the run did kill and emit, in more than one chunk
+    CHECK(killed > ParticleSimulation::ChunkSize);
+}
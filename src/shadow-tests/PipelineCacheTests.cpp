@@ -0,0 +1,292 @@
+#include "Test.h"
+
+#include "PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    const uint8_t VertexBlob[] = { 1, 2, 3, 4, 5 };
+    const uint8_t ComputeBlob[] = { 9, 8, 7 };
+
+    PipelineCacheIdentity MakeIdentity()
+    {
+        PipelineCacheIdentity identity;
+        identity.vendorId = 0x10de;
+        identity.deviceId = 0x2204;
+        identity.driverVersion = 0x0020001500000000ull;
+        return identity;
+    }
+
+    // a cache file of its own in the temp directory, removed again at the end of the test
+    class CacheFile
+    {
+    public:
+        explicit CacheFile(const char* name) : m_Path((std::filesystem::temp_directory_path() / name).string())
+        {
+            std::error_code code;
+            std::filesystem::remove(m_Path, code);
+        }
+
+        ~CacheFile()
+        {
+            std::error_code code;
+            std::filesystem::remove(m_Path, code);
+        }
+
+        // saves a cache with two entries
+        void Save() const
+        {
+            PipelineCache cache;
+            cache.SetIdentity(MakeIdentity());
+            cache.Store(1, VertexBlob, sizeof(VertexBlob));
+            cache.Store(2, ComputeBlob, sizeof(ComputeBlob));
+
+            std::string error;
+            CHECK(cache.Save(m_Path, error));
+            CHECK(!cache.IsModified());
+        }
+
+        std::vector<uint8_t> Read() const
+        {
+            std::vector<uint8_t> data;
+            std::FILE* file = std::fopen(m_Path.c_str(), "rb");
+            CHECK(file != nullptr);
+            if (file != nullptr)
+            {
+                int c;
+                while ((c = std::fgetc(file)) != EOF)
+                {
+                    data.push_back(static_cast<uint8_t>(c));
+                }
+                std::fclose(file);
+            }
+            return data;
+        }
+
+        void Write(const std::vector<uint8_t>& data) const
+        {
+            std::FILE* file = std::fopen(m_Path.c_str(), "wb");
+            CHECK(file != nullptr);
+            if (file != nullptr)
+            {
+                std::fwrite(data.data(), 1, data.size(), file);
+                std::fclose(file);
+            }
+        }
+
+        // writes header back into data with a checksum that matches the rest again
+        void WriteWithHeader(std::vector<uint8_t> data, PipelineCacheHeader header) const
+        {
+            header.checksum = PipelineKey().Add(data.data() + sizeof(header), data.size() - sizeof(header)).Get();
+            std::memcpy(data.data(), &header, sizeof(header));
+            Write(data);
+        }
+
+        const std::string& GetPath() const { return m_Path; }
+
+    private:
+        std::string m_Path;
+    };
+
+    PipelineCacheHeader ReadHeader(const std::vector<uint8_t>& data)
+    {
+        PipelineCacheHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        return header;
+    }
+
+    // Loads a file that has to be rejected into a cache that already holds an entry.
+    void CheckRejected(const CacheFile& file)
+    {
+        PipelineCache cache;
+        cache.Store(42, VertexBlob, sizeof(VertexBlob));
+
+        PipelineCacheIdentity identity = MakeIdentity();
+        std::string error;
+        CHECK(!cache.Load(file.GetPath(), &identity, error));
+        CHECK(!error.empty());
+        CHECK_EQ(size_t(0), cache.GetEntryCount());
+        CHECK(cache.Find(42) == nullptr);
+        CHECK(cache.Find(1) == nullptr);
+    }
+}
+
+TEST(PipelineCacheRoundTrip)
+{
+    CacheFile file("shadow-tests-round-trip.psocache");
+    file.Save();
+
+    PipelineCache cache;
+    PipelineCacheIdentity identity = MakeIdentity();
+    std::string error;
+    CHECK(cache.Load(file.GetPath(), &identity, error));
+    CHECK_EQ(std::string(), error);
+    CHECK(!cache.IsModified());
+    CHECK_EQ(size_t(2), cache.GetEntryCount());
+    CHECK(cache.GetIdentity() == identity);
+
+    const std::vector<uint8_t>* vertex = cache.Find(1);
+    const std::vector<uint8_t>* compute = cache.Find(2);
+    CHECK(vertex != nullptr && *vertex == std::vector<uint8_t>(VertexBlob, VertexBlob + sizeof(VertexBlob)));
+    CHECK(compute != nullptr && *compute == std::vector<uint8_t>(ComputeBlob, ComputeBlob + sizeof(ComputeBlob)));
+    CHECK(cache.Find(3) == nullptr);
+
+    // without an expected identity any device's file loads
+    PipelineCache anyDevice;
+    CHECK(anyDevice.Load(file.GetPath(), nullptr, error));
+    CHECK_EQ(size_t(2), anyDevice.GetEntryCount());
+}
+
+TEST(PipelineCacheMissingFile)
+{
+    CacheFile file("shadow-tests-missing.psocache");
+
+    PipelineCache cache;
+    cache.Store(42, VertexBlob, sizeof(VertexBlob));
+
+    PipelineCacheIdentity identity = MakeIdentity();
+    std::string error;
+    CHECK(cache.Load(file.GetPath(), &identity, error));
+    CHECK_EQ(std::string(), error);
+    CHECK_EQ(size_t(0), cache.GetEntryCount());
+    CHECK(!cache.IsModified());
+}
+
+TEST(PipelineCacheRejectsDamagedFiles)
+{
+    CacheFile file("shadow-tests-damaged.psocache");
+    file.Save();
+    const std::vector<uint8_t> good = file.Read();
+    CHECK(good.size() > sizeof(PipelineCacheHeader) + 2 * sizeof(PipelineCacheEntry));
+    if (good.size() <= sizeof(PipelineCacheHeader) + 2 * sizeof(PipelineCacheEntry))
+    {
+        return;
+    }
+    const PipelineCacheHeader header = ReadHeader(good);
+
+    // another driver
+    PipelineCacheHeader otherDriver = header;
+    ++otherDriver.driverVersion;
+    file.WriteWithHeader(good, otherDriver);
+    CheckRejected(file);
+
+    // a flipped byte of the last blob, caught by the checksum
+    std::vector<uint8_t> flipped = good;
+    flipped.back() ^= 0x40;
+    file.Write(flipped);
+    CheckRejected(file);
+
+    // cut inside the blobs, and inside the header
+    file.Write(std::vector<uint8_t>(good.begin(), good.end() - 2));
+    CheckRejected(file);
+    file.Write(std::vector<uint8_t>(good.begin(), good.begin() + sizeof(PipelineCacheHeader) - 1));
+    CheckRejected(file);
+
+    // a wrong magic or header size
+    std::vector<uint8_t> badMagic = good;
+    badMagic[0] = 'X';
+    file.Write(badMagic);
+    CheckRejected(file);
+
+    PipelineCacheHeader badHeaderSize = header;
+    badHeaderSize.headerSize += 8;
+    file.WriteWithHeader(good, badHeaderSize);
+    CheckRejected(file);
+
+    // A consistent checksum over a table that claims more than the file holds, once through
+    // the entry count and once through the offset of an entry.
+    PipelineCacheHeader tooManyEntries = header;
+    tooManyEntries.entryCount = 1000;
+    file.WriteWithHeader(good, tooManyEntries);
+    CheckRejected(file);
+
+    tooManyEntries.entryCount = ~0ull / sizeof(PipelineCacheEntry) + 1;
+    file.WriteWithHeader(good, tooManyEntries);
+    CheckRejected(file);
+
+    std::vector<uint8_t> offsetPastEnd = good;
+    PipelineCacheEntry entry;
+    std::memcpy(&entry, offsetPastEnd.data() + sizeof(PipelineCacheHeader), sizeof(entry));
+    entry.offset = good.size() + 1;
+    std::memcpy(offsetPastEnd.data() + sizeof(PipelineCacheHeader), &entry, sizeof(entry));
+    file.WriteWithHeader(offsetPastEnd, header);
+    CheckRejected(file);
+
+    // an offset in the file with a size past its end
+    entry.offset = good.size() - 1;
+    entry.size = 2;
+    std::memcpy(offsetPastEnd.data() + sizeof(PipelineCacheHeader), &entry, sizeof(entry));
+    file.WriteWithHeader(offsetPastEnd, header);
+    CheckRejected(file);
+
+    // the untouched file still loads
+    file.Write(good);
+    PipelineCache cache;
+    std::string error;
+    CHECK(cache.Load(file.GetPath(), nullptr, error));
+    CHECK_EQ(size_t(2), cache.GetEntryCount());
+}
+
+TEST(PipelineCacheModifications)
+{
+    CacheFile file("shadow-tests-modified.psocache");
+    file.Save();
+
+    PipelineCache cache;
+    std::string error;
+    CHECK(cache.Load(file.GetPath(), nullptr, error));
+    CHECK(!cache.IsModified());
+
+    // removing a key that is not there changes nothing
+    cache.Remove(3);
+    CHECK(!cache.IsModified());
+
+    // nothing unused either
+    cache.RemoveUnused({ 1, 2, 3 });
+    CHECK(!cache.IsModified());
+    CHECK_EQ(size_t(2), cache.GetEntryCount());
+
+    // storing an existing key replaces its blob
+    cache.Store(1, ComputeBlob, sizeof(ComputeBlob));
+    CHECK(cache.IsModified());
+    CHECK_EQ(size_t(2), cache.GetEntryCount());
+    CHECK_EQ(sizeof(ComputeBlob), cache.Find(1)->size());
+
+    CHECK(cache.Save(file.GetPath(), error));
+    CHECK(!cache.IsModified());
+
+    cache.Remove(1);
+    CHECK(cache.IsModified());
+    CHECK(cache.Find(1) == nullptr);
+    CHECK(cache.Save(file.GetPath(), error));
+
+    cache.Store(5, VertexBlob, sizeof(VertexBlob));
+    CHECK(cache.Save(file.GetPath(), error));
+    cache.RemoveUnused({ 5 });
+    CHECK(cache.IsModified());
+    CHECK_EQ(size_t(1), cache.GetEntryCount());
+    CHECK(cache.Find(2) == nullptr);
+    CHECK(cache.Find(5) != nullptr);
+
+    // loading again starts over unmodified
+    CHECK(cache.Load(file.GetPath(), nullptr, error));
+    CHECK(!cache.IsModified());
+    CHECK_EQ(size_t(2), cache.GetEntryCount());
+}
+
+TEST(PipelineKeyStrings)
+{
+    // the length prefix keeps the split between strings in the key
+    CHECK(PipelineKey().AddString("ab").AddString("c").Get() != PipelineKey().AddString("a").AddString("bc").Get());
+    CHECK(PipelineKey().AddString("").AddString("abc").Get() != PipelineKey().AddString("abc").AddString("").Get());
+    CHECK(PipelineKey().AddString("abc").Get() != PipelineKey().Add("abc", 3).Get());
+
+    CHECK_EQ(PipelineKey().AddString("VSMain").Add(uint64_t(7)).Get(), PipelineKey().AddString("VSMain").Add(uint64_t(7)).Get());
+    CHECK_EQ(PipelineKey().AddString(nullptr).Get(), PipelineKey().AddString("").Get());
+    CHECK(PipelineKey().AddString("").Get() != PipelineKey().Get());
+}
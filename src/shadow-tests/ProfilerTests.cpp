@@ -0,0 +1,197 @@
+#include "Test.h"
+
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    const ProfileStats* FindStats(const std::vector<ProfileStats>& stats, const char* name, ProfileTrack track)
+    {
+        for (const ProfileStats& entry : stats)
+        {
+            if (entry.track == track && std::strcmp(entry.name, name) == 0)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t CountEvents(const ProfileFrame& frame, const char* name)
+    {
+        size_t count = 0;
+        for (const ProfileEvent& event : frame.events)
+        {
+            count += std::strcmp(event.name, name) == 0 ? 1 : 0;
+        }
+        return count;
+    }
+
+    std::string ReadText(const std::string& path)
+    {
+        std::string text;
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        CHECK(file != nullptr);
+        if (file != nullptr)
+        {
+            int c;
+            while ((c = std::fgetc(file)) != EOF)
+            {
+                text += static_cast<char>(c);
+            }
+            std::fclose(file);
+        }
+        return text;
+    }
+}
+
+TEST(ProfilerStatsOfInjectedEvents)
+{
+    Profiler profiler(10);
+    profiler.BeginFrame(0);
+
+    // 1 to 200 us: min 1, average 100.5, p99 the value at index 198
+    for (int i = 200; i >= 1; --i)
+    {
+        profiler.AddEvent({ "Shadows", ProfileTrack::Compute, 0, 0.0, static_cast<double>(i) });
+    }
+    profiler.AddEvent({ "Shadows", ProfileTrack::Cpu, 0, 0.0, 5000.0 });
+
+    std::vector<ProfileStats> stats = profiler.ComputeStats();
+
+    // the CPU scope comes first, then the GPU tracks
+    CHECK_EQ(size_t(2), stats.size());
+    CHECK(stats[0].track == ProfileTrack::Cpu);
+
+    const ProfileStats* shadows = FindStats(stats, "Shadows", ProfileTrack::Compute);
+    CHECK(shadows != nullptr);
+    if (shadows == nullptr)
+    {
+        return;
+    }
+
+    CHECK_EQ(uint64_t(200), shadows->count);
+    CHECK_NEAR(0.001, shadows->minMs, 1e-12);
+    CHECK_NEAR(0.1005, shadows->avgMs, 1e-12);
+    CHECK_NEAR(0.199, shadows->p99Ms, 1e-12);
+    CHECK_NEAR(0.2, shadows->maxMs, 1e-12);
+
+    const ProfileStats* cpu = FindStats(stats, "Shadows", ProfileTrack::Cpu);
+    CHECK(cpu != nullptr && cpu->count == 1 && cpu->p99Ms == 5.0);
+}
+
+TEST(ProfilerHistogramBuckets)
+{
+    Profiler profiler;
+    profiler.BeginFrame(0);
+
+    // bucket 0 is below 1 us, bucket i from 2^(i - 1) up to 2^i us, the last one the rest
+    const double durations[] = { 0.0, 0.999, 1.0, 1.999, 2.0, 3.5, 4.0, 1024.0, 1e9 };
+    for (double duration : durations)
+    {
+        profiler.AddEvent({ "Pass", ProfileTrack::Graphics, 0, 0.0, duration });
+    }
+
+    std::vector<ProfileStats> stats = profiler.ComputeStats();
+    const ProfileStats* pass = FindStats(stats, "Pass", ProfileTrack::Graphics);
+    CHECK(pass != nullptr);
+    if (pass == nullptr)
+    {
+        return;
+    }
+
+    CHECK_EQ(2u, pass->histogram[0]);
+    CHECK_EQ(2u, pass->histogram[1]);
+    CHECK_EQ(2u, pass->histogram[2]);
+    CHECK_EQ(1u, pass->histogram[3]);
+    CHECK_EQ(1u, pass->histogram[11]);
+    CHECK_EQ(1u, pass->histogram[ProfileStats::HistogramBuckets - 1]);
+
+    uint32_t total = 0;
+    for (uint32_t bucket : pass->histogram)
+    {
+        total += bucket;
+    }
+    CHECK_EQ(9u, total);
+}
+
+TEST(ProfilerLateGpuEventsFindTheirFrame)
+{
+    Profiler profiler(10);
+    for (uint64_t frame = 0; frame < 6; ++frame)
+    {
+        profiler.BeginFrame(frame);
+    }
+
+    // timestamps of frame 2 resolved while frame 5 runs, and one of the current frame
+    profiler.AddEvent({ "Draw", ProfileTrack::Graphics, 2, 10.0, 3.0 });
+    profiler.AddEvent({ "Draw", ProfileTrack::Graphics, 5, 20.0, 3.0 });
+
+    const std::deque<ProfileFrame>& frames = profiler.GetFrames();
+    CHECK_EQ(size_t(6), frames.size());
+    for (const ProfileFrame& frame : frames)
+    {
+        CHECK_EQ(size_t(frame.frame == 2 || frame.frame == 5 ? 1 : 0), CountEvents(frame, "Draw"));
+    }
+
+    // BeginFrame closed every frame before the newest with a Frame event
+    CHECK_EQ(size_t(1), CountEvents(frames[4], "Frame"));
+    CHECK_EQ(size_t(0), CountEvents(frames[5], "Frame"));
+}
+
+TEST(ProfilerDropsEventsOfEvictedFrames)
+{
+    Profiler profiler(3);
+    for (uint64_t frame = 0; frame < 6; ++frame)
+    {
+        profiler.BeginFrame(frame);
+    }
+
+    const std::deque<ProfileFrame>& frames = profiler.GetFrames();
+    CHECK_EQ(size_t(3), frames.size());
+    CHECK_EQ(uint64_t(3), frames.front().frame);
+
+    // frame 1 is gone and frame 9 has not begun
+    profiler.AddEvent({ "Draw", ProfileTrack::Graphics, 1, 0.0, 3.0 });
+    profiler.AddEvent({ "Draw", ProfileTrack::Graphics, 9, 0.0, 3.0 });
+    for (const ProfileFrame& frame : frames)
+    {
+        CHECK_EQ(size_t(0), CountEvents(frame, "Draw"));
+    }
+    CHECK(FindStats(profiler.ComputeStats(), "Draw", ProfileTrack::Graphics) == nullptr);
+
+    // the Frame events of frames 3 and 4 are all that is left
+    const ProfileStats* frameStats = FindStats(profiler.ComputeStats(), "Frame", ProfileTrack::Cpu);
+    CHECK(frameStats != nullptr && frameStats->count == 2);
+}
+
+TEST(ProfilerTraceEscapesNames)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "shadow-tests-trace.json").string();
+
+    Profiler profiler;
+    profiler.BeginFrame(7);
+    profiler.AddEvent({ "say \"hi\"\\path\n\tend", ProfileTrack::Compute, 7, 1.5, 2.25 });
+
+    std::string error;
+    CHECK(profiler.WriteChromeTrace(path.c_str(), error));
+    std::string trace = ReadText(path);
+
+    std::error_code code;
+    std::filesystem::remove(path, code);
+
+    CHECK(trace.compare(0, 36, "{\"displayTimeUnit\":\"ms\",\"traceEvents") == 0);
+    CHECK(trace.find("{\"name\":\"say \\\"hi\\\"\\\\path\\u000a\\u0009end\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":2,\"ts\":1.500,\"dur\":2.250,\"args\":{\"frame\":7}}") != std::string::npos);
+    CHECK(trace.find("\"args\":{\"name\":\"Compute queue\"}") != std::string::npos);
+
+    // no raw control characters inside the strings, only the line breaks between events
+    for (char c : trace)
+    {
+        CHECK(c == '\n' || static_cast<unsigned char>(c) >= 0x20);
+    }
+}
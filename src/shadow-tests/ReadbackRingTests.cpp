@@ -0,0 +1,185 @@
+#include "Test.h"
+
+#include "ReadbackRing.h"
+
+#include <vector>
+
+namespace
+{
+    // Stands in for the queue fence the readback copies are keyed by. Signal hands out the next
+    // value, Complete lets the GPU catch up to a value.
+    class FakeFence
+    {
+    public:
+        uint64_t Signal() { return ++m_Signaled; }
+
+        void Complete(uint64_t value) { m_Completed = value; }
+
+        void CompleteAll() { m_Completed = m_Signaled; }
+
+        uint64_t GetCompletedValue() const { return m_Completed; }
+
+    private:
+        uint64_t m_Signaled = 0;
+        uint64_t m_Completed = 0;
+    };
+
+    // acquires a slot and submits a copy into it as FramePipeline does, returns the slot
+    uint32_t SubmitCopy(ReadbackRing& ring, FakeFence& fence, uint64_t frame)
+    {
+        uint32_t slot = ~0u;
+        CHECK(ring.Acquire(slot));
+        ring.Submit(slot, fence.Signal(), frame);
+        return slot;
+    }
+}
+
+TEST(ReadbackRingRoundTrip)
+{
+    FakeFence fence;
+    ReadbackRing ring(3);
+    CHECK_EQ(3u, ring.GetSlotCount());
+
+    uint32_t slot = SubmitCopy(ring, fence, 7);
+    CHECK_EQ(0u, slot);
+    CHECK_EQ(size_t(1), ring.GetInFlightCount());
+
+    // nothing comes back before the fence passed the copy
+    ReadbackRing::Readback readback;
+    CHECK(!ring.PopCompleted(fence.GetCompletedValue(), readback));
+
+    fence.CompleteAll();
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(slot, readback.slot);
+    CHECK_EQ(1u, readback.fenceValue);
+    CHECK_EQ(7u, readback.frame);
+    CHECK_EQ(size_t(0), ring.GetInFlightCount());
+    CHECK(!ring.PopCompleted(fence.GetCompletedValue(), readback));
+
+    ring.Release(readback.slot);
+    CHECK_EQ(uint64_t(0), ring.GetDroppedCount());
+}
+
+TEST(ReadbackRingCompletesInSubmissionOrder)
+{
+    FakeFence fence;
+    ReadbackRing ring(4);
+
+    std::vector<uint32_t> slots;
+    for (uint64_t frame = 0; frame < 4; ++frame)
+    {
+        slots.push_back(SubmitCopy(ring, fence, frame));
+    }
+
+    // the fence passed the first two copies only
+    fence.Complete(2);
+    ReadbackRing::Readback readback;
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(slots[0], readback.slot);
+    CHECK_EQ(uint64_t(0), readback.frame);
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(slots[1], readback.slot);
+    CHECK_EQ(uint64_t(1), readback.frame);
+    CHECK(!ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(size_t(2), ring.GetInFlightCount());
+
+    fence.CompleteAll();
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(slots[2], readback.slot);
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(slots[3], readback.slot);
+    CHECK_EQ(uint64_t(4), readback.fenceValue);
+}
+
+TEST(ReadbackRingKeepsSlotsUntilRelease)
+{
+    FakeFence fence;
+    ReadbackRing ring(2);
+
+    uint32_t first = SubmitCopy(ring, fence, 0);
+    uint32_t second = SubmitCopy(ring, fence, 1);
+    CHECK(first != second);
+
+    // popped but not released, the slot is still being read
+    fence.CompleteAll();
+    ReadbackRing::Readback readback;
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(first, readback.slot);
+
+    uint32_t slot;
+    CHECK(!ring.Acquire(slot));
+
+    ring.Release(readback.slot);
+    CHECK(ring.Acquire(slot));
+    CHECK_EQ(first, slot);
+}
+
+TEST(ReadbackRingWrapsAround)
+{
+    FakeFence fence;
+    ReadbackRing ring(3);
+
+    // many more frames than slots, each read back two frames after its copy
+    std::vector<uint32_t> slotOfFrame;
+    uint64_t nextRead = 0;
+    for (uint64_t frame = 0; frame < 20; ++frame)
+    {
+        slotOfFrame.push_back(SubmitCopy(ring, fence, frame));
+
+        if (frame >= 2)
+        {
+            fence.Complete(frame - 1);
+
+            ReadbackRing::Readback readback;
+            CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+            CHECK_EQ(nextRead, readback.frame);
+            CHECK_EQ(slotOfFrame[nextRead], readback.slot);
+            CHECK_EQ(nextRead + 1, readback.fenceValue);
+            CHECK(!ring.PopCompleted(fence.GetCompletedValue(), readback));
+            ring.Release(readback.slot);
+            ++nextRead;
+        }
+    }
+
+    CHECK_EQ(uint64_t(18), nextRead);
+    CHECK_EQ(size_t(2), ring.GetInFlightCount());
+    CHECK_EQ(uint64_t(0), ring.GetDroppedCount());
+
+    // every slot was used again after its first readback
+    for (uint32_t slot = 0; slot < ring.GetSlotCount(); ++slot)
+    {
+        size_t uses = 0;
+        for (uint32_t used : slotOfFrame)
+        {
+            uses += used == slot ? 1 : 0;
+        }
+        CHECK(uses > 1);
+    }
+}
+
+TEST(ReadbackRingDropsWhenEverySlotIsInFlight)
+{
+    FakeFence fence;
+    ReadbackRing ring(2);
+
+    SubmitCopy(ring, fence, 0);
+    SubmitCopy(ring, fence, 1);
+
+    // the GPU is behind, the next readbacks are skipped and counted
+    uint32_t slot;
+    CHECK(!ring.Acquire(slot));
+    CHECK(!ring.Acquire(slot));
+    CHECK_EQ(uint64_t(2), ring.GetDroppedCount());
+    CHECK_EQ(size_t(2), ring.GetInFlightCount());
+
+    // a dropped Acquire leaves the readbacks in flight alone
+    fence.Complete(1);
+    ReadbackRing::Readback readback;
+    CHECK(ring.PopCompleted(fence.GetCompletedValue(), readback));
+    CHECK_EQ(uint64_t(0), readback.frame);
+    ring.Release(readback.slot);
+
+    CHECK(ring.Acquire(slot));
+    CHECK_EQ(readback.slot, slot);
+    CHECK_EQ(uint64_t(2), ring.GetDroppedCount());
+}
@@ -0,0 +1,215 @@
+#include "Test.h"
+
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // A shader directory of its own under the temp directory, removed again at the end of the test.
+    class ShaderDirectory
+    {
+    public:
+        explicit ShaderDirectory(const char* name) : m_Path(std::filesystem::temp_directory_path() / name)
+        {
+            std::error_code code;
+            std::filesystem::remove_all(m_Path, code);
+            std::filesystem::create_directories(m_Path / "include", code);
+        }
+
+        ~ShaderDirectory()
+        {
+            std::error_code code;
+            std::filesystem::remove_all(m_Path, code);
+        }
+
+        void Write(const char* file, const char* text) const
+        {
+            std::FILE* out = std::fopen((m_Path / file).string().c_str(), "wb");
+            CHECK(out != nullptr);
+            if (out != nullptr)
+            {
+                std::fputs(text, out);
+                std::fclose(out);
+            }
+        }
+
+        uint64_t Hash(const char* file) const
+        {
+            uint64_t hash = 0;
+            std::string error;
+            CHECK(HashShaderSource(GetPath(), file, hash, error));
+            CHECK_EQ(std::string(), error);
+            return hash;
+        }
+
+        std::string GetPath() const { return m_Path.string(); }
+
+    private:
+        std::filesystem::path m_Path;
+    };
+
+    ShaderPermutation ComputePermutation()
+    {
+        ShaderPermutation permutation;
+        permutation.file = "Shadow.hlsl";
+        permutation.entryPoint = "CSMain";
+        permutation.target = "cs_5_0";
+        permutation.defines = { { "THREAD_X", "32" }, { "THREAD_Y", "32" } };
+        permutation.flags = 0x5;
+        return permutation;
+    }
+}
+
+TEST(ShaderCacheKeyFollowsTheSource)
+{
+    ShaderDirectory shaders("shadow-tests-shader-source");
+    shaders.Write("Shadow.hlsl", "#include \"Common.hlsli\"\n[numthreads(32, 32, 1)] void CSMain() {}\n");
+    shaders.Write("Common.hlsli", "#define RADIUS 20\n");
+
+    ShaderPermutation permutation = ComputePermutation();
+    uint64_t key = ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl"));
+
+    // the same sources give the same key
+    CHECK_EQ(key, ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl")));
+
+    shaders.Write("Shadow.hlsl", "#include \"Common.hlsli\"\n[numthreads(32, 32, 1)] void CSMain() { }\n");
+    uint64_t edited = ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl"));
+    CHECK(edited != key);
+
+    // an edit of the included file counts as much as one of the file itself
+    shaders.Write("Common.hlsli", "#define RADIUS 21\n");
+    CHECK(ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl")) != edited);
+}
+
+TEST(ShaderCacheKeyFollowsNestedIncludes)
+{
+    ShaderDirectory shaders("shadow-tests-shader-includes");
+    shaders.Write("Shadow.hlsl", "#include \"include/Outer.hlsli\"\nvoid CSMain() {}\n");
+    shaders.Write("include/Outer.hlsli", "  #  include \"Inner.hlsli\"\n");
+    shaders.Write("include/Inner.hlsli", "static const float Bias = 0.5;\n");
+
+    uint64_t hash = shaders.Hash("Shadow.hlsl");
+
+    // Inner.hlsli resolves against include/, the directory of the file including it
+    shaders.Write("include/Inner.hlsli", "static const float Bias = 0.25;\n");
+    uint64_t innerEdited = shaders.Hash("Shadow.hlsl");
+    CHECK(innerEdited != hash);
+
+    // a file of that name next to Shadow.hlsl is not the one included
+    shaders.Write("Inner.hlsli", "static const float Bias = 1.0;\n");
+    CHECK_EQ(innerEdited, shaders.Hash("Shadow.hlsl"));
+
+    // neither is a file nothing includes
+    shaders.Write("include/Unused.hlsli", "float Unused;\n");
+    CHECK_EQ(innerEdited, shaders.Hash("Shadow.hlsl"));
+
+    // a missing include is an error, not a stale key
+    shaders.Write("include/Outer.hlsli", "#include \"Missing.hlsli\"\n");
+    uint64_t missing = 0;
+    std::string error;
+    CHECK(!HashShaderSource(shaders.GetPath(), "Shadow.hlsl", missing, error));
+    CHECK(!error.empty());
+}
+
+TEST(ShaderCacheKeyIncludeCycle)
+{
+    ShaderDirectory shaders("shadow-tests-shader-cycle");
+    shaders.Write("Shadow.hlsl", "#include \"A.hlsli\"\n");
+    shaders.Write("A.hlsli", "#pragma once\n#include \"B.hlsli\"\n");
+    shaders.Write("B.hlsli", "#pragma once\n#include \"A.hlsli\"\n");
+
+    // every file is hashed once, the cycle ends
+    uint64_t hash = shaders.Hash("Shadow.hlsl");
+
+    shaders.Write("B.hlsli", "#pragma once\n#include \"A.hlsli\"\nfloat B;\n");
+    CHECK(shaders.Hash("Shadow.hlsl") != hash);
+}
+
+TEST(ShaderCacheKeyFollowsThePermutation)
+{
+    const uint64_t sourceHash = 0x0123456789abcdefull;
+
+    ShaderPermutation permutation = ComputePermutation();
+    uint64_t key = ShaderCacheKey(permutation, sourceHash);
+
+    CHECK(ShaderCacheKey(permutation, sourceHash + 1) != key);
+
+    ShaderPermutation changed = permutation;
+    changed.defines[0].value = "16";
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.defines[1].name = "THREAD_Z";
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.defines.push_back({ "USE_GRID", "1" });
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.defines.pop_back();
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    // the order of the defines is part of the key
+    changed = permutation;
+    std::swap(changed.defines[0], changed.defines[1]);
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.entryPoint = "CSMainGrid";
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.target = "cs_5_1";
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    changed = permutation;
+    changed.flags = 0x1;
+    CHECK(ShaderCacheKey(changed, sourceHash) != key);
+
+    // the same inputs built up separately
+    CHECK_EQ(key, ShaderCacheKey(ComputePermutation(), sourceHash));
+}
+
+TEST(ShaderCacheMissesAfterAnEdit)
+{
+    ShaderDirectory shaders("shadow-tests-shader-cache");
+    shaders.Write("Shadow.hlsl", "void CSMain() {}\n");
+
+    ShaderPermutation permutation = ComputePermutation();
+    std::string description = DescribePermutation(permutation);
+    std::string cacheDirectory = shaders.GetPath() + "/cache";
+
+    const uint8_t bytecode[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3 };
+    uint64_t key = ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl"));
+
+    std::string error;
+    ShaderCache cache;
+    CHECK(cache.Open(cacheDirectory, error));
+    CHECK(cache.Store(key, description, bytecode, sizeof(bytecode), error));
+
+    // reopened, the blob is found under the same key
+    ShaderCache reopened;
+    CHECK(reopened.Open(cacheDirectory, error));
+    std::vector<uint8_t> loaded;
+    CHECK(reopened.Load(key, loaded));
+    CHECK_EQ(sizeof(bytecode), loaded.size());
+
+    // after an edit the key is new, a miss, and storing it replaces the old blob
+    shaders.Write("Shadow.hlsl", "void CSMain() { return; }\n");
+    uint64_t editedKey = ShaderCacheKey(permutation, shaders.Hash("Shadow.hlsl"));
+    CHECK(editedKey != key);
+    CHECK(!reopened.Load(editedKey, loaded));
+    CHECK(loaded.empty());
+
+    CHECK(reopened.Store(editedKey, description, bytecode, sizeof(bytecode), error));
+    CHECK_EQ(size_t(1), reopened.GetEntries().size());
+    CHECK(!reopened.Load(key, loaded));
+    CHECK(!std::filesystem::exists(reopened.GetBlobPath(key)));
+    CHECK(reopened.Load(editedKey, loaded));
+}
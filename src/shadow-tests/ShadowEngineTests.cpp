@@ -0,0 +1,232 @@
+#include "Test.h"
+
+#include "SceneGenerator.h"
+#include "ShadowEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // The vectorized, sorted and grid modes multiply the same (1 - opacity) factors in another
+    // order. Each product rounds by at most half an ulp, so a few hundred hits stay far below this.
+    const double ReorderTolerance = 1e-5;
+
+    const XMFLOAT3 DemoSun(-700.0f, 500.0f, 0.0f);
+
+    // receivers whose shadow differs from expected in any bit
+    size_t CountBitDifferences(const std::vector<float>& expected, const std::vector<float>& actual)
+    {
+        CHECK_EQ(expected.size(), actual.size());
+
+        size_t differences = 0;
+        for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+        {
+            differences += std::memcmp(&expected[i], &actual[i], sizeof(float)) != 0 ? 1 : 0;
+        }
+        return differences;
+    }
+
+    double MaxDifference(const std::vector<float>& expected, const std::vector<float>& actual)
+    {
+        CHECK_EQ(expected.size(), actual.size());
+
+        double difference = 0.0;
+        for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+        {
+            difference = std::max(difference, std::fabs(static_cast<double>(expected[i]) - actual[i]));
+        }
+        return difference;
+    }
+
+    // every mode against Compute on one set of particles
+    void CheckModes(const SunBasis& basis, const std::vector<Particle>& particles, ThreadPool& pool)
+    {
+        ShadowEngine reference(basis);
+        std::vector<float> expected;
+        ShadowStats expectedStats = reference.Compute(particles, expected);
+
+        ShadowEngine engine(basis);
+        std::vector<float> shadows;
+
+        ShadowStats stats = engine.ComputeParallel(pool, particles, shadows);
+        CHECK_EQ(size_t(0), CountBitDifferences(expected, shadows));
+        CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+        CHECK_EQ(expectedStats.pairsTested, stats.pairsTested);
+
+        for (int level = 0; level <= static_cast<int>(DetectSimdLevel()); ++level)
+        {
+            engine.SetSimdLevel(static_cast<SimdLevel>(level));
+
+            stats = engine.ComputeVectorized(particles, shadows);
+            CHECK_NEAR(0.0, MaxDifference(expected, shadows), ReorderTolerance);
+            CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+
+            stats = engine.ComputeVectorized(particles, shadows, &pool);
+            CHECK_NEAR(0.0, MaxDifference(expected, shadows), ReorderTolerance);
+            CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+        }
+
+        for (ThreadPool* modePool : { static_cast<ThreadPool*>(nullptr), &pool })
+        {
+            stats = engine.ComputeSorted(particles, shadows, modePool);
+            CHECK_NEAR(0.0, MaxDifference(expected, shadows), ReorderTolerance);
+            CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+
+            stats = engine.ComputeGrid(particles, shadows, modePool);
+            CHECK_NEAR(0.0, MaxDifference(expected, shadows), ReorderTolerance);
+            CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+        }
+    }
+
+    Particle MakeParticle(float x, float y, float z, float radius, float opacity)
+    {
+        Particle particle;
+        particle.pos = XMFLOAT3(x, y, z);
+        particle.radius = radius;
+        particle.opacity = opacity;
+        return particle;
+    }
+}
+
+TEST(ShadowModesMatchComputeOnGeneratedScenes)
+{
+    ThreadPool pool(4);
+
+    for (SceneShape shape : { SceneShape::Sphere, SceneShape::Slab, SceneShape::Line, SceneShape::Blobs })
+    {
+        // not a multiple of any tile or block size
+        std::vector<Particle> particles = GenerateScene(shape, 1500, DemoSun, 3);
+        CheckModes(SunBasis::FromDirection(DemoSun), particles, pool);
+    }
+
+    // fewer particles than one tile, and none
+    CheckModes(SunBasis::FromDirection(DemoSun), GenerateScene(SceneShape::Blobs, 37, DemoSun, 5), pool);
+    CheckModes(SunBasis::FromDirection(DemoSun), std::vector<Particle>(), pool);
+}
+
+TEST(ShadowModesCoincidentParticles)
+{
+    ThreadPool pool(4);
+    SunBasis basis = SunBasis::FromDirection(XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+    // Stacks of particles at one spot: each is ahead of all the others (dirToOther.x = 0) and
+    // only its own index is skipped, so a particle of a stack of k is shadowed by the k - 1
+    // others. The stacks are far apart and do not shadow each other.
+    std::vector<Particle> particles;
+    const size_t stackSizes[] = { 1, 2, 9, 17, 40 };
+    for (size_t stack = 0; stack < sizeof(stackSizes) / sizeof(stackSizes[0]); ++stack)
+    {
+        for (size_t i = 0; i < stackSizes[stack]; ++i)
+        {
+            particles.push_back(MakeParticle(0.0f, 1000.0f * stack, 0.0f, 5.0f, 0.25f));
+        }
+    }
+
+    ShadowEngine engine(basis);
+    std::vector<float> shadows;
+    engine.Compute(particles, shadows);
+
+    size_t index = 0;
+    for (size_t stack = 0; stack < sizeof(stackSizes) / sizeof(stackSizes[0]); ++stack)
+    {
+        float expected = 1.0f;
+        for (size_t i = 1; i < stackSizes[stack]; ++i)
+        {
+            expected *= 0.75f;
+        }
+
+        for (size_t i = 0; i < stackSizes[stack]; ++i, ++index)
+        {
+            CHECK_EQ(expected, shadows[index]);
+        }
+    }
+
+    CheckModes(basis, particles, pool);
+}
+
+TEST(ShadowModesEqualDepth)
+{
+    ThreadPool pool(4);
+    SunBasis basis = SunBasis::FromDirection(XMFLOAT3(0.0f, 0.0f, 1.0f));
+
+    // A grid of overlapping particles all at one depth along the sun, so every pair passes
+    // dirToOther.x >= 0 both ways and the sort has a single run, then a second layer ahead of
+    // the first with some depths repeated.
+    std::vector<Particle> particles;
+    for (int y = 0; y < 23; ++y)
+    {
+        for (int x = 0; x < 29; ++x)
+        {
+            particles.push_back(MakeParticle(7.0f * x, 7.0f * y, 0.0f, 5.0f, 0.05f));
+        }
+    }
+    for (int i = 0; i < 300; ++i)
+    {
+        particles.push_back(MakeParticle(3.0f * (i % 61), 5.0f * (i % 37), 10.0f * (i % 3), 4.0f, 0.1f));
+    }
+
+    CheckModes(basis, particles, pool);
+
+    // two touching particles at one depth shadow each other
+    std::vector<Particle> pair = { MakeParticle(0.0f, 0.0f, 0.0f, 1.0f, 0.5f), MakeParticle(2.0f, 0.0f, 0.0f, 1.0f, 0.5f) };
+    ShadowEngine engine(basis);
+    std::vector<float> shadows;
+    ShadowStats stats = engine.ComputeSorted(pair, shadows);
+    CHECK_EQ(uint64_t(2), stats.occluderHits);
+    CHECK_EQ(0.5f, shadows[0]);
+    CHECK_EQ(0.5f, shadows[1]);
+
+    CheckModes(basis, pair, pool);
+}
+
+TEST(ShadowTiledMatchesComputeBitForBit)
+{
+    ThreadPool pool(4);
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+
+    // partial last groups and tiles: the group size of ComputeTiled is also its tile size
+    const size_t tile = ShadowEngine::ComputeGroupSize;
+    const size_t counts[] = { 1, 2, tile - 1, tile, tile + 1, 3 * tile + 7 };
+
+    for (size_t count : counts)
+    {
+        for (SceneShape shape : { SceneShape::Sphere, SceneShape::Blobs })
+        {
+            std::vector<Particle> particles = GenerateScene(shape, static_cast<uint32_t>(count), DemoSun, 11);
+
+            ShadowEngine reference(basis);
+            std::vector<float> expected;
+            ShadowStats expectedStats = reference.Compute(particles, expected);
+
+            ShadowEngine engine(basis);
+            std::vector<float> shadows;
+            for (ThreadPool* modePool : { static_cast<ThreadPool*>(nullptr), &pool })
+            {
+                ShadowStats stats = engine.ComputeTiled(particles, shadows, modePool);
+                CHECK_EQ(size_t(0), CountBitDifferences(expected, shadows));
+                CHECK_EQ(expectedStats.occluderHits, stats.occluderHits);
+                CHECK_EQ(expectedStats.pairsTested, stats.pairsTested);
+            }
+        }
+    }
+
+    // every particle in one spot: each group meets its own receivers inside a shared tile
+    std::vector<Particle> stack(tile + 1);
+    for (Particle& particle : stack)
+    {
+        particle.pos = XMFLOAT3(1.0f, 2.0f, 3.0f);
+        particle.radius = 1.0f;
+        particle.opacity = 0.001f;
+    }
+
+    ShadowEngine engine(basis);
+    std::vector<float> expected;
+    std::vector<float> shadows;
+    engine.Compute(stack, expected);
+    engine.ComputeTiled(stack, shadows, &pool);
+    CHECK_EQ(size_t(0), CountBitDifferences(expected, shadows));
+}
@@ -0,0 +1,254 @@
+#include "Test.h"
+
+#include "SceneGenerator.h"
+#include "ShadowSnapshot.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // a file of its own in the temp directory, removed again at the end of the test
+    class TempFile
+    {
+    public:
+        explicit TempFile(const char* name) : m_Path((std::filesystem::temp_directory_path() / name).string())
+        {
+        }
+
+        ~TempFile()
+        {
+            std::error_code code;
+            std::filesystem::remove(m_Path, code);
+        }
+
+        std::vector<uint8_t> Read() const
+        {
+            std::vector<uint8_t> data;
+            std::FILE* file = std::fopen(m_Path.c_str(), "rb");
+            CHECK(file != nullptr);
+            if (file != nullptr)
+            {
+                int c;
+                while ((c = std::fgetc(file)) != EOF)
+                {
+                    data.push_back(static_cast<uint8_t>(c));
+                }
+                std::fclose(file);
+            }
+            return data;
+        }
+
+        void Write(const std::vector<uint8_t>& data) const
+        {
+            std::FILE* file = std::fopen(m_Path.c_str(), "wb");
+            CHECK(file != nullptr);
+            if (file != nullptr)
+            {
+                std::fwrite(data.data(), 1, data.size(), file);
+                std::fclose(file);
+            }
+        }
+
+        const char* GetPath() const { return m_Path.c_str(); }
+
+    private:
+        std::string m_Path;
+    };
+
+    const XMFLOAT3 Sun(-0.8f, 0.6f, 0.0f);
+
+    // every section, with a count that leaves padding after each
+    void WriteFullSnapshot(const TempFile& file, const std::vector<Particle>& particles, const std::vector<float>& shadows)
+    {
+        SnapshotWriter writer(particles.size(), Sun);
+        CHECK(writer.AddParticles(particles.data()));
+        CHECK(writer.AddSection(SnapshotSection::Shadow, shadows.data()));
+
+        // a section only goes in once
+        CHECK(!writer.AddSection(SnapshotSection::Shadow, shadows.data()));
+
+        std::string error;
+        CHECK(writer.Write(file.GetPath(), error));
+    }
+
+    // Open has to fail with an error that contains what
+    void CheckRejected(const TempFile& file, const char* what)
+    {
+        SnapshotReader reader;
+        std::string error;
+        CHECK(!reader.Open(file.GetPath(), error));
+        CHECK(error.find(what) != std::string::npos);
+    }
+}
+
+TEST(SnapshotRoundTrip)
+{
+    TempFile file("shadow-tests-round-trip.snap");
+
+    std::vector<Particle> particles = GenerateScene(SceneShape::Blobs, 37, Sun, 4);
+    std::vector<float> shadows(particles.size());
+    for (size_t i = 0; i < shadows.size(); ++i)
+    {
+        shadows[i] = 1.0f / static_cast<float>(i + 1);
+    }
+    WriteFullSnapshot(file, particles, shadows);
+
+    SnapshotReader reader;
+    std::string error;
+    CHECK(reader.Open(file.GetPath(), error));
+    CHECK_EQ(std::string(), error);
+    CHECK(reader.VerifyChecksum());
+
+    CHECK_EQ(uint64_t(37), reader.GetCount());
+    CHECK_EQ(Sun.x, reader.GetSunDir().x);
+    CHECK_EQ(Sun.y, reader.GetSunDir().y);
+    CHECK_EQ(Sun.z, reader.GetSunDir().z);
+
+    const SnapshotHeader& header = reader.GetHeader();
+    CHECK_EQ(6u, header.sectionCount);
+    for (uint32_t i = 0; i < header.sectionCount; ++i)
+    {
+        CHECK_EQ(uint64_t(0), header.sections[i].offset % SnapshotAlignment);
+        CHECK_EQ(uint64_t(37 * sizeof(float)), header.sections[i].size);
+
+        // the section data is 64-byte aligned in memory too, the mapping starts on a page
+        CHECK_EQ(uint64_t(0), reinterpret_cast<uintptr_t>(reader.GetSection(static_cast<SnapshotSection>(header.sections[i].kind))) % SnapshotAlignment);
+    }
+
+    const float* x = reader.GetSection(SnapshotSection::PositionX);
+    const float* y = reader.GetSection(SnapshotSection::PositionY);
+    const float* z = reader.GetSection(SnapshotSection::PositionZ);
+    const float* radius = reader.GetSection(SnapshotSection::Radius);
+    const float* opacity = reader.GetSection(SnapshotSection::Opacity);
+    const float* shadow = reader.GetSection(SnapshotSection::Shadow);
+    CHECK(x != nullptr && y != nullptr && z != nullptr && radius != nullptr && opacity != nullptr && shadow != nullptr);
+    if (shadow == nullptr || opacity == nullptr || radius == nullptr || z == nullptr || y == nullptr || x == nullptr)
+    {
+        return;
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        mismatches += x[i] == particles[i].pos.x && y[i] == particles[i].pos.y && z[i] == particles[i].pos.z
+            && radius[i] == particles[i].radius && opacity[i] == particles[i].opacity && shadow[i] == shadows[i] ? 0 : 1;
+    }
+    CHECK_EQ(size_t(0), mismatches);
+
+    // the padding after every section is zero and the file ends on a boundary
+    std::vector<uint8_t> data = file.Read();
+    CHECK_EQ(size_t(sizeof(SnapshotHeader) + 6 * 192), data.size());
+    for (uint32_t i = 0; i < header.sectionCount; ++i)
+    {
+        size_t end = static_cast<size_t>(header.sections[i].offset + header.sections[i].size);
+        for (size_t at = end; at < static_cast<size_t>(header.sections[i].offset) + 192; ++at)
+        {
+            CHECK_EQ(0u, static_cast<uint32_t>(data[at]));
+        }
+    }
+}
+
+TEST(SnapshotStreamRoundTrip)
+{
+    TempFile file("shadow-tests-stream.snap");
+
+    std::vector<float> shadows(101);
+    for (size_t i = 0; i < shadows.size(); ++i)
+    {
+        shadows[i] = static_cast<float>(i) * 0.01f;
+    }
+
+    // odd block sizes, so checksum words straddle the appends
+    SnapshotStreamWriter writer;
+    std::string error;
+    CHECK(writer.Open(file.GetPath(), shadows.size(), Sun, SnapshotSection::Shadow, error));
+    CHECK(writer.Append(shadows.data(), 3));
+    CHECK(writer.Append(shadows.data() + 3, 1));
+    CHECK(writer.Append(shadows.data() + 4, 97));
+    CHECK(writer.Close(error));
+
+    SnapshotReader reader;
+    CHECK(reader.Open(file.GetPath(), error));
+    CHECK(reader.VerifyChecksum());
+    CHECK_EQ(uint64_t(101), reader.GetCount());
+    CHECK(reader.GetSection(SnapshotSection::Radius) == nullptr);
+
+    const float* shadow = reader.GetSection(SnapshotSection::Shadow);
+    CHECK(shadow != nullptr && shadow[0] == shadows[0] && shadow[100] == shadows[100]);
+}
+
+TEST(SnapshotRejectsDamagedFiles)
+{
+    TempFile file("shadow-tests-damaged.snap");
+
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, 50, Sun);
+    std::vector<float> shadows(particles.size(), 0.5f);
+    WriteFullSnapshot(file, particles, shadows);
+    const std::vector<uint8_t> good = file.Read();
+
+    std::vector<uint8_t> badMagic = good;
+    badMagic[3] = 'X';
+    file.Write(badMagic);
+    CheckRejected(file, "not a shadow snapshot");
+
+    std::vector<uint8_t> badVersion = good;
+    badVersion[8] = 2;
+    file.Write(badVersion);
+    CheckRejected(file, "snapshot version 2, expected 1");
+
+    // the right version with the wrong header size is reported as such
+    std::vector<uint8_t> badHeaderSize = good;
+    badHeaderSize[12] = 128;
+    badHeaderSize[13] = 0;
+    file.Write(badHeaderSize);
+    CheckRejected(file, "header of 128 bytes, expected 256");
+
+    // cut inside the last section, and inside the header
+    file.Write(std::vector<uint8_t>(good.begin(), good.end() - 64));
+    CheckRejected(file, "corrupt section table");
+    file.Write(std::vector<uint8_t>(good.begin(), good.begin() + 100));
+    CheckRejected(file, "not a shadow snapshot");
+
+    // Open only reads the header, a flipped data byte shows up in the checksum
+    std::vector<uint8_t> flipped = good;
+    flipped[sizeof(SnapshotHeader) + 5] ^= 0x10;
+    file.Write(flipped);
+    {
+        SnapshotReader reader;
+        std::string error;
+        CHECK(reader.Open(file.GetPath(), error));
+        CHECK(!reader.VerifyChecksum());
+    }
+
+    file.Write(good);
+    {
+        SnapshotReader reader;
+        std::string error;
+        CHECK(reader.Open(file.GetPath(), error));
+        CHECK(reader.VerifyChecksum());
+    }
+}
+
+TEST(ShadowsTextRoundTrip)
+{
+    TempFile file("shadow-tests-results.txt");
+
+    const float shadows[] = { 1.0f, 0.729f, 0.0123457f, 0.5f };
+    std::string error;
+    CHECK(WriteShadowsText(file.GetPath(), shadows, 4, error));
+
+    // the lines of the demo's dump, CRLF included
+    std::vector<uint8_t> data = file.Read();
+    std::string text(data.begin(), data.end());
+    CHECK_EQ(std::string("( 1,  )\r\n( 0.729,  )\r\n( 0.0123457,  )\r\n( 0.5,  )\r\n"), text);
+
+    std::vector<float> read;
+    CHECK(ReadShadowsText(file.GetPath(), read, error));
+    CHECK_EQ(size_t(4), read.size());
+    CHECK(read.size() == 4 && read[1] == shadows[1] && read[2] == shadows[2]);
+}
@@ -0,0 +1,179 @@
+#include "Test.h"
+
+#include "FramePipeline.h"
+#include "SceneGenerator.h"
+#include "SoftwareRenderBackend.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    const XMFLOAT3 DemoSun(-700.0f, 500.0f, 0.0f);
+
+    std::string FirstHazard(const SoftwareRenderBackend& backend)
+    {
+        return backend.GetHazards().empty() ? std::string() : backend.GetHazards().front();
+    }
+
+    bool HasHazard(const SoftwareRenderBackend& backend, const char* text)
+    {
+        for (const std::string& hazard : backend.GetHazards())
+        {
+            if (hazard.find(text) != std::string::npos)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // one frame by hand: shadows into slot 0 on compute, then a draw of them on graphics
+    void ShadeAndDraw(SoftwareRenderBackend& backend, bool waitForCompute)
+    {
+        backend.BeginCompute(0);
+        backend.DispatchShadows(0, nullptr);
+        backend.SubmitCompute();
+        uint64_t computeDone = backend.GetComputeQueue().Signal();
+
+        if (waitForCompute)
+        {
+            backend.GetGraphicsQueue().GpuWait(backend.GetComputeQueue(), computeDone);
+        }
+        backend.Draw(0);
+        backend.GetGraphicsQueue().Signal();
+        backend.Present();
+    }
+
+    // frames of the pipeline with particle updates or the simulation, checking every readback
+    void RunFrames(uint32_t latency, bool simulate, ThreadPool* pool)
+    {
+        const uint32_t count = 300;
+        const uint32_t receivers = count - 1;
+        const uint64_t frames = 12;
+
+        SunBasis basis = SunBasis::FromDirection(DemoSun);
+        std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, count, DemoSun, latency);
+
+        SimulationSettings settings;
+        settings.lifetimeMin = 0.05f;
+        settings.lifetimeMax = 0.2f;
+        settings.emissionRate = 2000.0f;
+
+        SoftwareRenderBackend backend(particles, basis, simulate ? &settings : nullptr, latency, pool);
+        FramePipeline pipeline(backend, particles, basis, simulate ? &settings : nullptr);
+
+        ShadowEngine engine(basis);
+        std::map<uint64_t, std::vector<float>> expected;
+        uint64_t readbacks = 0;
+        uint64_t mismatches = 0;
+
+        pipeline.SetReadbackCallback([&](const float* shadows, uint64_t frame)
+            {
+                ++readbacks;
+                auto found = expected.find(frame);
+                if (found != expected.end() && !std::equal(found->second.begin(), found->second.end(), shadows))
+                {
+                    ++mismatches;
+                }
+            });
+
+        for (uint64_t frame = 0; frame < frames; ++frame)
+        {
+            if (!simulate)
+            {
+                // a few receivers move, the light stays
+                uint32_t indices[3] = { static_cast<uint32_t>(frame * 7 % receivers), static_cast<uint32_t>(frame * 31 % receivers), 5 };
+                Particle values[3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    values[i] = pipeline.GetParticles()[indices[i]];
+                    values[i].pos.y += 4.0f;
+                }
+                CHECK(pipeline.UpdateParticles(indices, 3, values));
+
+                std::vector<float> shadows(receivers);
+                engine.Compute(pipeline.GetParticles().data(), receivers, shadows.data());
+                expected[frame] = shadows;
+            }
+
+            if (frame % 3 == 0)
+            {
+                pipeline.RequestReadback();
+            }
+            pipeline.RunFrame(1.0f / 60.0f);
+        }
+        pipeline.Flush();
+
+        CHECK_EQ(std::string(), FirstHazard(backend));
+        CHECK_EQ(uint64_t(0), backend.GetHazardCount());
+        CHECK_EQ(uint64_t(0), backend.GetStaleShadowCount());
+        CHECK_EQ(size_t(frames), backend.GetDrawCalls().size());
+        CHECK_EQ(uint64_t(frames / 3), readbacks);
+        CHECK_EQ(uint64_t(0), mismatches);
+    }
+}
+
+TEST(FramePipelineOnSoftwareBackendHasNoHazards)
+{
+    ThreadPool pool(4);
+    for (uint32_t latency = 0; latency <= 2; ++latency)
+    {
+        RunFrames(latency, false, nullptr);
+        RunFrames(latency, false, &pool);
+        RunFrames(latency, true, &pool);
+    }
+}
+
+TEST(SoftwareBackendReportsASkippedGpuWait)
+{
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, 50, DemoSun);
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+
+    // the check follows the waits, so it does not matter whether the compute work already ran
+    for (uint32_t latency = 0; latency <= 2; ++latency)
+    {
+        SoftwareRenderBackend ordered(particles, basis, nullptr, latency);
+        ShadeAndDraw(ordered, true);
+        CHECK_EQ(uint64_t(0), ordered.GetHazardCount());
+
+        SoftwareRenderBackend unordered(particles, basis, nullptr, latency);
+        ShadeAndDraw(unordered, false);
+        CHECK(unordered.GetHazardCount() > 0);
+        CHECK(HasHazard(unordered, "frame 0: graphics reads shadows[0], written by compute before its signal 1, without waiting for it"));
+    }
+}
+
+TEST(SoftwareBackendParticleSets)
+{
+    std::string error;
+    CHECK(!SoftwareRenderBackend::IsValidParticleSet(std::vector<Particle>(), error));
+    CHECK(!error.empty());
+
+    // the light alone is a valid scene without receivers
+    std::vector<Particle> light = GenerateScene(SceneShape::Sphere, 1, DemoSun);
+    error.clear();
+    CHECK(SoftwareRenderBackend::IsValidParticleSet(light, error));
+    CHECK_EQ(std::string(), error);
+
+    // an empty set is rejected above, but running it anyway must not underflow
+    SunBasis basis = SunBasis::FromDirection(DemoSun);
+    SimulationSettings settings;
+    for (const std::vector<Particle>& particles : { light, std::vector<Particle>() })
+    {
+        SoftwareRenderBackend backend(particles, basis, &settings, 1);
+        FramePipeline pipeline(backend, particles, basis, &settings);
+        for (int frame = 0; frame < 4; ++frame)
+        {
+            pipeline.RunFrame(1.0f / 60.0f);
+        }
+        pipeline.Flush();
+
+        CHECK_EQ(uint64_t(0), backend.GetHazardCount());
+        CHECK_EQ(size_t(4), backend.GetDrawCalls().size());
+    }
+}
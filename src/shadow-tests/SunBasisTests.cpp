@@ -0,0 +1,126 @@
+#include "Test.h"
+
+#include "SunBasis.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+
+namespace
+{
+    const float Tolerance = 1e-5f;
+
+    bool IsFinite(const XMFLOAT3& v)
+    {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+
+    // unit axes, pairwise perpendicular and right handed: up x forward = sunDir
+    void CheckOrthonormal(const SunBasis& basis)
+    {
+        CHECK(IsFinite(basis.sunDir) && IsFinite(basis.up) && IsFinite(basis.forward));
+
+        CHECK_NEAR(1.0, SunBasis::Dot(basis.sunDir, basis.sunDir), Tolerance);
+        CHECK_NEAR(1.0, SunBasis::Dot(basis.up, basis.up), Tolerance);
+        CHECK_NEAR(1.0, SunBasis::Dot(basis.forward, basis.forward), Tolerance);
+
+        CHECK_NEAR(0.0, SunBasis::Dot(basis.sunDir, basis.up), Tolerance);
+        CHECK_NEAR(0.0, SunBasis::Dot(basis.sunDir, basis.forward), Tolerance);
+        CHECK_NEAR(0.0, SunBasis::Dot(basis.up, basis.forward), Tolerance);
+
+        XMFLOAT3 cross = SunBasis::Cross(basis.up, basis.forward);
+        CHECK_NEAR(basis.sunDir.x, cross.x, Tolerance);
+        CHECK_NEAR(basis.sunDir.y, cross.y, Tolerance);
+        CHECK_NEAR(basis.sunDir.z, cross.z, Tolerance);
+    }
+}
+
+TEST(SunBasisIsOrthonormal)
+{
+    // a sweep over the sphere, through the poles and the z = 0 plane where the construction switches sign
+    for (int i = 0; i <= 24; ++i)
+    {
+        float polar = 3.14159265f * static_cast<float>(i) / 24.0f;
+        for (int j = 0; j < 48; ++j)
+        {
+            float azimuth = 6.28318531f * static_cast<float>(j) / 48.0f;
+            XMFLOAT3 direction(std::sin(polar) * std::cos(azimuth), std::sin(polar) * std::sin(azimuth), std::cos(polar));
+
+            SunBasis basis = SunBasis::FromDirection(direction);
+            CheckOrthonormal(basis);
+            CHECK_NEAR(direction.x, basis.sunDir.x, Tolerance);
+            CHECK_NEAR(direction.y, basis.sunDir.y, Tolerance);
+            CHECK_NEAR(direction.z, basis.sunDir.z, Tolerance);
+        }
+    }
+
+    // the demo's sun, not normalized
+    CheckOrthonormal(SunBasis::FromDirection(XMFLOAT3(-700.0f, 500.0f, 0.0f)));
+}
+
+TEST(SunBasisAxes)
+{
+    const XMFLOAT3 axes[] =
+    {
+        XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f),
+        XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+        XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f),
+    };
+
+    for (const XMFLOAT3& axis : axes)
+    {
+        XMFLOAT3 scaled(axis.x * 250.0f, axis.y * 250.0f, axis.z * 250.0f);
+        SunBasis basis = SunBasis::FromDirection(scaled);
+        CheckOrthonormal(basis);
+
+        CHECK_EQ(axis.x, basis.sunDir.x);
+        CHECK_EQ(axis.y, basis.sunDir.y);
+        CHECK_EQ(axis.z, basis.sunDir.z);
+
+        // the light's own direction projects onto the depth axis only
+        XMFLOAT3 projected = basis.Project(scaled);
+        CHECK_NEAR(250.0, projected.x, 1e-3);
+        CHECK_NEAR(0.0, projected.y, 1e-3);
+        CHECK_NEAR(0.0, projected.z, 1e-3);
+    }
+}
+
+TEST(SunBasisExtremeLengths)
+{
+    // the squared length of these rounds to zero or overflows
+    CheckOrthonormal(SunBasis::FromDirection(XMFLOAT3(1e-30f, 0.0f, 0.0f)));
+    CheckOrthonormal(SunBasis::FromDirection(XMFLOAT3(0.0f, -1e-40f, 1e-40f)));
+    CheckOrthonormal(SunBasis::FromDirection(XMFLOAT3(3e38f, 3e38f, -3e38f)));
+
+    SunBasis basis = SunBasis::FromDirection(XMFLOAT3(1e-30f, 0.0f, 0.0f));
+    CHECK_EQ(1.0f, basis.sunDir.x);
+}
+
+TEST(SunBasisRejectsDegenerateDirections)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    const XMFLOAT3 invalid[] =
+    {
+        XMFLOAT3(0.0f, 0.0f, 0.0f),
+        XMFLOAT3(-0.0f, -0.0f, -0.0f),
+        XMFLOAT3(infinity, 0.0f, 0.0f),
+        XMFLOAT3(1.0f, -infinity, 0.0f),
+        XMFLOAT3(nan, 1.0f, 0.0f),
+        XMFLOAT3(0.0f, 0.0f, nan),
+    };
+
+    for (const XMFLOAT3& direction : invalid)
+    {
+        CHECK(!SunBasis::IsValidDirection(direction));
+
+        // no NaNs, the basis of (0, 0, 1)
+        SunBasis basis = SunBasis::FromDirection(direction);
+        CheckOrthonormal(basis);
+        CHECK_EQ(1.0f, basis.sunDir.z);
+    }
+
+    CHECK(SunBasis::IsValidDirection(XMFLOAT3(0.0f, 0.0f, -1e-45f)));
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A few macros are all the tests need, so there is no framework to fetch. TEST(Name) defines a
+// test that registers itself, CHECK and friends record a failure and let the test go on.
+
+using TestFunction = void (*)();
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, TestFunction function);
+};
+
+// records a failed check of the running test
+void ReportFailure(const char* file, int line, const std::string& message);
+
+std::string FormatTestValue(double value);
+std::string FormatTestValue(uint64_t value);
+std::string FormatTestValue(int64_t value);
+inline std::string FormatTestValue(uint32_t value) { return FormatTestValue(static_cast<uint64_t>(value)); }
+inline std::string FormatTestValue(int32_t value) { return FormatTestValue(static_cast<int64_t>(value)); }
+inline std::string FormatTestValue(bool value) { return value ? "true" : "false"; }
+inline std::string FormatTestValue(const std::string& value) { return "\"" + value + "\""; }
+inline std::string FormatTestValue(const char* value) { return FormatTestValue(std::string(value)); }
+
+#define TEST(name) \
+    static void name(); \
+    static const TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            ReportFailure(__FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+#define CHECK_EQ(expected, actual) \
+    do \
+    { \
+        auto checkExpected = (expected); \
+        auto checkActual = (actual); \
+        if (!(checkExpected == checkActual)) \
+        { \
+            ReportFailure(__FILE__, __LINE__, #actual " is " + FormatTestValue(checkActual) + ", expected " + FormatTestValue(checkExpected)); \
+        } \
+    } while (false)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+    do \
+    { \
+        double checkExpected = (expected); \
+        double checkActual = (actual); \
+        if (!(std::fabs(checkExpected - checkActual) <= (tolerance))) \
+        { \
+            ReportFailure(__FILE__, __LINE__, #actual " is " + FormatTestValue(checkActual) + ", expected " + FormatTestValue(checkExpected)); \
+        } \
+    } while (false)
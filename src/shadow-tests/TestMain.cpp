@@ -0,0 +1,82 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        TestFunction function;
+    };
+
+    std::vector<TestCase>& GetTests()
+    {
+        // a function local, the registrars of other files may run before anything of this one
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    size_t g_Failures = 0;
+}
+
+TestRegistrar::TestRegistrar(const char* name, TestFunction function)
+{
+    GetTests().push_back({ name, function });
+}
+
+void ReportFailure(const char* file, int line, const std::string& message)
+{
+    std::fprintf(stderr, "%s(%d): %s\n", file, line, message.c_str());
+    ++g_Failures;
+}
+
+std::string FormatTestValue(double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+std::string FormatTestValue(uint64_t value)
+{
+    return std::to_string(value);
+}
+
+std::string FormatTestValue(int64_t value)
+{
+    return std::to_string(value);
+}
+
+// shadow-tests [name...]: runs the tests whose names contain any of the arguments, all without any
+int main(int argc, char** argv)
+{
+    size_t run = 0;
+    size_t failed = 0;
+
+    for (const TestCase& test : GetTests())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i)
+        {
+            selected = selected || std::strstr(test.name, argv[i]) != nullptr;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+
+        size_t failuresBefore = g_Failures;
+        test.function();
+        ++run;
+
+        bool passed = g_Failures == failuresBefore;
+        failed += passed ? 0 : 1;
+        std::printf("%s %s\n", passed ? "ok    " : "FAILED", test.name);
+    }
+
+    std::printf("%zu tests, %zu failed\n", run, failed);
+    return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "Commands.h"
+#include "ReportTable.h"
+
+#include "DeepOpacityMap.h"
+#include "SceneGenerator.h"
+#include "ShadowEngine.h"
+#include "ShadowError.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    bool ParseUInt32(const std::string& value, uint32_t& result)
+    {
+        uint64_t parsed;
+        if (!CommandLine::ParseUInt64(value, parsed) || parsed == 0 || parsed > UINT32_MAX)
+        {
+            return false;
+        }
+        result = static_cast<uint32_t>(parsed);
+        return true;
+    }
+
+    template <typename Function>
+    double Seconds(const Function& function)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int RunAccuracy(const CommandLine& args)
+{
+    std::vector<SceneShape> shapes;
+    if (!CommandLine::ParseList("accuracy", "scene", args.Get("scene", "sphere,blobs"), shapes, [](const std::string& name, SceneShape& shape) { return ParseSceneShape(name.c_str(), shape); }))
+    {
+        return 1;
+    }
+
+    std::vector<uint64_t> counts;
+    std::vector<uint32_t> resolutions;
+    std::vector<uint32_t> slices;
+    if (!CommandLine::ParseList("accuracy", "counts", args.Get("counts", "1000,10000,100000"), counts, CommandLine::ParseUInt64)
+        || !CommandLine::ParseList("accuracy", "resolutions", args.Get("resolutions", "64,128,256,512"), resolutions, ParseUInt32)
+        || !CommandLine::ParseList("accuracy", "slices", args.Get("slices", "16,64"), slices, ParseUInt32))
+    {
+        return 1;
+    }
+
+    // the demo's sun at (-700, 500, 0)
+    DirectX::XMFLOAT3 sun(-700.0f, 500.0f, 0.0f);
+    std::string sunArg = args.Get("sun");
+    if (!sunArg.empty() && (!CommandLine::ParseFloat3(sunArg, sun) || !SunBasis::IsValidDirection(sun)))
+    {
+        std::fprintf(stderr, "accuracy: --sun expects a non-zero, finite x,y,z, got '%s'\n", sunArg.c_str());
+        return 1;
+    }
+
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    float threshold = 0.01f;
+
+    if (!CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0
+        || !CommandLine::ParseFloat(args.Get("threshold", "0.01"), threshold))
+    {
+        std::fprintf(stderr, "accuracy: --threads expects a positive integer, --threshold a number\n");
+        return 1;
+    }
+
+    std::string format = args.Get("format", "csv");
+    if (format != "csv" && format != "json")
+    {
+        std::fprintf(stderr, "accuracy: --format is csv or json\n");
+        return 1;
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+    SunBasis basis = SunBasis::FromDirection(sun);
+
+    ReportTable table({
+        "scene", "count", "resolution", "slices", "cell_size", "slice_depth", "seconds", "exact_seconds", "speedup",
+        "max_abs_error", "mean_abs_error", "rms_error", "mean_signed_error", "over_threshold_fraction", "memory_bytes" });
+
+    for (SceneShape shape : shapes)
+    {
+        for (uint64_t count : counts)
+        {
+            std::vector<Particle> particles = GenerateScene(shape, static_cast<uint32_t>(count), sun);
+
+            // the grid mode is the fastest exact one, it matches Compute up to the multiplication order
+            ShadowEngine engine(basis);
+            std::vector<float> exact;
+            double exactSeconds = Seconds([&]() { engine.ComputeGrid(particles, exact, &pool); });
+
+            for (uint32_t resolution : resolutions)
+            {
+                for (uint32_t sliceCount : slices)
+                {
+                    DeepOpacityMapSettings settings;
+                    settings.resolution = resolution;
+                    settings.slices = sliceCount;
+
+                    DeepOpacityMap map(basis, settings);
+                    std::vector<float> shadows;
+
+                    // the second run reuses the buffers, as an effect recomputed every frame would
+                    map.Compute(particles, shadows, &pool);
+                    double seconds = Seconds([&]() { map.Compute(particles, shadows, &pool); });
+
+                    ShadowErrorStats error = CompareShadows(exact.data(), shadows.data(), exact.size(), threshold);
+
+                    table.AddRow();
+                    table.Set("scene", GetSceneShapeName(shape));
+                    table.Set("count", count);
+                    table.Set("resolution", static_cast<uint64_t>(resolution));
+                    table.Set("slices", static_cast<uint64_t>(sliceCount));
+                    table.Set("cell_size", static_cast<double>(map.GetCellSize()));
+                    table.Set("slice_depth", static_cast<double>(map.GetSliceDepth()));
+                    table.Set("seconds", seconds);
+                    table.Set("exact_seconds", exactSeconds);
+                    table.Set("speedup", seconds > 0.0 ? exactSeconds / seconds : 0.0);
+                    table.Set("max_abs_error", error.maxAbsError);
+                    table.Set("mean_abs_error", error.meanAbsError);
+                    table.Set("rms_error", error.rmsError);
+                    table.Set("mean_signed_error", error.meanSignedError);
+                    table.Set("over_threshold_fraction", count > 0 ? static_cast<double>(error.overThreshold) / static_cast<double>(count) : 0.0);
+                    table.Set("memory_bytes", static_cast<uint64_t>(map.GetMemoryUsage()));
+                }
+            }
+        }
+    }
+
+    std::ofstream file;
+    std::string outPath = args.Get("out");
+    if (!outPath.empty())
+    {
+        file.open(outPath);
+        if (!file)
+        {
+            std::fprintf(stderr, "accuracy: cannot write '%s'\n", outPath.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : file;
+
+    if (format == "json")
+    {
+        table.WriteJson(out, {
+            { "tool", "shadow-tool accuracy" },
+            { "reference", "grid" },
+            { "threshold", std::to_string(threshold) },
+            { "sun", std::to_string(sun.x) + "," + std::to_string(sun.y) + "," + std::to_string(sun.z) } });
+    }
+    else
+    {
+        table.WriteCsv(out);
+    }
+    return 0;
+}
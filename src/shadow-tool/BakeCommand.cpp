@@ -0,0 +1,108 @@
+#include "Commands.h"
+
+#include "ShadowEngine.h"
+#include "ShadowError.h"
+#include "ShadowSnapshot.h"
+#include "StreamingBaker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Compares the baked shadows with the exact in-memory result, for inputs that fit in memory.
+    int CheckAgainstExact(const SnapshotReader& input, const char* bakedPath, ThreadPool& pool)
+    {
+        std::string error;
+        SnapshotReader baked;
+        if (!baked.Open(bakedPath, error))
+        {
+            std::fprintf(stderr, "bake: %s\n", error.c_str());
+            return 1;
+        }
+
+        uint64_t count = input.GetCount();
+        const float* x = input.GetSection(SnapshotSection::PositionX);
+        const float* y = input.GetSection(SnapshotSection::PositionY);
+        const float* z = input.GetSection(SnapshotSection::PositionZ);
+        const float* radius = input.GetSection(SnapshotSection::Radius);
+        const float* opacity = input.GetSection(SnapshotSection::Opacity);
+
+        std::vector<Particle> particles(static_cast<size_t>(count));
+        for (size_t i = 0; i < particles.size(); ++i)
+        {
+            particles[i].pos = DirectX::XMFLOAT3(x[i], y[i], z[i]);
+            particles[i].radius = radius[i];
+            particles[i].opacity = opacity[i];
+        }
+
+        ShadowEngine engine(SunBasis::FromDirection(input.GetSunDir()));
+        std::vector<float> exact;
+        engine.ComputeGrid(particles, exact, &pool);
+
+        ShadowErrorStats errors = CompareShadows(exact.data(), baked.GetSection(SnapshotSection::Shadow), exact.size());
+
+        std::printf("check: max_abs_error=%g mean_abs_error=%g rms_error=%g mean_signed_error=%g\n",
+            errors.maxAbsError, errors.meanAbsError, errors.rmsError, errors.meanSignedError);
+        return 0;
+    }
+}
+
+int RunBake(const CommandLine& args)
+{
+    const std::vector<std::string>& paths = args.GetPositional();
+    if (paths.size() != 2)
+    {
+        std::fprintf(stderr, "bake: expected an input and an output path\n");
+        return 1;
+    }
+
+    StreamingBakeSettings settings;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (!CommandLine::ParseUInt64(args.Get("slab", std::to_string(settings.slabSize)), settings.slabSize) || settings.slabSize == 0
+        || !CommandLine::ParseUInt64(args.Get("max-cells", std::to_string(settings.maxCells)), settings.maxCells)
+        || !CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0
+        || !CommandLine::ParseFloat(args.Get("cell", "0"), settings.cellSize))
+    {
+        std::fprintf(stderr, "bake: --slab, --max-cells and --threads expect positive integers, --cell a size\n");
+        return 1;
+    }
+
+    std::string error;
+    SnapshotReader input;
+    if (!input.Open(paths[0].c_str(), error))
+    {
+        std::fprintf(stderr, "bake: %s\n", error.c_str());
+        return 1;
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+    StreamingShadowBaker baker(settings);
+    StreamingBakeStats stats;
+
+    auto start = std::chrono::steady_clock::now();
+    if (!baker.Bake(input, paths[1].c_str(), &pool, stats, error))
+    {
+        std::fprintf(stderr, "bake: %s\n", error.c_str());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("particles=%llu slabs=%llu largest_slab=%llu cell_size=%g cells=%ux%u pairs_tested=%llu cells_splatted=%llu memory_bytes=%llu seconds=%g\n",
+        static_cast<unsigned long long>(stats.particles), static_cast<unsigned long long>(stats.slabs),
+        static_cast<unsigned long long>(stats.largestSlab), stats.cellSize, stats.cellsY, stats.cellsZ,
+        static_cast<unsigned long long>(stats.pairsTested), static_cast<unsigned long long>(stats.cellsSplatted),
+        static_cast<unsigned long long>(stats.memoryBytes), seconds);
+
+    if (args.Has("check"))
+    {
+        return CheckAgainstExact(input, paths[1].c_str(), pool);
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include "Commands.h"
+#include "ReportTable.h"
+
+#include "SceneGenerator.h"
+#include "ShadowEngine.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    enum class BenchMode
+    {
+        Serial,
+        Parallel,
+        Simd,
+        Sorted,
+        Grid,
+        Tiled,
+    };
+
+    const BenchMode allModes[] = { BenchMode::Serial, BenchMode::Parallel, BenchMode::Simd, BenchMode::Sorted, BenchMode::Grid, BenchMode::Tiled };
+
+    const char* GetModeName(BenchMode mode)
+    {
+        switch (mode)
+        {
+        case BenchMode::Parallel:
+            return "parallel";
+        case BenchMode::Simd:
+            return "simd";
+        case BenchMode::Sorted:
+            return "sorted";
+        case BenchMode::Grid:
+            return "grid";
+        case BenchMode::Tiled:
+            return "tiled";
+        default:
+            return "serial";
+        }
+    }
+
+    bool ParseMode(const std::string& name, BenchMode& mode)
+    {
+        for (BenchMode candidate : allModes)
+        {
+            if (name == GetModeName(candidate))
+            {
+                mode = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Upper bound of the pairs a mode will test, used to skip runs that would take hours. The
+    // grid only degenerates when every particle falls into the same few cells, as in a line.
+    double EstimatePairs(BenchMode mode, SceneShape shape, uint64_t count)
+    {
+        double allPairs = static_cast<double>(count) * static_cast<double>(count > 0 ? count - 1 : 0);
+
+        switch (mode)
+        {
+        case BenchMode::Sorted:
+            return 0.5 * allPairs;
+        case BenchMode::Grid:
+            return shape == SceneShape::Line ? 0.5 * allPairs : 0.0;
+        default:
+            return allPairs;
+        }
+    }
+
+    ShadowStats RunMode(BenchMode mode, ShadowEngine& engine, ThreadPool& pool, const std::vector<Particle>& particles, std::vector<float>& shadows)
+    {
+        switch (mode)
+        {
+        case BenchMode::Parallel:
+            return engine.ComputeParallel(pool, particles, shadows);
+        case BenchMode::Simd:
+            return engine.ComputeVectorized(particles, shadows, &pool);
+        case BenchMode::Sorted:
+            return engine.ComputeSorted(particles, shadows, &pool);
+        case BenchMode::Grid:
+            return engine.ComputeGrid(particles, shadows, &pool);
+        case BenchMode::Tiled:
+            return engine.ComputeTiled(particles, shadows, &pool);
+        default:
+            return engine.Compute(particles, shadows);
+        }
+    }
+}
+
+int RunBench(const CommandLine& args)
+{
+    std::vector<SceneShape> shapes;
+    std::string sceneArg = args.Get("scene", "all");
+    if (sceneArg == "all")
+    {
+        shapes = { SceneShape::Sphere, SceneShape::Slab, SceneShape::Line, SceneShape::Blobs };
+    }
+    else if (!CommandLine::ParseList("bench", "scene", sceneArg, shapes, [](const std::string& name, SceneShape& shape) { return ParseSceneShape(name.c_str(), shape); }))
+    {
+        return 1;
+    }
+
+    std::vector<BenchMode> modes;
+    std::string modeArg = args.Get("modes", "all");
+    if (modeArg == "all")
+    {
+        modes.assign(std::begin(allModes), std::end(allModes));
+    }
+    else if (!CommandLine::ParseList("bench", "modes", modeArg, modes, ParseMode))
+    {
+        return 1;
+    }
+
+    std::vector<uint64_t> counts;
+    if (!CommandLine::ParseList("bench", "counts", args.Get("counts", "100,1000,10000,100000,1000000"), counts, CommandLine::ParseUInt64))
+    {
+        return 1;
+    }
+
+    std::vector<DirectX::XMFLOAT3> suns;
+    for (const std::string& sun : args.GetAll("sun"))
+    {
+        DirectX::XMFLOAT3 sunDir;
+        if (!CommandLine::ParseFloat3(sun, sunDir) || !SunBasis::IsValidDirection(sunDir))
+        {
+            std::fprintf(stderr, "bench: --sun expects a non-zero, finite x,y,z, got '%s'\n", sun.c_str());
+            return 1;
+        }
+        suns.push_back(sunDir);
+    }
+    if (suns.empty())
+    {
+        // the demo's sun at (-700, 500, 0)
+        suns.push_back(DirectX::XMFLOAT3(-700.0f, 500.0f, 0.0f));
+    }
+
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t repeat = 3;
+    uint64_t maxPairs = 20000000000ull;
+
+    if (!CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0
+        || !CommandLine::ParseUInt64(args.Get("repeat", std::to_string(repeat)), repeat) || repeat == 0
+        || !CommandLine::ParseUInt64(args.Get("max-pairs", std::to_string(maxPairs)), maxPairs))
+    {
+        std::fprintf(stderr, "bench: --threads, --repeat and --max-pairs expect positive integers\n");
+        return 1;
+    }
+
+    std::string format = args.Get("format", "csv");
+    if (format != "csv" && format != "json")
+    {
+        std::fprintf(stderr, "bench: --format is csv or json\n");
+        return 1;
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+
+    ReportTable table({
+        "scene", "count", "sun_x", "sun_y", "sun_z", "mode", "threads", "seconds",
+        "pairs_total", "pairs_tested", "pairs_pruned", "pruned_fraction", "occluder_hits",
+        "ns_per_pair", "receivers_per_second", "pairs_per_second", "memory_bytes" });
+
+    for (SceneShape shape : shapes)
+    {
+        for (uint64_t count : counts)
+        {
+            for (const DirectX::XMFLOAT3& sun : suns)
+            {
+                std::vector<Particle> particles = GenerateScene(shape, static_cast<uint32_t>(count), sun);
+                std::vector<float> shadows;
+
+                for (BenchMode mode : modes)
+                {
+                    if (EstimatePairs(mode, shape, count) > static_cast<double>(maxPairs))
+                    {
+                        std::fprintf(stderr, "bench: skipping %s/%s at %llu particles, over --max-pairs\n",
+                            GetSceneShapeName(shape), GetModeName(mode), static_cast<unsigned long long>(count));
+                        continue;
+                    }
+
+                    // a fresh engine per mode, so memory_bytes only counts what this mode keeps
+                    ShadowEngine engine(SunBasis::FromDirection(sun));
+
+                    double bestSeconds = 0.0;
+                    ShadowStats stats;
+
+                    for (uint64_t run = 0; run < repeat; ++run)
+                    {
+                        auto start = std::chrono::steady_clock::now();
+                        stats = RunMode(mode, engine, pool, particles, shadows);
+                        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                        if (run == 0 || seconds < bestSeconds)
+                        {
+                            bestSeconds = seconds;
+                        }
+                    }
+
+                    uint64_t pairsTotal = count > 0 ? count * (count - 1) : 0;
+                    size_t memory = engine.GetMemoryUsage() + particles.capacity() * sizeof(Particle) + shadows.capacity() * sizeof(float);
+
+                    table.AddRow();
+                    table.Set("scene", GetSceneShapeName(shape));
+                    table.Set("count", count);
+                    table.Set("sun_x", static_cast<double>(sun.x));
+                    table.Set("sun_y", static_cast<double>(sun.y));
+                    table.Set("sun_z", static_cast<double>(sun.z));
+                    table.Set("mode", GetModeName(mode));
+                    table.Set("threads", static_cast<uint64_t>(mode == BenchMode::Serial ? 1 : threads));
+                    table.Set("seconds", bestSeconds);
+                    table.Set("pairs_total", pairsTotal);
+                    table.Set("pairs_tested", stats.pairsTested);
+                    table.Set("pairs_pruned", pairsTotal - stats.pairsTested);
+                    table.Set("pruned_fraction", pairsTotal > 0 ? 1.0 - static_cast<double>(stats.pairsTested) / static_cast<double>(pairsTotal) : 0.0);
+                    table.Set("occluder_hits", stats.occluderHits);
+                    table.Set("ns_per_pair", stats.pairsTested > 0 ? bestSeconds * 1e9 / static_cast<double>(stats.pairsTested) : 0.0);
+                    table.Set("receivers_per_second", static_cast<double>(count) / bestSeconds);
+                    table.Set("pairs_per_second", static_cast<double>(stats.pairsTested) / bestSeconds);
+                    table.Set("memory_bytes", static_cast<uint64_t>(memory));
+                }
+            }
+        }
+    }
+
+    std::ofstream file;
+    std::string outPath = args.Get("out");
+    if (!outPath.empty())
+    {
+        file.open(outPath);
+        if (!file)
+        {
+            std::fprintf(stderr, "bench: cannot write '%s'\n", outPath.c_str());
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : file;
+
+    if (format == "json")
+    {
+        table.WriteJson(out, {
+            { "tool", "shadow-tool bench" },
+            { "simd", GetSimdLevelName(DetectSimdLevel()) },
+            { "hardware_threads", std::to_string(std::thread::hardware_concurrency()) },
+            { "repeat", std::to_string(repeat) } });
+    }
+    else
+    {
+        table.WriteCsv(out);
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "CommandLine.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+CommandLine::CommandLine(int argc, char** argv, int first)
+{
+    for (int i = first; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+
+        if (argument.compare(0, 2, "--") != 0)
+        {
+            m_Positional.push_back(argument);
+            continue;
+        }
+
+        Option option;
+        option.name = argument.substr(2);
+
+        // a following "--" starts the next option, "-1,0,0" is still a value
+        if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+        {
+            option.value = argv[++i];
+        }
+        m_Options.push_back(option);
+    }
+}
+
+bool CommandLine::Has(const std::string& name) const
+{
+    for (const Option& option : m_Options)
+    {
+        if (option.name == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string CommandLine::Get(const std::string& name, const std::string& fallback) const
+{
+    for (auto it = m_Options.rbegin(); it != m_Options.rend(); ++it)
+    {
+        if (it->name == name)
+        {
+            return it->value;
+        }
+    }
+    return fallback;
+}
+
+std::vector<std::string> CommandLine::GetAll(const std::string& name) const
+{
+    std::vector<std::string> values;
+    for (const Option& option : m_Options)
+    {
+        if (option.name == name)
+        {
+            values.push_back(option.value);
+        }
+    }
+    return values;
+}
+
+std::vector<std::string> CommandLine::Split(const std::string& value, char separator)
+{
+    std::vector<std::string> parts;
+
+    size_t start = 0;
+    while (start <= value.size())
+    {
+        size_t end = value.find(separator, start);
+        if (end == std::string::npos)
+        {
+            end = value.size();
+        }
+
+        if (end > start)
+        {
+            parts.push_back(value.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return parts;
+}
+
+bool CommandLine::ParseUInt64(const std::string& value, uint64_t& result)
+{
+    if (value.empty() || value[0] == '-')
+    {
+        return false;
+    }
+
+    // scientific notation is accepted for the large particle counts, e.g. 1e7
+    char* end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(value.c_str(), &end);
+    if (errno != 0 || *end != '\0' || parsed < 0.0 || parsed > 1.8e19 || parsed != static_cast<double>(static_cast<uint64_t>(parsed)))
+    {
+        return false;
+    }
+
+    result = static_cast<uint64_t>(parsed);
+    return true;
+}
+
+bool CommandLine::ParseFloat(const std::string& value, float& result)
+{
+    char* end = nullptr;
+    errno = 0;
+    float parsed = std::strtof(value.c_str(), &end);
+    if (value.empty() || errno != 0 || *end != '\0')
+    {
+        return false;
+    }
+
+    result = parsed;
+    return true;
+}
+
+bool CommandLine::ParseFloat3(const std::string& value, DirectX::XMFLOAT3& result)
+{
+    std::vector<std::string> parts = Split(value, ',');
+    DirectX::XMFLOAT3 parsed;
+
+    if (parts.size() != 3 || !ParseFloat(parts[0], parsed.x) || !ParseFloat(parts[1], parsed.y) || !ParseFloat(parts[2], parsed.z))
+    {
+        return false;
+    }
+
+    result = parsed;
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "MathTypes.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Arguments of one subcommand: "--name value" options, "--name" flags and positional values.
+// An option may be given several times, Get returns the last value and GetAll every one.
+class CommandLine
+{
+public:
+    CommandLine(int argc, char** argv, int first);
+
+    bool Has(const std::string& name) const;
+
+    std::string Get(const std::string& name, const std::string& fallback = "") const;
+
+    std::vector<std::string> GetAll(const std::string& name) const;
+
+    const std::vector<std::string>& GetPositional() const { return m_Positional; }
+
+    static std::vector<std::string> Split(const std::string& value, char separator);
+
+    // the Parse helpers return false and leave result alone when value is malformed
+    static bool ParseUInt64(const std::string& value, uint64_t& result);
+    static bool ParseFloat(const std::string& value, float& result);
+
+    // "x,y,z"
+    static bool ParseFloat3(const std::string& value, DirectX::XMFLOAT3& result);
+
+    // Parses every comma separated part of value with parse(part, T&). On the first malformed
+    // part it prints "command: bad value 'part' for --option" and returns false.
+    template <typename T, typename Parse>
+    static bool ParseList(const char* command, const char* option, const std::string& value, std::vector<T>& result, Parse parse)
+    {
+        result.clear();
+        for (const std::string& part : Split(value, ','))
+        {
+            T parsed;
+            if (!parse(part, parsed))
+            {
+                std::fprintf(stderr, "%s: bad value '%s' for --%s\n", command, part.c_str(), option);
+                return false;
+            }
+            result.push_back(parsed);
+        }
+        return true;
+    }
+
+private:
+    struct Option
+    {
+        std::string name;
+        std::string value;
+    };
+
+    std::vector<Option> m_Options;
+    std::vector<std::string> m_Positional;
+};
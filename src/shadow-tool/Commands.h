@@ -0,0 +1,42 @@
+#pragma once
+#include "CommandLine.h"
+
+// Every subcommand takes the arguments after its name and returns the process exit code.
+
+// Times the ShadowEngine modes on synthetic scenes and reports CSV or JSON.
+int RunBench(const CommandLine& args);
+
+// Converts the old results.txt shadow dump to a binary snapshot, or a snapshot back to text
+// when the output ends in .txt.
+int RunConvert(const CommandLine& args);
+
+// Writes a synthetic scene as a particle snapshot sorted from the nearest to the sun to the farthest.
+int RunScene(const CommandLine& args);
+
+// Streams a sorted particle snapshot through StreamingShadowBaker into a shadow snapshot.
+int RunBake(const CommandLine& args);
+
+// Reports speed and error of DeepOpacityMap settings against the exact pairwise shadows.
+int RunAccuracy(const CommandLine& args);
+
+// Steps ParticleSimulation on the demo scene and prints the population and a checksum of the state.
+int RunSimulate(const CommandLine& args);
+
+// Lists a shader cache directory and checks its blobs and pipeline cache, with --source also
+// whether the shader sources still hash to each key.
+int RunShaders(const CommandLine& args);
+
+// Runs the frame loop of RenderSystem on SoftwareRenderBackend and reports the CPU time per
+// frame, readbacks that differ from the CPU shadows and synchronization hazards. --trace adds
+// per scope timings and writes them as a Chrome trace.
+int RunFrames(const CommandLine& args);
+
+// Draws a particle snapshot the way the demo does with SplatRasterizer and writes a PPM or PNG.
+int RunRender(const CommandLine& args);
+
+// Compares two PPM images in CIELAB and fails when too many pixels differ, for golden images.
+int RunDiff(const CommandLine& args);
+
+// Times the depth sort of the draw order, serial and parallel radix sort against std::stable_sort,
+// and checks that all of them agree.
+int RunSort(const CommandLine& args);
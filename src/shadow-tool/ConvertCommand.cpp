@@ -0,0 +1,98 @@
+#include "Commands.h"
+
+#include "ShadowSnapshot.h"
+#include "SunBasis.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    bool EndsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    int SnapshotToText(const std::string& inPath, const std::string& outPath)
+    {
+        std::string error;
+        SnapshotReader reader;
+        if (!reader.Open(inPath.c_str(), error))
+        {
+            std::fprintf(stderr, "convert: %s\n", error.c_str());
+            return 1;
+        }
+
+        if (!reader.VerifyChecksum())
+        {
+            std::fprintf(stderr, "convert: '%s' fails its checksum\n", inPath.c_str());
+            return 1;
+        }
+
+        const float* shadows = reader.GetSection(SnapshotSection::Shadow);
+        if (shadows == nullptr)
+        {
+            std::fprintf(stderr, "convert: '%s' has no shadow section\n", inPath.c_str());
+            return 1;
+        }
+
+        if (!WriteShadowsText(outPath.c_str(), shadows, reader.GetCount(), error))
+        {
+            std::fprintf(stderr, "convert: %s\n", error.c_str());
+            return 1;
+        }
+
+        std::fprintf(stderr, "convert: wrote %llu shadows to '%s'\n", static_cast<unsigned long long>(reader.GetCount()), outPath.c_str());
+        return 0;
+    }
+
+    int TextToSnapshot(const std::string& inPath, const std::string& outPath, const DirectX::XMFLOAT3& sunDir)
+    {
+        std::string error;
+        std::vector<float> shadows;
+        if (!ReadShadowsText(inPath.c_str(), shadows, error))
+        {
+            std::fprintf(stderr, "convert: %s\n", error.c_str());
+            return 1;
+        }
+
+        SnapshotWriter writer(shadows.size(), sunDir);
+        writer.AddSection(SnapshotSection::Shadow, shadows.data());
+
+        if (!writer.Write(outPath.c_str(), error))
+        {
+            std::fprintf(stderr, "convert: %s\n", error.c_str());
+            return 1;
+        }
+
+        std::fprintf(stderr, "convert: wrote %llu shadows to '%s'\n", static_cast<unsigned long long>(shadows.size()), outPath.c_str());
+        return 0;
+    }
+}
+
+int RunConvert(const CommandLine& args)
+{
+    const std::vector<std::string>& paths = args.GetPositional();
+    if (paths.size() != 2)
+    {
+        std::fprintf(stderr, "convert: expected an input and an output path\n");
+        return 1;
+    }
+
+    if (EndsWith(paths[1], ".txt"))
+    {
+        return SnapshotToText(paths[0], paths[1]);
+    }
+
+    // the text dump does not record the sun, it stays zero unless given
+    DirectX::XMFLOAT3 sunDir(0.0f, 0.0f, 0.0f);
+    std::string sun = args.Get("sun");
+    if (!sun.empty() && (!CommandLine::ParseFloat3(sun, sunDir) || !SunBasis::IsValidDirection(sunDir)))
+    {
+        std::fprintf(stderr, "convert: --sun expects a non-zero, finite x,y,z, got '%s'\n", sun.c_str());
+        return 1;
+    }
+
+    return TextToSnapshot(paths[0], paths[1], sunDir);
+}
@@ -0,0 +1,65 @@
+#include "Commands.h"
+
+#include "ImageDiff.h"
+#include "RgbaImage.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int RunDiff(const CommandLine& args)
+{
+    const std::vector<std::string>& paths = args.GetPositional();
+    if (paths.size() != 2)
+    {
+        std::fprintf(stderr, "diff: expected the golden and the new image\n");
+        return 1;
+    }
+
+    ImageDiffSettings settings;
+    float maxFraction = 0.0f;
+    if (!CommandLine::ParseFloat(args.Get("threshold", std::to_string(settings.threshold)), settings.threshold) || settings.threshold <= 0.0f
+        || !CommandLine::ParseFloat(args.Get("max-fraction", std::to_string(maxFraction)), maxFraction) || maxFraction < 0.0f)
+    {
+        std::fprintf(stderr, "diff: --threshold expects a positive delta E, --max-fraction a fraction of the pixels\n");
+        return 1;
+    }
+    settings.blur = !args.Has("no-blur");
+
+    std::string error;
+    RgbaImage expected;
+    RgbaImage actual;
+    if (!ReadPpm(paths[0].c_str(), expected, error) || !ReadPpm(paths[1].c_str(), actual, error))
+    {
+        std::fprintf(stderr, "diff: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::string heatMapPath = args.Get("out");
+    RgbaImage heatMap;
+
+    ImageDiffResult result;
+    if (!DiffImages(expected, actual, settings, result, heatMapPath.empty() ? nullptr : &heatMap, error))
+    {
+        std::fprintf(stderr, "diff: %s\n", error.c_str());
+        return 1;
+    }
+
+    double fraction = result.pixelCount > 0 ? static_cast<double>(result.differingPixels) / static_cast<double>(result.pixelCount) : 0.0;
+    std::printf("mean_delta_e=%.4f max_delta_e=%.4f at %u,%u differing=%llu of %llu (%.4f%%)\n",
+        result.meanDeltaE, result.maxDeltaE, result.maxX, result.maxY,
+        static_cast<unsigned long long>(result.differingPixels), static_cast<unsigned long long>(result.pixelCount), fraction * 100.0);
+
+    if (!heatMapPath.empty())
+    {
+        if (!WriteImage(heatMapPath.c_str(), heatMap, error))
+        {
+            std::fprintf(stderr, "diff: %s\n", error.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "diff: wrote '%s'\n", heatMapPath.c_str());
+    }
+
+    // the exit code is what a golden image test checks
+    return fraction > maxFraction ? 1 : 0;
+}
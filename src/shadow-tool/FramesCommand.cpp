@@ -0,0 +1,312 @@
+#include "Commands.h"
+
+#include "FramePipeline.h"
+#include "ParticleSimulation.h"
+#include "Profiler.h"
+#include "SceneGenerator.h"
+#include "ShadowEngine.h"
+#include "SoftwareRenderBackend.h"
+#include "SplatRasterizer.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // uniform in [-1, 1], spelled out so every standard library gives the same scenes
+    float RandomSigned(std::mt19937& random)
+    {
+        return static_cast<float>(random() >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    // what the shadow pass of a frame leaves in sbShadows, the light keeps its 1.0
+    std::vector<float> ReferenceShadows(ShadowEngine& engine, ThreadPool& pool, const Particle* particles, size_t count)
+    {
+        std::vector<float> shadows(count, 1.0f);
+        engine.ComputeParallel(pool, particles, count - 1, shadows.data());
+        return shadows;
+    }
+
+    // min, avg, p99 and max of every scope, then the buckets of its histogram that are not empty
+    void PrintProfile(const Profiler& profiler)
+    {
+        std::printf("profile of the last %zu frames, ms:        min       avg       p99       max\n", profiler.GetFrames().size());
+        for (const ProfileStats& stats : profiler.ComputeStats())
+        {
+            std::printf("  %-14s %-14s %9.3f %9.3f %9.3f %9.3f\n", Profiler::GetTrackName(stats.track), stats.name,
+                stats.minMs, stats.avgMs, stats.p99Ms, stats.maxMs);
+
+            std::string histogram;
+            for (size_t bucket = 0; bucket < ProfileStats::HistogramBuckets; ++bucket)
+            {
+                if (stats.histogram[bucket] != 0)
+                {
+                    bool last = bucket + 1 == ProfileStats::HistogramBuckets;
+                    histogram += (last ? " >=" : " <") + std::to_string(1ull << (last ? bucket - 1 : bucket)) + "us:" + std::to_string(stats.histogram[bucket]);
+                }
+            }
+            std::printf("    %s\n", histogram.c_str());
+        }
+    }
+}
+
+int RunFrames(const CommandLine& args)
+{
+    uint64_t count = 1025;
+    uint64_t frames = 300;
+    uint64_t updates = 16;
+    uint64_t readbackEvery = 10;
+    uint64_t latency = 1;
+    uint64_t seed = 0;
+    uint64_t report = 60;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!CommandLine::ParseUInt64(args.Get("count", std::to_string(count)), count) || count < 2 || count > UINT32_MAX
+        || !CommandLine::ParseUInt64(args.Get("frames", std::to_string(frames)), frames)
+        || !CommandLine::ParseUInt64(args.Get("updates", std::to_string(updates)), updates)
+        || !CommandLine::ParseUInt64(args.Get("readback-every", std::to_string(readbackEvery)), readbackEvery)
+        || !CommandLine::ParseUInt64(args.Get("latency", std::to_string(latency)), latency) || latency > 16
+        || !CommandLine::ParseUInt64(args.Get("seed", std::to_string(seed)), seed)
+        || !CommandLine::ParseUInt64(args.Get("report", std::to_string(report)), report)
+        || !CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0)
+    {
+        std::fprintf(stderr, "frames: --count expects at least 2, --threads a positive integer, --latency at most 16, the others integers\n");
+        return 1;
+    }
+
+    float deltaTime = 1.0f / 60.0f;
+    if (!CommandLine::ParseFloat(args.Get("dt", std::to_string(deltaTime)), deltaTime) || deltaTime < 0.0f)
+    {
+        std::fprintf(stderr, "frames: --dt expects a number that is not negative\n");
+        return 1;
+    }
+
+    DirectX::XMFLOAT3 sunDir(-700.0f, 500.0f, 0.0f);
+    std::string sun = args.Get("sun");
+    if (!sun.empty() && (!CommandLine::ParseFloat3(sun, sunDir) || !SunBasis::IsValidDirection(sunDir)))
+    {
+        std::fprintf(stderr, "frames: --sun expects a non-zero, finite x,y,z, got '%s'\n", sun.c_str());
+        return 1;
+    }
+
+    bool simulate = args.Has("simulate");
+
+    // the demo scene, its last particle is the light as in RenderSystem
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, static_cast<uint32_t>(count), sunDir, static_cast<uint32_t>(seed));
+    std::string error;
+    if (!SoftwareRenderBackend::IsValidParticleSet(particles, error))
+    {
+        std::fprintf(stderr, "frames: %s\n", error.c_str());
+        return 1;
+    }
+    uint32_t receivers = static_cast<uint32_t>(count - 1);
+
+    // the drift simulate gives it
+    SimulationSettings settings;
+    settings.emitterSpread = 330.0f * std::cbrt(static_cast<float>(receivers) / 1024.0f);
+    settings.emitVelocity = DirectX::XMFLOAT3(0.0f, 0.0f, -20.0f);
+    settings.velocitySpread = 10.0f;
+    settings.lifetimeMin = 10.0f;
+    settings.lifetimeMax = 20.0f;
+    settings.emissionRate = static_cast<float>(receivers) / 15.0f;
+    settings.seed = static_cast<uint32_t>(seed);
+
+    ThreadPool pool(static_cast<size_t>(threads));
+    SunBasis basis = SunBasis::FromDirection(sunDir);
+
+    SoftwareRenderBackend backend(particles, basis, simulate ? &settings : nullptr, static_cast<uint32_t>(latency), &pool);
+    FramePipeline pipeline(backend, particles, basis, simulate ? &settings : nullptr);
+
+    // draws cull against the view of the demo camera
+    bool cull = args.Has("cull");
+    Frustum frustum = Frustum::FromViewProjection(SplatCamera::Demo(800.0f / 600.0f).wvpMat);
+    if (cull)
+    {
+        backend.SetFrustum(&frustum);
+    }
+
+    // every frame is kept, so the trace covers the whole run
+    std::string tracePath = args.Get("trace");
+    Profiler profiler(static_cast<size_t>(frames) + 1);
+    if (!tracePath.empty())
+    {
+        pipeline.SetProfiler(&profiler);
+        backend.SetProfiler(&profiler);
+    }
+
+    // the CPU side of the checks: the same steps through ParticleSimulation, and the shadows
+    // every readback has to come back with, by frame
+    ParticleSimulation simulation(settings);
+    simulation.Reset(particles.data(), receivers);
+
+    ShadowEngine engine(basis);
+    std::map<uint64_t, std::vector<float>> expected;
+
+    uint64_t readbacks = 0;
+    uint64_t mismatches = 0;
+
+    pipeline.SetReadbackCallback([&](const float* shadows, uint64_t frame)
+        {
+            auto found = expected.find(frame);
+            if (found == expected.end())
+            {
+                return;
+            }
+
+            ++readbacks;
+            if (!std::equal(found->second.begin(), found->second.end(), shadows))
+            {
+                ++mismatches;
+                std::fprintf(stderr, "frames: the readback of frame %llu does not match the shadows computed on the CPU\n", static_cast<unsigned long long>(frame));
+            }
+            expected.erase(found);
+        });
+
+    std::mt19937 random(static_cast<uint32_t>(seed));
+    std::vector<uint32_t> indices;
+    std::vector<Particle> values;
+
+    std::vector<double> overhead;
+    std::vector<double> kernels;
+    overhead.reserve(static_cast<size_t>(frames));
+    kernels.reserve(static_cast<size_t>(frames));
+
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        const Particle* current = pipeline.GetParticles().data();
+
+        if (simulate)
+        {
+            simulation.Step(deltaTime, &pool);
+            current = simulation.GetParticles().data();
+        }
+        else if (updates > 0)
+        {
+            // a few receivers drift by up to half their radius
+            indices.clear();
+            values.clear();
+            for (uint64_t i = 0; i < updates; ++i)
+            {
+                uint32_t index = static_cast<uint32_t>(random() % receivers);
+                Particle particle = pipeline.GetParticles()[index];
+                particle.pos.x += RandomSigned(random) * 0.5f * particle.radius;
+                particle.pos.y += RandomSigned(random) * 0.5f * particle.radius;
+                particle.pos.z += RandomSigned(random) * 0.5f * particle.radius;
+
+                indices.push_back(index);
+                values.push_back(particle);
+            }
+        }
+
+        // the frame's shadows, the light is the last entry of the pipeline's copy either way
+        if (readbackEvery > 0 && frame % readbackEvery == 0)
+        {
+            std::vector<Particle> scene(current, current + receivers);
+            scene.push_back(pipeline.GetParticles().back());
+            if (!simulate)
+            {
+                for (size_t i = 0; i < indices.size(); ++i)
+                {
+                    scene[indices[i]] = values[i];
+                }
+            }
+
+            expected[frame] = ReferenceShadows(engine, pool, scene.data(), scene.size());
+            pipeline.RequestReadback();
+        }
+
+        double kernelStart = backend.GetKernelSeconds();
+        auto start = std::chrono::steady_clock::now();
+
+        if (!indices.empty())
+        {
+            pipeline.UpdateParticles(indices.data(), indices.size(), values.data());
+        }
+        FrameStats stats = pipeline.RunFrame(deltaTime);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double kernelSeconds = backend.GetKernelSeconds() - kernelStart;
+
+        overhead.push_back(seconds - kernelSeconds);
+        kernels.push_back(kernelSeconds);
+
+        if (report > 0 && ((frame + 1) % report == 0 || frame + 1 == frames))
+        {
+            std::printf("frame %llu: compute slot %u, draw slot %u, uploaded %u, shaded %u%s, emitted %u, readbacks %u\n",
+                static_cast<unsigned long long>(frame), stats.computeSlot, stats.drawSlot, stats.uploadedParticles, stats.shadedReceivers,
+                stats.incremental ? " (incremental)" : "", stats.emitCount, stats.readbacks);
+        }
+    }
+
+    pipeline.Flush();
+
+    // the readbacks the ring had to drop never come back
+    uint64_t dropped = expected.size();
+
+    uint64_t drawHash = 14695981039346656037ull;
+    uint64_t drawnInstances = 0;
+    for (const SoftwareDrawCall& draw : backend.GetDrawCalls())
+    {
+        drawHash = (drawHash ^ draw.contentHash) * 1099511628211ull;
+        drawnInstances += draw.instanceCount;
+    }
+
+    double overheadMean = 0.0;
+    double kernelMean = 0.0;
+    for (size_t i = 0; i < overhead.size(); ++i)
+    {
+        overheadMean += overhead[i];
+        kernelMean += kernels[i];
+    }
+
+    if (!overhead.empty())
+    {
+        overheadMean /= static_cast<double>(overhead.size());
+        kernelMean /= static_cast<double>(overhead.size());
+
+        std::sort(overhead.begin(), overhead.end());
+    }
+
+    double overheadMax = overhead.empty() ? 0.0 : overhead.back();
+    double overheadP99 = overhead.empty() ? 0.0 : overhead[std::min(overhead.size() - 1, overhead.size() * 99 / 100)];
+
+    std::printf("cpu overhead per frame: mean %.1f us, p99 %.1f us, max %.1f us\n", overheadMean * 1e6, overheadP99 * 1e6, overheadMax * 1e6);
+    std::printf("kernels per frame: mean %.3f ms\n", kernelMean * 1e3);
+    std::printf("draws %zu, content hash %016llx\n", backend.GetDrawCalls().size(), static_cast<unsigned long long>(drawHash));
+    if (cull && !backend.GetDrawCalls().empty())
+    {
+        std::printf("instances per draw after the cull: mean %.1f of %llu\n",
+            static_cast<double>(drawnInstances) / static_cast<double>(backend.GetDrawCalls().size()), static_cast<unsigned long long>(count));
+    }
+    std::printf("readbacks %llu checked, %llu mismatched, %llu dropped\n", static_cast<unsigned long long>(readbacks),
+        static_cast<unsigned long long>(mismatches), static_cast<unsigned long long>(dropped));
+    std::printf("hazards %llu, stale shadows %llu\n", static_cast<unsigned long long>(backend.GetHazardCount()), static_cast<unsigned long long>(backend.GetStaleShadowCount()));
+
+    for (const std::string& hazard : backend.GetHazards())
+    {
+        std::fprintf(stderr, "frames: %s\n", hazard.c_str());
+    }
+
+    if (!tracePath.empty())
+    {
+        PrintProfile(profiler);
+
+        if (!profiler.WriteChromeTrace(tracePath.c_str(), error))
+        {
+            std::fprintf(stderr, "frames: %s\n", error.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "frames: wrote '%s'\n", tracePath.c_str());
+    }
+
+    return backend.GetHazardCount() == 0 && backend.GetStaleShadowCount() == 0 && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "Commands.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    struct Command
+    {
+        const char* name;
+        int (*run)(const CommandLine& args);
+        const char* usage;
+    };
+
+    const Command commands[] =
+    {
+        {
+            "bench", RunBench,
+            "bench [--scene sphere|slab|line|blobs|all] [--counts 100,1e3,...] [--sun x,y,z]...\n"
+            "      [--modes serial,parallel,simd,sorted,grid,tiled|all] [--threads N] [--repeat N]\n"
+            "      [--max-pairs N] [--format csv|json] [--out file]"
+        },
+        {
+            "convert", RunConvert,
+            "convert <results.txt> <out.snap> [--sun x,y,z]\n"
+            "convert <in.snap> <out.txt>"
+        },
+        {
+            "scene", RunScene,
+            "scene --out file.snap [--scene sphere|slab|line|blobs] [--count N] [--sun x,y,z] [--seed N]"
+        },
+        {
+            "bake", RunBake,
+            "bake <particles.snap> <shadows.snap> [--slab N] [--cell size] [--max-cells N] [--threads N]\n"
+            "      [--check]"
+        },
+        {
+            "accuracy", RunAccuracy,
+            "accuracy [--scene sphere,blobs,...] [--counts 1000,...] [--resolutions 64,128,...]\n"
+            "      [--slices 16,64,...] [--sun x,y,z] [--threshold e] [--threads N] [--format csv|json]\n"
+            "      [--out file]"
+        },
+        {
+            "simulate", RunSimulate,
+            "simulate [--count N] [--frames N] [--dt seconds] [--rate per-second] [--gravity x,y,z]\n"
+            "      [--drag d] [--seed N] [--sun x,y,z] [--threads N] [--report N] [--out file.snap]"
+        },
+        {
+            "shaders", RunShaders,
+            "shaders <cache-dir> [--source dir] [--prune]"
+        },
+        {
+            "frames", RunFrames,
+            "frames [--count N] [--frames N] [--simulate] [--dt seconds] [--updates N] [--readback-every N]\n"
+            "      [--latency N] [--sun x,y,z] [--seed N] [--threads N] [--report N] [--cull]\n"
+            "      [--trace trace.json]"
+        },
+        {
+            "render", RunRender,
+            "render <particles.snap> <out.ppm|png> [--width N] [--height N] [--camera x,y,z] [--look x,y,z]\n"
+            "      [--shadows shadows.snap] [--no-light] [--unsorted] [--no-cull] [--threads N] [--simd auto|scalar]"
+        },
+        {
+            "diff", RunDiff,
+            "diff <golden.ppm> <new.ppm> [--threshold delta-e] [--max-fraction f] [--no-blur] [--out heat.ppm|png]"
+        },
+        {
+            "sort", RunSort,
+            "sort [--count N] [--camera x,y,z] [--threads N] [--repeat N]"
+        },
+    };
+
+    void PrintUsage()
+    {
+        std::fprintf(stderr, "usage: shadow-tool <command> [options]\n\n");
+        for (const Command& command : commands)
+        {
+            std::fprintf(stderr, "  %s\n\n", command.usage);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    for (const Command& command : commands)
+    {
+        if (std::strcmp(argv[1], command.name) == 0)
+        {
+            return command.run(CommandLine(argc, argv, 2));
+        }
+    }
+
+    std::fprintf(stderr, "unknown command '%s'\n\n", argv[1]);
+    PrintUsage();
+    return 1;
+}
@@ -0,0 +1,178 @@
+#include "Commands.h"
+
+#include "DepthSort.h"
+#include "FrustumCull.h"
+#include "RgbaImage.h"
+#include "ShadowEngine.h"
+#include "ShadowSnapshot.h"
+#include "SplatRasterizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+int RunRender(const CommandLine& args)
+{
+    const std::vector<std::string>& paths = args.GetPositional();
+    if (paths.size() != 2)
+    {
+        std::fprintf(stderr, "render: expected a particle snapshot and an output image\n");
+        return 1;
+    }
+
+    SplatSettings settings;
+    uint64_t width = settings.width;
+    uint64_t height = settings.height;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!CommandLine::ParseUInt64(args.Get("width", std::to_string(width)), width) || width == 0 || width > 16384
+        || !CommandLine::ParseUInt64(args.Get("height", std::to_string(height)), height) || height == 0 || height > 16384
+        || !CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0)
+    {
+        std::fprintf(stderr, "render: --width and --height expect sizes up to 16384, --threads a positive integer\n");
+        return 1;
+    }
+    settings.width = static_cast<uint32_t>(width);
+    settings.height = static_cast<uint32_t>(height);
+
+    // the camera the demo starts with
+    DirectX::XMFLOAT3 position(0.0f, 0.0f, 1500.0f);
+    DirectX::XMFLOAT3 look(0.0f, 0.0f, -1.0f);
+    std::string positionValue = args.Get("camera");
+    std::string lookValue = args.Get("look");
+    if ((!positionValue.empty() && !CommandLine::ParseFloat3(positionValue, position))
+        || (!lookValue.empty() && (!CommandLine::ParseFloat3(lookValue, look) || SunBasis::Dot(look, look) == 0.0f)))
+    {
+        std::fprintf(stderr, "render: --camera expects x,y,z and --look a non-zero x,y,z\n");
+        return 1;
+    }
+
+    std::string simd = args.Get("simd", "auto");
+    if (simd != "auto" && simd != "scalar")
+    {
+        std::fprintf(stderr, "render: --simd expects auto or scalar, got '%s'\n", simd.c_str());
+        return 1;
+    }
+
+    std::string error;
+    SnapshotReader input;
+    if (!input.Open(paths[0].c_str(), error))
+    {
+        std::fprintf(stderr, "render: %s\n", error.c_str());
+        return 1;
+    }
+
+    const float* x = input.GetSection(SnapshotSection::PositionX);
+    const float* y = input.GetSection(SnapshotSection::PositionY);
+    const float* z = input.GetSection(SnapshotSection::PositionZ);
+    const float* radius = input.GetSection(SnapshotSection::Radius);
+    const float* opacity = input.GetSection(SnapshotSection::Opacity);
+    if (x == nullptr || y == nullptr || z == nullptr || radius == nullptr || opacity == nullptr || input.GetCount() == 0)
+    {
+        std::fprintf(stderr, "render: '%s' holds no particles\n", paths[0].c_str());
+        return 1;
+    }
+
+    // snapshots keep no color, every particle gets the one the demo draws with
+    std::vector<Particle> particles(static_cast<size_t>(input.GetCount()));
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        particles[i].pos = DirectX::XMFLOAT3(x[i], y[i], z[i]);
+        particles[i].radius = radius[i];
+        particles[i].opacity = opacity[i];
+    }
+
+    // the demo draws its last particle as the light source
+    if (!args.Has("no-light"))
+    {
+        settings.lightSourceIndex = static_cast<uint32_t>(particles.size() - 1);
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+
+    // shadows from --shadows, then from the snapshot itself, computed when neither has them
+    SnapshotReader shadowInput;
+    const float* shadows = input.GetSection(SnapshotSection::Shadow);
+    std::vector<float> computed;
+
+    std::string shadowPath = args.Get("shadows");
+    if (!shadowPath.empty())
+    {
+        if (!shadowInput.Open(shadowPath.c_str(), error))
+        {
+            std::fprintf(stderr, "render: %s\n", error.c_str());
+            return 1;
+        }
+
+        shadows = shadowInput.GetSection(SnapshotSection::Shadow);
+        if (shadows == nullptr || shadowInput.GetCount() != input.GetCount())
+        {
+            std::fprintf(stderr, "render: '%s' holds no shadows for the %llu particles\n", shadowPath.c_str(), static_cast<unsigned long long>(input.GetCount()));
+            return 1;
+        }
+    }
+    else if (shadows == nullptr)
+    {
+        if (!SunBasis::IsValidDirection(input.GetSunDir()))
+        {
+            std::fprintf(stderr, "render: '%s' has neither shadows nor a sun direction to compute them, pass --shadows\n", paths[0].c_str());
+            return 1;
+        }
+
+        ShadowEngine engine(SunBasis::FromDirection(input.GetSunDir()));
+        engine.ComputeGrid(particles, computed, &pool);
+        shadows = computed.data();
+    }
+
+    float aspectRatio = static_cast<float>(settings.width) / static_cast<float>(settings.height);
+    SplatCamera camera = SplatCamera::LookTo(position, look, DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), 0.8f, aspectRatio, 1.0f, 5000.0f);
+
+    SplatRasterizer rasterizer(settings);
+    if (simd == "scalar")
+    {
+        rasterizer.SetSimdLevel(SimdLevel::Scalar);
+    }
+
+    RgbaImage image;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // back to front like the demo, --unsorted draws in index order
+    DepthSorter sorter;
+    const uint32_t* drawOrder = nullptr;
+    size_t drawCount = particles.size();
+    if (!args.Has("unsorted"))
+    {
+        drawOrder = sorter.Sort(particles.data(), particles.size(), ViewDepth::FromInvView(camera.invViewMat), &pool).data();
+    }
+
+    // then only what can reach the view, in the same order; --no-cull sets up every sprite
+    FrustumCuller culler;
+    if (!args.Has("no-cull"))
+    {
+        const std::vector<uint32_t>& visible = culler.Cull(particles.data(), particles.size(), Frustum::FromViewProjection(camera.wvpMat), drawOrder, &pool);
+        drawOrder = visible.data();
+        drawCount = visible.size();
+    }
+
+    SplatStats stats = rasterizer.Render(particles.data(), shadows, drawCount, camera, image, &pool, drawOrder);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!WriteImage(paths[1].c_str(), image, error))
+    {
+        std::fprintf(stderr, "render: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::printf("%ux%u, %s: %llu sprites drawn, %llu culled, %llu clipped, %llu tile bins, %llu pixels shaded in %.2f ms\n",
+        settings.width, settings.height, rasterizer.GetSimdLevel() == SimdLevel::Scalar ? "scalar" : "avx2",
+        static_cast<unsigned long long>(stats.drawnSprites), static_cast<unsigned long long>(particles.size() - drawCount),
+        static_cast<unsigned long long>(stats.clippedSprites),
+        static_cast<unsigned long long>(stats.binnedSprites), static_cast<unsigned long long>(stats.shadedPixels), seconds * 1000.0);
+
+    std::fprintf(stderr, "render: wrote '%s'\n", paths[1].c_str());
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "ReportTable.h"
+
+#include <cmath>
+#include <cstdio>
+
+ReportTable::ReportTable(const std::vector<std::string>& columns) : m_Columns(columns)
+{
+}
+
+void ReportTable::AddRow()
+{
+    m_Rows.emplace_back(m_Columns.size());
+}
+
+void ReportTable::Set(const std::string& column, const std::string& text)
+{
+    Cell& cell = At(column);
+    cell.text = text;
+    cell.isSet = true;
+    cell.isNumber = false;
+}
+
+void ReportTable::Set(const std::string& column, const char* text)
+{
+    Set(column, std::string(text));
+}
+
+void ReportTable::Set(const std::string& column, double value)
+{
+    Cell& cell = At(column);
+
+    // JSON has no inf/nan, those stay null
+    if (!std::isfinite(value))
+    {
+        cell = Cell();
+        return;
+    }
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+
+    cell.text = buffer;
+    cell.isSet = true;
+    cell.isNumber = true;
+}
+
+void ReportTable::Set(const std::string& column, uint64_t value)
+{
+    Cell& cell = At(column);
+    cell.text = std::to_string(value);
+    cell.isSet = true;
+    cell.isNumber = true;
+}
+
+void ReportTable::WriteCsv(std::ostream& out) const
+{
+    for (size_t c = 0; c < m_Columns.size(); ++c)
+    {
+        out << (c > 0 ? "," : "") << m_Columns[c];
+    }
+    out << "\n";
+
+    for (const std::vector<Cell>& row : m_Rows)
+    {
+        for (size_t c = 0; c < row.size(); ++c)
+        {
+            out << (c > 0 ? "," : "") << row[c].text;
+        }
+        out << "\n";
+    }
+}
+
+void ReportTable::WriteJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& metadata) const
+{
+    out << "{\n  \"metadata\": {";
+    for (size_t i = 0; i < metadata.size(); ++i)
+    {
+        out << (i > 0 ? ", " : "") << "\"" << EscapeJson(metadata[i].first) << "\": \"" << EscapeJson(metadata[i].second) << "\"";
+    }
+    out << "},\n  \"rows\": [";
+
+    for (size_t r = 0; r < m_Rows.size(); ++r)
+    {
+        out << (r > 0 ? "," : "") << "\n    {";
+
+        const std::vector<Cell>& row = m_Rows[r];
+        for (size_t c = 0; c < row.size(); ++c)
+        {
+            out << (c > 0 ? ", " : "") << "\"" << EscapeJson(m_Columns[c]) << "\": ";
+
+            if (!row[c].isSet)
+            {
+                out << "null";
+            }
+            else if (row[c].isNumber)
+            {
+                out << row[c].text;
+            }
+            else
+            {
+                out << "\"" << EscapeJson(row[c].text) << "\"";
+            }
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+ReportTable::Cell& ReportTable::At(const std::string& column)
+{
+    size_t c = 0;
+    while (c < m_Columns.size() && m_Columns[c] != column)
+    {
+        ++c;
+    }
+
+    // an unknown column is a programming error, grow the table rather than write out of bounds
+    if (c == m_Columns.size())
+    {
+        m_Columns.push_back(column);
+        for (std::vector<Cell>& row : m_Rows)
+        {
+            row.resize(m_Columns.size());
+        }
+    }
+
+    if (m_Rows.empty())
+    {
+        AddRow();
+    }
+    return m_Rows.back()[c];
+}
+
+std::string ReportTable::EscapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            escaped += "\\\"";
+            break;
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
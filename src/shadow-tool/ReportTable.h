@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Rows of named columns written as CSV or JSON. Cells left unset are empty in CSV and null in JSON.
+class ReportTable
+{
+public:
+    explicit ReportTable(const std::vector<std::string>& columns);
+
+    // starts a new row, the Set calls fill it
+    void AddRow();
+
+    void Set(const std::string& column, const std::string& text);
+    void Set(const std::string& column, const char* text);
+    void Set(const std::string& column, double value);
+    void Set(const std::string& column, uint64_t value);
+
+    size_t GetRowCount() const { return m_Rows.size(); }
+
+    void WriteCsv(std::ostream& out) const;
+
+    // {"metadata": {...}, "rows": [{...}, ...]}, metadata values are written as strings
+    void WriteJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& metadata) const;
+
+private:
+    struct Cell
+    {
+        std::string text;
+        bool isSet = false;
+        bool isNumber = false;
+    };
+
+    Cell& At(const std::string& column);
+
+    static std::string EscapeJson(const std::string& text);
+
+    std::vector<std::string> m_Columns;
+    std::vector<std::vector<Cell>> m_Rows;
+};
@@ -0,0 +1,82 @@
+#include "Commands.h"
+
+#include "RadixSort.h"
+#include "SceneGenerator.h"
+#include "ShadowSnapshot.h"
+#include "SunBasis.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int RunScene(const CommandLine& args)
+{
+    SceneShape shape;
+    std::string sceneArg = args.Get("scene", "sphere");
+    if (!ParseSceneShape(sceneArg.c_str(), shape))
+    {
+        std::fprintf(stderr, "scene: unknown --scene '%s'\n", sceneArg.c_str());
+        return 1;
+    }
+
+    uint64_t count = 1024;
+    uint64_t seed = 0;
+    if (!CommandLine::ParseUInt64(args.Get("count", std::to_string(count)), count) || count > UINT32_MAX
+        || !CommandLine::ParseUInt64(args.Get("seed", std::to_string(seed)), seed))
+    {
+        std::fprintf(stderr, "scene: --count and --seed expect integers, --count below 2^32\n");
+        return 1;
+    }
+
+    // the demo's sun at (-700, 500, 0)
+    DirectX::XMFLOAT3 sunDir(-700.0f, 500.0f, 0.0f);
+    std::string sun = args.Get("sun");
+    if (!sun.empty() && (!CommandLine::ParseFloat3(sun, sunDir) || !SunBasis::IsValidDirection(sunDir)))
+    {
+        std::fprintf(stderr, "scene: --sun expects a non-zero, finite x,y,z, got '%s'\n", sun.c_str());
+        return 1;
+    }
+
+    std::string outPath = args.Get("out");
+    if (outPath.empty())
+    {
+        std::fprintf(stderr, "scene: --out is required\n");
+        return 1;
+    }
+
+    std::vector<Particle> particles = GenerateScene(shape, static_cast<uint32_t>(count), sunDir, static_cast<uint32_t>(seed));
+
+    // from the nearest to the sun to the farthest, the order the streaming baker expects
+    SunBasis basis = SunBasis::FromDirection(sunDir);
+
+    std::vector<uint32_t> keys(particles.size());
+    std::vector<uint32_t> order(particles.size());
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        keys[i] = ~FloatToSortableKey(basis.Project(particles[i].pos).x);
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    RadixSorter sorter;
+    sorter.Sort(keys, order);
+
+    std::vector<Particle> sorted(particles.size());
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        sorted[i] = particles[order[i]];
+    }
+
+    SnapshotWriter writer(sorted.size(), sunDir);
+    writer.AddParticles(sorted.data());
+
+    std::string error;
+    if (!writer.Write(outPath.c_str(), error))
+    {
+        std::fprintf(stderr, "scene: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::fprintf(stderr, "scene: wrote %llu %s particles to '%s'\n", static_cast<unsigned long long>(sorted.size()), GetSceneShapeName(shape), outPath.c_str());
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "Commands.h"
+
+#include "PipelineCache.h"
+#include "ShaderCache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int RunShaders(const CommandLine& args)
+{
+    if (args.GetPositional().size() != 1)
+    {
+        std::fprintf(stderr, "shaders: expects the cache directory\n");
+        return 1;
+    }
+
+    std::string error;
+    ShaderCache cache;
+    if (!cache.Open(args.GetPositional()[0], error))
+    {
+        std::fprintf(stderr, "shaders: %s\n", error.c_str());
+        return 1;
+    }
+
+    // with --source, each entry is also checked against the key the current sources give
+    std::string sourceDirectory = args.Get("source");
+
+    size_t bad = 0;
+    size_t stale = 0;
+
+    std::vector<uint8_t> bytecode;
+    for (const ShaderCache::Entry& entry : cache.GetEntries())
+    {
+        const char* status = "ok";
+
+        ShaderPermutation permutation;
+        uint64_t sourceHash;
+        if (!cache.Load(entry.key, bytecode))
+        {
+            status = "bad";
+            ++bad;
+        }
+        else if (!sourceDirectory.empty())
+        {
+            if (!ParsePermutation(entry.description, permutation))
+            {
+                status = "unknown";
+                ++stale;
+            }
+            else if (!HashShaderSource(sourceDirectory, permutation.file, sourceHash, error))
+            {
+                std::fprintf(stderr, "shaders: %s\n", error.c_str());
+                return 1;
+            }
+            else if (ShaderCacheKey(permutation, sourceHash) != entry.key)
+            {
+                status = "stale";
+                ++stale;
+            }
+        }
+
+        std::printf("%016llx %8llu %-7s %s\n", static_cast<unsigned long long>(entry.key), static_cast<unsigned long long>(entry.size), status, entry.description.c_str());
+    }
+
+    if (args.Has("prune") && bad > 0)
+    {
+        size_t pruned = cache.Prune(error);
+        if (!error.empty())
+        {
+            std::fprintf(stderr, "shaders: %s\n", error.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "shaders: dropped %llu entries without a matching blob\n", static_cast<unsigned long long>(pruned));
+        bad = 0;
+    }
+
+    // pipeline blobs only load on the adapter and driver in the header, show which
+    PipelineCache pipelines;
+    std::string pipelinesPath = cache.GetDirectory() + "/pipelines.bin";
+    if (!pipelines.Load(pipelinesPath, nullptr, error))
+    {
+        std::fprintf(stderr, "shaders: %s\n", error.c_str());
+        ++bad;
+    }
+    else if (pipelines.GetEntryCount() > 0)
+    {
+        const PipelineCacheIdentity& identity = pipelines.GetIdentity();
+        std::printf("pipelines.bin: %llu pipelines for vendor 0x%04x device 0x%04x driver %u.%u.%u.%u\n",
+            static_cast<unsigned long long>(pipelines.GetEntryCount()), identity.vendorId, identity.deviceId,
+            static_cast<unsigned>(identity.driverVersion >> 48), static_cast<unsigned>(identity.driverVersion >> 32 & 0xFFFF),
+            static_cast<unsigned>(identity.driverVersion >> 16 & 0xFFFF), static_cast<unsigned>(identity.driverVersion & 0xFFFF));
+    }
+
+    std::fprintf(stderr, "shaders: %llu entries, %llu bad, %llu stale\n", static_cast<unsigned long long>(cache.GetEntries().size()),
+        static_cast<unsigned long long>(bad), static_cast<unsigned long long>(stale));
+    return bad > 0 || stale > 0 ? 1 : 0;
+}
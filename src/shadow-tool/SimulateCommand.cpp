@@ -0,0 +1,113 @@
+#include "Commands.h"
+
+#include "ParticleSimulation.h"
+#include "SceneGenerator.h"
+#include "ShadowEngine.h"
+#include "ShadowSnapshot.h"
+#include "SunBasis.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+int RunSimulate(const CommandLine& args)
+{
+    uint64_t count = 1024;
+    uint64_t frames = 600;
+    uint64_t seed = 0;
+    uint64_t report = 60;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!CommandLine::ParseUInt64(args.Get("count", std::to_string(count)), count) || count == 0 || count > UINT32_MAX
+        || !CommandLine::ParseUInt64(args.Get("frames", std::to_string(frames)), frames)
+        || !CommandLine::ParseUInt64(args.Get("seed", std::to_string(seed)), seed)
+        || !CommandLine::ParseUInt64(args.Get("report", std::to_string(report)), report)
+        || !CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0)
+    {
+        std::fprintf(stderr, "simulate: --count and --threads expect positive integers, --frames, --seed and --report integers\n");
+        return 1;
+    }
+
+    // the demo scene and the drift RenderSystem gives it
+    SimulationSettings settings;
+    settings.emitterSpread = 330.0f * std::cbrt(static_cast<float>(count) / 1024.0f);
+    settings.emitVelocity = DirectX::XMFLOAT3(0.0f, 0.0f, -20.0f);
+    settings.velocitySpread = 10.0f;
+    settings.lifetimeMin = 10.0f;
+    settings.lifetimeMax = 20.0f;
+    settings.emissionRate = static_cast<float>(count) / 15.0f;
+    settings.seed = static_cast<uint32_t>(seed);
+
+    float deltaTime = 1.0f / 60.0f;
+    std::string gravity = args.Get("gravity");
+    if (!CommandLine::ParseFloat(args.Get("dt", std::to_string(deltaTime)), deltaTime) || deltaTime < 0.0f
+        || !CommandLine::ParseFloat(args.Get("rate", std::to_string(settings.emissionRate)), settings.emissionRate)
+        || !CommandLine::ParseFloat(args.Get("drag", std::to_string(settings.drag)), settings.drag)
+        || (!gravity.empty() && !CommandLine::ParseFloat3(gravity, settings.gravity)))
+    {
+        std::fprintf(stderr, "simulate: --dt, --rate and --drag expect numbers, --dt not negative, --gravity x,y,z\n");
+        return 1;
+    }
+
+    DirectX::XMFLOAT3 sunDir(-700.0f, 500.0f, 0.0f);
+    std::string sun = args.Get("sun");
+    if (!sun.empty() && (!CommandLine::ParseFloat3(sun, sunDir) || !SunBasis::IsValidDirection(sunDir)))
+    {
+        std::fprintf(stderr, "simulate: --sun expects a non-zero, finite x,y,z, got '%s'\n", sun.c_str());
+        return 1;
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, static_cast<uint32_t>(count), sunDir);
+
+    ParticleSimulation simulation(settings);
+    simulation.Reset(particles.data(), particles.size());
+
+    for (uint64_t frame = 1; frame <= frames; ++frame)
+    {
+        SimulationStepStats stats = simulation.Step(deltaTime, &pool);
+
+        if (report > 0 && (frame % report == 0 || frame == frames))
+        {
+            std::printf("frame %llu: alive %u, killed %u, emitted %u\n", static_cast<unsigned long long>(frame), stats.alive, stats.killed, stats.emitted);
+        }
+    }
+
+    // the same settings, seed and steps always give the same state, whatever --threads says
+    const std::vector<Particle>& result = simulation.GetParticles();
+    const std::vector<ParticleMotion>& motion = simulation.GetMotion();
+
+    uint64_t checksum = SnapshotChecksum(result.data(), result.size() * sizeof(Particle));
+    checksum = SnapshotChecksum(motion.data(), motion.size() * sizeof(ParticleMotion), checksum);
+    std::printf("state checksum %016llx\n", static_cast<unsigned long long>(checksum));
+
+    std::string outPath = args.Get("out");
+    if (outPath.empty())
+    {
+        return 0;
+    }
+
+    // shadows of the live set as the shadow pass sees it, dead particles have no radius or opacity
+    std::vector<float> shadows;
+    ShadowEngine engine(SunBasis::FromDirection(sunDir));
+    engine.ComputeGrid(result, shadows, &pool);
+
+    SnapshotWriter writer(result.size(), sunDir);
+    writer.AddParticles(result.data());
+    writer.AddSection(SnapshotSection::Shadow, shadows.data());
+
+    std::string error;
+    if (!writer.Write(outPath.c_str(), error))
+    {
+        std::fprintf(stderr, "simulate: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::fprintf(stderr, "simulate: wrote %llu particles after %llu frames to '%s'\n", static_cast<unsigned long long>(result.size()), static_cast<unsigned long long>(frames), outPath.c_str());
+    return 0;
+}
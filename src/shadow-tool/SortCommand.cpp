@@ -0,0 +1,129 @@
+#include "Commands.h"
+
+#include "DepthSort.h"
+#include "RadixSort.h"
+#include "SceneGenerator.h"
+#include "SplatRasterizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // the fastest of repeat runs of run(), in milliseconds
+    template <typename Run>
+    double TimeBest(uint64_t repeat, Run run)
+    {
+        double best = 0.0;
+        for (uint64_t i = 0; i < repeat; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = i == 0 ? milliseconds : std::min(best, milliseconds);
+        }
+        return best;
+    }
+}
+
+int RunSort(const CommandLine& args)
+{
+    uint64_t count = 1 << 20;
+    uint64_t repeat = 5;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!CommandLine::ParseUInt64(args.Get("count", std::to_string(count)), count) || count == 0 || count > UINT32_MAX
+        || !CommandLine::ParseUInt64(args.Get("repeat", std::to_string(repeat)), repeat) || repeat == 0
+        || !CommandLine::ParseUInt64(args.Get("threads", std::to_string(threads)), threads) || threads == 0)
+    {
+        std::fprintf(stderr, "sort: --count, --repeat and --threads expect positive integers\n");
+        return 1;
+    }
+
+    DirectX::XMFLOAT3 position(0.0f, 0.0f, 1500.0f);
+    std::string positionValue = args.Get("camera");
+    if (!positionValue.empty() && !CommandLine::ParseFloat3(positionValue, position))
+    {
+        std::fprintf(stderr, "sort: --camera expects x,y,z, got '%s'\n", positionValue.c_str());
+        return 1;
+    }
+
+    ThreadPool pool(static_cast<size_t>(threads));
+
+    std::vector<Particle> particles = GenerateScene(SceneShape::Sphere, static_cast<uint32_t>(count), DirectX::XMFLOAT3(-700.0f, 500.0f, 0.0f));
+
+    // the demo camera moved to position, still looking down -z
+    SplatCamera camera = SplatCamera::LookTo(position, DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f), DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), 0.8f, 800.0f / 600.0f, 1.0f, 5000.0f);
+    ViewDepth view = ViewDepth::FromInvView(camera.invViewMat);
+
+    std::vector<uint32_t> keys(particles.size());
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        keys[i] = DepthSortKey(view, particles[i].pos);
+    }
+
+    // the order every sort has to produce, ties in index order
+    std::vector<uint32_t> expected(particles.size());
+    std::iota(expected.begin(), expected.end(), 0u);
+
+    double stableMs = TimeBest(1, [&]()
+        {
+            std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        });
+
+    RadixSorter sorter;
+    std::vector<uint32_t> sortedKeys;
+    std::vector<uint32_t> order;
+    auto reset = [&]()
+        {
+            sortedKeys = keys;
+            order.resize(keys.size());
+            std::iota(order.begin(), order.end(), 0u);
+        };
+
+    int failures = 0;
+    auto check = [&](const char* name, const std::vector<uint32_t>& result)
+        {
+            if (result != expected)
+            {
+                std::fprintf(stderr, "sort: %s differs from std::stable_sort\n", name);
+                ++failures;
+            }
+        };
+
+    double serialMs = 0.0;
+    double parallelMs = 0.0;
+    for (uint64_t i = 0; i < repeat; ++i)
+    {
+        reset();
+        double ms = TimeBest(1, [&]() { sorter.Sort(sortedKeys.data(), order.data(), order.size()); });
+        serialMs = i == 0 ? ms : std::min(serialMs, ms);
+    }
+    check("RadixSorter::Sort", order);
+
+    for (uint64_t i = 0; i < repeat; ++i)
+    {
+        reset();
+        double ms = TimeBest(1, [&]() { sorter.SortParallel(pool, sortedKeys.data(), order.data(), order.size()); });
+        parallelMs = i == 0 ? ms : std::min(parallelMs, ms);
+    }
+    check("RadixSorter::SortParallel", order);
+
+    // what the software rasterizer pays per frame, keys included
+    DepthSorter depthSorter;
+    double depthSortMs = TimeBest(repeat, [&]() { depthSorter.Sort(particles.data(), particles.size(), view, &pool); });
+    check("DepthSorter", depthSorter.GetOrder());
+
+    std::printf("%llu particles, %llu threads\n", static_cast<unsigned long long>(count), static_cast<unsigned long long>(pool.GetWorkerCount()));
+    std::printf("  std::stable_sort     %9.3f ms\n", stableMs);
+    std::printf("  radix serial         %9.3f ms\n", serialMs);
+    std::printf("  radix parallel       %9.3f ms\n", parallelMs);
+    std::printf("  depth sort (keys+)   %9.3f ms\n", depthSortMs);
+
+    return failures > 0 ? 1 : 0;
+}